@@ -156,6 +156,31 @@ LPTSTR BatchParams(LPTSTR s1, LPTSTR s2)
     return dp;
 }
 
+/*
+ * free the label index of a batch file
+ */
+static VOID FreeBatchLabels(VOID)
+{
+    LPBATCH_LABEL label, next;
+    INT i;
+
+    if (bc->labels && bc->labelsfree)
+    {
+        for (i = 0; i < BATCH_LABEL_BUCKETS; i++)
+        {
+            for (label = bc->labels->buckets[i]; label; label = next)
+            {
+                next = label->next;
+                cmd_free(label);
+            }
+        }
+        cmd_free(bc->labels);
+    }
+
+    bc->labels = NULL;
+    bc->labelsfree = FALSE;
+}
+
 /*
  * free the allocated memory of a batch file
  */
@@ -163,6 +188,8 @@ VOID ClearBatch(VOID)
 {
     TRACE ("ClearBatch  mem = %08x    free = %d\n", bc->mem, bc->memfree);
 
+    FreeBatchLabels();
+
     if (bc->mem && bc->memfree)
         cmd_free(bc->mem);
 
@@ -227,6 +254,125 @@ void BatchFile2Mem(HANDLE hBatchFile)
         bc->memfree=FALSE;
     }
     bc->mempos = 0;                 /* set position to the start */
+    bc->labels = NULL;              /* the label index is built on demand */
+    bc->labelsfree = FALSE;
+}
+
+/*
+ * Case-insensitive hash of a label name
+ */
+static UINT BatchLabelHash(LPCTSTR name)
+{
+    UINT hash = 0;
+
+    while (*name)
+        hash = hash * 31 + (TCHAR)_totupper(*name++);
+
+    return hash % BATCH_LABEL_BUCKETS;
+}
+
+/*
+ * Scan the whole batch file once and record every label together with
+ * the position of the line following it. Only the first occurrence of
+ * a label is kept, as GOTO always jumps to the first one.
+ */
+static BOOL BatchBuildLabels(VOID)
+{
+    LPBATCH_LABEL label;
+    DWORD savedpos = bc->mempos;
+    LPTSTR tmp, name;
+    INT_PTR size;
+    UINT hash;
+    INT pos;
+
+    bc->labels = (LPBATCH_LABELS)cmd_alloc(sizeof(BATCH_LABELS));
+    if (bc->labels == NULL)
+    {
+        WARN("Cannot allocate memory for the batch label index!\n");
+        error_out_of_memory();
+        return FALSE;
+    }
+    ZeroMemory(bc->labels, sizeof(BATCH_LABELS));
+    bc->labelsfree = TRUE;
+
+    bc->mempos = 0;
+    while (BatchGetString(textline, sizeof(textline) / sizeof(textline[0])))
+    {
+        /* Strip out any trailing spaces or control chars */
+        tmp = textline + _tcslen (textline) - 1;
+
+        while (tmp > textline && (_istcntrl (*tmp) || _istspace (*tmp) ||  (*tmp == _T(':'))))
+            tmp--;
+        *(tmp + 1) = _T('\0');
+
+        /* Then leading spaces... */
+        tmp = textline;
+        while (_istspace (*tmp))
+            tmp++;
+
+        if (*tmp != _T(':'))
+            continue;
+
+        /* All space after leading space terminate the string */
+        size = _tcslen(tmp) -1;
+        pos=0;
+        while (tmp+pos < tmp+size)
+        {
+            if (_istspace(tmp[pos]))
+                tmp[pos]=_T('\0');
+            pos++;
+        }
+
+        name = tmp + 1;
+        hash = BatchLabelHash(name);
+        for (label = bc->labels->buckets[hash]; label; label = label->next)
+        {
+            if (_tcsicmp(label->name, name) == 0)
+                break;
+        }
+        if (label)
+            continue;
+
+        label = (LPBATCH_LABEL)cmd_alloc(sizeof(BATCH_LABEL) + _tcslen(name) * sizeof(TCHAR));
+        if (label == NULL)
+        {
+            WARN("Cannot allocate memory for a batch label!\n");
+            error_out_of_memory();
+            FreeBatchLabels();
+            bc->mempos = savedpos;
+            return FALSE;
+        }
+        _tcscpy(label->name, name);
+        label->pos = bc->mempos;
+        label->next = bc->labels->buckets[hash];
+        bc->labels->buckets[hash] = label;
+    }
+
+    bc->mempos = savedpos;
+    return TRUE;
+}
+
+/*
+ * Look up a label (without its leading colon) in the current batch file.
+ * On success, pos receives the position of the line following the label.
+ */
+BOOL BatchFindLabel(LPCTSTR name, LPDWORD pos)
+{
+    LPBATCH_LABEL label;
+
+    if (bc->labels == NULL && !BatchBuildLabels())
+        return FALSE;
+
+    for (label = bc->labels->buckets[BatchLabelHash(name)]; label; label = label->next)
+    {
+        if (_tcsicmp(label->name, name) == 0)
+        {
+            *pos = label->pos;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
 }
 
 /*
@@ -306,6 +452,8 @@ INT Batch(LPTSTR fullname, LPTSTR firstword, LPTSTR param, PARSED_COMMAND *Cmd)
             new.memsize = bc->memsize;
             new.mempos  = 0;
             new.memfree = FALSE;    /* don't free this, being used before this */
+            new.labels  = bc->labels;
+            new.labelsfree = FALSE; /* the label index is shared as well */
         }
         bc = &new;
         bc->RedirList = NULL;
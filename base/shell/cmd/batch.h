@@ -4,6 +4,20 @@
 
 #pragma once
 
+#define BATCH_LABEL_BUCKETS 256
+
+typedef struct tagBATCHLABEL
+{
+    struct tagBATCHLABEL *next;
+    DWORD   pos;        /* position of the line following the label */
+    TCHAR   name[1];    /* label name, without the leading colon */
+} BATCH_LABEL, *LPBATCH_LABEL;
+
+typedef struct tagBATCHLABELS
+{
+    LPBATCH_LABEL buckets[BATCH_LABEL_BUCKETS];
+} BATCH_LABELS, *LPBATCH_LABELS;
+
 typedef struct tagBATCHCONTEXT
 {
     struct tagBATCHCONTEXT *prev;
@@ -11,6 +25,8 @@ typedef struct tagBATCHCONTEXT
     DWORD   memsize;    /* size of batchfile */
     DWORD   mempos;     /* current position to read from */
     BOOL    memfree;    /* true if it need to be freed when exitbatch is called */	
+    LPBATCH_LABELS labels;  /* label index of mem, built on first GOTO */
+    BOOL    labelsfree; /* true if labels need to be freed when exitbatch is called */
     TCHAR BatchFilePath[MAX_PATH];
     LPTSTR params;
     LPTSTR raw_params;  /* Holds the raw params given by the input */
@@ -50,5 +66,6 @@ LPTSTR BatchParams(LPTSTR, LPTSTR);
 VOID   ExitBatch(VOID);
 INT    Batch(LPTSTR, LPTSTR, LPTSTR, PARSED_COMMAND *);
 BOOL   BatchGetString(LPTSTR lpBuffer, INT nBufferLength);
+BOOL   BatchFindLabel(LPCTSTR label, LPDWORD pos);
 LPTSTR ReadBatchLine(VOID);
 VOID   AddBatchRedirection(REDIRECTION **);
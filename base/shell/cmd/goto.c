@@ -38,7 +38,9 @@
 
 INT cmd_goto (LPTSTR param)
 {
-    LPTSTR tmp, tmp2;
+    LPTSTR tmp;
+    DWORD pos, pos2;
+    BOOL found;
 
     TRACE ("cmd_goto (\'%s\')\n", debugstr_aw(param));
 
@@ -74,41 +76,20 @@ INT cmd_goto (LPTSTR param)
         return 0;
     }
 
-    /* jump to begin of the file */
-    bc->mempos=0;
-
-    while (BatchGetString (textline, sizeof(textline) / sizeof(textline[0])))
+    /* Look the label up in the label index of the batch file. A line
+     * ":label" matches both the given parameter and the parameter without
+     * its first character; the first matching line in the file wins. */
+    found = BatchFindLabel(param, &pos);
+    if (BatchFindLabel(param + 1, &pos2) && (!found || pos2 < pos))
     {
-        int pos;
-        INT_PTR size;
-
-        /* Strip out any trailing spaces or control chars */
-        tmp = textline + _tcslen (textline) - 1;
-
-        while (tmp > textline && (_istcntrl (*tmp) || _istspace (*tmp) ||  (*tmp == _T(':'))))
-            tmp--;
-        *(tmp + 1) = _T('\0');
-
-        /* Then leading spaces... */
-        tmp = textline;
-        while (_istspace (*tmp))
-            tmp++;
-
-        /* All space after leading space terminate the string */
-        size = _tcslen(tmp) -1;
-        pos=0;
-        while (tmp+pos < tmp+size)
-        {
-            if (_istspace(tmp[pos]))
-                tmp[pos]=_T('\0');
-            pos++;
-        }
-
-        tmp2 = param;
-        /* use whole label name */
-        if ((*tmp == _T(':')) && ((_tcsicmp (++tmp, param) == 0) || (_tcsicmp (tmp, ++tmp2) == 0)))
-            return 0;
+        pos = pos2;
+        found = TRUE;
+    }
 
+    if (found)
+    {
+        bc->mempos = pos;
+        return 0;
     }
 
     ConErrResPrintf(STRING_GOTO_ERROR2, param);
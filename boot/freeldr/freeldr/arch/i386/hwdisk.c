@@ -133,10 +133,62 @@ DiskOpen(CHAR* Path, OPENMODE OpenMode, ULONG* FileId)
     return ESUCCESS;
 }
 
+static BOOLEAN
+DiskCanUseCache(DISKCONTEXT* Context)
+{
+    /*
+     * The cache holds the sectors of a single BIOS drive. Floppies are
+     * never kept cached, and the sector size must match the one of the
+     * cached drive.
+     */
+    if (Context->DriveNumber < 0x80)
+        return FALSE;
+    if (!CacheInitializeDrive(Context->DriveNumber))
+        return FALSE;
+    return (CacheManagerDrive.BytesPerSector == Context->SectorSize);
+}
+
 static ARC_STATUS
-DiskRead(ULONG FileId, VOID* Buffer, ULONG N, ULONG* Count)
+DiskReadCached(DISKCONTEXT* Context, UCHAR* Ptr, ULONG N, ULONG* Count)
+{
+    ULONGLONG SectorOffset = Context->SectorNumber + Context->SectorOffset;
+    ULONG FullSectors = N / Context->SectorSize;
+    ULONG Length = FullSectors * Context->SectorSize;
+
+    *Count = 0;
+
+    /* Read the whole sectors straight into the caller's buffer */
+    if (FullSectors &&
+        !CacheReadDiskSectors(Context->DriveNumber, SectorOffset, FullSectors, Ptr))
+    {
+        return EIO;
+    }
+
+    /*
+     * Read the partial last sector into the disk read buffer. It lies in a
+     * single cache block, so the cache is done with the disk read buffer
+     * by the time it copies the sector out of the block.
+     */
+    if (N > Length)
+    {
+        if (!CacheReadDiskSectors(Context->DriveNumber,
+                                  SectorOffset + FullSectors,
+                                  1,
+                                  DiskReadBuffer))
+        {
+            *Count = Length;
+            return EIO;
+        }
+        RtlCopyMemory(Ptr + Length, DiskReadBuffer, N - Length);
+    }
+
+    *Count = N;
+    return ESUCCESS;
+}
+
+static ARC_STATUS
+DiskReadDirect(DISKCONTEXT* Context, VOID* Buffer, ULONG N, ULONG* Count)
 {
-    DISKCONTEXT* Context = FsGetDeviceSpecific(FileId);
     UCHAR* Ptr = (UCHAR*)Buffer;
     ULONG Length, TotalSectors, MaxSectors, ReadSectors;
     BOOLEAN ret;
@@ -178,6 +230,24 @@ DiskRead(ULONG FileId, VOID* Buffer, ULONG N, ULONG* Count)
     return (!ret) ? EIO : ESUCCESS;
 }
 
+static ARC_STATUS
+DiskRead(ULONG FileId, VOID* Buffer, ULONG N, ULONG* Count)
+{
+    DISKCONTEXT* Context = FsGetDeviceSpecific(FileId);
+
+    /*
+     * The cache fails the read when it can't allocate its blocks,
+     * so read the disk directly then.
+     */
+    if (DiskCanUseCache(Context) &&
+        DiskReadCached(Context, (UCHAR*)Buffer, N, Count) == ESUCCESS)
+    {
+        return ESUCCESS;
+    }
+
+    return DiskReadDirect(Context, Buffer, N, Count);
+}
+
 static ARC_STATUS
 DiskSeek(ULONG FileId, LARGE_INTEGER* Position, SEEKMODE SeekMode)
 {
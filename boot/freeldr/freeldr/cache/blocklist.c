@@ -24,8 +24,10 @@ DBG_DEFAULT_CHANNEL(CACHE);
 
 // Returns a pointer to a CACHE_BLOCK structure
 // Adds the block to the cache manager block list
-// in cache memory if it isn't already there
-PCACHE_BLOCK CacheInternalGetBlockPointer(PCACHE_DRIVE CacheDrive, ULONG BlockNumber)
+// in cache memory if it isn't already there.
+// BlockCount is the number of blocks the caller is
+// going to need, starting at BlockNumber.
+PCACHE_BLOCK CacheInternalGetBlockPointer(PCACHE_DRIVE CacheDrive, ULONG BlockNumber, ULONG BlockCount)
 {
     PCACHE_BLOCK    CacheBlock = NULL;
 
@@ -36,13 +38,22 @@ PCACHE_BLOCK CacheInternalGetBlockPointer(PCACHE_DRIVE CacheDrive, ULONG BlockNu
     if (CacheBlock != NULL)
     {
         TRACE("Cache hit! BlockNumber: %d CacheBlock->BlockNumber: %d\n", BlockNumber, CacheBlock->BlockNumber);
+        CacheStatistics.Hits++;
+
+        // Keep the most recently used blocks at the head of the list
+        CacheInternalOptimizeBlockList(CacheDrive, CacheBlock);
 
         return CacheBlock;
     }
 
     TRACE("Cache miss! BlockNumber: %d\n", BlockNumber);
+    CacheStatistics.Misses++;
 
-    CacheBlock = CacheInternalAddBlockToCache(CacheDrive, BlockNumber);
+    CacheBlock = CacheInternalAddBlockToCache(CacheDrive, BlockNumber, BlockCount);
+    if (CacheBlock == NULL)
+    {
+        return NULL;
+    }
 
     // Optimize the block list so it has a LRU structure
     CacheInternalOptimizeBlockList(CacheDrive, CacheBlock);
@@ -52,47 +63,41 @@ PCACHE_BLOCK CacheInternalGetBlockPointer(PCACHE_DRIVE CacheDrive, ULONG BlockNu
 
 PCACHE_BLOCK CacheInternalFindBlock(PCACHE_DRIVE CacheDrive, ULONG BlockNumber)
 {
-    PCACHE_BLOCK    CacheBlock = NULL;
+    PLIST_ENTRY        HashHead;
+    PLIST_ENTRY        Entry;
+    PCACHE_BLOCK    CacheBlock;
 
     TRACE("CacheInternalFindBlock() BlockNumber = %d\n", BlockNumber);
 
     //
-    // Make sure the block list has entries before I start searching it.
+    // Only the bucket of this block number has to be searched
     //
-    if (!IsListEmpty(&CacheDrive->CacheBlockHead))
+    HashHead = &CacheDrive->HashTable[BlockNumber & (CACHE_HASH_SIZE - 1)];
+    for (Entry = HashHead->Flink; Entry != HashHead; Entry = Entry->Flink)
     {
+        CacheBlock = CONTAINING_RECORD(Entry, CACHE_BLOCK, HashEntry);
+
         //
-        // Search the list and find the BIOS drive number
+        // We found the block, so return it
         //
-        CacheBlock = CONTAINING_RECORD(CacheDrive->CacheBlockHead.Flink, CACHE_BLOCK, ListEntry);
-
-        while (&CacheBlock->ListEntry != &CacheDrive->CacheBlockHead)
+        if (CacheBlock->BlockNumber == BlockNumber)
         {
             //
-            // We found the block, so return it
+            // Increment the blocks access count
             //
-            if (CacheBlock->BlockNumber == BlockNumber)
-            {
-                //
-                // Increment the blocks access count
-                //
-                CacheBlock->AccessCount++;
-
-                return CacheBlock;
-            }
+            CacheBlock->AccessCount++;
 
-            CacheBlock = CONTAINING_RECORD(CacheBlock->ListEntry.Flink, CACHE_BLOCK, ListEntry);
+            return CacheBlock;
         }
     }
 
     return NULL;
 }
 
-PCACHE_BLOCK CacheInternalAddBlockToCache(PCACHE_DRIVE CacheDrive, ULONG BlockNumber)
+static PCACHE_BLOCK CacheInternalInsertBlock(PCACHE_DRIVE CacheDrive, ULONG BlockNumber, PVOID BlockData)
 {
     PCACHE_BLOCK    CacheBlock = NULL;
-
-    TRACE("CacheInternalAddBlockToCache() BlockNumber = %d\n", BlockNumber);
+    ULONG            BlockBytes = CacheDrive->BlockSize * CacheDrive->BytesPerSector;
 
     // Check the size of the cache so we don't exceed our limits
     CacheInternalCheckCacheSizeLimits(CacheDrive);
@@ -110,29 +115,96 @@ PCACHE_BLOCK CacheInternalAddBlockToCache(PCACHE_DRIVE CacheDrive, ULONG BlockNu
     // allocate room for the block data
     RtlZeroMemory(CacheBlock, sizeof(CACHE_BLOCK));
     CacheBlock->BlockNumber = BlockNumber;
-    CacheBlock->BlockData = FrLdrTempAlloc(CacheDrive->BlockSize * CacheDrive->BytesPerSector,
-                                           TAG_CACHE_DATA);
-    if (CacheBlock->BlockData ==NULL)
+    CacheBlock->BlockData = FrLdrTempAlloc(BlockBytes, TAG_CACHE_DATA);
+    if (CacheBlock->BlockData == NULL)
     {
         FrLdrTempFree(CacheBlock, TAG_CACHE_BLOCK);
         return NULL;
     }
+    RtlCopyMemory(CacheBlock->BlockData, BlockData, BlockBytes);
+
+    // Add it to our list of blocks managed by the cache.
+    // New blocks go to the head so that the ones we read
+    // ahead are not the first to be freed.
+    InsertHeadList(&CacheDrive->CacheBlockHead, &CacheBlock->ListEntry);
+    InsertHeadList(&CacheDrive->HashTable[BlockNumber & (CACHE_HASH_SIZE - 1)], &CacheBlock->HashEntry);
 
-    // Now try to read in the block
-    if (!MachDiskReadLogicalSectors(CacheDrive->DriveNumber, (BlockNumber * CacheDrive->BlockSize), CacheDrive->BlockSize, DiskReadBuffer))
+    // Update the cache data
+    CacheBlockCount++;
+    CacheSizeCurrent = CacheBlockCount * BlockBytes;
+
+    return CacheBlock;
+}
+
+PCACHE_BLOCK CacheInternalAddBlockToCache(PCACHE_DRIVE CacheDrive, ULONG BlockNumber, ULONG BlockCount)
+{
+    PCACHE_BLOCK    CacheBlock = NULL;
+    ULONG            BlockBytes = CacheDrive->BlockSize * CacheDrive->BytesPerSector;
+    ULONG            MaxBlocks;
+    ULONG            Idx;
+
+    TRACE("CacheInternalAddBlockToCache() BlockNumber = %d BlockCount = %d\n", BlockNumber, BlockCount);
+
+    // Read ahead if this continues the last read from the disk
+    if (BlockNumber == CacheDrive->NextSequentialBlock)
     {
-        FrLdrTempFree(CacheBlock->BlockData, TAG_CACHE_DATA);
-        FrLdrTempFree(CacheBlock, TAG_CACHE_BLOCK);
-        return NULL;
+        BlockCount += CACHE_READ_AHEAD_BLOCKS;
     }
-    RtlCopyMemory(CacheBlock->BlockData, DiskReadBuffer, CacheDrive->BlockSize * CacheDrive->BytesPerSector);
 
-    // Add it to our list of blocks managed by the cache
-    InsertTailList(&CacheDrive->CacheBlockHead, &CacheBlock->ListEntry);
+    // One read can't be larger than the disk read buffer,
+    // nor take more than half of the cache
+    MaxBlocks = min(DiskReadBufferSize, CacheSizeLimit / 2) / BlockBytes;
+    BlockCount = max(min(BlockCount, MaxBlocks), 1);
 
-    // Update the cache data
-    CacheBlockCount++;
-    CacheSizeCurrent = CacheBlockCount * (CacheDrive->BlockSize * CacheDrive->BytesPerSector);
+    // Don't read the blocks that we already have again
+    for (Idx = 1; Idx < BlockCount; Idx++)
+    {
+        if (CacheInternalFindBlock(CacheDrive, BlockNumber + Idx) != NULL)
+        {
+            BlockCount = Idx;
+            break;
+        }
+    }
+
+    // Now try to read in the blocks. Reading ahead can run
+    // past the end of the disk, so retry with just the one
+    // block we were asked for if the larger read fails.
+    CacheStatistics.DiskReads++;
+    if (!MachDiskReadLogicalSectors(CacheDrive->DriveNumber, (BlockNumber * CacheDrive->BlockSize), BlockCount * CacheDrive->BlockSize, DiskReadBuffer))
+    {
+        if (BlockCount == 1)
+        {
+            return NULL;
+        }
+
+        BlockCount = 1;
+        CacheStatistics.DiskReads++;
+        if (!MachDiskReadLogicalSectors(CacheDrive->DriveNumber, (BlockNumber * CacheDrive->BlockSize), CacheDrive->BlockSize, DiskReadBuffer))
+        {
+            return NULL;
+        }
+    }
+    CacheStatistics.BytesRead += BlockCount * BlockBytes;
+    CacheDrive->NextSequentialBlock = BlockNumber + BlockCount;
+
+    // Add the block we were asked for
+    CacheBlock = CacheInternalInsertBlock(CacheDrive, BlockNumber, DiskReadBuffer);
+    if (CacheBlock == NULL)
+    {
+        return NULL;
+    }
+
+    // And the ones we read along with it, if we have the memory
+    for (Idx = 1; Idx < BlockCount; Idx++)
+    {
+        if (CacheInternalInsertBlock(CacheDrive,
+                                     BlockNumber + Idx,
+                                     (PVOID)((ULONG_PTR)DiskReadBuffer + Idx * BlockBytes)) == NULL)
+        {
+            break;
+        }
+        CacheStatistics.BlocksReadAhead++;
+    }
 
     CacheInternalDumpBlockList(CacheDrive);
 
@@ -156,12 +228,13 @@ BOOLEAN CacheInternalFreeBlock(PCACHE_DRIVE CacheDrive)
 
     // No blocks left in cache that can be freed
     // so just return
-    if (IsListEmpty(&CacheDrive->CacheBlockHead))
+    if (&CacheBlockToFree->ListEntry == &CacheDrive->CacheBlockHead)
     {
         return FALSE;
     }
 
     RemoveEntryList(&CacheBlockToFree->ListEntry);
+    RemoveEntryList(&CacheBlockToFree->HashEntry);
 
     // Free the block memory and the block structure
     FrLdrTempFree(CacheBlockToFree->BlockData, TAG_CACHE_DATA);
@@ -33,11 +33,13 @@ BOOLEAN            CacheManagerDataInvalid = FALSE;
 ULONG            CacheBlockCount = 0;
 SIZE_T            CacheSizeLimit = 0;
 SIZE_T            CacheSizeCurrent = 0;
+CACHE_STATISTICS    CacheStatistics;
 
 BOOLEAN CacheInitializeDrive(UCHAR DriveNumber)
 {
     PCACHE_BLOCK    NextCacheBlock;
     GEOMETRY    DriveGeometry;
+    ULONG        Idx;
 
     // If we already have a cache for this drive then
     // by all means lets keep it, unless it is a removable
@@ -80,6 +82,10 @@ BOOLEAN CacheInitializeDrive(UCHAR DriveNumber)
     // Initialize the structure
     RtlZeroMemory(&CacheManagerDrive, sizeof(CACHE_DRIVE));
     InitializeListHead(&CacheManagerDrive.CacheBlockHead);
+    for (Idx = 0; Idx < CACHE_HASH_SIZE; Idx++)
+    {
+        InitializeListHead(&CacheManagerDrive.HashTable[Idx]);
+    }
     CacheManagerDrive.DriveNumber = DriveNumber;
     if (!MachDiskGetDriveGeometry(DriveNumber, &DriveGeometry))
     {
@@ -90,12 +96,14 @@ BOOLEAN CacheInitializeDrive(UCHAR DriveNumber)
     // Get the number of sectors in each cache block
     CacheManagerDrive.BlockSize = MachDiskGetCacheableBlockCount(DriveNumber);
 
+    // Use up to a quarter of the memory, but leave most of
+    // the temporary heap to the loader's own allocations
     CacheBlockCount = 0;
-    CacheSizeLimit = TotalPagesInLookupTable / 8 * MM_PAGE_SIZE;
+    CacheSizeLimit = TotalPagesInLookupTable / 4 * MM_PAGE_SIZE;
     CacheSizeCurrent = 0;
-    if (CacheSizeLimit > TEMP_HEAP_SIZE - (128 * 1024))
+    if (CacheSizeLimit > CACHE_SIZE_LIMIT_MAX)
     {
-        CacheSizeLimit = TEMP_HEAP_SIZE - (128 * 1024);
+        CacheSizeLimit = CACHE_SIZE_LIMIT_MAX;
     }
 
     CacheManagerInitialized = TRUE;
@@ -151,7 +159,7 @@ BOOLEAN CacheReadDiskSectors(UCHAR DiskNumber, ULONGLONG StartSector, ULONG Sect
         //
         // Get cache block pointer (this forces the disk sectors into the cache memory)
         //
-        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, StartBlock);
+        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, StartBlock, BlockCount);
         if (CacheBlock == NULL)
         {
             return FALSE;
@@ -184,7 +192,7 @@ BOOLEAN CacheReadDiskSectors(UCHAR DiskNumber, ULONGLONG StartSector, ULONG Sect
         //
         // Get cache block pointer (this forces the disk sectors into the cache memory)
         //
-        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, Idx);
+        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, Idx, BlockCount);
         if (CacheBlock == NULL)
         {
             return FALSE;
@@ -217,7 +225,7 @@ BOOLEAN CacheReadDiskSectors(UCHAR DiskNumber, ULONGLONG StartSector, ULONG Sect
         //
         // Get cache block pointer (this forces the disk sectors into the cache memory)
         //
-        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, EndBlock);
+        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, EndBlock, 1);
         if (CacheBlock == NULL)
         {
             return FALSE;
@@ -277,7 +285,7 @@ BOOLEAN CacheForceDiskSectorsIntoCache(UCHAR DiskNumber, ULONGLONG StartSector,
         //
         // Get cache block pointer (this forces the disk sectors into the cache memory)
         //
-        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, Idx);
+        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, Idx, (StartBlock + BlockCount) - Idx);
         if (CacheBlock == NULL)
         {
             return FALSE;
@@ -322,3 +330,14 @@ BOOLEAN CacheReleaseMemory(ULONG MinimumAmountToRelease)
     // Return status
     return (AmountReleased >= MinimumAmountToRelease);
 }
+
+VOID CacheDumpStatistics(VOID)
+{
+    ULONG    Lookups = CacheStatistics.Hits + CacheStatistics.Misses;
+
+    TRACE("Disk cache: %lu reads, %I64u bytes read, %lu blocks read ahead\n",
+          CacheStatistics.DiskReads, CacheStatistics.BytesRead, CacheStatistics.BlocksReadAhead);
+    TRACE("Disk cache: %lu hits, %lu misses, hit rate %lu%%\n",
+          CacheStatistics.Hits, CacheStatistics.Misses,
+          Lookups ? (ULONG)((ULONGLONG)CacheStatistics.Hits * 100 / Lookups) : 0);
+}
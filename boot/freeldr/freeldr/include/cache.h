@@ -23,6 +23,10 @@
 #define TAG_CACHE_DATA 'DcaC'
 #define TAG_CACHE_BLOCK 'BcaC'
 
+#define CACHE_HASH_SIZE             64  // Number of buckets in the block index (power of 2)
+#define CACHE_READ_AHEAD_BLOCKS     8   // Blocks read ahead when reads are sequential
+#define CACHE_SIZE_LIMIT_MAX        (4 * 1024 * 1024)   // The cache shares the temporary heap
+
 ///////////////////////////////////////////////////////////////////////////////////////
 //
 // This structure describes a cached block element. The disk is divided up into
@@ -35,6 +39,7 @@
 typedef struct
 {
     LIST_ENTRY    ListEntry;                    // Doubly linked list synchronization member
+    LIST_ENTRY    HashEntry;                    // Links the block into its hash bucket
 
     ULONG            BlockNumber;                // Track index for CHS, 64k block index for LBA
     BOOLEAN        LockedInCache;                // Indicates that this block is locked in cache memory
@@ -58,10 +63,28 @@ typedef struct
 
     ULONG            BlockSize;            // Block size (in sectors)
     LIST_ENTRY        CacheBlockHead;            // Contains CACHE_BLOCK structures
+    LIST_ENTRY        HashTable[CACHE_HASH_SIZE];    // CACHE_BLOCK structures hashed by block number
+    ULONG            NextSequentialBlock;    // Block following the last one read from the disk
 
 } CACHE_DRIVE, *PCACHE_DRIVE;
 
 
+///////////////////////////////////////////////////////////////////////////////////////
+//
+// Counters for the boot-time report. They are kept across drives.
+//
+///////////////////////////////////////////////////////////////////////////////////////
+typedef struct
+{
+    ULONG            DiskReads;            // Number of reads issued to the disk
+    ULONGLONG        BytesRead;            // Number of bytes read from the disk
+    ULONG            BlocksReadAhead;    // Blocks read in addition to the requested ones
+    ULONG            Hits;                // Block lookups satisfied by the cache
+    ULONG            Misses;                // Block lookups that went to the disk
+
+} CACHE_STATISTICS, *PCACHE_STATISTICS;
+
+
 ///////////////////////////////////////////////////////////////////////////////////////
 //
 // Internal data
@@ -72,15 +95,16 @@ extern    BOOLEAN            CacheManagerInitialized;
 extern    ULONG                CacheBlockCount;
 extern    SIZE_T                CacheSizeLimit;
 extern    SIZE_T                CacheSizeCurrent;
+extern    CACHE_STATISTICS    CacheStatistics;
 
 ///////////////////////////////////////////////////////////////////////////////////////
 //
 // Internal functions
 //
 ///////////////////////////////////////////////////////////////////////////////////////
-PCACHE_BLOCK    CacheInternalGetBlockPointer(PCACHE_DRIVE CacheDrive, ULONG BlockNumber);                // Returns a pointer to a CACHE_BLOCK structure given a block number
-PCACHE_BLOCK    CacheInternalFindBlock(PCACHE_DRIVE CacheDrive, ULONG BlockNumber);                    // Searches the block list for a particular block
-PCACHE_BLOCK    CacheInternalAddBlockToCache(PCACHE_DRIVE CacheDrive, ULONG BlockNumber);                // Adds a block to the cache's block list
+PCACHE_BLOCK    CacheInternalGetBlockPointer(PCACHE_DRIVE CacheDrive, ULONG BlockNumber, ULONG BlockCount);    // Returns a pointer to a CACHE_BLOCK structure given a block number
+PCACHE_BLOCK    CacheInternalFindBlock(PCACHE_DRIVE CacheDrive, ULONG BlockNumber);                    // Searches the block index for a particular block
+PCACHE_BLOCK    CacheInternalAddBlockToCache(PCACHE_DRIVE CacheDrive, ULONG BlockNumber, ULONG BlockCount);    // Reads a run of blocks and adds them to the cache's block list
 BOOLEAN            CacheInternalFreeBlock(PCACHE_DRIVE CacheDrive);                                    // Removes a block from the cache's block list & frees the memory
 VOID            CacheInternalCheckCacheSizeLimits(PCACHE_DRIVE CacheDrive);                            // Checks the cache size limits to see if we can add a new block, if not calls CacheInternalFreeBlock()
 VOID            CacheInternalDumpBlockList(PCACHE_DRIVE CacheDrive);                                // Dumps the list of cached blocks to the debug output port
@@ -92,3 +116,4 @@ VOID    CacheInvalidateCacheData(VOID);
 BOOLEAN    CacheReadDiskSectors(UCHAR DiskNumber, ULONGLONG StartSector, ULONG SectorCount, PVOID Buffer);
 BOOLEAN    CacheForceDiskSectorsIntoCache(UCHAR DiskNumber, ULONGLONG StartSector, ULONG SectorCount);
 BOOLEAN    CacheReleaseMemory(ULONG MinimumAmountToRelease);
+VOID    CacheDumpStatistics(VOID);
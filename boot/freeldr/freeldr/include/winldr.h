@@ -79,6 +79,32 @@ typedef struct _LOADER_SYSTEM_BLOCK
 
 extern PLOADER_SYSTEM_BLOCK WinLdrSystemBlock;
 
+/*
+ * Boot driver bundle: the images of the boot drivers, stored one after
+ * the other in load order, so that they can be read in one go.
+ * The file starts with a header followed by EntryCount entries.
+ * sdk/tools/mkbootbnd writes it, see boot/bootdata/CMakeLists.txt.
+ */
+#define BOOT_BUNDLE_FILE_NAME   "system32\\bootdrv.bnd"
+#define BOOT_BUNDLE_SIGNATURE   'LDNB'
+#define BOOT_BUNDLE_VERSION     1
+
+typedef struct _BOOT_BUNDLE_HEADER
+{
+    ULONG Signature;
+    ULONG Version;
+    ULONG EntryCount;
+    ULONG TotalSize;            // Size of the whole bundle file
+} BOOT_BUNDLE_HEADER, *PBOOT_BUNDLE_HEADER;
+
+typedef struct _BOOT_BUNDLE_ENTRY
+{
+    CHAR FileName[64];          // Path relative to the system root
+    ULONG FileSize;             // Size of the file the image was taken from
+    ULONG TimeDateStamp;        // Time stamp of that image
+    ULONG DataOffset;           // Offset of the image from the start of the bundle
+} BOOT_BUNDLE_ENTRY, *PBOOT_BUNDLE_ENTRY;
+
 ///////////////////////////////////////////////////////////////////////////////////////
 //
 // ReactOS Loading Functions
@@ -116,6 +142,18 @@ WinLdrScanImportDescriptorTable(IN OUT PLIST_ENTRY ModuleListHead,
 PVOID WinLdrLoadModule(PCSTR ModuleName, ULONG *Size,
                        TYPE_OF_MEMORY MemoryType);
 
+// wlbundle.c
+VOID
+WinLdrOpenBootBundle(IN PCSTR BootPath);
+
+VOID
+WinLdrCloseBootBundle(VOID);
+
+BOOLEAN
+WinLdrFindBundledImage(IN PCSTR FileName,
+                       OUT PVOID *ImageData,
+                       OUT PULONG ImageSize);
+
 // wlmemory.c
 BOOLEAN
 WinLdrSetupMemoryLayout(IN OUT PLOADER_PARAMETER_BLOCK LoaderBlock);
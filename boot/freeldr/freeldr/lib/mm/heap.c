@@ -347,6 +347,7 @@ FrLdrHeapAllocateEx(
     /* Calculate alloc size */
     BlockSize = (USHORT)((ByteSize + sizeof(HEAP_BLOCK) - 1) / sizeof(HEAP_BLOCK));
 
+Retry:
     /* Walk the free block list */
     Block = &Heap->Blocks + Heap->TerminatingBlock;
     for (Block = &Heap->Blocks + Block->Data[0].Flink;
@@ -426,6 +427,17 @@ FrLdrHeapAllocateEx(
         return Block->Data;
     }
 
+    /* The disk cache only borrows the temporary heap, have it give memory back */
+    if ((HeapHandle == FrLdrTempHeap) &&
+        (Tag != TAG_CACHE_BLOCK) && (Tag != TAG_CACHE_DATA))
+    {
+        SIZE_T CacheSize = CacheSizeCurrent;
+
+        CacheReleaseMemory((ULONG)ByteSize);
+        if (CacheSizeCurrent < CacheSize)
+            goto Retry;
+    }
+
     /* We found nothing */
     WARN("HEAP: nothing suitable found for 0x%lx bytes\n", ByteSize);
     return NULL;
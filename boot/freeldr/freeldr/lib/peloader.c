@@ -257,11 +257,55 @@ WinLdrAllocateDataTableEntry(IN OUT PLIST_ENTRY ModuleListHead,
     return TRUE;
 }
 
+/* Where WinLdrLoadImage takes the image from: a file or a boot bundle entry */
+typedef struct _IMAGE_SOURCE
+{
+    ULONG FileId;
+    PUCHAR Buffer;
+    ULONG Size;
+} IMAGE_SOURCE, *PIMAGE_SOURCE;
+
+static ARC_STATUS
+WinLdrpReadImage(IN PIMAGE_SOURCE Source,
+                 IN ULONG Offset,
+                 OUT PVOID Buffer,
+                 IN ULONG Length)
+{
+    LARGE_INTEGER Position;
+    ARC_STATUS Status;
+    ULONG BytesRead;
+
+    if (Source->Buffer)
+    {
+        /* Like a file read, a read past the end is short */
+        if (Offset > Source->Size)
+            return EIO;
+        RtlCopyMemory(Buffer, Source->Buffer + Offset, min(Length, Source->Size - Offset));
+        return ESUCCESS;
+    }
+
+    Position.QuadPart = Offset;
+    Status = ArcSeek(Source->FileId, &Position, SeekAbsolute);
+    if (Status != ESUCCESS)
+        return Status;
+
+    return ArcRead(Source->FileId, Buffer, Length, &BytesRead);
+}
+
+static VOID
+WinLdrpCloseImage(IN PIMAGE_SOURCE Source)
+{
+    /* Bundled images are freed with the bundle */
+    if (!Source->Buffer)
+        ArcClose(Source->FileId);
+}
+
 /*
  * WinLdrLoadImage loads the specified image from the file (it doesn't
  * perform any additional operations on the filename, just directly
  * calls the file I/O routines), and relocates it so that it's ready
- * to be used when paging is enabled.
+ * to be used when paging is enabled. Boot drivers are taken from the
+ * boot bundle instead of the file when it has an up to date copy.
  * Addressing mode: physical
  */
 BOOLEAN
@@ -269,7 +313,7 @@ WinLdrLoadImage(IN PCHAR FileName,
                 TYPE_OF_MEMORY MemoryType,
                 OUT PVOID *ImageBasePA)
 {
-    ULONG FileId;
+    IMAGE_SOURCE Source;
     PVOID PhysicalBase;
     PVOID VirtualBase = NULL;
     UCHAR HeadersBuffer[SECTOR_SIZE * 2];
@@ -277,24 +321,31 @@ WinLdrLoadImage(IN PCHAR FileName,
     PIMAGE_SECTION_HEADER SectionHeader;
     ULONG VirtualSize, SizeOfRawData, NumberOfSections;
     ARC_STATUS Status;
-    LARGE_INTEGER Position;
-    ULONG i, BytesRead;
+    ULONG i;
     TRACE("WinLdrLoadImage(%s, %ld, *)\n", FileName, MemoryType);
 
-    /* Open the image file */
-    Status = ArcOpen(FileName, OpenReadOnly, &FileId);
-    if (Status != ESUCCESS)
+    /* Use the bundled copy if we have one, or open the image file */
+    RtlZeroMemory(&Source, sizeof(Source));
+    if (WinLdrFindBundledImage(FileName, (PVOID*)&Source.Buffer, &Source.Size))
     {
-        // UiMessageBox("Can not open the file.");
-        return FALSE;
+        TRACE("Loading %s from the boot bundle\n", FileName);
+    }
+    else
+    {
+        Status = ArcOpen(FileName, OpenReadOnly, &Source.FileId);
+        if (Status != ESUCCESS)
+        {
+            // UiMessageBox("Can not open the file.");
+            return FALSE;
+        }
     }
 
     /* Load the first 2 sectors of the image so we can read the PE header */
-    Status = ArcRead(FileId, HeadersBuffer, SECTOR_SIZE * 2, &BytesRead);
+    Status = WinLdrpReadImage(&Source, 0, HeadersBuffer, SECTOR_SIZE * 2);
     if (Status != ESUCCESS)
     {
         UiMessageBox("Error reading from file.");
-        ArcClose(FileId);
+        WinLdrpCloseImage(&Source);
         return FALSE;
     }
 
@@ -304,7 +355,7 @@ WinLdrLoadImage(IN PCHAR FileName,
     {
         // Print(L"Error - no NT header found in %s\n", FileName);
         UiMessageBox("Error - no NT header found.");
-        ArcClose(FileId);
+        WinLdrpCloseImage(&Source);
         return FALSE;
     }
 
@@ -313,7 +364,7 @@ WinLdrLoadImage(IN PCHAR FileName,
     {
         // Print(L"Not an executable image %s\n", FileName);
         UiMessageBox("Not an executable image.");
-        ArcClose(FileId);
+        WinLdrpCloseImage(&Source);
         return FALSE;
     }
 
@@ -335,7 +386,7 @@ WinLdrLoadImage(IN PCHAR FileName,
         {
             // Print(L"Failed to alloc pages for image %s\n", FileName);
             UiMessageBox("Failed to alloc pages for image.");
-            ArcClose(FileId);
+            WinLdrpCloseImage(&Source);
             return FALSE;
         }
     }
@@ -345,22 +396,13 @@ WinLdrLoadImage(IN PCHAR FileName,
 
     TRACE("Base PA: 0x%X, VA: 0x%X\n", PhysicalBase, VirtualBase);
 
-    /* Set to 0 position and fully load the file image */
-    Position.HighPart = Position.LowPart = 0;
-    Status = ArcSeek(FileId, &Position, SeekAbsolute);
-    if (Status != ESUCCESS)
-    {
-        UiMessageBox("Error seeking to start of file.");
-        ArcClose(FileId);
-        return FALSE;
-    }
-
-    Status = ArcRead(FileId, PhysicalBase, NtHeaders->OptionalHeader.SizeOfHeaders, &BytesRead);
+    /* Fully load the file image, starting with the headers */
+    Status = WinLdrpReadImage(&Source, 0, PhysicalBase, NtHeaders->OptionalHeader.SizeOfHeaders);
     if (Status != ESUCCESS)
     {
         // Print(L"Error reading headers %s\n", FileName);
         UiMessageBox("Error reading headers.");
-        ArcClose(FileId);
+        WinLdrpCloseImage(&Source);
         return FALSE;
     }
 
@@ -399,14 +441,13 @@ WinLdrLoadImage(IN PCHAR FileName,
         /* Actually read the section (if its size is not 0) */
         if (SizeOfRawData != 0)
         {
-            /* Seek to the correct position */
-            Position.LowPart = SectionHeader->PointerToRawData;
-            Status = ArcSeek(FileId, &Position, SeekAbsolute);
-
             TRACE("SH->VA: 0x%X\n", SectionHeader->VirtualAddress);
 
             /* Read this section from the file, size = SizeOfRawData */
-            Status = ArcRead(FileId, (PUCHAR)PhysicalBase + SectionHeader->VirtualAddress, SizeOfRawData, &BytesRead);
+            Status = WinLdrpReadImage(&Source,
+                                      SectionHeader->PointerToRawData,
+                                      (PUCHAR)PhysicalBase + SectionHeader->VirtualAddress,
+                                      SizeOfRawData);
             if (Status != ESUCCESS)
             {
                 ERR("WinLdrLoadImage(): Error reading section from file!\n");
@@ -425,7 +466,7 @@ WinLdrLoadImage(IN PCHAR FileName,
     }
 
     /* We are done with the file - close it */
-    ArcClose(FileId);
+    WinLdrpCloseImage(&Source);
 
     /* If loading failed - return right now */
     if (Status != ESUCCESS)
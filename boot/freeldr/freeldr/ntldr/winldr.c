@@ -300,6 +300,9 @@ WinLdrLoadBootDrivers(PLOADER_PARAMETER_BLOCK LoaderBlock,
     BOOLEAN Success;
     BOOLEAN ret = TRUE;
 
+    // Read the bundled driver images, if there are any
+    WinLdrOpenBootBundle(BootPath);
+
     // Walk through the boot drivers list
     NextBd = LoaderBlock->BootDriverListHead.Flink;
 
@@ -340,6 +343,8 @@ WinLdrLoadBootDrivers(PLOADER_PARAMETER_BLOCK LoaderBlock,
         NextBd = BootDriver->Link.Flink;
     }
 
+    WinLdrCloseBootBundle();
+
     return ret;
 }
 
@@ -836,6 +841,9 @@ LoadAndBootWindowsCommon(
     /* Cleanup ini file */
     IniCleanup();
 
+    /* Report how the disk cache did */
+    CacheDumpStatistics();
+
     /* Debugging... */
     //DumpMemoryAllocMap();
 
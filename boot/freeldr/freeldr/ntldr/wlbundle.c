@@ -0,0 +1,183 @@
+/*
+ * PROJECT:         EFI Windows Loader
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * FILE:            boot/freeldr/freeldr/ntldr/wlbundle.c
+ * PURPOSE:         Boot driver bundle support
+ */
+
+/* INCLUDES ***************************************************************/
+
+#include <freeldr.h>
+
+#include <debug.h>
+
+DBG_DEFAULT_CHANNEL(WINDOWS);
+
+/* GLOBALS ****************************************************************/
+
+static PBOOT_BUNDLE_HEADER BootBundle = NULL;
+static CHAR BootBundlePath[MAX_PATH];
+
+/* FUNCTIONS **************************************************************/
+
+static BOOLEAN
+WinLdrpValidateBootBundle(IN PBOOT_BUNDLE_HEADER Header,
+                          IN ULONG Size)
+{
+    PBOOT_BUNDLE_ENTRY Entry;
+    ULONG i;
+
+    if (Size < sizeof(BOOT_BUNDLE_HEADER) ||
+        Header->Signature != BOOT_BUNDLE_SIGNATURE ||
+        Header->Version != BOOT_BUNDLE_VERSION ||
+        Header->TotalSize != Size)
+    {
+        return FALSE;
+    }
+
+    if (Header->EntryCount > (Size - sizeof(BOOT_BUNDLE_HEADER)) / sizeof(BOOT_BUNDLE_ENTRY))
+        return FALSE;
+
+    /* Every image must be inside of the file */
+    Entry = (PBOOT_BUNDLE_ENTRY)(Header + 1);
+    for (i = 0; i < Header->EntryCount; i++, Entry++)
+    {
+        if (Entry->FileName[sizeof(Entry->FileName) - 1] != ANSI_NULL ||
+            Entry->DataOffset > Size ||
+            Entry->FileSize > Size - Entry->DataOffset)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+VOID
+WinLdrOpenBootBundle(IN PCSTR BootPath)
+{
+    CHAR FileName[MAX_PATH];
+    PVOID Bundle;
+    ULONG Size;
+
+    WinLdrCloseBootBundle();
+
+    /* The bundle is optional, just load the drivers one by one without it */
+    _snprintf(FileName, sizeof(FileName), "%s%s", BootPath, BOOT_BUNDLE_FILE_NAME);
+    Bundle = WinLdrLoadModule(FileName, &Size, LoaderFirmwareTemporary);
+    if (!Bundle)
+        return;
+
+    if (!WinLdrpValidateBootBundle(Bundle, Size))
+    {
+        WARN("Ignoring invalid boot bundle %s\n", FileName);
+        MmFreeMemory(Bundle);
+        return;
+    }
+
+    BootBundle = Bundle;
+    strncpy(BootBundlePath, BootPath, sizeof(BootBundlePath) - 1);
+    BootBundlePath[sizeof(BootBundlePath) - 1] = ANSI_NULL;
+
+    TRACE("Loaded boot bundle %s with %lu images\n", FileName, BootBundle->EntryCount);
+}
+
+VOID
+WinLdrCloseBootBundle(VOID)
+{
+    if (!BootBundle)
+        return;
+
+    MmFreeMemory(BootBundle);
+    BootBundle = NULL;
+}
+
+/* Returns the NT headers of an image only if they lie within its Size bytes */
+static PIMAGE_NT_HEADERS
+WinLdrpGetImageNtHeaders(IN PVOID Image,
+                         IN ULONG Size)
+{
+    PIMAGE_DOS_HEADER DosHeader = Image;
+
+    if (Size < sizeof(IMAGE_DOS_HEADER) + sizeof(IMAGE_NT_HEADERS) ||
+        DosHeader->e_magic != IMAGE_DOS_SIGNATURE ||
+        DosHeader->e_lfanew < 0 ||
+        (ULONG)DosHeader->e_lfanew > Size - sizeof(IMAGE_NT_HEADERS))
+    {
+        return NULL;
+    }
+
+    return RtlImageNtHeader(Image);
+}
+
+/*
+ * The bundle is stale if a driver was updated after it was built. Only
+ * the directory entry of the file it replaces is looked at, its data is
+ * never read: the file systems report no time stamps, so the file size
+ * is what the bundled image is checked against.
+ */
+static BOOLEAN
+WinLdrpIsBundledImageCurrent(IN PCSTR FileName,
+                             IN PBOOT_BUNDLE_ENTRY Entry)
+{
+    PIMAGE_NT_HEADERS NtHeaders;
+    FILEINFORMATION FileInfo;
+    ARC_STATUS Status;
+    ULONG FileId;
+
+    /* The bundled image itself must match its entry */
+    NtHeaders = WinLdrpGetImageNtHeaders((PUCHAR)BootBundle + Entry->DataOffset,
+                                         Entry->FileSize);
+    if (!NtHeaders || NtHeaders->FileHeader.TimeDateStamp != Entry->TimeDateStamp)
+        return FALSE;
+
+    Status = ArcOpen((PCHAR)FileName, OpenReadOnly, &FileId);
+    if (Status != ESUCCESS)
+        return FALSE;
+
+    Status = ArcGetFileInformation(FileId, &FileInfo);
+    ArcClose(FileId);
+
+    return (Status == ESUCCESS &&
+            FileInfo.EndingAddress.HighPart == 0 &&
+            FileInfo.EndingAddress.LowPart == Entry->FileSize);
+}
+
+BOOLEAN
+WinLdrFindBundledImage(IN PCSTR FileName,
+                       OUT PVOID *ImageData,
+                       OUT PULONG ImageSize)
+{
+    PBOOT_BUNDLE_ENTRY Entry;
+    SIZE_T PathLength;
+    PCSTR RelativeName;
+    ULONG i;
+
+    if (!BootBundle)
+        return FALSE;
+
+    /* Only files below the system root can be in the bundle */
+    PathLength = strlen(BootBundlePath);
+    if (_strnicmp(FileName, BootBundlePath, PathLength) != 0)
+        return FALSE;
+    RelativeName = FileName + PathLength;
+
+    Entry = (PBOOT_BUNDLE_ENTRY)(BootBundle + 1);
+    for (i = 0; i < BootBundle->EntryCount; i++, Entry++)
+    {
+        if (_stricmp(RelativeName, Entry->FileName) != 0)
+            continue;
+
+        if (!WinLdrpIsBundledImageCurrent(FileName, Entry))
+        {
+            WARN("Boot bundle image of %s is stale, loading the file\n", FileName);
+            return FALSE;
+        }
+
+        *ImageData = (PUCHAR)BootBundle + Entry->DataOffset;
+        *ImageSize = Entry->FileSize;
+        return TRUE;
+    }
+
+    return FALSE;
+}
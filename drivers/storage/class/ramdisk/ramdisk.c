@@ -40,6 +40,9 @@
 
 #define TOC_DATA_TRACK              (0x04)
 
+/* Section views must start on an allocation granularity boundary */
+#define RAMDISK_VIEW_ALIGNMENT      0x10000
+
 typedef enum _RAMDISK_DEVICE_TYPE
 {
     RamdiskBus,
@@ -88,6 +91,15 @@ typedef struct _RAMDISK_BUS_EXTENSION
     RAMDISK_EXTENSION;
 } RAMDISK_BUS_EXTENSION, *PRAMDISK_BUS_EXTENSION;
 
+typedef struct _RAMDISK_VIEW
+{
+    LIST_ENTRY ListEntry;
+    LARGE_INTEGER Offset;
+    SIZE_T Length;
+    PVOID BaseAddress;
+    LONG ReferenceCount;
+} RAMDISK_VIEW, *PRAMDISK_VIEW;
+
 typedef struct _RAMDISK_DRIVE_EXTENSION
 {
     /* Inherited base class */
@@ -110,6 +122,24 @@ typedef struct _RAMDISK_DRIVE_EXTENSION
     ULONG NumberOfHeads;
     ULONG Cylinders;
     ULONG HiddenSectors;
+
+    /* Backing section of file backed and virtual disks */
+    HANDLE SectionHandle;
+
+    /* Backing file of file backed disks, and the chunks of the section
+     * (RAMDISK_VIEW_ALIGNMENT bytes each) written since the last flush */
+    HANDLE FileHandle;
+    RTL_BITMAP DirtyMap;
+
+    /* Mapping of the whole disk, if we could get one */
+    PVOID MappedBase;
+
+    /* Otherwise, recently used views, most recent first */
+    KSPIN_LOCK ViewLock;
+    LIST_ENTRY ViewList;
+    PRAMDISK_VIEW Views;
+    ULONG ViewCount;
+    ULONG ViewLength;
 } RAMDISK_DRIVE_EXTENSION, *PRAMDISK_DRIVE_EXTENSION;
 
 ULONG MaximumViewLength;
@@ -264,6 +294,150 @@ QueryParameters(IN PUNICODE_STRING RegistryPath)
     }
 }
 
+static
+PHYSICAL_ADDRESS
+RamdiskGetPhysicalAddress(IN PRAMDISK_DRIVE_EXTENSION DeviceExtension,
+                          IN LARGE_INTEGER ActualOffset)
+{
+    PHYSICAL_ADDRESS PhysicalAddress;
+
+    /* The loader gave us physically contiguous pages starting at BasePage */
+    PhysicalAddress.QuadPart = ((ULONGLONG)DeviceExtension->BasePage << PAGE_SHIFT) +
+                               (ActualOffset.QuadPart & ~((LONGLONG)PAGE_SIZE - 1));
+    return PhysicalAddress;
+}
+
+static
+PVOID
+RamdiskMapView(IN PRAMDISK_DRIVE_EXTENSION DeviceExtension,
+               IN LARGE_INTEGER ActualOffset,
+               IN SIZE_T Length)
+{
+    PVOID BaseAddress = NULL;
+    SIZE_T ViewSize = Length;
+    NTSTATUS Status;
+
+    if (!DeviceExtension->SectionHandle)
+    {
+        /* Map the I/O Space from the loader */
+        return MmMapIoSpace(RamdiskGetPhysicalAddress(DeviceExtension, ActualOffset),
+                            Length,
+                            MmCached);
+    }
+
+    /* Map the section into the system process, we are called from the worker */
+    Status = ZwMapViewOfSection(DeviceExtension->SectionHandle,
+                                NtCurrentProcess(),
+                                &BaseAddress,
+                                0,
+                                0,
+                                &ActualOffset,
+                                &ViewSize,
+                                ViewUnmap,
+                                0,
+                                DeviceExtension->DiskOptions.Readonly ?
+                                PAGE_READONLY : PAGE_READWRITE);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("ZwMapViewOfSection() failed (Status 0x%08lx)\n", Status);
+        return NULL;
+    }
+
+    return BaseAddress;
+}
+
+static
+VOID
+RamdiskUnmapView(IN PRAMDISK_DRIVE_EXTENSION DeviceExtension,
+                 IN PVOID BaseAddress,
+                 IN SIZE_T Length)
+{
+    if (!DeviceExtension->SectionHandle)
+    {
+        /* Unmap the I/O space we got from the loader */
+        MmUnmapIoSpace(BaseAddress, Length);
+        return;
+    }
+
+    ZwUnmapViewOfSection(NtCurrentProcess(), BaseAddress);
+}
+
+static
+VOID
+RamdiskInitializeViews(IN PRAMDISK_DRIVE_EXTENSION DeviceExtension,
+                       IN ULONG ViewCount,
+                       IN SIZE_T ViewLength)
+{
+    LARGE_INTEGER Zero = {{0, 0}};
+    ULONG i;
+
+    KeInitializeSpinLock(&DeviceExtension->ViewLock);
+    InitializeListHead(&DeviceExtension->ViewList);
+    DeviceExtension->MappedBase = NULL;
+    DeviceExtension->Views = NULL;
+    DeviceExtension->ViewCount = 0;
+
+#ifdef _WIN64
+    /* There is enough system space to map a boot disk once */
+    if (!DeviceExtension->SectionHandle)
+    {
+        DeviceExtension->MappedBase = MmMapIoSpace(RamdiskGetPhysicalAddress(DeviceExtension, Zero),
+                                                   ROUND_TO_PAGES(DeviceExtension->DiskOffset +
+                                                                  DeviceExtension->DiskLength.QuadPart),
+                                                   MmCached);
+        if (DeviceExtension->MappedBase) return;
+    }
+#else
+    UNREFERENCED_PARAMETER(Zero);
+#endif
+
+    /* Use the requested view settings, within the configured limits */
+    if (ViewCount < MinimumViewCount || ViewCount > MaximumViewCount) ViewCount = DefaultViewCount;
+    if (ViewLength < MinimumViewLength || ViewLength > MaximumViewLength) ViewLength = DefaultViewLength;
+    if (ViewLength > MaximumPerDiskViewLength / ViewCount) ViewLength = MaximumPerDiskViewLength / ViewCount;
+
+    /* Views start on an allocation granularity boundary */
+    ViewLength &= ~(RAMDISK_VIEW_ALIGNMENT - 1);
+    if (ViewLength < RAMDISK_VIEW_ALIGNMENT) ViewLength = RAMDISK_VIEW_ALIGNMENT;
+    DeviceExtension->ViewLength = (ULONG)ViewLength;
+
+    DeviceExtension->Views = ExAllocatePoolWithTag(NonPagedPool,
+                                                   ViewCount * sizeof(RAMDISK_VIEW),
+                                                   'dmaR');
+    if (!DeviceExtension->Views) return;
+
+    /* They get mapped on first use */
+    RtlZeroMemory(DeviceExtension->Views, ViewCount * sizeof(RAMDISK_VIEW));
+    for (i = 0; i < ViewCount; i++)
+    {
+        InsertTailList(&DeviceExtension->ViewList, &DeviceExtension->Views[i].ListEntry);
+    }
+    DeviceExtension->ViewCount = ViewCount;
+}
+
+static
+PVOID
+RamdiskMapTemporary(IN PRAMDISK_DRIVE_EXTENSION DeviceExtension,
+                    IN LARGE_INTEGER ActualOffset,
+                    IN ULONG Length)
+{
+    PVOID MappedBase;
+    ULONG Delta;
+
+    /* Map from the start of the page, or of the allocation granularity for sections */
+    Delta = (ULONG)(ActualOffset.QuadPart %
+                    (DeviceExtension->SectionHandle ? RAMDISK_VIEW_ALIGNMENT : PAGE_SIZE));
+    ActualOffset.QuadPart -= Delta;
+
+    MappedBase = RamdiskMapView(DeviceExtension,
+                                ActualOffset,
+                                ROUND_TO_PAGES(Delta + Length));
+
+    /* Return actual offset within the mapping */
+    if (MappedBase) MappedBase = (PVOID)((ULONG_PTR)MappedBase + Delta);
+    return MappedBase;
+}
+
 PVOID
 NTAPI
 RamdiskMapPages(IN PRAMDISK_DRIVE_EXTENSION DeviceExtension,
@@ -271,44 +445,106 @@ RamdiskMapPages(IN PRAMDISK_DRIVE_EXTENSION DeviceExtension,
                 IN ULONG Length,
                 OUT PULONG OutputLength)
 {
-    PHYSICAL_ADDRESS PhysicalAddress;
-    PVOID MappedBase;
-    ULONG PageOffset;
-    SIZE_T ActualLength;
-    LARGE_INTEGER ActualOffset;
-    LARGE_INTEGER ActualPages;
-
-    /* We only support boot disks for now */
-    ASSERT(DeviceExtension->DiskType == RAMDISK_BOOT_DISK);
+    PRAMDISK_VIEW View, FreeView;
+    PLIST_ENTRY ListEntry;
+    PVOID OldBase, MappedBase;
+    SIZE_T OldLength;
+    LARGE_INTEGER ActualOffset, ViewOffset;
+    ULONGLONG DiskEnd, Delta;
+    KIRQL OldIrql;
+
+    /* We only support boot disks and section backed disks for now */
+    ASSERT((DeviceExtension->DiskType == RAMDISK_BOOT_DISK) ||
+           (DeviceExtension->SectionHandle != NULL));
 
     /* Calculate the actual offset in the drive */
     ActualOffset.QuadPart = DeviceExtension->DiskOffset + Offset.QuadPart;
 
-    /* Convert to pages */
-    ActualPages.QuadPart = ActualOffset.QuadPart >> PAGE_SHIFT;
+    /* The whole disk is mapped, nothing to do */
+    if (DeviceExtension->MappedBase)
+    {
+        *OutputLength = Length;
+        return (PVOID)((ULONG_PTR)DeviceExtension->MappedBase + (ULONG_PTR)ActualOffset.QuadPart);
+    }
+
+    /* No views, map the whole request */
+    if (!DeviceExtension->ViewCount)
+    {
+        *OutputLength = Length;
+        return RamdiskMapTemporary(DeviceExtension, ActualOffset, Length);
+    }
+
+    /* Find the view containing the offset */
+    ViewOffset.QuadPart = ActualOffset.QuadPart -
+                          (ActualOffset.QuadPart % DeviceExtension->ViewLength);
+    Delta = ActualOffset.QuadPart - ViewOffset.QuadPart;
+
+    /* Only hand out what the view covers, the callers loop for the rest */
+    if (Length > DeviceExtension->ViewLength - Delta)
+        Length = (ULONG)(DeviceExtension->ViewLength - Delta);
+
+    FreeView = NULL;
+    KeAcquireSpinLock(&DeviceExtension->ViewLock, &OldIrql);
+    for (ListEntry = DeviceExtension->ViewList.Flink;
+         ListEntry != &DeviceExtension->ViewList;
+         ListEntry = ListEntry->Flink)
+    {
+        View = CONTAINING_RECORD(ListEntry, RAMDISK_VIEW, ListEntry);
+        if (View->BaseAddress && View->Offset.QuadPart == ViewOffset.QuadPart)
+        {
+            /* Hit, make it the most recently used one */
+            View->ReferenceCount++;
+            RemoveEntryList(&View->ListEntry);
+            InsertHeadList(&DeviceExtension->ViewList, &View->ListEntry);
+            KeReleaseSpinLock(&DeviceExtension->ViewLock, OldIrql);
+
+            *OutputLength = Length;
+            return (PVOID)((ULONG_PTR)View->BaseAddress + (ULONG_PTR)Delta);
+        }
+
+        /* Remember the least recently used idle view */
+        if (!View->ReferenceCount) FreeView = View;
+    }
+
+    if (!FreeView)
+    {
+        /* All views are busy, fall back to a mapping of our own */
+        KeReleaseSpinLock(&DeviceExtension->ViewLock, OldIrql);
+        *OutputLength = Length;
+        return RamdiskMapTemporary(DeviceExtension, ActualOffset, Length);
+    }
 
-    /* Now add the base page */
-    ActualPages.QuadPart = DeviceExtension->BasePage + ActualPages.QuadPart;
+    /* Take the view over. Nobody can find it until it is mapped again. */
+    View = FreeView;
+    View->ReferenceCount = 1;
+    OldBase = View->BaseAddress;
+    OldLength = View->Length;
+    View->BaseAddress = NULL;
+    RemoveEntryList(&View->ListEntry);
+    InsertHeadList(&DeviceExtension->ViewList, &View->ListEntry);
+    KeReleaseSpinLock(&DeviceExtension->ViewLock, OldIrql);
 
-    /* Calculate final amount of bytes */
-    PhysicalAddress.QuadPart = ActualPages.QuadPart << PAGE_SHIFT;
+    if (OldBase) RamdiskUnmapView(DeviceExtension, OldBase, OldLength);
 
-    /* Calculate pages spanned for the mapping */
-    ActualLength = ADDRESS_AND_SIZE_TO_SPAN_PAGES(ActualOffset.QuadPart, Length);
+    /* Don't map past the end of the disk (or of the section) */
+    DiskEnd = DeviceExtension->DiskOffset + DeviceExtension->DiskLength.QuadPart;
+    if (!DeviceExtension->SectionHandle) DiskEnd = ROUND_TO_PAGES(DiskEnd);
+    View->Length = DeviceExtension->ViewLength;
+    if ((ULONGLONG)ViewOffset.QuadPart + View->Length > DiskEnd)
+        View->Length = (SIZE_T)(DiskEnd - ViewOffset.QuadPart);
 
-    /* And convert this back to bytes */
-    ActualLength <<= PAGE_SHIFT;
+    MappedBase = RamdiskMapView(DeviceExtension, ViewOffset, View->Length);
 
-    /* Get the offset within the page */
-    PageOffset = BYTE_OFFSET(ActualOffset.QuadPart);
+    KeAcquireSpinLock(&DeviceExtension->ViewLock, &OldIrql);
+    View->Offset = ViewOffset;
+    View->BaseAddress = MappedBase;
+    if (!MappedBase) View->ReferenceCount = 0;
+    KeReleaseSpinLock(&DeviceExtension->ViewLock, OldIrql);
 
-    /* Map the I/O Space from the loader */
-    MappedBase = MmMapIoSpace(PhysicalAddress, ActualLength, MmCached);
+    if (!MappedBase) return NULL;
 
-    /* Return actual offset within the page as well as the length */
-    if (MappedBase) MappedBase = (PVOID)((ULONG_PTR)MappedBase + PageOffset);
     *OutputLength = Length;
-    return MappedBase;
+    return (PVOID)((ULONG_PTR)MappedBase + (ULONG_PTR)Delta);
 }
 
 VOID
@@ -318,30 +554,266 @@ RamdiskUnmapPages(IN PRAMDISK_DRIVE_EXTENSION DeviceExtension,
                   IN LARGE_INTEGER Offset,
                   IN ULONG Length)
 {
+    PRAMDISK_VIEW View;
     LARGE_INTEGER ActualOffset;
-    SIZE_T ActualLength;
-    ULONG PageOffset;
+    ULONG Delta;
+    KIRQL OldIrql;
+    ULONG i;
+
+    /* We only support boot disks and section backed disks for now */
+    ASSERT((DeviceExtension->DiskType == RAMDISK_BOOT_DISK) ||
+           (DeviceExtension->SectionHandle != NULL));
+
+    /* The whole disk stays mapped */
+    if (DeviceExtension->MappedBase) return;
 
-    /* We only support boot disks for now */
-    ASSERT(DeviceExtension->DiskType == RAMDISK_BOOT_DISK);
+    /* Check if this came from one of the views */
+    KeAcquireSpinLock(&DeviceExtension->ViewLock, &OldIrql);
+    for (i = 0; i < DeviceExtension->ViewCount; i++)
+    {
+        View = &DeviceExtension->Views[i];
+        if (View->BaseAddress &&
+            (ULONG_PTR)BaseAddress >= (ULONG_PTR)View->BaseAddress &&
+            (ULONG_PTR)BaseAddress < (ULONG_PTR)View->BaseAddress + View->Length)
+        {
+            /* Keep it mapped for the next request */
+            ASSERT(View->ReferenceCount > 0);
+            View->ReferenceCount--;
+            KeReleaseSpinLock(&DeviceExtension->ViewLock, OldIrql);
+            return;
+        }
+    }
+    KeReleaseSpinLock(&DeviceExtension->ViewLock, OldIrql);
 
     /* Calculate the actual offset in the drive */
     ActualOffset.QuadPart = DeviceExtension->DiskOffset + Offset.QuadPart;
 
-    /* Calculate pages spanned for the mapping */
-    ActualLength = ADDRESS_AND_SIZE_TO_SPAN_PAGES(ActualOffset.QuadPart, Length);
+    /* Calculate actual base address where we mapped this */
+    Delta = (ULONG)(ActualOffset.QuadPart %
+                    (DeviceExtension->SectionHandle ? RAMDISK_VIEW_ALIGNMENT : PAGE_SIZE));
+    BaseAddress = (PVOID)((ULONG_PTR)BaseAddress - Delta);
 
-    /* And convert this back to bytes */
-    ActualLength <<= PAGE_SHIFT;
+    /* Unmap the temporary mapping */
+    RamdiskUnmapView(DeviceExtension, BaseAddress, ROUND_TO_PAGES(Delta + Length));
+}
 
-    /* Get the offset within the page */
-    PageOffset = BYTE_OFFSET(ActualOffset.QuadPart);
+static
+VOID
+RamdiskMarkDirty(IN PRAMDISK_DRIVE_EXTENSION DeviceExtension,
+                 IN LARGE_INTEGER Offset,
+                 IN ULONG Length)
+{
+    ULONGLONG ActualOffset;
+    ULONG FirstChunk, LastChunk;
+    KIRQL OldIrql;
 
-    /* Calculate actual base address where we mapped this */
-    BaseAddress = (PVOID)((ULONG_PTR)BaseAddress - PageOffset);
+    /* Only file backed disks are written back */
+    if (!DeviceExtension->DirtyMap.Buffer) return;
 
-    /* Unmap the I/O space we got from the loader */
-    MmUnmapIoSpace(BaseAddress, ActualLength);
+    ActualOffset = DeviceExtension->DiskOffset + Offset.QuadPart;
+    FirstChunk = (ULONG)(ActualOffset / RAMDISK_VIEW_ALIGNMENT);
+    LastChunk = (ULONG)((ActualOffset + Length - 1) / RAMDISK_VIEW_ALIGNMENT);
+
+    KeAcquireSpinLock(&DeviceExtension->ViewLock, &OldIrql);
+    RtlSetBits(&DeviceExtension->DirtyMap, FirstChunk, LastChunk - FirstChunk + 1);
+    KeReleaseSpinLock(&DeviceExtension->ViewLock, OldIrql);
+}
+
+static
+NTSTATUS
+RamdiskFlushViews(IN PRAMDISK_DRIVE_EXTENSION DeviceExtension)
+{
+    IO_STATUS_BLOCK IoStatusBlock;
+    LARGE_INTEGER Offset, ViewOffset;
+    ULONGLONG DiskEnd;
+    ULONG Chunk, Found, ChunkCount, MaxChunks, Length;
+    PVOID BaseAddress, Buffer;
+    SIZE_T ViewLength;
+    KIRQL OldIrql;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    /* Virtual disks have nothing to write back */
+    if (!DeviceExtension->FileHandle) return STATUS_SUCCESS;
+
+    /*
+     * Flushing the mapped views is no use, MmFlushVirtualMemory does not
+     * write anything. Copy the chunks written since the last flush to the
+     * file instead. It was opened write-through, so the data is on the disk
+     * once ZwWriteFile returns. The data goes through a buffer, so that the
+     * view is not faulted in while the file system writes to the same file.
+     */
+    Buffer = ExAllocatePoolWithTag(PagedPool, DeviceExtension->ViewLength, 'dmaR');
+    if (!Buffer) return STATUS_INSUFFICIENT_RESOURCES;
+
+    MaxChunks = DeviceExtension->ViewLength / RAMDISK_VIEW_ALIGNMENT;
+    DiskEnd = DeviceExtension->DiskOffset + DeviceExtension->DiskLength.QuadPart;
+    Chunk = 0;
+    while (TRUE)
+    {
+        /* Take the next run of dirty chunks, up to a view */
+        KeAcquireSpinLock(&DeviceExtension->ViewLock, &OldIrql);
+        Found = RtlFindSetBits(&DeviceExtension->DirtyMap, 1, Chunk);
+
+        /* Stop when the search wraps, writes behind us belong to the next flush */
+        if ((Found == MAXULONG) || (Found < Chunk))
+        {
+            KeReleaseSpinLock(&DeviceExtension->ViewLock, OldIrql);
+            break;
+        }
+        Chunk = Found;
+        ChunkCount = 1;
+        while ((ChunkCount < MaxChunks) &&
+               (Chunk + ChunkCount < DeviceExtension->DirtyMap.SizeOfBitMap) &&
+               RtlCheckBit(&DeviceExtension->DirtyMap, Chunk + ChunkCount))
+        {
+            ChunkCount++;
+        }
+        RtlClearBits(&DeviceExtension->DirtyMap, Chunk, ChunkCount);
+        KeReleaseSpinLock(&DeviceExtension->ViewLock, OldIrql);
+
+        /* Map the chunks, but only write the part of the file that belongs to the disk */
+        ViewOffset.QuadPart = (ULONGLONG)Chunk * RAMDISK_VIEW_ALIGNMENT;
+        ViewLength = ChunkCount * RAMDISK_VIEW_ALIGNMENT;
+        if ((ULONGLONG)ViewOffset.QuadPart + ViewLength > DiskEnd)
+            ViewLength = (SIZE_T)(DiskEnd - ViewOffset.QuadPart);
+        Offset.QuadPart = max(ViewOffset.QuadPart, DeviceExtension->DiskOffset);
+        Length = (ULONG)(ViewOffset.QuadPart + ViewLength - Offset.QuadPart);
+
+        BaseAddress = RamdiskMapView(DeviceExtension, ViewOffset, ViewLength);
+        if (!BaseAddress)
+        {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+        }
+        else
+        {
+            RtlCopyMemory(Buffer,
+                          (PVOID)((ULONG_PTR)BaseAddress +
+                                  (ULONG_PTR)(Offset.QuadPart - ViewOffset.QuadPart)),
+                          Length);
+            RamdiskUnmapView(DeviceExtension, BaseAddress, ViewLength);
+
+            Status = ZwWriteFile(DeviceExtension->FileHandle,
+                                 NULL,
+                                 NULL,
+                                 NULL,
+                                 &IoStatusBlock,
+                                 Buffer,
+                                 Length,
+                                 &Offset,
+                                 NULL);
+        }
+
+        if (!NT_SUCCESS(Status))
+        {
+            /* Keep them dirty for the next flush */
+            DPRINT1("Failed to write back the disk at 0x%I64x (Status 0x%08lx)\n",
+                    Offset.QuadPart, Status);
+            KeAcquireSpinLock(&DeviceExtension->ViewLock, &OldIrql);
+            RtlSetBits(&DeviceExtension->DirtyMap, Chunk, ChunkCount);
+            KeReleaseSpinLock(&DeviceExtension->ViewLock, OldIrql);
+            break;
+        }
+
+        Chunk += ChunkCount;
+    }
+
+    ExFreePoolWithTag(Buffer, 'dmaR');
+    return Status;
+}
+
+static
+NTSTATUS
+RamdiskCreateSection(IN PRAMDISK_CREATE_INPUT Input,
+                     OUT PHANDLE SectionHandle,
+                     OUT PHANDLE WriteBackHandle)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    IO_STATUS_BLOCK IoStatusBlock;
+    FILE_STANDARD_INFORMATION StandardInfo;
+    UNICODE_STRING FileName;
+    LARGE_INTEGER MaximumSize;
+    HANDLE FileHandle = NULL;
+    BOOLEAN Readonly;
+    NTSTATUS Status;
+
+    Readonly = Input->Options.Readonly;
+    *WriteBackHandle = NULL;
+
+    if (Input->DiskType == RAMDISK_MEMORY_MAPPED_DISK)
+    {
+        /* Open the image file. This runs in the worker thread, so an access
+         * check would be done against the system token. The caller was
+         * checked by RamdiskCreateRamdisk in its own context instead. */
+        RtlInitUnicodeString(&FileName, Input->FileName);
+        InitializeObjectAttributes(&ObjectAttributes,
+                                   &FileName,
+                                   OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE,
+                                   NULL,
+                                   NULL);
+        Status = ZwOpenFile(&FileHandle,
+                            SYNCHRONIZE | FILE_READ_DATA |
+                            (Readonly ? 0 : FILE_WRITE_DATA),
+                            &ObjectAttributes,
+                            &IoStatusBlock,
+                            FILE_SHARE_READ,
+                            FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE |
+                            (Readonly ? 0 : FILE_WRITE_THROUGH));
+        if (!NT_SUCCESS(Status))
+        {
+            DPRINT1("Failed to open %wZ (Status 0x%08lx)\n", &FileName, Status);
+            return Status;
+        }
+
+        /* Use the rest of the file if no length was given */
+        if (!Input->DiskLength.QuadPart)
+        {
+            Status = ZwQueryInformationFile(FileHandle,
+                                            &IoStatusBlock,
+                                            &StandardInfo,
+                                            sizeof(StandardInfo),
+                                            FileStandardInformation);
+            if (!NT_SUCCESS(Status))
+            {
+                ZwClose(FileHandle);
+                return Status;
+            }
+
+            Input->DiskLength.QuadPart = StandardInfo.EndOfFile.QuadPart - Input->DiskOffset;
+        }
+    }
+
+    if (Input->DiskLength.QuadPart <= 0)
+    {
+        if (FileHandle) ZwClose(FileHandle);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    /* Without a file, the section is backed by the paging file:
+     * pages are only allocated when first written and can be paged out */
+    MaximumSize.QuadPart = Input->DiskOffset + Input->DiskLength.QuadPart;
+    InitializeObjectAttributes(&ObjectAttributes, NULL, OBJ_KERNEL_HANDLE, NULL, NULL);
+    Status = ZwCreateSection(SectionHandle,
+                             SECTION_QUERY | SECTION_MAP_READ |
+                             (Readonly ? 0 : SECTION_MAP_WRITE),
+                             &ObjectAttributes,
+                             &MaximumSize,
+                             Readonly ? PAGE_READONLY : PAGE_READWRITE,
+                             SEC_COMMIT,
+                             FileHandle);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("ZwCreateSection() failed (Status 0x%08lx)\n", Status);
+        if (FileHandle) ZwClose(FileHandle);
+        return Status;
+    }
+
+    /* Writable file backed disks keep the file to write the data back on flush */
+    if (FileHandle && !Readonly)
+        *WriteBackHandle = FileHandle;
+    else if (FileHandle)
+        ZwClose(FileHandle);
+
+    return Status;
 }
 
 NTSTATUS
@@ -365,10 +837,14 @@ RamdiskCreateDiskDevice(IN PRAMDISK_BUS_EXTENSION DeviceExtension,
     PVOID BaseAddress;
     LARGE_INTEGER CurrentOffset, CylinderSize, DiskLength;
     ULONG CylinderCount, SizeByCylinders;
+    HANDLE SectionHandle = NULL, FileHandle = NULL;
+    PULONG DirtyBits = NULL;
+    ULONG DirtyChunks = 0;
 
     /* Check if we're a boot RAM disk */
     DiskType = Input->DiskType;
-    if (DiskType >= RAMDISK_BOOT_DISK)
+    if ((DiskType >= RAMDISK_BOOT_DISK) ||
+        (DiskType == RAMDISK_MEMORY_MAPPED_DISK))
     {
         /* Check if we're an ISO */
         if (DiskType == RAMDISK_BOOT_DISK)
@@ -385,6 +861,18 @@ RamdiskCreateDiskDevice(IN PRAMDISK_BUS_EXTENSION DeviceExtension,
             Input->Options.NoDosDevice = FALSE;
             Input->Options.NoDriveLetter = IsWinPEBoot ? TRUE : FALSE;
         }
+        else if ((DiskType == RAMDISK_MEMORY_MAPPED_DISK) ||
+                 (DiskType == RAMDISK_VIRTUAL_DISK))
+        {
+            /* Sanitize disk options */
+            if (DiskType == RAMDISK_VIRTUAL_DISK) Input->Options.Readonly = FALSE;
+            if (Input->DiskOffset < 0) return STATUS_INVALID_PARAMETER;
+            if (DiskType == RAMDISK_VIRTUAL_DISK &&
+                Input->DiskLength.QuadPart <= 0)
+            {
+                return STATUS_INVALID_PARAMETER;
+            }
+        }
         else
         {
             /* The only other possibility is a WIM disk */
@@ -408,6 +896,30 @@ RamdiskCreateDiskDevice(IN PRAMDISK_BUS_EXTENSION DeviceExtension,
         /* Are we just validating and returning to the user? */
         if (ValidateOnly) return STATUS_SUCCESS;
 
+        /* File backed and virtual disks live in a section */
+        if ((DiskType == RAMDISK_MEMORY_MAPPED_DISK) ||
+            (DiskType == RAMDISK_VIRTUAL_DISK))
+        {
+            Status = RamdiskCreateSection(Input, &SectionHandle, &FileHandle);
+            if (!NT_SUCCESS(Status)) return Status;
+
+            /* Track which chunks of the file have to be written back */
+            if (FileHandle)
+            {
+                DirtyChunks = (ULONG)((Input->DiskOffset + Input->DiskLength.QuadPart +
+                                       RAMDISK_VIEW_ALIGNMENT - 1) / RAMDISK_VIEW_ALIGNMENT);
+                DirtyBits = ExAllocatePoolWithTag(NonPagedPool,
+                                                  ((DirtyChunks + 31) / 32) * sizeof(ULONG),
+                                                  'dmaR');
+                if (!DirtyBits)
+                {
+                    ZwClose(FileHandle);
+                    ZwClose(SectionHandle);
+                    return STATUS_INSUFFICIENT_RESOURCES;
+                }
+            }
+        }
+
         /* Build the GUID string */
         Status = RtlStringFromGUID(&Input->DiskGuid, &GuidString);
         if (!(NT_SUCCESS(Status)) || !(GuidString.Buffer))
@@ -525,11 +1037,32 @@ RamdiskCreateDiskDevice(IN PRAMDISK_BUS_EXTENSION DeviceExtension,
         DriveExtension->DiskOptions = Input->Options;
         DriveExtension->DiskLength = DiskLength;
         DriveExtension->DiskOffset = Input->DiskOffset;
-        DriveExtension->BasePage = Input->BasePage;
         DriveExtension->BytesPerSector = 0;
         DriveExtension->SectorsPerTrack = 0;
         DriveExtension->NumberOfHeads = 0;
 
+        /* Set up the mappings used for I/O */
+        if (SectionHandle)
+        {
+            DriveExtension->BasePage = 0;
+            DriveExtension->SectionHandle = SectionHandle;
+            SectionHandle = NULL;
+            if (FileHandle)
+            {
+                DriveExtension->FileHandle = FileHandle;
+                RtlInitializeBitMap(&DriveExtension->DirtyMap, DirtyBits, DirtyChunks);
+                RtlClearAllBits(&DriveExtension->DirtyMap);
+                FileHandle = NULL;
+                DirtyBits = NULL;
+            }
+            RamdiskInitializeViews(DriveExtension, Input->ViewCount, Input->ViewLength);
+        }
+        else
+        {
+            DriveExtension->BasePage = Input->BasePage;
+            RamdiskInitializeViews(DriveExtension, DefaultViewCount, DefaultViewLength);
+        }
+
         /* Make sure we don't free it later */
         DeviceName.Buffer = NULL;
         SymbolicLinkName.Buffer = NULL;
@@ -627,6 +1160,9 @@ RamdiskCreateDiskDevice(IN PRAMDISK_BUS_EXTENSION DeviceExtension,
     }
 
 FailCreate:
+    if (SectionHandle) ZwClose(SectionHandle);
+    if (FileHandle) ZwClose(FileHandle);
+    if (DirtyBits) ExFreePoolWithTag(DirtyBits, 'dmaR');
     UNIMPLEMENTED_DBGBREAK();
     return STATUS_SUCCESS;
 }
@@ -658,9 +1194,25 @@ RamdiskCreateRamdisk(IN PDEVICE_OBJECT DeviceObject,
         return STATUS_INVALID_PARAMETER;
     }
 
+    /* Only privileged callers may have us open files and allocate disks.
+     * The disk is created in the worker thread, so check in the context
+     * of the caller, when the request is validated. */
+    if (ValidateOnly &&
+        (Irp->RequestorMode != KernelMode) &&
+        !SeSinglePrivilegeCheck(RtlConvertLongToLuid(SE_MANAGE_VOLUME_PRIVILEGE),
+                                Irp->RequestorMode))
+    {
+        return STATUS_PRIVILEGE_NOT_HELD;
+    }
+
     /* Validate the disk type */
     DiskType = Input->DiskType;
-    if (DiskType == RAMDISK_WIM_DISK) return STATUS_INVALID_PARAMETER;
+    if ((DiskType == RAMDISK_WIM_DISK) ||
+        (DiskType == RAMDISK_REGISTRY_DISK) ||
+        (DiskType > RAMDISK_VIRTUAL_DISK))
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
 
     /* Look at the disk type */
     if (DiskType == RAMDISK_BOOT_DISK)
@@ -808,6 +1360,11 @@ SetAndQuit:
     return Status;
 }
 
+NTSTATUS
+NTAPI
+RamdiskReadWriteReal(IN PIRP Irp,
+                     IN PRAMDISK_DRIVE_EXTENSION DeviceExtension);
+
 VOID
 NTAPI
 RamdiskWorkerThread(IN PDEVICE_OBJECT DeviceObject,
@@ -874,7 +1431,7 @@ RamdiskWorkerThread(IN PDEVICE_OBJECT DeviceObject,
             /* Read or write request */
             case IRP_MJ_READ:
             case IRP_MJ_WRITE:
-                UNIMPLEMENTED_DBGBREAK("Read/Write request\n");
+                Status = RamdiskReadWriteReal(Irp, (PRAMDISK_DRIVE_EXTENSION)DeviceExtension);
                 break;
 
             /* Internal request (SCSI?) */
@@ -884,7 +1441,8 @@ RamdiskWorkerThread(IN PDEVICE_OBJECT DeviceObject,
 
             /* Flush request */
             case IRP_MJ_FLUSH_BUFFERS:
-                UNIMPLEMENTED_DBGBREAK("Flush request\n");
+                Status = RamdiskFlushViews((PRAMDISK_DRIVE_EXTENSION)DeviceExtension);
+                Irp->IoStatus.Information = 0;
                 break;
 
             /* Anything else */
@@ -894,10 +1452,10 @@ RamdiskWorkerThread(IN PDEVICE_OBJECT DeviceObject,
                 break;
         }
 
-        /* Complete the I/O */
+        /* Complete the I/O, keeping the transferred length */
         IoReleaseRemoveLock(&DeviceExtension->RemoveLock, Irp);
         Irp->IoStatus.Status = Status;
-        Irp->IoStatus.Information = 0;
+        if (!NT_SUCCESS(Status)) Irp->IoStatus.Information = 0;
         IoCompleteRequest(Irp, IO_DISK_INCREMENT);
         return;
     }
@@ -1009,6 +1567,8 @@ RamdiskReadWriteReal(IN PIRP Irp,
 DoCopy:
             /* Copy the data */
             RtlCopyMemory(Destination, Source, CopyLength);
+            if (IoStackLocation->MajorFunction == IRP_MJ_WRITE)
+                RamdiskMarkDirty(DeviceExtension, CurrentOffset, CopyLength);
         }
         else
         {
@@ -1048,8 +1608,8 @@ RamdiskReadWrite(IN PDEVICE_OBJECT DeviceObject,
                  IN PIRP Irp)
 {
     PRAMDISK_DRIVE_EXTENSION DeviceExtension;
-    // ULONG Length;
-    // LARGE_INTEGER ByteOffset;
+    ULONG Length;
+    LARGE_INTEGER ByteOffset;
     PIO_STACK_LOCATION IoStackLocation;
     NTSTATUS Status, ReturnStatus;
 
@@ -1064,10 +1624,18 @@ RamdiskReadWrite(IN PDEVICE_OBJECT DeviceObject,
 
     /* Capture parameters */
     IoStackLocation = IoGetCurrentIrpStackLocation(Irp);
-    // Length = IoStackLocation->Parameters.Read.Length;
-    // ByteOffset = IoStackLocation->Parameters.Read.ByteOffset;
+    Length = IoStackLocation->Parameters.Read.Length;
+    ByteOffset = IoStackLocation->Parameters.Read.ByteOffset;
 
-    /* FIXME: Validate offset */
+    /* Validate offset, the mappings don't go past the end of the disk */
+    if ((ByteOffset.QuadPart < 0) ||
+        (ByteOffset.QuadPart > DeviceExtension->DiskLength.QuadPart) ||
+        (Length > DeviceExtension->DiskLength.QuadPart - ByteOffset.QuadPart))
+    {
+        /* Fail */
+        Status = STATUS_INVALID_PARAMETER;
+        goto Complete;
+    }
 
     /* FIXME: Validate sector */
 
@@ -1080,8 +1648,9 @@ RamdiskReadWrite(IN PDEVICE_OBJECT DeviceObject,
         goto Complete;
     }
 
-    /* See if we want to do this sync or async */
-    if (DeviceExtension->DiskType > RAMDISK_MEMORY_MAPPED_DISK)
+    /* See if we want to do this sync or async. Section views are mapped
+     * in the system process, so only the worker can touch them. */
+    if (!DeviceExtension->SectionHandle)
     {
         /* Do it sync */
         Status = RamdiskReadWriteReal(Irp, DeviceExtension);
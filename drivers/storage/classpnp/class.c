@@ -2269,6 +2269,9 @@ VOID NTAPI ServiceTransferRequest(PDEVICE_OBJECT Fdo, PIRP Irp)
     if (entireXferLen % fdoData->HwMaxXferLen){
         numPackets++;
     }
+    if (numPackets > 1){
+        InterlockedIncrement((PLONG)&fdoData->TransferPacketStats.SplitTransfers);
+    }
 
     /*
      *  First get all the TRANSFER_PACKETs that we'll need at once.
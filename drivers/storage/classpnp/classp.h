@@ -45,6 +45,9 @@ extern GUID ClassGuidQueryRegInfoEx;
 #define CLASSP_REG_WRITE_CACHE_VALUE_NAME       (L"WriteCacheEnableOverride")
 #define CLASSP_REG_PERF_RESTORE_VALUE_NAME      (L"RestorePerfAtCount")
 #define CLASSP_REG_REMOVAL_POLICY_VALUE_NAME    (L"UserRemovalPolicy")
+#define CLASSP_REG_PEAK_PACKETS_VALUE_NAME      (L"TransferPacketsPeak")
+#define CLASSP_REG_PACKET_ALLOCS_VALUE_NAME     (L"TransferPacketAllocations")
+#define CLASSP_REG_SPLIT_XFERS_VALUE_NAME       (L"SplitTransfers")
 
 #define CLASS_PERF_RESTORE_MINIMUM (0x10)
 #define CLASS_ERROR_LEVEL_1 (0x4)
@@ -370,6 +373,12 @@ typedef struct _TRANSFER_PACKET {
  *  whatever is required by the current activity, up to the memory limit;
  *  as soon as stress ends, we snap down to MAX_WORKINGSET_TRANSFER_PACKETS;
  *  we then lazily work down to MIN_WORKINGSET_TRANSFER_PACKETS.
+ *
+ *  The per-SKU MIN_WORKINGSET_TRANSFER_PACKETS is only the floor.
+ *  A device that does command queueing starts out with at least
+ *  MIN_WORKINGSET_TRANSFER_PACKETS_Queued, and the working set of each
+ *  device then follows the peak number of packets it recently had in use
+ *  (see AdjustTransferPacketWorkingSet).
  */
 #define MIN_INITIAL_TRANSFER_PACKETS                     1
 #define MIN_WORKINGSET_TRANSFER_PACKETS_Consumer      4
@@ -378,6 +387,9 @@ typedef struct _TRANSFER_PACKET {
 #define MAX_WORKINGSET_TRANSFER_PACKETS_Server      1024
 #define MIN_WORKINGSET_TRANSFER_PACKETS_Enterprise    256
 #define MAX_WORKINGSET_TRANSFER_PACKETS_Enterprise   2048
+#define MIN_WORKINGSET_TRANSFER_PACKETS_Queued        32
+
+#define TRANSFER_PACKET_STATS_SAVE_INTERVAL         60
 
 
 //
@@ -437,6 +449,37 @@ struct _CLASS_PRIVATE_FDO_DATA {
     ULONG NumTotalTransferPackets;
     ULONG DbgPeakNumTransferPackets;
 
+    /*
+     *  Working set thresholds for this device's TRANSFER_PACKETs.
+     *  LocalMinWorkingSetTransferPackets moves between the floor
+     *  and the max with the observed number of packets in use.
+     */
+    ULONG MinWorkingSetTransferPackets;
+    ULONG MaxWorkingSetTransferPackets;
+    ULONG LocalMinWorkingSetTransferPackets;
+    ULONG PeakPacketsInUseSinceIdle;
+
+    /*
+     *  TRANSFER_PACKETs (including their SRB and sense buffer)
+     *  come from this lookaside list.
+     */
+    NPAGED_LOOKASIDE_LIST TransferPacketLookasideList;
+    BOOLEAN TransferPacketLookasideListInitialized;
+
+    /*
+     *  Counters for capacity planning.  They are saved in the
+     *  device's Classpnp registry key when the device goes idle,
+     *  at most every TRANSFER_PACKET_STATS_SAVE_INTERVAL seconds,
+     *  and when the device is removed.
+     */
+    struct {
+        ULONG PeakPacketsInUse;     // most packets ever outstanding at once
+        ULONG PacketAllocations;    // packets allocated on the I/O path
+        ULONG SplitTransfers;       // client transfers sent as several packets
+    } TransferPacketStats;
+    ULONG TransferPacketStatsSaveTime;          // in seconds of interrupt time
+    PIO_WORKITEM TransferPacketStatsWorkItem;   // set while a save is queued
+
     /*
      *  Queue for deferred client irps
      */
@@ -848,6 +891,7 @@ PTRANSFER_PACKET NTAPI NewTransferPacket(PDEVICE_OBJECT Fdo);
 VOID NTAPI DestroyTransferPacket(PTRANSFER_PACKET Pkt);
 VOID NTAPI EnqueueFreeTransferPacket(PDEVICE_OBJECT Fdo, PTRANSFER_PACKET Pkt);
 PTRANSFER_PACKET NTAPI DequeueFreeTransferPacket(PDEVICE_OBJECT Fdo, BOOLEAN AllocIfNeeded);
+VOID NTAPI SaveTransferPacketStats(PFUNCTIONAL_DEVICE_EXTENSION FdoExt);
 VOID NTAPI SetupReadWriteTransferPacket(PTRANSFER_PACKET pkt, PVOID Buf, ULONG Len, LARGE_INTEGER DiskLocation, PIRP OriginalIrp);
 VOID NTAPI SubmitTransferPacket(PTRANSFER_PACKET Pkt);
 NTSTATUS NTAPI TransferPktComplete(IN PDEVICE_OBJECT NullFdo, IN PIRP Irp, IN PVOID Context);
@@ -23,18 +23,18 @@ Revision History:
 
 #include "classp.h"
 
+IO_WORKITEM_ROUTINE SaveTransferPacketStatsWorker;
+
 #ifdef ALLOC_PRAGMA
     #pragma alloc_text(PAGE, InitializeTransferPackets)
     #pragma alloc_text(PAGE, DestroyAllTransferPackets)
+    #pragma alloc_text(PAGE, SaveTransferPacketStats)
+    #pragma alloc_text(PAGE, SaveTransferPacketStatsWorker)
     #pragma alloc_text(PAGE, SetupEjectionTransferPacket)
     #pragma alloc_text(PAGE, SetupModeSenseTransferPacket)
 #endif
 
 
-ULONG MinWorkingSetTransferPackets = MIN_WORKINGSET_TRANSFER_PACKETS_Consumer;
-ULONG MaxWorkingSetTransferPackets = MAX_WORKINGSET_TRANSFER_PACKETS_Consumer;
-
-
 /*
  *  InitializeTransferPackets
  *
@@ -46,6 +46,8 @@ NTSTATUS NTAPI InitializeTransferPackets(PDEVICE_OBJECT Fdo)
     PFUNCTIONAL_DEVICE_EXTENSION fdoExt = Fdo->DeviceExtension;
     PCLASS_PRIVATE_FDO_DATA fdoData = fdoExt->PrivateFdoData;
     PSTORAGE_ADAPTER_DESCRIPTOR adapterDesc = commonExt->PartitionZeroExtension->AdapterDescriptor;
+    PSTORAGE_DEVICE_DESCRIPTOR deviceDesc = fdoExt->DeviceDescriptor;
+    ULONG minWorkingSet, maxWorkingSet;
     ULONG hwMaxPages;
     NTSTATUS status = STATUS_SUCCESS;
 
@@ -78,39 +80,73 @@ NTSTATUS NTAPI InitializeTransferPackets(PDEVICE_OBJECT Fdo)
     InitializeSListHead(&fdoData->FreeTransferPacketsList);
     InitializeListHead(&fdoData->AllTransferPacketsList);
     InitializeListHead(&fdoData->DeferredClientIrpList);
-        
+    RtlZeroMemory(&fdoData->TransferPacketStats, sizeof(fdoData->TransferPacketStats));
+
+    /*
+     *  All packets of this device come from one lookaside list,
+     *  so that recycling a packet does not have to go to pool.
+     */
+    if (!fdoData->TransferPacketLookasideListInitialized){
+        ExInitializeNPagedLookasideList(&fdoData->TransferPacketLookasideList,
+                                        NULL,
+                                        NULL,
+                                        0,
+                                        sizeof(TRANSFER_PACKET),
+                                        'pnPC',
+                                        0);
+        fdoData->TransferPacketLookasideListInitialized = TRUE;
+    }
+
     /*
      *  Set the packet threshold numbers based on the Windows SKU.
      */
     if (ExVerifySuite(Personal)){
         // this is Windows Personal
-        MinWorkingSetTransferPackets = MIN_WORKINGSET_TRANSFER_PACKETS_Consumer;
-        MaxWorkingSetTransferPackets = MAX_WORKINGSET_TRANSFER_PACKETS_Consumer;
+        minWorkingSet = MIN_WORKINGSET_TRANSFER_PACKETS_Consumer;
+        maxWorkingSet = MAX_WORKINGSET_TRANSFER_PACKETS_Consumer;
     }
     else if (ExVerifySuite(Enterprise) || ExVerifySuite(DataCenter)){
         // this is Advanced Server or Datacenter
-        MinWorkingSetTransferPackets = MIN_WORKINGSET_TRANSFER_PACKETS_Enterprise;
-        MaxWorkingSetTransferPackets = MAX_WORKINGSET_TRANSFER_PACKETS_Enterprise;
+        minWorkingSet = MIN_WORKINGSET_TRANSFER_PACKETS_Enterprise;
+        maxWorkingSet = MAX_WORKINGSET_TRANSFER_PACKETS_Enterprise;
     }
     else if (ExVerifySuite(TerminalServer)){
         // this is standard Server or Pro with terminal server
-        MinWorkingSetTransferPackets = MIN_WORKINGSET_TRANSFER_PACKETS_Server;
-        MaxWorkingSetTransferPackets = MAX_WORKINGSET_TRANSFER_PACKETS_Server;
+        minWorkingSet = MIN_WORKINGSET_TRANSFER_PACKETS_Server;
+        maxWorkingSet = MAX_WORKINGSET_TRANSFER_PACKETS_Server;
     }
     else {
         // this is Professional without terminal server
-        MinWorkingSetTransferPackets = MIN_WORKINGSET_TRANSFER_PACKETS_Consumer;
-        MaxWorkingSetTransferPackets = MAX_WORKINGSET_TRANSFER_PACKETS_Consumer;
+        minWorkingSet = MIN_WORKINGSET_TRANSFER_PACKETS_Consumer;
+        maxWorkingSet = MAX_WORKINGSET_TRANSFER_PACKETS_Consumer;
     }
 
-    while (fdoData->NumFreeTransferPackets < MIN_INITIAL_TRANSFER_PACKETS){
+    /*
+     *  A device that queues commands will keep a packet per queue slot busy,
+     *  so keep at least enough packets around to fill a typical device queue.
+     */
+    if (adapterDesc->CommandQueueing && deviceDesc && deviceDesc->CommandQueueing){
+        minWorkingSet = MAX(minWorkingSet, MIN(MIN_WORKINGSET_TRANSFER_PACKETS_Queued, maxWorkingSet));
+    }
+    fdoData->MinWorkingSetTransferPackets = minWorkingSet;
+    fdoData->MaxWorkingSetTransferPackets = maxWorkingSet;
+    fdoData->LocalMinWorkingSetTransferPackets = minWorkingSet;
+    fdoData->PeakPacketsInUseSinceIdle = 0;
+
+    /*
+     *  Preallocate the working set so that the I/O path does not have to.
+     *  Only MIN_INITIAL_TRANSFER_PACKETS are required to start the device.
+     */
+    while (fdoData->NumFreeTransferPackets < minWorkingSet){
         PTRANSFER_PACKET pkt = NewTransferPacket(Fdo);
         if (pkt){
             InterlockedIncrement((PLONG)&fdoData->NumTotalTransferPackets);
             EnqueueFreeTransferPacket(Fdo, pkt);
         }
         else {
-            status = STATUS_INSUFFICIENT_RESOURCES;
+            if (fdoData->NumFreeTransferPackets < MIN_INITIAL_TRANSFER_PACKETS){
+                status = STATUS_INSUFFICIENT_RESOURCES;
+            }
             break;
         }
     }
@@ -147,6 +183,106 @@ VOID NTAPI DestroyAllTransferPackets(PDEVICE_OBJECT Fdo)
     }
 
     ASSERT(fdoData->NumTotalTransferPackets == 0);
+
+    /*
+     *  The packet pool is only set up if the device was started.
+     *  Save the final counters for capacity planning.
+     */
+    if (fdoData->TransferPacketLookasideListInitialized){
+        SaveTransferPacketStats(fdoExt);
+
+        ExDeleteNPagedLookasideList(&fdoData->TransferPacketLookasideList);
+        fdoData->TransferPacketLookasideListInitialized = FALSE;
+    }
+}
+
+/*
+ *  SaveTransferPacketStats
+ *
+ *      Writes the transfer packet counters to the device's
+ *      Classpnp registry key.
+ */
+VOID NTAPI SaveTransferPacketStats(PFUNCTIONAL_DEVICE_EXTENSION FdoExt)
+{
+    PCLASS_PRIVATE_FDO_DATA fdoData = FdoExt->PrivateFdoData;
+
+    PAGED_CODE();
+
+    ClassSetDeviceParameter(FdoExt,
+                            CLASSP_REG_SUBKEY_NAME,
+                            CLASSP_REG_PEAK_PACKETS_VALUE_NAME,
+                            fdoData->TransferPacketStats.PeakPacketsInUse);
+    ClassSetDeviceParameter(FdoExt,
+                            CLASSP_REG_SUBKEY_NAME,
+                            CLASSP_REG_PACKET_ALLOCS_VALUE_NAME,
+                            fdoData->TransferPacketStats.PacketAllocations);
+    ClassSetDeviceParameter(FdoExt,
+                            CLASSP_REG_SUBKEY_NAME,
+                            CLASSP_REG_SPLIT_XFERS_VALUE_NAME,
+                            fdoData->TransferPacketStats.SplitTransfers);
+}
+
+VOID NTAPI SaveTransferPacketStatsWorker(PDEVICE_OBJECT Fdo, PVOID Context)
+{
+    PFUNCTIONAL_DEVICE_EXTENSION fdoExt = Fdo->DeviceExtension;
+    PCLASS_PRIVATE_FDO_DATA fdoData = fdoExt->PrivateFdoData;
+    PIO_WORKITEM workItem = fdoData->TransferPacketStatsWorkItem;
+
+    PAGED_CODE();
+
+    SaveTransferPacketStats(fdoExt);
+
+    fdoData->TransferPacketStatsWorkItem = NULL;
+    IoFreeWorkItem(workItem);
+    ClassReleaseRemoveLock(Fdo, (PIRP)workItem);
+}
+
+/*
+ *  QueueSaveTransferPacketStats
+ *
+ *      Called when all packets of the device are free again.
+ *      Saves the counters from a work item, so that they can be
+ *      read while the device runs, but not more often than every
+ *      TRANSFER_PACKET_STATS_SAVE_INTERVAL seconds.
+ */
+static VOID QueueSaveTransferPacketStats(PDEVICE_OBJECT Fdo)
+{
+    PFUNCTIONAL_DEVICE_EXTENSION fdoExt = Fdo->DeviceExtension;
+    PCLASS_PRIVATE_FDO_DATA fdoData = fdoExt->PrivateFdoData;
+    PIO_WORKITEM workItem;
+    ULONG now;
+
+    now = (ULONG)(KeQueryInterruptTime() / 10000000);
+    if (now - fdoData->TransferPacketStatsSaveTime < TRANSFER_PACKET_STATS_SAVE_INTERVAL){
+        return;
+    }
+
+    workItem = IoAllocateWorkItem(Fdo);
+    if (!workItem){
+        return;
+    }
+
+    /*
+     *  Only one save at a time.
+     */
+    if (InterlockedCompareExchangePointer((PVOID *)&fdoData->TransferPacketStatsWorkItem, workItem, NULL) != NULL){
+        IoFreeWorkItem(workItem);
+        return;
+    }
+    fdoData->TransferPacketStatsSaveTime = now;
+
+    /*
+     *  Grab the remove lock so that removal will block
+     *  until the work item is done.
+     */
+    if (ClassAcquireRemoveLock(Fdo, (PIRP)workItem) != NO_REMOVE){
+        ClassReleaseRemoveLock(Fdo, (PIRP)workItem);
+        fdoData->TransferPacketStatsWorkItem = NULL;
+        IoFreeWorkItem(workItem);
+        return;
+    }
+
+    IoQueueWorkItem(workItem, SaveTransferPacketStatsWorker, DelayedWorkQueue, NULL);
 }
 
 PTRANSFER_PACKET NTAPI NewTransferPacket(PDEVICE_OBJECT Fdo)
@@ -155,7 +291,7 @@ PTRANSFER_PACKET NTAPI NewTransferPacket(PDEVICE_OBJECT Fdo)
     PCLASS_PRIVATE_FDO_DATA fdoData = fdoExt->PrivateFdoData;
     PTRANSFER_PACKET newPkt;
 
-    newPkt = ExAllocatePoolWithTag(NonPagedPool, sizeof(TRANSFER_PACKET), 'pnPC');
+    newPkt = ExAllocateFromNPagedLookasideList(&fdoData->TransferPacketLookasideList);
     if (newPkt){
         RtlZeroMemory(newPkt, sizeof(TRANSFER_PACKET)); // just to be sure
 
@@ -177,7 +313,7 @@ PTRANSFER_PACKET NTAPI NewTransferPacket(PDEVICE_OBJECT Fdo)
             KeReleaseSpinLock(&fdoData->SpinLock, oldIrql);
         }
         else {
-            ExFreePool(newPkt);
+            ExFreeToNPagedLookasideList(&fdoData->TransferPacketLookasideList, newPkt);
             newPkt = NULL;
         }
     }
@@ -211,7 +347,40 @@ VOID NTAPI DestroyTransferPacket(PTRANSFER_PACKET Pkt)
     KeReleaseSpinLock(&fdoData->SpinLock, oldIrql);
 
     IoFreeIrp(Pkt->Irp);
-    ExFreePool(Pkt);
+    ExFreeToNPagedLookasideList(&fdoData->TransferPacketLookasideList, Pkt);
+}
+
+/*
+ *  AdjustTransferPacketWorkingSet
+ *
+ *      Called when all packets of the device are free again.
+ *      Move the lower working set threshold towards the peak number
+ *      of packets that were in use since the device was last idle:
+ *      grow to a higher peak at once, and shrink slowly so that
+ *      a short lull does not throw away packets we will need again.
+ */
+static VOID AdjustTransferPacketWorkingSet(PCLASS_PRIVATE_FDO_DATA FdoData)
+{
+    ULONG peak, localMin, target;
+
+    peak = InterlockedExchange((PLONG)&FdoData->PeakPacketsInUseSinceIdle, 0);
+    localMin = FdoData->LocalMinWorkingSetTransferPackets;
+
+    target = MAX(peak, FdoData->MinWorkingSetTransferPackets);
+    target = MIN(target, FdoData->MaxWorkingSetTransferPackets);
+
+    if (target > localMin){
+        localMin = target;
+    }
+    else {
+        /*
+         *  Round the step up, or a gap of less than 8 packets
+         *  would never close.
+         */
+        localMin -= (localMin - target + 7) / 8;
+    }
+
+    FdoData->LocalMinWorkingSetTransferPackets = localMin;
 }
 
 VOID NTAPI EnqueueFreeTransferPacket(PDEVICE_OBJECT Fdo, PTRANSFER_PACKET Pkt)
@@ -228,23 +397,26 @@ VOID NTAPI EnqueueFreeTransferPacket(PDEVICE_OBJECT Fdo, PTRANSFER_PACKET Pkt)
     ASSERT(newNumPkts <= fdoData->NumTotalTransferPackets);
 
     /*
-     *  If the total number of packets is larger than MinWorkingSetTransferPackets,
+     *  If the total number of packets is larger than the working set,
      *  that means that we've been in stress.  If all those packets are now
      *  free, then we are now out of stress and can free the extra packets.
      *  Free down to MaxWorkingSetTransferPackets immediately, and
-     *  down to MinWorkingSetTransferPackets lazily (one at a time).
+     *  down to LocalMinWorkingSetTransferPackets lazily (one at a time).
      */
     if (fdoData->NumFreeTransferPackets >= fdoData->NumTotalTransferPackets){
 
+        AdjustTransferPacketWorkingSet(fdoData);
+        QueueSaveTransferPacketStats(Fdo);
+
         /*
          *  1.  Immediately snap down to our UPPER threshold.
          */
-        if (fdoData->NumTotalTransferPackets > MaxWorkingSetTransferPackets){
+        if (fdoData->NumTotalTransferPackets > fdoData->MaxWorkingSetTransferPackets){
             SINGLE_LIST_ENTRY pktList;
             PSINGLE_LIST_ENTRY slistEntry;
             PTRANSFER_PACKET pktToDelete;
 
-            DBGTRACE(ClassDebugTrace, ("Exiting stress, block freeing (%d-%d) packets.", fdoData->NumTotalTransferPackets, MaxWorkingSetTransferPackets));
+            DBGTRACE(ClassDebugTrace, ("Exiting stress, block freeing (%d-%d) packets.", fdoData->NumTotalTransferPackets, fdoData->MaxWorkingSetTransferPackets));
 
             /*
              *  Check the counter again with lock held.  This eliminates a race condition
@@ -258,7 +430,7 @@ VOID NTAPI EnqueueFreeTransferPacket(PDEVICE_OBJECT Fdo, PTRANSFER_PACKET Pkt)
             SimpleInitSlistHdr(&pktList);
             KeAcquireSpinLock(&fdoData->SpinLock, &oldIrql);
             while ((fdoData->NumFreeTransferPackets >= fdoData->NumTotalTransferPackets) && 
-                   (fdoData->NumTotalTransferPackets > MaxWorkingSetTransferPackets)){
+                   (fdoData->NumTotalTransferPackets > fdoData->MaxWorkingSetTransferPackets)){
                    
                 pktToDelete = DequeueFreeTransferPacket(Fdo, FALSE);   
                 if (pktToDelete){
@@ -266,7 +438,7 @@ VOID NTAPI EnqueueFreeTransferPacket(PDEVICE_OBJECT Fdo, PTRANSFER_PACKET Pkt)
                     InterlockedDecrement((PLONG)&fdoData->NumTotalTransferPackets);    
                 }
                 else {
-                    DBGTRACE(ClassDebugTrace, ("Extremely unlikely condition (non-fatal): %d packets dequeued at once for Fdo %p. NumTotalTransferPackets=%d (1).", MaxWorkingSetTransferPackets, Fdo, fdoData->NumTotalTransferPackets));
+                    DBGTRACE(ClassDebugTrace, ("Extremely unlikely condition (non-fatal): %d packets dequeued at once for Fdo %p. NumTotalTransferPackets=%d (1).", fdoData->MaxWorkingSetTransferPackets, Fdo, fdoData->NumTotalTransferPackets));
                     break;
                 }
             }
@@ -282,7 +454,7 @@ VOID NTAPI EnqueueFreeTransferPacket(PDEVICE_OBJECT Fdo, PTRANSFER_PACKET Pkt)
         /*
          *  2.  Lazily work down to our LOWER threshold (by only freeing one packet at a time).
          */
-        if (fdoData->NumTotalTransferPackets > MinWorkingSetTransferPackets){
+        if (fdoData->NumTotalTransferPackets > fdoData->LocalMinWorkingSetTransferPackets){
             /*
              *  Check the counter again with lock held.  This eliminates a race condition
              *  while still allowing us to not grab the spinlock in the common codepath.
@@ -294,18 +466,18 @@ VOID NTAPI EnqueueFreeTransferPacket(PDEVICE_OBJECT Fdo, PTRANSFER_PACKET Pkt)
              */
             PTRANSFER_PACKET pktToDelete = NULL; 
 
-            DBGTRACE(ClassDebugTrace, ("Exiting stress, lazily freeing one of %d/%d packets.", fdoData->NumTotalTransferPackets, MinWorkingSetTransferPackets));
+            DBGTRACE(ClassDebugTrace, ("Exiting stress, lazily freeing one of %d/%d packets.", fdoData->NumTotalTransferPackets, fdoData->LocalMinWorkingSetTransferPackets));
             
             KeAcquireSpinLock(&fdoData->SpinLock, &oldIrql);
             if ((fdoData->NumFreeTransferPackets >= fdoData->NumTotalTransferPackets) &&
-                (fdoData->NumTotalTransferPackets > MinWorkingSetTransferPackets)){
+                (fdoData->NumTotalTransferPackets > fdoData->LocalMinWorkingSetTransferPackets)){
                 
                 pktToDelete = DequeueFreeTransferPacket(Fdo, FALSE);
                 if (pktToDelete){
                     InterlockedDecrement((PLONG)&fdoData->NumTotalTransferPackets);    
                 }
                 else {
-                    DBGTRACE(ClassDebugTrace, ("Extremely unlikely condition (non-fatal): %d packets dequeued at once for Fdo %p. NumTotalTransferPackets=%d (2).", MinWorkingSetTransferPackets, Fdo, fdoData->NumTotalTransferPackets));
+                    DBGTRACE(ClassDebugTrace, ("Extremely unlikely condition (non-fatal): %d packets dequeued at once for Fdo %p. NumTotalTransferPackets=%d (2).", fdoData->LocalMinWorkingSetTransferPackets, Fdo, fdoData->NumTotalTransferPackets));
                 }
             }
             KeReleaseSpinLock(&fdoData->SpinLock, oldIrql);
@@ -325,6 +497,7 @@ PTRANSFER_PACKET NTAPI DequeueFreeTransferPacket(PDEVICE_OBJECT Fdo, BOOLEAN All
     PCLASS_PRIVATE_FDO_DATA fdoData = fdoExt->PrivateFdoData;
     PTRANSFER_PACKET pkt;
     PSINGLE_LIST_ENTRY slistEntry;
+    ULONG numInUse;
     //KIRQL oldIrql;
 
     slistEntry = InterlockedPopEntrySList(&fdoData->FreeTransferPacketsList);
@@ -345,6 +518,7 @@ PTRANSFER_PACKET NTAPI DequeueFreeTransferPacket(PDEVICE_OBJECT Fdo, BOOLEAN All
             pkt = NewTransferPacket(Fdo);
             if (pkt){
                 InterlockedIncrement((PLONG)&fdoData->NumTotalTransferPackets);
+                InterlockedIncrement((PLONG)&fdoData->TransferPacketStats.PacketAllocations);
                 fdoData->DbgPeakNumTransferPackets = max(fdoData->DbgPeakNumTransferPackets, fdoData->NumTotalTransferPackets);
             }
             else {
@@ -355,7 +529,24 @@ PTRANSFER_PACKET NTAPI DequeueFreeTransferPacket(PDEVICE_OBJECT Fdo, BOOLEAN All
             pkt = NULL;
         }
     }
-    
+
+    /*
+     *  Track the number of packets in use for sizing the working set.
+     *  Only the I/O path counts; the callers that trim or destroy
+     *  the pool pass AllocIfNeeded == FALSE.
+     *  The unsynchronized updates may lose a peak under contention,
+     *  which only makes the estimate a little conservative.
+     */
+    if (pkt && AllocIfNeeded){
+        numInUse = fdoData->NumTotalTransferPackets - fdoData->NumFreeTransferPackets;
+        if (numInUse > fdoData->PeakPacketsInUseSinceIdle){
+            fdoData->PeakPacketsInUseSinceIdle = numInUse;
+        }
+        if (numInUse > fdoData->TransferPacketStats.PeakPacketsInUse){
+            fdoData->TransferPacketStats.PeakPacketsInUse = numInUse;
+        }
+    }
+
     return pkt;
 }
 
@@ -139,6 +139,22 @@ PortFdoStartMiniport(
         return Status;
     }
 
+    /* The miniport may have changed the SRB extension size */
+    if (DeviceExtension->Miniport.PortConfig.SrbExtensionSize != 0 &&
+        !DeviceExtension->SrbExtensionListInitialized)
+    {
+        /* Blocks smaller than a page do not cross a page boundary,
+           so miniports can use the SRB extension for DMA */
+        ExInitializeNPagedLookasideList(&DeviceExtension->SrbExtensionList,
+                                        NULL,
+                                        NULL,
+                                        0,
+                                        DeviceExtension->Miniport.PortConfig.SrbExtensionSize,
+                                        TAG_SRB_EXTENSION,
+                                        0);
+        DeviceExtension->SrbExtensionListInitialized = TRUE;
+    }
+
     /* Connect the configured interrupt */
     Status = PortFdoConnectInterrupt(DeviceExtension);
     if (!NT_SUCCESS(Status))
@@ -247,29 +263,18 @@ static NTSTATUS
 SpiSendInquiry(IN PDEVICE_OBJECT DeviceObject,
                ULONG Bus, ULONG Target, ULONG Lun)
 {
-//    IO_STATUS_BLOCK IoStatusBlock;
-//    PIO_STACK_LOCATION IrpStack;
-//    KEVENT Event;
-//    KIRQL Irql;
-//    PIRP Irp;
+    IO_STATUS_BLOCK IoStatusBlock;
+    PIO_STACK_LOCATION IrpStack;
+    KEVENT Event;
+    PIRP Irp;
     NTSTATUS Status;
     PINQUIRYDATA InquiryBuffer;
     PUCHAR /*PSENSE_DATA*/ SenseBuffer;
-//    BOOLEAN KeepTrying = TRUE;
-//    ULONG RetryCount = 0;
     SCSI_REQUEST_BLOCK Srb;
     PCDB Cdb;
-//    PSCSI_PORT_LUN_EXTENSION LunExtension;
-//    PSCSI_PORT_DEVICE_EXTENSION DeviceExtension;
-
-PFDO_DEVICE_EXTENSION DeviceExtension;
-    PVOID SrbExtension = NULL;
-    BOOLEAN ret;
 
     DPRINT1("SpiSendInquiry() called\n");
 
-    DeviceExtension = (PFDO_DEVICE_EXTENSION)DeviceObject->DeviceExtension;
-
     InquiryBuffer = ExAllocatePoolWithTag(NonPagedPool, INQUIRYDATABUFFERSIZE, TAG_INQUIRY_DATA);
     if (InquiryBuffer == NULL)
         return STATUS_INSUFFICIENT_RESOURCES;
@@ -281,199 +286,97 @@ PFDO_DEVICE_EXTENSION DeviceExtension;
         return STATUS_INSUFFICIENT_RESOURCES;
     }
 
-    if (DeviceExtension->Miniport.PortConfig.SrbExtensionSize != 0)
+    /* Initialize event for waiting */
+    KeInitializeEvent(&Event,
+                      NotificationEvent,
+                      FALSE);
+
+    /* Create an IRP */
+    Irp = IoBuildDeviceIoControlRequest(IOCTL_SCSI_EXECUTE_IN,
+                                        DeviceObject,
+                                        NULL,
+                                        0,
+                                        InquiryBuffer,
+                                        INQUIRYDATABUFFERSIZE,
+                                        TRUE,
+                                        &Event,
+                                        &IoStatusBlock);
+    if (Irp == NULL)
     {
-        SrbExtension = ExAllocatePoolWithTag(NonPagedPool, DeviceExtension->Miniport.PortConfig.SrbExtensionSize, TAG_SENSE_DATA);
-        if (SrbExtension == NULL)
-        {
-            ExFreePoolWithTag(SenseBuffer, TAG_SENSE_DATA);
-            ExFreePoolWithTag(InquiryBuffer, TAG_INQUIRY_DATA);
-            return STATUS_INSUFFICIENT_RESOURCES;
-        }
+        DPRINT1("IoBuildDeviceIoControlRequest() failed\n");
+        ExFreePoolWithTag(SenseBuffer, TAG_SENSE_DATA);
+        ExFreePoolWithTag(InquiryBuffer, TAG_INQUIRY_DATA);
+        return STATUS_INSUFFICIENT_RESOURCES;
     }
 
-//    while (KeepTrying)
-    {
-        /* Initialize event for waiting */
-//        KeInitializeEvent(&Event,
-//                          NotificationEvent,
-//                          FALSE);
-
-        /* Create an IRP */
-//        Irp = IoBuildDeviceIoControlRequest(IOCTL_SCSI_EXECUTE_IN,
-//                                            DeviceObject,
-//                                            NULL,
-//                                            0,
-//                                            InquiryBuffer,
-//                                            INQUIRYDATABUFFERSIZE,
-//                                            TRUE,
-//                                            &Event,
-//                                            &IoStatusBlock);
-//        if (Irp == NULL)
-//        {
-//            DPRINT1("IoBuildDeviceIoControlRequest() failed\n");
-
-            /* Quit the loop */
-//            Status = STATUS_INSUFFICIENT_RESOURCES;
-//            KeepTrying = FALSE;
-//            continue;
-//        }
-
-        /* Prepare SRB */
-        RtlZeroMemory(&Srb, sizeof(SCSI_REQUEST_BLOCK));
-
-        Srb.Length = sizeof(SCSI_REQUEST_BLOCK);
-//        Srb.OriginalRequest = Irp;
-        Srb.PathId = Bus;
-        Srb.TargetId = Target;
-        Srb.Lun = Lun;
-        Srb.Function = SRB_FUNCTION_EXECUTE_SCSI;
-        Srb.SrbFlags = SRB_FLAGS_DATA_IN | SRB_FLAGS_DISABLE_SYNCH_TRANSFER;
-        Srb.TimeOutValue = 4;
-        Srb.CdbLength = 6;
-
-        Srb.SenseInfoBuffer = SenseBuffer;
-        Srb.SenseInfoBufferLength = SENSE_BUFFER_SIZE;
-
-        Srb.DataBuffer = InquiryBuffer;
-        Srb.DataTransferLength = INQUIRYDATABUFFERSIZE;
-
-        Srb.SrbExtension = SrbExtension;
-
-        /* Attach Srb to the Irp */
-//        IrpStack = IoGetNextIrpStackLocation(Irp);
-//        IrpStack->Parameters.Scsi.Srb = &Srb;
-
-        /* Fill in CDB */
-        Cdb = (PCDB)Srb.Cdb;
-        Cdb->CDB6INQUIRY.OperationCode = SCSIOP_INQUIRY;
-        Cdb->CDB6INQUIRY.LogicalUnitNumber = Lun;
-        Cdb->CDB6INQUIRY.AllocationLength = INQUIRYDATABUFFERSIZE;
-
-        /* Call the driver */
-
-
-        ret = MiniportStartIo(&DeviceExtension->Miniport,
-                              &Srb);
-DPRINT1("MiniportStartIo returned %u\n", ret);
-
-//        Status = IoCallDriver(DeviceObject, Irp);
-
-        /* Wait for it to complete */
-//        if (Status == STATUS_PENDING)
-//        {
-//            DPRINT1("SpiSendInquiry(): Waiting for the driver to process request...\n");
-//            KeWaitForSingleObject(&Event,
-//                                  Executive,
-//                                  KernelMode,
-//                                  FALSE,
-//                                  NULL);
-//            Status = IoStatusBlock.Status;
-//        }
-
-//        DPRINT1("SpiSendInquiry(): Request processed by driver, status = 0x%08X\n", Status);
-
-        if (SRB_STATUS(Srb.SrbStatus) == SRB_STATUS_SUCCESS)
-        {
-            /* All fine, copy data over */
-//            RtlCopyMemory(LunInfo->InquiryData,
-//                          InquiryBuffer,
-//                          INQUIRYDATABUFFERSIZE);
-
-            /* Quit the loop */
-            Status = STATUS_SUCCESS;
-//            KeepTrying = FALSE;
-//            continue;
-        }
+    /* Prepare SRB */
+    RtlZeroMemory(&Srb, sizeof(SCSI_REQUEST_BLOCK));
 
-        DPRINT("Inquiry SRB failed with SrbStatus 0x%08X\n", Srb.SrbStatus);
-#if 0
-        /* Check if the queue is frozen */
-        if (Srb.SrbStatus & SRB_STATUS_QUEUE_FROZEN)
-        {
-            /* Something weird happened, deal with it (unfreeze the queue) */
-            KeepTrying = FALSE;
+    Srb.Length = sizeof(SCSI_REQUEST_BLOCK);
+    Srb.OriginalRequest = Irp;
+    Srb.PathId = Bus;
+    Srb.TargetId = Target;
+    Srb.Lun = Lun;
+    Srb.Function = SRB_FUNCTION_EXECUTE_SCSI;
+    Srb.SrbFlags = SRB_FLAGS_DATA_IN | SRB_FLAGS_DISABLE_SYNCH_TRANSFER;
+    Srb.TimeOutValue = 4;
+    Srb.CdbLength = 6;
 
-            DPRINT("SpiSendInquiry(): the queue is frozen at TargetId %d\n", Srb.TargetId);
+    Srb.SenseInfoBuffer = SenseBuffer;
+    Srb.SenseInfoBufferLength = SENSE_BUFFER_SIZE;
 
-            LunExtension = SpiGetLunExtension(DeviceExtension,
-                                              LunInfo->PathId,
-                                              LunInfo->TargetId,
-                                              LunInfo->Lun);
+    Srb.DataBuffer = InquiryBuffer;
+    Srb.DataTransferLength = INQUIRYDATABUFFERSIZE;
 
-            /* Clear frozen flag */
-            LunExtension->Flags &= ~LUNEX_FROZEN_QUEUE;
+    /* Attach Srb to the Irp */
+    IrpStack = IoGetNextIrpStackLocation(Irp);
+    IrpStack->Parameters.Scsi.Srb = &Srb;
 
-            /* Acquire the spinlock */
-            KeAcquireSpinLock(&DeviceExtension->SpinLock, &Irql);
+    /* Fill in CDB */
+    Cdb = (PCDB)Srb.Cdb;
+    Cdb->CDB6INQUIRY.OperationCode = SCSIOP_INQUIRY;
+    Cdb->CDB6INQUIRY.LogicalUnitNumber = Lun;
+    Cdb->CDB6INQUIRY.AllocationLength = INQUIRYDATABUFFERSIZE;
 
-            /* Process the request */
-            SpiGetNextRequestFromLun(DeviceObject->DeviceExtension, LunExtension);
+    /* Call the driver */
+    Status = IoCallDriver(DeviceObject, Irp);
 
-            /* SpiGetNextRequestFromLun() releases the spinlock,
-                so we just lower irql back to what it was before */
-            KeLowerIrql(Irql);
-        }
+    /* Wait for it to complete */
+    if (Status == STATUS_PENDING)
+    {
+        DPRINT1("SpiSendInquiry(): Waiting for the driver to process request...\n");
+        KeWaitForSingleObject(&Event,
+                              Executive,
+                              KernelMode,
+                              FALSE,
+                              NULL);
+        Status = IoStatusBlock.Status;
+    }
 
-        /* Check if data overrun happened */
-        if (SRB_STATUS(Srb.SrbStatus) == SRB_STATUS_DATA_OVERRUN)
-        {
-            DPRINT("Data overrun at TargetId %d\n", LunInfo->TargetId);
+    DPRINT1("SpiSendInquiry(): Request processed by driver, status = 0x%08X\n", Status);
 
-            /* Nothing dramatic, just copy data, but limiting the size */
-            RtlCopyMemory(LunInfo->InquiryData,
-                            InquiryBuffer,
-                            (Srb.DataTransferLength > INQUIRYDATABUFFERSIZE) ?
-                            INQUIRYDATABUFFERSIZE : Srb.DataTransferLength);
+    if (SRB_STATUS(Srb.SrbStatus) == SRB_STATUS_SUCCESS)
+    {
+        /* All fine */
+        Status = STATUS_SUCCESS;
+    }
+    else
+    {
+        DPRINT("Inquiry SRB failed with SrbStatus 0x%08X\n", Srb.SrbStatus);
 
-            /* Quit the loop */
-            Status = STATUS_SUCCESS;
-            KeepTrying = FALSE;
-        }
-        else if ((Srb.SrbStatus & SRB_STATUS_AUTOSENSE_VALID) &&
-                 SenseBuffer->SenseKey == SCSI_SENSE_ILLEGAL_REQUEST)
+        /* Set status according to SRB status */
+        if (SRB_STATUS(Srb.SrbStatus) == SRB_STATUS_BAD_FUNCTION ||
+            SRB_STATUS(Srb.SrbStatus) == SRB_STATUS_BAD_SRB_BLOCK_LENGTH)
         {
-            /* LUN is not valid, but some device responds there.
-                Mark it as invalid anyway */
-
-            /* Quit the loop */
             Status = STATUS_INVALID_DEVICE_REQUEST;
-            KeepTrying = FALSE;
         }
         else
         {
-            /* Retry a couple of times if no timeout happened */
-            if ((RetryCount < 2) &&
-                (SRB_STATUS(Srb.SrbStatus) != SRB_STATUS_NO_DEVICE) &&
-                (SRB_STATUS(Srb.SrbStatus) != SRB_STATUS_SELECTION_TIMEOUT))
-            {
-                RetryCount++;
-                KeepTrying = TRUE;
-            }
-            else
-            {
-                /* That's all, quit the loop */
-                KeepTrying = FALSE;
-
-                /* Set status according to SRB status */
-                if (SRB_STATUS(Srb.SrbStatus) == SRB_STATUS_BAD_FUNCTION ||
-                    SRB_STATUS(Srb.SrbStatus) == SRB_STATUS_BAD_SRB_BLOCK_LENGTH)
-                {
-                    Status = STATUS_INVALID_DEVICE_REQUEST;
-                }
-                else
-                {
-                    Status = STATUS_IO_DEVICE_ERROR;
-                }
-            }
+            Status = STATUS_IO_DEVICE_ERROR;
         }
-#endif
     }
 
     /* Free buffers */
-    if (SrbExtension != NULL)
-        ExFreePoolWithTag(SrbExtension, TAG_SENSE_DATA);
-
     ExFreePoolWithTag(SenseBuffer, TAG_SENSE_DATA);
     ExFreePoolWithTag(InquiryBuffer, TAG_INQUIRY_DATA);
 
@@ -574,19 +477,55 @@ PortFdoScsi(
     _In_ PIRP Irp)
 {
     PFDO_DEVICE_EXTENSION DeviceExtension;
-//    PIO_STACK_LOCATION Stack;
+    PIO_STACK_LOCATION Stack;
+    PSCSI_REQUEST_BLOCK Srb;
     ULONG_PTR Information = 0;
     NTSTATUS Status = STATUS_NOT_SUPPORTED;
 
-    DPRINT1("PortFdoScsi(%p %p)\n",
-            DeviceObject, Irp);
+    DPRINT("PortFdoScsi(%p %p)\n",
+           DeviceObject, Irp);
 
     DeviceExtension = (PFDO_DEVICE_EXTENSION)DeviceObject->DeviceExtension;
     ASSERT(DeviceExtension);
     ASSERT(DeviceExtension->ExtensionType == FdoExtension);
 
-//    Stack = IoGetCurrentIrpStackLocation(Irp);
+    Stack = IoGetCurrentIrpStackLocation(Irp);
+    Srb = Stack->Parameters.Scsi.Srb;
 
+    if (Srb == NULL)
+    {
+        Status = STATUS_INVALID_PARAMETER;
+    }
+    else if (DeviceExtension->PnpState != dsStarted)
+    {
+        Srb->SrbStatus = SRB_STATUS_NO_HBA;
+        Status = STATUS_DEVICE_NOT_READY;
+    }
+    else
+    {
+        switch (Srb->Function)
+        {
+            case SRB_FUNCTION_CLAIM_DEVICE:
+            case SRB_FUNCTION_RELEASE_DEVICE:
+            case SRB_FUNCTION_RELEASE_QUEUE:
+            case SRB_FUNCTION_FLUSH_QUEUE:
+            case SRB_FUNCTION_LOCK_QUEUE:
+            case SRB_FUNCTION_UNLOCK_QUEUE:
+                /* Queues are never frozen */
+                Srb->SrbStatus = SRB_STATUS_SUCCESS;
+                Status = STATUS_SUCCESS;
+                break;
+
+            default:
+                /* Everything else goes to the miniport */
+                Status = PortQueueRequest(DeviceExtension, Irp, Srb);
+                if (Status == STATUS_PENDING)
+                    return Status;
+
+                Srb->SrbStatus = SRB_STATUS_ERROR;
+                break;
+        }
+    }
 
     Irp->IoStatus.Information = Information;
     Irp->IoStatus.Status = Status;
@@ -629,6 +568,7 @@ PortFdoPnp(
 
         case IRP_MN_REMOVE_DEVICE: /* 0x02 */
             DPRINT1("IRP_MJ_PNP / IRP_MN_REMOVE_DEVICE\n");
+            PortDeleteQueues(DeviceExtension);
             break;
 
         case IRP_MN_CANCEL_REMOVE_DEVICE: /* 0x03 */
@@ -637,6 +577,7 @@ PortFdoPnp(
 
         case IRP_MN_STOP_DEVICE: /* 0x04 */
             DPRINT1("IRP_MJ_PNP / IRP_MN_STOP_DEVICE\n");
+            PortDeleteQueues(DeviceExtension);
             break;
 
         case IRP_MN_QUERY_STOP_DEVICE: /* 0x05 */
@@ -363,18 +363,54 @@ MiniportHwInterrupt(
 }
 
 
+BOOLEAN
+MiniportBuildIo(
+    _In_ PMINIPORT Miniport,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    BOOLEAN Result;
+
+    DPRINT("MiniportBuildIo(%p %p)\n",
+           Miniport, Srb);
+
+    /* HwBuildIo is optional */
+    if (Miniport->InitData->HwBuildIo == NULL)
+        return TRUE;
+
+    Result = Miniport->InitData->HwBuildIo(&Miniport->MiniportExtension->HwDeviceExtension, Srb);
+    DPRINT("HwBuildIo() returned %u\n", Result);
+
+    return Result;
+}
+
+
 BOOLEAN
 MiniportStartIo(
     _In_ PMINIPORT Miniport,
     _In_ PSCSI_REQUEST_BLOCK Srb)
 {
+    PKINTERRUPT Interrupt;
     BOOLEAN Result;
+    KIRQL OldIrql;
+
+    DPRINT("MiniportHwStartIo(%p %p)\n",
+           Miniport, Srb);
 
-    DPRINT1("MiniportHwStartIo(%p %p)\n",
-            Miniport, Srb);
+    /* Half duplex miniports expect HwStartIo and HwInterrupt to be serialized */
+    Interrupt = Miniport->DeviceExtension->Interrupt;
+    if (Miniport->PortConfig.SynchronizationModel == StorSynchronizeHalfDuplex &&
+        Interrupt != NULL)
+    {
+        OldIrql = KeAcquireInterruptSpinLock(Interrupt);
+        Result = Miniport->InitData->HwStartIo(&Miniport->MiniportExtension->HwDeviceExtension, Srb);
+        KeReleaseInterruptSpinLock(Interrupt, OldIrql);
+    }
+    else
+    {
+        Result = Miniport->InitData->HwStartIo(&Miniport->MiniportExtension->HwDeviceExtension, Srb);
+    }
 
-    Result = Miniport->InitData->HwStartIo(&Miniport->MiniportExtension->HwDeviceExtension, Srb);
-    DPRINT1("HwStartIo() returned %u\n", Result);
+    DPRINT("HwStartIo() returned %u\n", Result);
 
     return Result;
 }
@@ -31,6 +31,12 @@
 #define TAG_ADDRESS_MAPPING 'MAtS'
 #define TAG_INQUIRY_DATA    'QItS'
 #define TAG_SENSE_DATA      'NStS'
+#define TAG_UNIT_DATA       'DUtS'
+#define TAG_REQUEST         'QRtS'
+#define TAG_SRB_EXTENSION   'EStS'
+
+/* Requests per logical unit until the miniport sets the queue depth */
+#define DEFAULT_QUEUE_DEPTH 20
 
 typedef enum
 {
@@ -81,6 +87,29 @@ typedef struct _MINIPORT
     PMINIPORT_DEVICE_EXTENSION MiniportExtension;
 } MINIPORT, *PMINIPORT;
 
+typedef struct _UNIT_DATA
+{
+    LIST_ENTRY ListEntry;
+    UCHAR PathId;
+    UCHAR TargetId;
+    UCHAR Lun;
+    ULONG QueueDepth;
+    ULONG OutstandingRequests;      /* Requests passed to HwStartIo */
+    LONG BusyRequests;              /* Completions to wait for after StorPortDeviceBusy */
+    LIST_ENTRY PendingRequestList;  /* Requests waiting for the unit */
+    PVOID LuExtension;
+} UNIT_DATA, *PUNIT_DATA;
+
+typedef struct _PORT_REQUEST
+{
+    LIST_ENTRY ListEntry;           /* Pending request list or completion list */
+    PIRP Irp;
+    PSCSI_REQUEST_BLOCK Srb;
+    PUNIT_DATA Unit;
+    PVOID DataBuffer;               /* Data buffer of the caller */
+    PSTOR_SCATTER_GATHER_LIST ScatterGatherList;
+} PORT_REQUEST, *PPORT_REQUEST;
+
 typedef struct _FDO_DEVICE_EXTENSION
 {
     EXTENSION_TYPE ExtensionType;
@@ -105,6 +134,19 @@ typedef struct _FDO_DEVICE_EXTENSION
     PHW_PASSIVE_INITIALIZE_ROUTINE HwPassiveInitRoutine;
     PKINTERRUPT Interrupt;
     ULONG InterruptIrql;
+
+    KSPIN_LOCK StartIoLock;         /* Protects the units and HwStartIo */
+    LIST_ENTRY UnitListHead;
+    PLIST_ENTRY NextUnitEntry;      /* Unit to start the next request from */
+    ULONG OutstandingRequests;
+    LONG BusyRequests;              /* Completions to wait for after StorPortBusy */
+    KSPIN_LOCK CompletionLock;
+    LIST_ENTRY CompletionList;
+    KDPC CompletionDpc;
+    KTIMER RetryTimer;              /* Restarts the queues after HwStartIo rejected a request */
+    KDPC RetryDpc;
+    NPAGED_LOOKASIDE_LIST SrbExtensionList;
+    BOOLEAN SrbExtensionListInitialized;
 } FDO_DEVICE_EXTENSION, *PFDO_DEVICE_EXTENSION;
 
 
@@ -154,6 +196,11 @@ BOOLEAN
 MiniportHwInterrupt(
     _In_ PMINIPORT Miniport);
 
+BOOLEAN
+MiniportBuildIo(
+    _In_ PMINIPORT Miniport,
+    _In_ PSCSI_REQUEST_BLOCK Srb);
+
 BOOLEAN
 MiniportStartIo(
     _In_ PMINIPORT Miniport,
@@ -232,6 +279,42 @@ PortPdoPnp(
     _In_ PIRP Irp);
 
 
+/* queue.c */
+
+PUNIT_DATA
+PortGetUnit(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ UCHAR PathId,
+    _In_ UCHAR TargetId,
+    _In_ UCHAR Lun);
+
+VOID
+PortInitializeQueues(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension);
+
+VOID
+PortDeleteQueues(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension);
+
+NTSTATUS
+PortQueueRequest(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PIRP Irp,
+    _In_ PSCSI_REQUEST_BLOCK Srb);
+
+VOID
+PortStartNextRequests(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension);
+
+VOID
+PortRequestComplete(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb);
+
+PSTOR_SCATTER_GATHER_LIST
+PortGetScatterGatherList(
+    _In_ PSCSI_REQUEST_BLOCK Srb);
+
 /* storport.c */
 
 PHW_INITIALIZATION_DATA
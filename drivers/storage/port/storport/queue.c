@@ -0,0 +1,683 @@
+/*
+ * PROJECT:     ReactOS Storport Driver
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Storport request queues
+ */
+
+/* INCLUDES *******************************************************************/
+
+#include "precomp.h"
+
+#define NDEBUG
+#include <debug.h>
+
+/* Delay before HwStartIo is called again, when it rejected a request
+   while none were outstanding: 10 ms, in 100 ns units */
+#define START_IO_RETRY_DELAY    (-10 * 10000LL)
+
+
+/* FUNCTIONS ******************************************************************/
+
+static
+BOOLEAN
+IsReadWriteRequest(
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    switch (Srb->Cdb[0])
+    {
+        case SCSIOP_READ6:
+        case SCSIOP_WRITE6:
+        case SCSIOP_READ:
+        case SCSIOP_WRITE:
+        case SCSIOP_READ12:
+        case SCSIOP_WRITE12:
+        case SCSIOP_READ16:
+        case SCSIOP_WRITE16:
+            return TRUE;
+
+        default:
+            return FALSE;
+    }
+}
+
+
+static
+VOID
+DecrementBusyCount(
+    _Inout_ PLONG BusyRequests)
+{
+    LONG Count;
+
+    /* The count may be reset by StorPortReady at the same time */
+    do
+    {
+        Count = *BusyRequests;
+        if (Count == 0)
+            return;
+    } while (InterlockedCompareExchange(BusyRequests, Count - 1, Count) != Count);
+}
+
+
+static
+PUNIT_DATA
+PortCreateUnit(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ UCHAR PathId,
+    _In_ UCHAR TargetId,
+    _In_ UCHAR Lun)
+{
+    PUNIT_DATA Unit;
+    ULONG LuExtensionSize;
+
+    DPRINT("PortCreateUnit(%p %u %u %u)\n",
+           DeviceExtension, PathId, TargetId, Lun);
+
+    LuExtensionSize = DeviceExtension->Miniport.PortConfig.SpecificLuExtensionSize;
+
+    Unit = ExAllocatePoolWithTag(NonPagedPool,
+                                 sizeof(UNIT_DATA) + LuExtensionSize,
+                                 TAG_UNIT_DATA);
+    if (Unit == NULL)
+        return NULL;
+
+    RtlZeroMemory(Unit, sizeof(UNIT_DATA) + LuExtensionSize);
+
+    Unit->PathId = PathId;
+    Unit->TargetId = TargetId;
+    Unit->Lun = Lun;
+    Unit->QueueDepth = DEFAULT_QUEUE_DEPTH;
+    InitializeListHead(&Unit->PendingRequestList);
+
+    if (LuExtensionSize != 0)
+        Unit->LuExtension = (PVOID)(Unit + 1);
+
+    /* Units are never removed while the adapter runs, so StorPortDeviceBusy
+       and friends look them up at any IRQL without the lock, following the
+       Flink pointers only. The caller holds the StartIo lock, which keeps
+       other writers out. Link the new unit completely, then publish it
+       with a single interlocked store, which also orders the writes to
+       the unit before it. */
+    Unit->ListEntry.Flink = &DeviceExtension->UnitListHead;
+    Unit->ListEntry.Blink = DeviceExtension->UnitListHead.Blink;
+    InterlockedExchangePointer((PVOID volatile *)&DeviceExtension->UnitListHead.Blink->Flink,
+                               &Unit->ListEntry);
+    DeviceExtension->UnitListHead.Blink = &Unit->ListEntry;
+
+    return Unit;
+}
+
+
+PUNIT_DATA
+PortGetUnit(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ UCHAR PathId,
+    _In_ UCHAR TargetId,
+    _In_ UCHAR Lun)
+{
+    PLIST_ENTRY ListEntry;
+    PUNIT_DATA Unit;
+
+    /* See PortCreateUnit, this does not need the StartIo lock */
+    ListEntry = *(PLIST_ENTRY volatile *)&DeviceExtension->UnitListHead.Flink;
+    while (ListEntry != &DeviceExtension->UnitListHead)
+    {
+        Unit = CONTAINING_RECORD(ListEntry, UNIT_DATA, ListEntry);
+        if (Unit->PathId == PathId &&
+            Unit->TargetId == TargetId &&
+            Unit->Lun == Lun)
+        {
+            return Unit;
+        }
+
+        ListEntry = *(PLIST_ENTRY volatile *)&ListEntry->Flink;
+    }
+
+    return NULL;
+}
+
+
+static
+NTSTATUS
+PortBuildScatterGatherList(
+    _In_ PPORT_REQUEST Request,
+    _In_ ULONG MaximumElements)
+{
+    PSTOR_SCATTER_GATHER_LIST List;
+    PSCSI_REQUEST_BLOCK Srb;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    PPFN_NUMBER PfnArray;
+    ULONG_PTR Offset;
+    ULONG Remaining, Length, Count;
+    PMDL Mdl;
+
+    Srb = Request->Srb;
+    List = Request->ScatterGatherList;
+    Mdl = Request->Irp->MdlAddress;
+
+    /* Page offset of the data buffer, in the MDL if there is one */
+    if (Mdl != NULL)
+    {
+        PfnArray = MmGetMdlPfnArray(Mdl);
+        Offset = (ULONG_PTR)Request->DataBuffer - (ULONG_PTR)MmGetMdlVirtualAddress(Mdl) +
+                 MmGetMdlByteOffset(Mdl);
+    }
+    else
+    {
+        PfnArray = NULL;
+        Offset = 0;
+    }
+
+    Count = 0;
+    Remaining = Srb->DataTransferLength;
+    while (Remaining != 0)
+    {
+        if (PfnArray != NULL)
+        {
+            PhysicalAddress.QuadPart = ((ULONGLONG)PfnArray[Offset >> PAGE_SHIFT] << PAGE_SHIFT) +
+                                       (Offset & (PAGE_SIZE - 1));
+            Length = PAGE_SIZE - (ULONG)(Offset & (PAGE_SIZE - 1));
+        }
+        else
+        {
+            /* Port internal requests use non-paged pool buffers */
+            PhysicalAddress = MmGetPhysicalAddress((PUCHAR)Request->DataBuffer + Offset);
+            Length = PAGE_SIZE - BYTE_OFFSET((PUCHAR)Request->DataBuffer + Offset);
+        }
+
+        if (Length > Remaining)
+            Length = Remaining;
+
+        /* Merge physically contiguous pages */
+        if (Count != 0 &&
+            List->List[Count - 1].PhysicalAddress.QuadPart + List->List[Count - 1].Length == PhysicalAddress.QuadPart)
+        {
+            List->List[Count - 1].Length += Length;
+        }
+        else
+        {
+            if (Count == MaximumElements)
+                return STATUS_INSUFFICIENT_RESOURCES;
+
+            List->List[Count].PhysicalAddress = PhysicalAddress;
+            List->List[Count].Length = Length;
+            List->List[Count].Reserved = 0;
+            Count++;
+        }
+
+        Offset += Length;
+        Remaining -= Length;
+    }
+
+    List->NumberOfElements = Count;
+
+    return STATUS_SUCCESS;
+}
+
+
+static
+VOID
+PortFreeRequest(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PPORT_REQUEST Request)
+{
+    PSCSI_REQUEST_BLOCK Srb = Request->Srb;
+
+    if (Srb->SrbExtension != NULL)
+    {
+        ExFreeToNPagedLookasideList(&DeviceExtension->SrbExtensionList,
+                                    Srb->SrbExtension);
+        Srb->SrbExtension = NULL;
+    }
+
+    /* Hand the caller's buffer back */
+    Srb->DataBuffer = Request->DataBuffer;
+
+    ExFreePoolWithTag(Request, TAG_REQUEST);
+}
+
+
+static
+VOID
+PortCompleteIrp(
+    _In_ PIRP Irp,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    switch (SRB_STATUS(Srb->SrbStatus))
+    {
+        case SRB_STATUS_SUCCESS:
+            Irp->IoStatus.Status = STATUS_SUCCESS;
+            Irp->IoStatus.Information = Srb->DataTransferLength;
+            break;
+
+        case SRB_STATUS_DATA_OVERRUN:
+            /* Short transfer, DataTransferLength has the real length */
+            Irp->IoStatus.Status = STATUS_SUCCESS;
+            Irp->IoStatus.Information = Srb->DataTransferLength;
+            break;
+
+        case SRB_STATUS_INVALID_REQUEST:
+        case SRB_STATUS_BAD_FUNCTION:
+            Irp->IoStatus.Status = STATUS_INVALID_DEVICE_REQUEST;
+            Irp->IoStatus.Information = 0;
+            break;
+
+        case SRB_STATUS_NO_DEVICE:
+        case SRB_STATUS_SELECTION_TIMEOUT:
+            Irp->IoStatus.Status = STATUS_DEVICE_DOES_NOT_EXIST;
+            Irp->IoStatus.Information = 0;
+            break;
+
+        default:
+            Irp->IoStatus.Status = STATUS_IO_DEVICE_ERROR;
+            Irp->IoStatus.Information = 0;
+            break;
+    }
+
+    IoCompleteRequest(Irp, IO_DISK_INCREMENT);
+}
+
+
+static
+VOID
+NTAPI
+PortCompletionDpcRoutine(
+    _In_ PKDPC Dpc,
+    _In_opt_ PVOID DeferredContext,
+    _In_opt_ PVOID SystemArgument1,
+    _In_opt_ PVOID SystemArgument2)
+{
+    PFDO_DEVICE_EXTENSION DeviceExtension;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    PPORT_REQUEST Request;
+    PLIST_ENTRY ListEntry;
+    PSCSI_REQUEST_BLOCK Srb;
+    PIRP Irp;
+
+    DeviceExtension = (PFDO_DEVICE_EXTENSION)DeferredContext;
+
+    while ((ListEntry = ExInterlockedRemoveHeadList(&DeviceExtension->CompletionList,
+                                                    &DeviceExtension->CompletionLock)) != NULL)
+    {
+        Request = CONTAINING_RECORD(ListEntry, PORT_REQUEST, ListEntry);
+        Srb = Request->Srb;
+        Irp = Request->Irp;
+
+        DPRINT("Completing Srb %p Irp %p (SrbStatus 0x%02x)\n", Srb, Irp, Srb->SrbStatus);
+
+        /* Requests completed by HwBuildIo never reached a unit */
+        if (Request->Unit != NULL)
+        {
+            KeAcquireInStackQueuedSpinLockAtDpcLevel(&DeviceExtension->StartIoLock, &LockHandle);
+
+            Request->Unit->OutstandingRequests--;
+            DeviceExtension->OutstandingRequests--;
+
+            /* A busy unit or adapter waits for completions, but not for ones that will never come */
+            DecrementBusyCount(&Request->Unit->BusyRequests);
+            if (Request->Unit->OutstandingRequests == 0)
+                Request->Unit->BusyRequests = 0;
+
+            DecrementBusyCount(&DeviceExtension->BusyRequests);
+            if (DeviceExtension->OutstandingRequests == 0)
+                DeviceExtension->BusyRequests = 0;
+
+            KeReleaseInStackQueuedSpinLockFromDpcLevel(&LockHandle);
+        }
+
+        PortFreeRequest(DeviceExtension, Request);
+        PortCompleteIrp(Irp, Srb);
+    }
+
+    /* The completions made room in the unit queues */
+    PortStartNextRequests(DeviceExtension);
+}
+
+
+static
+VOID
+NTAPI
+PortRetryDpcRoutine(
+    _In_ PKDPC Dpc,
+    _In_opt_ PVOID DeferredContext,
+    _In_opt_ PVOID SystemArgument1,
+    _In_opt_ PVOID SystemArgument2)
+{
+    PFDO_DEVICE_EXTENSION DeviceExtension;
+
+    DeviceExtension = (PFDO_DEVICE_EXTENSION)DeferredContext;
+
+    DPRINT("Retrying the rejected requests\n");
+    PortStartNextRequests(DeviceExtension);
+}
+
+
+VOID
+PortInitializeQueues(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension)
+{
+    KeInitializeSpinLock(&DeviceExtension->StartIoLock);
+    InitializeListHead(&DeviceExtension->UnitListHead);
+    DeviceExtension->NextUnitEntry = &DeviceExtension->UnitListHead;
+
+    KeInitializeSpinLock(&DeviceExtension->CompletionLock);
+    InitializeListHead(&DeviceExtension->CompletionList);
+    KeInitializeDpc(&DeviceExtension->CompletionDpc,
+                    PortCompletionDpcRoutine,
+                    DeviceExtension);
+
+    KeInitializeTimer(&DeviceExtension->RetryTimer);
+    KeInitializeDpc(&DeviceExtension->RetryDpc,
+                    PortRetryDpcRoutine,
+                    DeviceExtension);
+}
+
+
+VOID
+PortDeleteQueues(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension)
+{
+    KLOCK_QUEUE_HANDLE LockHandle;
+    LIST_ENTRY UnitList;
+    PPORT_REQUEST Request;
+    PSCSI_REQUEST_BLOCK Srb;
+    PUNIT_DATA Unit;
+    PIRP Irp;
+
+    DPRINT("PortDeleteQueues(%p)\n", DeviceExtension);
+
+    if (DeviceExtension->OutstandingRequests != 0)
+    {
+        DPRINT1("%lu requests are still outstanding\n",
+                DeviceExtension->OutstandingRequests);
+    }
+
+    /* The completion and retry DPCs can arm the retry timer again,
+       so repeat until neither the timer nor its DPC is queued */
+    do
+    {
+        KeFlushQueuedDpcs();
+    } while (KeCancelTimer(&DeviceExtension->RetryTimer) ||
+             KeRemoveQueueDpc(&DeviceExtension->RetryDpc));
+
+    /* Take the units off the adapter, they are created again on the next request */
+    KeAcquireInStackQueuedSpinLock(&DeviceExtension->StartIoLock, &LockHandle);
+
+    InitializeListHead(&UnitList);
+    if (!IsListEmpty(&DeviceExtension->UnitListHead))
+    {
+        UnitList.Flink = DeviceExtension->UnitListHead.Flink;
+        UnitList.Blink = DeviceExtension->UnitListHead.Blink;
+        UnitList.Flink->Blink = &UnitList;
+        UnitList.Blink->Flink = &UnitList;
+        InitializeListHead(&DeviceExtension->UnitListHead);
+    }
+    DeviceExtension->NextUnitEntry = &DeviceExtension->UnitListHead;
+
+    KeReleaseInStackQueuedSpinLock(&LockHandle);
+
+    /* Fail the requests that never reached the miniport and free the units */
+    while (!IsListEmpty(&UnitList))
+    {
+        Unit = CONTAINING_RECORD(RemoveHeadList(&UnitList), UNIT_DATA, ListEntry);
+
+        while (!IsListEmpty(&Unit->PendingRequestList))
+        {
+            Request = CONTAINING_RECORD(RemoveHeadList(&Unit->PendingRequestList),
+                                        PORT_REQUEST,
+                                        ListEntry);
+            Srb = Request->Srb;
+            Irp = Request->Irp;
+
+            Srb->SrbStatus = SRB_STATUS_NO_DEVICE;
+            PortFreeRequest(DeviceExtension, Request);
+            PortCompleteIrp(Irp, Srb);
+        }
+
+        ExFreePoolWithTag(Unit, TAG_UNIT_DATA);
+    }
+
+    /* The SRB extension size may change when the adapter is started again */
+    if (DeviceExtension->SrbExtensionListInitialized)
+    {
+        ExDeleteNPagedLookasideList(&DeviceExtension->SrbExtensionList);
+        DeviceExtension->SrbExtensionListInitialized = FALSE;
+    }
+}
+
+
+NTSTATUS
+PortQueueRequest(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PIRP Irp,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    KLOCK_QUEUE_HANDLE LockHandle;
+    PPORT_REQUEST Request;
+    PUNIT_DATA Unit;
+    PVOID SystemAddress;
+    ULONG MaximumElements, MapBuffers;
+    BOOLEAN Result;
+    KIRQL OldIrql;
+    NTSTATUS Status;
+
+    DPRINT("PortQueueRequest(%p %p %p)\n",
+           DeviceExtension, Irp, Srb);
+
+    /* One element per page the buffer touches is always enough */
+    MaximumElements = 0;
+    if (Srb->DataTransferLength != 0 && Srb->DataBuffer != NULL)
+        MaximumElements = ADDRESS_AND_SIZE_TO_SPAN_PAGES(Srb->DataBuffer, Srb->DataTransferLength);
+
+    Request = ExAllocatePoolWithTag(NonPagedPool,
+                                    sizeof(PORT_REQUEST) +
+                                    FIELD_OFFSET(STOR_SCATTER_GATHER_LIST, List[MaximumElements]),
+                                    TAG_REQUEST);
+    if (Request == NULL)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    Request->Irp = Irp;
+    Request->Srb = Srb;
+    Request->Unit = NULL;
+    Request->DataBuffer = Srb->DataBuffer;
+    Request->ScatterGatherList = (PSTOR_SCATTER_GATHER_LIST)(Request + 1);
+    Request->ScatterGatherList->NumberOfElements = 0;
+    Request->ScatterGatherList->Reserved = 0;
+
+    Srb->OriginalRequest = Irp;
+    Srb->SrbExtension = NULL;
+    Srb->SrbStatus = SRB_STATUS_PENDING;
+    Irp->Tail.Overlay.DriverContext[0] = Request;
+
+    if (MaximumElements != 0)
+    {
+        Status = PortBuildScatterGatherList(Request, MaximumElements);
+        if (!NT_SUCCESS(Status))
+        {
+            PortFreeRequest(DeviceExtension, Request);
+            return Status;
+        }
+
+        /* Give the miniport a system address if it wants to touch the data */
+        MapBuffers = DeviceExtension->Miniport.PortConfig.MapBuffers;
+        if (Irp->MdlAddress != NULL &&
+            (MapBuffers == STOR_MAP_ALL_BUFFERS ||
+             (MapBuffers == STOR_MAP_NON_READ_WRITE_BUFFERS && !IsReadWriteRequest(Srb))))
+        {
+            SystemAddress = MmGetSystemAddressForMdlSafe(Irp->MdlAddress, NormalPagePriority);
+            if (SystemAddress == NULL)
+            {
+                PortFreeRequest(DeviceExtension, Request);
+                return STATUS_INSUFFICIENT_RESOURCES;
+            }
+
+            Srb->DataBuffer = (PUCHAR)SystemAddress +
+                              ((ULONG_PTR)Request->DataBuffer - (ULONG_PTR)MmGetMdlVirtualAddress(Irp->MdlAddress));
+        }
+    }
+
+    if (DeviceExtension->SrbExtensionListInitialized)
+    {
+        Srb->SrbExtension = ExAllocateFromNPagedLookasideList(&DeviceExtension->SrbExtensionList);
+        if (Srb->SrbExtension == NULL)
+        {
+            PortFreeRequest(DeviceExtension, Request);
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        RtlZeroMemory(Srb->SrbExtension,
+                      DeviceExtension->Miniport.PortConfig.SrbExtensionSize);
+    }
+
+    IoMarkIrpPending(Irp);
+
+    KeRaiseIrql(DISPATCH_LEVEL, &OldIrql);
+
+    /* HwBuildIo runs without any lock held, so requests get prepared in parallel */
+    Result = MiniportBuildIo(&DeviceExtension->Miniport, Srb);
+    if (Result)
+    {
+        KeAcquireInStackQueuedSpinLockAtDpcLevel(&DeviceExtension->StartIoLock, &LockHandle);
+
+        Unit = PortGetUnit(DeviceExtension, Srb->PathId, Srb->TargetId, Srb->Lun);
+        if (Unit == NULL)
+            Unit = PortCreateUnit(DeviceExtension, Srb->PathId, Srb->TargetId, Srb->Lun);
+
+        if (Unit != NULL)
+        {
+            Request->Unit = Unit;
+            InsertTailList(&Unit->PendingRequestList, &Request->ListEntry);
+        }
+
+        KeReleaseInStackQueuedSpinLockFromDpcLevel(&LockHandle);
+
+        if (Unit != NULL)
+        {
+            PortStartNextRequests(DeviceExtension);
+        }
+        else
+        {
+            Srb->SrbStatus = SRB_STATUS_ERROR;
+            PortFreeRequest(DeviceExtension, Request);
+            PortCompleteIrp(Irp, Srb);
+        }
+    }
+    else
+    {
+        /* The miniport completed the request through StorPortNotification already */
+        DPRINT("HwBuildIo() completed Srb %p\n", Srb);
+    }
+
+    KeLowerIrql(OldIrql);
+
+    return STATUS_PENDING;
+}
+
+
+VOID
+PortStartNextRequests(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension)
+{
+    KLOCK_QUEUE_HANDLE LockHandle;
+    PPORT_REQUEST Request;
+    PLIST_ENTRY UnitEntry, ListEntry;
+    PUNIT_DATA Unit = NULL;
+    BOOLEAN Result;
+
+    KeAcquireInStackQueuedSpinLock(&DeviceExtension->StartIoLock, &LockHandle);
+
+    while (DeviceExtension->BusyRequests == 0)
+    {
+        /* Take turns between the units, starting after the last one served */
+        Request = NULL;
+        UnitEntry = DeviceExtension->NextUnitEntry;
+        do
+        {
+            UnitEntry = UnitEntry->Flink;
+            if (UnitEntry == &DeviceExtension->UnitListHead)
+                continue;
+
+            Unit = CONTAINING_RECORD(UnitEntry, UNIT_DATA, ListEntry);
+            if (Unit->BusyRequests == 0 &&
+                Unit->OutstandingRequests < Unit->QueueDepth &&
+                !IsListEmpty(&Unit->PendingRequestList))
+            {
+                ListEntry = RemoveHeadList(&Unit->PendingRequestList);
+                Request = CONTAINING_RECORD(ListEntry, PORT_REQUEST, ListEntry);
+                break;
+            }
+        } while (UnitEntry != DeviceExtension->NextUnitEntry);
+
+        if (Request == NULL)
+            break;
+
+        DeviceExtension->NextUnitEntry = UnitEntry;
+        Unit->OutstandingRequests++;
+        DeviceExtension->OutstandingRequests++;
+
+        /* HwStartIo runs under the StartIo lock only. Completions and the
+           interrupt keep going while it runs. */
+        Result = MiniportStartIo(&DeviceExtension->Miniport, Request->Srb);
+        if (!Result)
+        {
+            /* Not accepted, try again once something completes */
+            DPRINT("HwStartIo() rejected Srb %p\n", Request->Srb);
+            Unit->OutstandingRequests--;
+            DeviceExtension->OutstandingRequests--;
+            InsertHeadList(&Unit->PendingRequestList, &Request->ListEntry);
+
+            /* If nothing is outstanding, no completion will restart the queues */
+            if (DeviceExtension->OutstandingRequests == 0)
+            {
+                LARGE_INTEGER DueTime;
+
+                DueTime.QuadPart = START_IO_RETRY_DELAY;
+                KeSetTimer(&DeviceExtension->RetryTimer, DueTime, &DeviceExtension->RetryDpc);
+            }
+            break;
+        }
+    }
+
+    KeReleaseInStackQueuedSpinLock(&LockHandle);
+}
+
+
+VOID
+PortRequestComplete(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PPORT_REQUEST Request;
+    PIRP Irp;
+
+    /* May be called from HwInterrupt, just hand the request to the DPC */
+    Irp = (PIRP)Srb->OriginalRequest;
+    Request = (PPORT_REQUEST)Irp->Tail.Overlay.DriverContext[0];
+    ASSERT(Request->Srb == Srb);
+
+    ExInterlockedInsertTailList(&DeviceExtension->CompletionList,
+                                &Request->ListEntry,
+                                &DeviceExtension->CompletionLock);
+
+    KeInsertQueueDpc(&DeviceExtension->CompletionDpc, NULL, NULL);
+}
+
+
+PSTOR_SCATTER_GATHER_LIST
+PortGetScatterGatherList(
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PPORT_REQUEST Request;
+    PIRP Irp;
+
+    Irp = (PIRP)Srb->OriginalRequest;
+    if (Irp == NULL)
+        return NULL;
+
+    Request = (PPORT_REQUEST)Irp->Tail.Overlay.DriverContext[0];
+    if (Request == NULL || Request->Srb != Srb)
+        return NULL;
+
+    return Request->ScatterGatherList;
+}
+
+/* EOF */
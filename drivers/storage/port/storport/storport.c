@@ -117,10 +117,14 @@ PortAcquireSpinLock(
     {
         case DpcLock: /* 1, */
             DPRINT1("DpcLock\n");
+            KeAcquireInStackQueuedSpinLock((PKSPIN_LOCK)&((PSTOR_DPC)LockContext)->Lock,
+                                           (PKLOCK_QUEUE_HANDLE)&LockHandle->Context);
             break;
 
         case StartIoLock: /* 2 */
             DPRINT1("StartIoLock\n");
+            KeAcquireInStackQueuedSpinLock(&DeviceExtension->StartIoLock,
+                                           (PKLOCK_QUEUE_HANDLE)&LockHandle->Context);
             break;
 
         case InterruptLock: /* 3 */
@@ -146,11 +150,10 @@ PortReleaseSpinLock(
     switch (LockHandle->Lock)
     {
         case DpcLock: /* 1, */
-            DPRINT1("DpcLock\n");
-            break;
-
         case StartIoLock: /* 2 */
-            DPRINT1("StartIoLock\n");
+            DPRINT1("%s\n", (LockHandle->Lock == DpcLock) ? "DpcLock" : "StartIoLock");
+            /* The queue handle remembers which lock it holds */
+            KeReleaseInStackQueuedSpinLock((PKLOCK_QUEUE_HANDLE)&LockHandle->Context);
             break;
 
         case InterruptLock: /* 3 */
@@ -223,6 +226,8 @@ PortAddDevice(
 
     DeviceExtension->PnpState = dsStopped;
 
+    PortInitializeQueues(DeviceExtension);
+
     /* Attach the FDO to the device stack */
     Status = IoAttachDeviceToDeviceStackSafe(Fdo,
                                              PhysicalDeviceObject,
@@ -477,7 +482,7 @@ StorPortAllocateRegistryBuffer(
 
 
 /*
- * @unimplemented
+ * @implemented
  */
 STORPORT_API
 BOOLEAN
@@ -486,9 +491,23 @@ StorPortBusy(
     _In_ PVOID HwDeviceExtension,
     _In_ ULONG RequestsToComplete)
 {
-    DPRINT1("StorPortBuzy()\n");
-    UNIMPLEMENTED;
-    return FALSE;
+    PMINIPORT_DEVICE_EXTENSION MiniportExtension;
+    PFDO_DEVICE_EXTENSION DeviceExtension;
+
+    DPRINT("StorPortBusy(%p %lu)\n",
+           HwDeviceExtension, RequestsToComplete);
+
+    /* Get the miniport extension */
+    MiniportExtension = CONTAINING_RECORD(HwDeviceExtension,
+                                          MINIPORT_DEVICE_EXTENSION,
+                                          HwDeviceExtension);
+    DeviceExtension = MiniportExtension->Miniport->DeviceExtension;
+
+    /* Hold back new requests until enough of them have completed */
+    InterlockedExchange(&DeviceExtension->BusyRequests,
+                        max(RequestsToComplete, 1));
+
+    return TRUE;
 }
 
 
@@ -562,7 +581,7 @@ StorPortDebugPrint(
 
 
 /*
- * @unimplemented
+ * @implemented
  */
 STORPORT_API
 BOOLEAN
@@ -574,14 +593,33 @@ StorPortDeviceBusy(
     _In_ UCHAR Lun,
     _In_ ULONG RequestsToComplete)
 {
-    DPRINT1("StorPortDeviceBusy()\n");
-    UNIMPLEMENTED;
-    return FALSE;
+    PMINIPORT_DEVICE_EXTENSION MiniportExtension;
+    PFDO_DEVICE_EXTENSION DeviceExtension;
+    PUNIT_DATA Unit;
+
+    DPRINT("StorPortDeviceBusy(%p %u %u %u %lu)\n",
+           HwDeviceExtension, PathId, TargetId, Lun, RequestsToComplete);
+
+    /* Get the miniport extension */
+    MiniportExtension = CONTAINING_RECORD(HwDeviceExtension,
+                                          MINIPORT_DEVICE_EXTENSION,
+                                          HwDeviceExtension);
+    DeviceExtension = MiniportExtension->Miniport->DeviceExtension;
+
+    Unit = PortGetUnit(DeviceExtension, PathId, TargetId, Lun);
+    if (Unit == NULL)
+        return FALSE;
+
+    /* Hold back new requests for the unit until enough of them have completed */
+    InterlockedExchange(&Unit->BusyRequests,
+                        max(RequestsToComplete, 1));
+
+    return TRUE;
 }
 
 
 /*
- * @unimplemented
+ * @implemented
  */
 STORPORT_API
 BOOLEAN
@@ -592,9 +630,29 @@ StorPortDeviceReady(
     _In_ UCHAR TargetId,
     _In_ UCHAR Lun)
 {
-    DPRINT1("StorPortDeviceReady()\n");
-    UNIMPLEMENTED;
-    return FALSE;
+    PMINIPORT_DEVICE_EXTENSION MiniportExtension;
+    PFDO_DEVICE_EXTENSION DeviceExtension;
+    PUNIT_DATA Unit;
+
+    DPRINT("StorPortDeviceReady(%p %u %u %u)\n",
+           HwDeviceExtension, PathId, TargetId, Lun);
+
+    /* Get the miniport extension */
+    MiniportExtension = CONTAINING_RECORD(HwDeviceExtension,
+                                          MINIPORT_DEVICE_EXTENSION,
+                                          HwDeviceExtension);
+    DeviceExtension = MiniportExtension->Miniport->DeviceExtension;
+
+    Unit = PortGetUnit(DeviceExtension, PathId, TargetId, Lun);
+    if (Unit == NULL)
+        return FALSE;
+
+    InterlockedExchange(&Unit->BusyRequests, 0);
+
+    /* Restart the queues from the completion DPC */
+    KeInsertQueueDpc(&DeviceExtension->CompletionDpc, NULL, NULL);
+
+    return TRUE;
 }
 
 
@@ -762,7 +820,7 @@ StorPortGetDeviceBase(
 
 
 /*
- * @unimplemented
+ * @implemented
  */
 STORPORT_API
 PVOID
@@ -773,9 +831,22 @@ StorPortGetLogicalUnit(
     _In_ UCHAR TargetId,
     _In_ UCHAR Lun)
 {
-    DPRINT1("StorPortGetLogicalUnit()\n");
-    UNIMPLEMENTED;
-    return NULL;
+    PMINIPORT_DEVICE_EXTENSION MiniportExtension;
+    PUNIT_DATA Unit;
+
+    DPRINT("StorPortGetLogicalUnit()\n");
+
+    /* Get the miniport extension */
+    MiniportExtension = CONTAINING_RECORD(HwDeviceExtension,
+                                          MINIPORT_DEVICE_EXTENSION,
+                                          HwDeviceExtension);
+
+    Unit = PortGetUnit(MiniportExtension->Miniport->DeviceExtension,
+                       PathId, TargetId, Lun);
+    if (Unit == NULL)
+        return NULL;
+
+    return Unit->LuExtension;
 }
 
 
@@ -835,7 +906,7 @@ StorPortGetPhysicalAddress(
 
 
 /*
- * @unimplemented
+ * @implemented
  */
 STORPORT_API
 PSTOR_SCATTER_GATHER_LIST
@@ -844,9 +915,10 @@ StorPortGetScatterGatherList(
     _In_ PVOID DeviceExtension,
     _In_ PSCSI_REQUEST_BLOCK Srb)
 {
-    DPRINT1("StorPortGetScatterGatherList()\n");
-    UNIMPLEMENTED;
-    return NULL;
+    DPRINT("StorPortGetScatterGatherList(%p %p)\n",
+           DeviceExtension, Srb);
+
+    return PortGetScatterGatherList(Srb);
 }
 
 
@@ -1099,6 +1171,10 @@ StorPortNotification(
     PBOOLEAN Result;
     PSTOR_DPC Dpc;
     PHW_DPC_ROUTINE HwDpcRoutine;
+    PSCSI_REQUEST_BLOCK Srb;
+    PVOID SystemArgument1;
+    PVOID SystemArgument2;
+    PBOOLEAN Succeeded;
     va_list ap;
 
     STOR_SPINLOCK SpinLock;
@@ -1124,6 +1200,13 @@ StorPortNotification(
 
     switch (NotificationType)
     {
+        case RequestComplete:
+            Srb = (PSCSI_REQUEST_BLOCK)va_arg(ap, PSCSI_REQUEST_BLOCK);
+            DPRINT("RequestComplete Srb %p\n", Srb);
+            if (DeviceExtension != NULL && Srb->OriginalRequest != NULL)
+                PortRequestComplete(DeviceExtension, Srb);
+            break;
+
         case GetExtendedFunctionTable:
             DPRINT1("GetExtendedFunctionTable\n");
             ppExtendedFunctions = (PSTORPORT_EXTENDED_FUNCTIONS*)va_arg(ap, PSTORPORT_EXTENDED_FUNCTIONS*);
@@ -1154,10 +1237,23 @@ StorPortNotification(
             HwDpcRoutine = (PHW_DPC_ROUTINE)va_arg(ap, PHW_DPC_ROUTINE);
             DPRINT1("HwDpcRoutine %p\n", HwDpcRoutine);
 
+            /* HW_DPC_ROUTINE expects the miniport's device extension */
             KeInitializeDpc((PRKDPC)&Dpc->Dpc,
                             (PKDEFERRED_ROUTINE)HwDpcRoutine,
-                            (PVOID)DeviceExtension);
-            KeInitializeSpinLock(&Dpc->Lock);
+                            HwDeviceExtension);
+            KeInitializeSpinLock((PKSPIN_LOCK)&Dpc->Lock);
+            break;
+
+        case IssueDpc:
+            Dpc = (PSTOR_DPC)va_arg(ap, PSTOR_DPC);
+            SystemArgument1 = (PVOID)va_arg(ap, PVOID);
+            SystemArgument2 = (PVOID)va_arg(ap, PVOID);
+            Succeeded = (PBOOLEAN)va_arg(ap, PBOOLEAN);
+            DPRINT("IssueDpc Dpc %p\n", Dpc);
+
+            *Succeeded = KeInsertQueueDpc((PRKDPC)&Dpc->Dpc,
+                                          SystemArgument1,
+                                          SystemArgument2);
             break;
 
         case AcquireSpinLock:
@@ -1246,7 +1342,7 @@ StorPortQuerySystemTime(
 
 
 /*
- * @unimplemented
+ * @implemented
  */
 STORPORT_API
 BOOLEAN
@@ -1254,9 +1350,23 @@ NTAPI
 StorPortReady(
     _In_ PVOID HwDeviceExtension)
 {
-    DPRINT1("StorPortReady()\n");
-    UNIMPLEMENTED;
-    return FALSE;
+    PMINIPORT_DEVICE_EXTENSION MiniportExtension;
+    PFDO_DEVICE_EXTENSION DeviceExtension;
+
+    DPRINT("StorPortReady(%p)\n", HwDeviceExtension);
+
+    /* Get the miniport extension */
+    MiniportExtension = CONTAINING_RECORD(HwDeviceExtension,
+                                          MINIPORT_DEVICE_EXTENSION,
+                                          HwDeviceExtension);
+    DeviceExtension = MiniportExtension->Miniport->DeviceExtension;
+
+    InterlockedExchange(&DeviceExtension->BusyRequests, 0);
+
+    /* Restart the queues from the completion DPC */
+    KeInsertQueueDpc(&DeviceExtension->CompletionDpc, NULL, NULL);
+
+    return TRUE;
 }
 
 
@@ -1375,7 +1485,7 @@ StorPortSetBusDataByOffset(
 
 
 /*
- * @unimplemented
+ * @implemented
  */
 STORPORT_API
 BOOLEAN
@@ -1387,9 +1497,31 @@ StorPortSetDeviceQueueDepth(
     _In_ UCHAR Lun,
     _In_ ULONG Depth)
 {
-    DPRINT1("StorPortSetDeviceQueueDepth()\n");
-    UNIMPLEMENTED;
-    return FALSE;
+    PMINIPORT_DEVICE_EXTENSION MiniportExtension;
+    PFDO_DEVICE_EXTENSION DeviceExtension;
+    PUNIT_DATA Unit;
+
+    DPRINT1("StorPortSetDeviceQueueDepth(%p %u %u %u %lu)\n",
+            HwDeviceExtension, PathId, TargetId, Lun, Depth);
+
+    /* Get the miniport extension */
+    MiniportExtension = CONTAINING_RECORD(HwDeviceExtension,
+                                          MINIPORT_DEVICE_EXTENSION,
+                                          HwDeviceExtension);
+    DeviceExtension = MiniportExtension->Miniport->DeviceExtension;
+
+    /* May be called from HwStartIo, so the StartIo lock cannot be taken here.
+       Units are never removed from the list. */
+    Unit = PortGetUnit(DeviceExtension, PathId, TargetId, Lun);
+    if (Unit == NULL)
+        return FALSE;
+
+    Unit->QueueDepth = max(Depth, 1);
+
+    /* A larger depth may allow waiting requests to start */
+    KeInsertQueueDpc(&DeviceExtension->CompletionDpc, NULL, NULL);
+
+    return TRUE;
 }
 
 
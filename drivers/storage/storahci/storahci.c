@@ -172,7 +172,9 @@ AhciAllocateResourceForAdapter (
     AdapterExtension->PortCount = portCount;
     nonCachedExtensionSize =    sizeof(AHCI_COMMAND_HEADER) * AlignedNCS + //should be 1K aligned
                                 sizeof(AHCI_RECEIVED_FIS) +
-                                sizeof(IDENTIFY_DEVICE_DATA);
+                                sizeof(IDENTIFY_DEVICE_DATA) +
+                                sizeof(AHCI_COMMAND_TABLE) + // 128 byte aligned
+                                DEVICE_ATA_BLOCK_SIZE;
 
     // align nonCachedExtensionSize to 1024
     nonCachedExtensionSize = ROUND_UP(nonCachedExtensionSize, 1024);
@@ -206,6 +208,11 @@ AhciAllocateResourceForAdapter (
 
             PortExtension->ReceivedFIS = (PAHCI_RECEIVED_FIS)tmp;
             PortExtension->IdentifyDeviceData = (PIDENTIFY_DEVICE_DATA)(tmp + sizeof(AHCI_RECEIVED_FIS));
+
+            tmp += sizeof(AHCI_RECEIVED_FIS) + sizeof(IDENTIFY_DEVICE_DATA);
+            PortExtension->InternalCommandTable = (PAHCI_COMMAND_TABLE)tmp;
+            PortExtension->NcqErrorLog = (PUCHAR)(tmp + sizeof(AHCI_COMMAND_TABLE));
+
             PortExtension->MaxPortQueueDepth = NCS;
             nonCachedExtension += nonCachedExtensionSize;
         }
@@ -499,6 +506,7 @@ AhciHwPassiveInitialize (
             PortExtension = &AdapterExtension->PortExtension[index];
             PortExtension->DeviceParams.IsActive = AhciStartPort(PortExtension);
             StorPortInitializeDpc(AdapterExtension, &PortExtension->CommandCompletion, AhciCommandCompletionDpcRoutine);
+            StorPortInitializeDpc(AdapterExtension, &PortExtension->ErrorRecovery, AhciErrorRecoveryDpcRoutine);
         }
     }
 
@@ -608,6 +616,343 @@ AhciCompleteIssuedSrb (
     return;
 }// -- AhciCompleteIssuedSrb();
 
+/**
+ * @name AhciCompleteFailedSrb
+ * @implemented
+ *
+ * Complete Srbs of the given slots with an error, the class driver retries them
+ *
+ * @param PortExtension
+ * @param CommandsToComplete
+ *
+ */
+VOID
+AhciCompleteFailedSrb (
+    __in PAHCI_PORT_EXTENSION PortExtension,
+    __in ULONG CommandsToComplete
+    )
+{
+    ULONG NCS, i;
+    PSCSI_REQUEST_BLOCK Srb;
+    PAHCI_ADAPTER_EXTENSION AdapterExtension;
+
+    AhciDebugPrint("AhciCompleteFailedSrb()\n");
+    AhciDebugPrint("\tFailed Commands: %x\n", CommandsToComplete);
+
+    AdapterExtension = PortExtension->AdapterExtension;
+    NCS = AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP);
+
+    for (i = 0; i < NCS; i++)
+    {
+        if (((1 << i) & CommandsToComplete) != 0)
+        {
+            Srb = PortExtension->Slot[i];
+
+            if (Srb == NULL)
+            {
+                continue;
+            }
+
+            // the completion routines only run for successful requests
+            Srb->SrbStatus = SRB_STATUS_ERROR;
+            StorPortNotification(RequestComplete, AdapterExtension, Srb);
+        }
+    }
+
+    return;
+}// -- AhciCompleteFailedSrb();
+
+/**
+ * @name AhciReadNcqErrorLog
+ * @implemented
+ *
+ * Issue READ LOG EXT for the NCQ Command Error log, to find out which
+ * native queued command failed. The device aborted all of them and
+ * does not accept new commands before the log has been read.
+ * The command is built in the first aborted slot, its Srb is programmed
+ * again by AhciCompleteNcqErrorLog.
+ *
+ * @param PortExtension
+ *
+ */
+VOID
+AhciReadNcqErrorLog (
+    __in PAHCI_PORT_EXTENSION PortExtension
+    )
+{
+    ULONG length, slotIndex;
+    PAHCI_COMMAND_TABLE cmdTable;
+    PAHCI_COMMAND_HEADER CommandHeader;
+    PAHCI_ADAPTER_EXTENSION AdapterExtension;
+    STOR_PHYSICAL_ADDRESS PhysicalAddress;
+
+    AhciDebugPrint("AhciReadNcqErrorLog()\n");
+
+    AdapterExtension = PortExtension->AdapterExtension;
+    cmdTable = PortExtension->InternalCommandTable;
+
+    NT_ASSERT(PortExtension->AbortedSlots != 0);
+    NT_ASSERT(PortExtension->CommandIssuedSlots == 0);
+
+    for (slotIndex = 0; (PortExtension->AbortedSlots & (1 << slotIndex)) == 0; slotIndex++);
+
+    AhciZeroMemory((PCHAR)cmdTable->CFIS, sizeof(cmdTable->CFIS));
+
+    cmdTable->CFIS[AHCI_ATA_CFIS_FisType] = FIS_TYPE_REG_H2D;
+    cmdTable->CFIS[AHCI_ATA_CFIS_PMPort_C] = (1 << 7);
+    cmdTable->CFIS[AHCI_ATA_CFIS_CommandReg] = IDE_COMMAND_READ_LOG_EXT;
+    cmdTable->CFIS[AHCI_ATA_CFIS_LBA0] = ATA_LOG_NCQ_COMMAND_ERROR;
+    cmdTable->CFIS[AHCI_ATA_CFIS_Device] = 0xA0;
+    cmdTable->CFIS[AHCI_ATA_CFIS_SectorCountLow] = 1;
+
+    PhysicalAddress = StorPortGetPhysicalAddress(AdapterExtension,
+                                                 NULL,
+                                                 PortExtension->NcqErrorLog,
+                                                 &length);
+
+    cmdTable->PRDT[0].DBA = PhysicalAddress.LowPart;
+    cmdTable->PRDT[0].DBAU = IsAdapterCAPS64(AdapterExtension->CAP) ? PhysicalAddress.HighPart : 0;
+    cmdTable->PRDT[0].RSV0 = 0;
+    cmdTable->PRDT[0].DBC = DEVICE_ATA_BLOCK_SIZE - 1;
+    cmdTable->PRDT[0].RSV1 = 0;
+    cmdTable->PRDT[0].I = 0;
+
+    PhysicalAddress = StorPortGetPhysicalAddress(AdapterExtension,
+                                                 NULL,
+                                                 cmdTable,
+                                                 &length);
+
+    CommandHeader = &PortExtension->CommandList[slotIndex];
+    CommandHeader->DI.Status = 0;
+    CommandHeader->DI.CFL = 5;
+    CommandHeader->DI.PRDTL = 1;
+    CommandHeader->PRDBC = 0;
+    CommandHeader->CTBA = PhysicalAddress.LowPart;
+
+    if (IsAdapterCAPS64(AdapterExtension->CAP))
+    {
+        CommandHeader->CTBA_U = PhysicalAddress.HighPart;
+    }
+
+    PortExtension->DeviceParams.ReadLogPending = TRUE;
+    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->CI, (1 << slotIndex));
+
+    return;
+}// -- AhciReadNcqErrorLog();
+
+/**
+ * @name AhciCompleteNcqErrorLog
+ * @implemented
+ *
+ * The NCQ Command Error log has been read. Fail the command it names
+ * and program the other aborted commands again.
+ *
+ * @param PortExtension
+ *
+ */
+VOID
+AhciCompleteNcqErrorLog (
+    __in PAHCI_PORT_EXTENSION PortExtension
+    )
+{
+    ULONG NCS, i, failedSlots, abortedSlots;
+
+    AhciDebugPrint("AhciCompleteNcqErrorLog()\n");
+
+    NCS = AHCI_Global_Port_CAP_NCS(PortExtension->AdapterExtension->CAP);
+    abortedSlots = PortExtension->AbortedSlots;
+
+    // byte 0: NQ bit and the tag of the failed command, tags are command slots
+    if ((PortExtension->NcqErrorLog[0] & ATA_NCQ_ERROR_LOG_NQ) == 0)
+    {
+        failedSlots = abortedSlots & (1 << (PortExtension->NcqErrorLog[0] & ATA_NCQ_ERROR_LOG_TAG_MASK));
+    }
+    else
+    {
+        // the error was not reported for a queued command
+        failedSlots = abortedSlots;
+    }
+
+    AhciDebugPrint("\tNCQ error log: %x, failed: %x\n", PortExtension->NcqErrorLog[0], failedSlots);
+
+    PortExtension->DeviceParams.ReadLogPending = FALSE;
+    PortExtension->AbortedSlots = 0;
+
+    if (failedSlots != 0)
+    {
+        AhciCompleteFailedSrb(PortExtension, failedSlots);
+    }
+
+    for (i = 0; i < NCS; i++)
+    {
+        if (((abortedSlots & ~failedSlots) & (1 << i)) != 0)
+        {
+            AhciProcessSrb(PortExtension, PortExtension->Slot[i], i);
+        }
+    }
+
+    return;
+}// -- AhciCompleteNcqErrorLog();
+
+/**
+ * @name AhciPortErrorRecovery
+ * @implemented
+ *
+ * Recover the port from a fatal error (6.2.2). Completes what has finished,
+ * restarts the port and either fails the outstanding non-queued command
+ * or reads the NCQ error log to find the failed native queued command.
+ * Runs at DISPATCH_LEVEL, the interrupt handler only captured the port state.
+ *
+ * @param PortExtension
+ *
+ */
+VOID
+AhciPortErrorRecovery (
+    __in PAHCI_PORT_EXTENSION PortExtension
+    )
+{
+    ULONG outstanding, failedSlots, ncqFailedSlots, index;
+    AHCI_PORT_CMD cmd;
+    AHCI_TASK_FILE_DATA tfd;
+    STOR_LOCK_HANDLE lockhandle = {0};
+    PAHCI_ADAPTER_EXTENSION AdapterExtension;
+
+    AhciDebugPrint("AhciPortErrorRecovery()\n");
+
+    AdapterExtension = PortExtension->AdapterExtension;
+
+    StorPortAcquireSpinLock(AdapterExtension, InterruptLock, NULL, &lockhandle);
+
+    outstanding = PortExtension->ErrorOutstandingSlots;
+
+    if (PortExtension->DeviceParams.ReadLogPending)
+    {
+        // reading the error log failed as well, give up on the aborted commands
+        PortExtension->DeviceParams.ReadLogPending = FALSE;
+        failedSlots = PortExtension->AbortedSlots;
+        PortExtension->AbortedSlots = 0;
+    }
+    else
+    {
+        if ((PortExtension->CommandIssuedSlots & (~outstanding)) != 0)
+        {
+            AhciCompleteIssuedSrb(PortExtension, (PortExtension->CommandIssuedSlots & (~outstanding)));
+        }
+
+        failedSlots = PortExtension->CommandIssuedSlots & outstanding;
+    }
+
+    ncqFailedSlots = failedSlots & PortExtension->NcqIssuedSlots;
+    PortExtension->CommandIssuedSlots = 0;
+    PortExtension->NcqIssuedSlots = 0;
+
+    StorPortReleaseSpinLock(AdapterExtension, &lockhandle);
+
+    // The port interrupts stay masked and AhciActivatePort issues nothing while
+    // ErrorRecoveryPending is set, so the port can be restarted without the lock
+
+    // 10.4.2 Port Reset
+    // clear PxCMD.ST and wait up to 500ms for PxCMD.CR to clear
+    cmd.Status = StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->CMD);
+    cmd.ST = 0;
+    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->CMD, cmd.Status);
+
+    for (index = 0; index < 500; index++)
+    {
+        cmd.Status = StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->CMD);
+        if (cmd.CR == 0)
+        {
+            break;
+        }
+
+        StorPortStallExecution(1000);
+    }
+
+    // clear the error and interrupt status
+    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->SERR, (ULONG)~0);
+    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->IS, (ULONG)~0);
+
+    // the device has to be idle before the port is started again
+    tfd.Status = StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->TFD);
+    if ((tfd.STS.BSY) || (tfd.STS.DRQ))
+    {
+        if (IsAdapterCAPSCLO(AdapterExtension->CAP))
+        {
+            cmd.CLO = 1;
+            StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->CMD, cmd.Status);
+
+            for (index = 0; index < 500; index++)
+            {
+                cmd.Status = StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->CMD);
+                if (cmd.CLO == 0)
+                {
+                    break;
+                }
+
+                StorPortStallExecution(1000);
+            }
+        }
+        else
+        {
+            AhciDebugPrint("\tUnhandled Case BSY-DRQ\n");
+        }
+    }
+
+    cmd.ST = 1;
+    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->CMD, cmd.Status);
+
+    StorPortAcquireSpinLock(AdapterExtension, InterruptLock, NULL, &lockhandle);
+
+    PortExtension->DeviceParams.ErrorRecoveryPending = FALSE;
+
+    if (ncqFailedSlots != 0)
+    {
+        PortExtension->AbortedSlots = failedSlots;
+        AhciReadNcqErrorLog(PortExtension);
+    }
+    else if (failedSlots != 0)
+    {
+        AhciCompleteFailedSrb(PortExtension, failedSlots);
+    }
+
+    // unmask the port interrupts and issue what was queued meanwhile
+    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->IE, PortExtension->InterruptEnable);
+    AhciAssignSlots(PortExtension);
+    AhciActivatePort(PortExtension);
+
+    StorPortReleaseSpinLock(AdapterExtension, &lockhandle);
+
+    return;
+}// -- AhciPortErrorRecovery();
+
+/**
+ * @name AhciErrorRecoveryDpcRoutine
+ * @implemented
+ *
+ * Recovers a port from the fatal error its interrupt handler has seen
+ *
+ * @param Dpc
+ * @param HwDeviceExtension
+ * @param SystemArgument1
+ * @param SystemArgument2
+ */
+VOID
+AhciErrorRecoveryDpcRoutine (
+    __in PSTOR_DPC Dpc,
+    __in PVOID HwDeviceExtension,
+    __in PVOID SystemArgument1,
+    __in PVOID SystemArgument2
+  )
+{
+    UNREFERENCED_PARAMETER(Dpc);
+    UNREFERENCED_PARAMETER(HwDeviceExtension);
+    UNREFERENCED_PARAMETER(SystemArgument2);
+
+    AhciDebugPrint("AhciErrorRecoveryDpcRoutine()\n");
+
+    AhciPortErrorRecovery((PAHCI_PORT_EXTENSION)SystemArgument1);
+}// -- AhciErrorRecoveryDpcRoutine();
+
 /**
  * @name AhciInterruptHandler
  * @not_implemented
@@ -622,6 +967,7 @@ AhciInterruptHandler (
     __in PAHCI_PORT_EXTENSION PortExtension
     )
 {
+    BOOLEAN fatalError;
     ULONG is, ci, sact, outstanding;
     AHCI_INTERRUPT_STATUS PxIS;
     AHCI_INTERRUPT_STATUS PxISMasked;
@@ -652,7 +998,8 @@ AhciInterruptHandler (
     // 6.2.2
     // Fatal Error
     // signified by the setting of PxIS.HBFS, PxIS.HBDS, PxIS.IFS, or PxIS.TFES
-    if (PxIS.HBFS || PxIS.HBDS || PxIS.IFS || PxIS.TFES)
+    fatalError = (PxIS.HBFS || PxIS.HBDS || PxIS.IFS || PxIS.TFES);
+    if (fatalError)
     {
         // In this state, the HBA shall not issue any new commands nor acknowledge DMA Setup FISes to process
         // any native command queuing commands. To recover, the port must be restarted
@@ -663,6 +1010,21 @@ AhciInterruptHandler (
         // non-queued commands were being issued or native command queuing commands were being issued.
 
         AhciDebugPrint("\tFatal Error: %x\n", PxIS.Status);
+
+        // Restarting the port waits for up to a second, far too long for the interrupt handler.
+        // Capture the outstanding commands, mask the port interrupts and leave the rest to a DPC,
+        // which also clears PxIS
+        PortExtension->ErrorOutstandingSlots = StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->CI) |
+                                               StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->SACT);
+        PortExtension->InterruptEnable = StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->IE);
+        StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->IE, 0);
+        PortExtension->DeviceParams.ErrorRecoveryPending = TRUE;
+
+        is = (1 << PortExtension->PortNumber);
+        StorPortWriteRegisterUlong(AdapterExtension, AdapterExtension->IS, is);
+
+        StorPortIssueDpc(AdapterExtension, &PortExtension->ErrorRecovery, PortExtension, NULL);
+        return;
     }
 
     // Normal Command Completion
@@ -678,7 +1040,7 @@ AhciInterruptHandler (
     // A PRD with the ‘I’ bit set has transferred all of its data.
     PxISMasked.DPS = PxIS.DPS;
 
-    if (PxISMasked.Status != 0)
+    if ((PxISMasked.Status != 0) && (fatalError == FALSE))
     {
         StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->IS, PxISMasked.Status);
     }
@@ -692,13 +1054,30 @@ AhciInterruptHandler (
     ci = StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->CI);
     sact = StorPortReadRegisterUlong(AdapterExtension, &PortExtension->Port->SACT);
 
-    outstanding = ci | sact; // NOTE: Including both non-NCQ and NCQ based commands
-    if ((PortExtension->CommandIssuedSlots & (~outstanding)) != 0)
+    if (PortExtension->DeviceParams.ReadLogPending)
+    {
+        // READ LOG EXT is the only outstanding command
+        if (ci == 0)
+        {
+            AhciCompleteNcqErrorLog(PortExtension);
+        }
+    }
+    else
     {
-        AhciCompleteIssuedSrb(PortExtension, (PortExtension->CommandIssuedSlots & (~outstanding)));
-        PortExtension->CommandIssuedSlots &= outstanding;
+        outstanding = ci | sact; // NOTE: Including both non-NCQ and NCQ based commands
+        if ((PortExtension->CommandIssuedSlots & (~outstanding)) != 0)
+        {
+            AhciCompleteIssuedSrb(PortExtension, (PortExtension->CommandIssuedSlots & (~outstanding)));
+            PortExtension->CommandIssuedSlots &= outstanding;
+            PortExtension->NcqIssuedSlots &= outstanding;
+        }
     }
 
+    // the completed commands may have been holding back queued ones
+    // program the free slots and issue what is waiting
+    AhciAssignSlots(PortExtension);
+    AhciActivatePort(PortExtension);
+
     return;
 }// -- AhciInterruptHandler();
 
@@ -1403,6 +1782,13 @@ AhciProcessSrb (
     NT_ASSERT(SlotIndex < AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP));
     SrbExtension->SlotIndex = SlotIndex;
 
+    if (IsNcqCommand(SrbExtension))
+    {
+        // FPDMA QUEUED: the tag goes in Count(7:3), we use the command slot as tag
+        SrbExtension->SectorCountLow = (UCHAR)(SlotIndex << 3);
+        SrbExtension->SectorCountHigh = 0;
+    }
+
     // program the CFIS in the CommandTable
     CommandHeader = &PortExtension->CommandList[SlotIndex];
 
@@ -1471,6 +1857,61 @@ AhciProcessSrb (
     return;
 }// -- AhciProcessSrb();
 
+/**
+ * @name AhciAssignSlots
+ * @implemented
+ *
+ * Program pending Srbs from the port's SrbQueue into all free command slots
+ * Called with the InterruptLock held
+ *
+ * @param PortExtension
+ *
+ */
+VOID
+AhciAssignSlots (
+    __in PAHCI_PORT_EXTENSION PortExtension
+    )
+{
+    PSCSI_REQUEST_BLOCK Srb;
+    ULONG commandSlotMask, occupiedSlots, slotIndex, NCS;
+
+    AhciDebugPrint("AhciAssignSlots()\n");
+
+    // the slots are frozen until the NCQ error log is read
+    if (PortExtension->DeviceParams.ReadLogPending)
+    {
+        return;
+    }
+
+    // Busy command slots for given port
+    occupiedSlots = (PortExtension->QueueSlots | PortExtension->CommandIssuedSlots | PortExtension->AbortedSlots);
+    NCS = PortExtension->MaxPortQueueDepth;
+    commandSlotMask = (1 << NCS) - 1; // available slots mask
+
+    commandSlotMask = (commandSlotMask & ~occupiedSlots);
+
+    // iterate over HBA port slots
+    for (slotIndex = 0; (slotIndex < NCS) && (commandSlotMask != 0); slotIndex++)
+    {
+        if ((commandSlotMask & (1 << slotIndex)) == 0)
+        {
+            continue;
+        }
+
+        Srb = RemoveQueue(&PortExtension->SrbQueue);
+        if (Srb == NULL)
+        {
+            break;
+        }
+
+        NT_ASSERT(Srb->PathId == PortExtension->PortNumber);
+        AhciProcessSrb(PortExtension, Srb, slotIndex);
+        commandSlotMask &= ~(1 << slotIndex);
+    }
+
+    return;
+}// -- AhciAssignSlots();
+
 /**
  * @name AhciActivatePort
  * @implemented
@@ -1492,7 +1933,8 @@ AhciActivatePort (
     )
 {
     AHCI_PORT_CMD cmd;
-    ULONG QueueSlots, slotToActivate, tmp;
+    ULONG QueueSlots, slotsToActivate, ncqSlots, index, i, NCS;
+    PAHCI_SRB_EXTENSION SrbExtension;
     PAHCI_ADAPTER_EXTENSION AdapterExtension;
 
     AhciDebugPrint("AhciActivatePort()\n");
@@ -1500,7 +1942,9 @@ AhciActivatePort (
     AdapterExtension = PortExtension->AdapterExtension;
     QueueSlots = PortExtension->QueueSlots;
 
-    if (QueueSlots == 0)
+    if ((QueueSlots == 0) ||
+        PortExtension->DeviceParams.ReadLogPending ||
+        PortExtension->DeviceParams.ErrorRecoveryPending)
     {
         return;
     }
@@ -1514,23 +1958,69 @@ AhciActivatePort (
         return;
     }
 
-    // get the lowest set bit
-    tmp = QueueSlots & (QueueSlots - 1);
+    // Native queued commands can be issued together, but never while a non-queued
+    // command is outstanding. A non-queued command is issued alone, once the device is idle.
+    // Start after the last issued slot so no queued slot waits forever
+    NCS = AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP);
+    slotsToActivate = 0;
+    ncqSlots = 0;
 
-    if (tmp == 0)
-        slotToActivate = QueueSlots;
-    else
-        slotToActivate = (QueueSlots & (~tmp));
+    for (i = 0; i < NCS; i++)
+    {
+        index = (PortExtension->NextSlotToIssue + i) % NCS;
+        if ((QueueSlots & (1 << index)) == 0)
+        {
+            continue;
+        }
+
+        SrbExtension = GetSrbExtension(PortExtension->Slot[index]);
+
+        if (IsNcqCommand(SrbExtension))
+        {
+            if ((PortExtension->CommandIssuedSlots & ~PortExtension->NcqIssuedSlots) != 0)
+            {
+                break;
+            }
+
+            ncqSlots |= (1 << index);
+        }
+        else
+        {
+            if ((PortExtension->CommandIssuedSlots != 0) || (ncqSlots != 0))
+            {
+                break;
+            }
+
+            slotsToActivate = (1 << index);
+            PortExtension->NextSlotToIssue = (index + 1) % NCS;
+            break;
+        }
 
-    // mark that bit off in QueueSlots
+        PortExtension->NextSlotToIssue = (index + 1) % NCS;
+    }
+
+    slotsToActivate |= ncqSlots;
+    if (slotsToActivate == 0)
+    {
+        return;
+    }
+
+    // mark these bits off in QueueSlots
     // so we can know we it is really needed to activate port or not
-    PortExtension->QueueSlots &= ~slotToActivate;
+    PortExtension->QueueSlots &= ~slotsToActivate;
     // mark this CommandIssuedSlots
     // to validate in completeIssuedCommand
-    PortExtension->CommandIssuedSlots |= slotToActivate;
+    PortExtension->CommandIssuedSlots |= slotsToActivate;
 
-    // tell the HBA to issue this Command Slot to the given port
-    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->CI, slotToActivate);
+    // 5.3.2 PxSACT has to be set before PxCI for native queued commands
+    if (ncqSlots != 0)
+    {
+        PortExtension->NcqIssuedSlots |= ncqSlots;
+        StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->SACT, ncqSlots);
+    }
+
+    // tell the HBA to issue these Command Slots to the given port
+    StorPortWriteRegisterUlong(AdapterExtension, &PortExtension->Port->CI, slotsToActivate);
 
     return;
 }// -- AhciActivatePort();
@@ -1558,10 +2048,8 @@ AhciProcessIO (
     __in PSCSI_REQUEST_BLOCK Srb
     )
 {
-    PSCSI_REQUEST_BLOCK tmpSrb;
     STOR_LOCK_HANDLE lockhandle = {0};
     PAHCI_PORT_EXTENSION PortExtension;
-    ULONG commandSlotMask, occupiedSlots, slotIndex, NCS;
 
     AhciDebugPrint("AhciProcessIO()\n");
     AhciDebugPrint("\tPathId: %d\n", PathId);
@@ -1583,36 +2071,7 @@ AhciProcessIO (
         return; // we should wait for device to get active
     }
 
-    occupiedSlots = (PortExtension->QueueSlots | PortExtension->CommandIssuedSlots); // Busy command slots for given port
-    NCS = AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP);
-    commandSlotMask = (1 << NCS) - 1; // available slots mask
-
-    commandSlotMask = (commandSlotMask & ~occupiedSlots);
-    if(commandSlotMask != 0)
-    {
-        // iterate over HBA port slots
-        for (slotIndex = 0; slotIndex < NCS; slotIndex++)
-        {
-            // find first free slot
-            if ((commandSlotMask & (1 << slotIndex)) != 0)
-            {
-                tmpSrb = RemoveQueue(&PortExtension->SrbQueue);
-                if (tmpSrb != NULL)
-                {
-                    NT_ASSERT(tmpSrb->PathId == PathId);
-                    AhciProcessSrb(PortExtension, tmpSrb, slotIndex);
-                }
-                else
-                {
-                    break;
-                }
-            }
-            else
-            {
-                break;
-            }
-        }
-    }
+    AhciAssignSlots(PortExtension);
 
     // program HBA port
     AhciActivatePort(PortExtension);
@@ -1766,6 +2225,20 @@ InquiryCompletion (
 
         PortExtension->DeviceParams.BytesPerPhysicalSector = DEVICE_ATA_BLOCK_SIZE;
 
+        /* Native Command Queuing, the FPDMA QUEUED commands are 48 bit */
+        if (IsAdapterCAPSNCQ(AdapterExtension->CAP) &&
+            (IdentifyDeviceData->ReservedWords76[0] & ATA_SATA_CAPABILITIES_NCQ) &&
+            PortExtension->DeviceParams.Lba48BitMode)
+        {
+            PortExtension->DeviceParams.NcqEnabled = 1;
+
+            // tags are command slots, keep them below the device queue depth
+            PortExtension->MaxPortQueueDepth = min(AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP),
+                                                   (ULONG)IdentifyDeviceData->QueueDepth + 1);
+
+            AhciDebugPrint("\tNCQ enabled, Queue Depth: %d\n", PortExtension->MaxPortQueueDepth);
+        }
+
         // last byte should be NULL
         StorPortCopyMemory(PortExtension->DeviceParams.VendorId, IdentifyDeviceData->ModelNumber, sizeof(PortExtension->DeviceParams.VendorId) - 1);
         StorPortCopyMemory(PortExtension->DeviceParams.RevisionID, IdentifyDeviceData->FirmwareRevision, sizeof(PortExtension->DeviceParams.RevisionID) - 1);
@@ -1798,7 +2271,7 @@ InquiryCompletion (
     // prepare data to send
     InquiryData->Versions = 2;
     InquiryData->Wide32Bit = 1;
-    InquiryData->CommandQueue = 0; // NCQ not supported
+    InquiryData->CommandQueue = PortExtension->DeviceParams.NcqEnabled;
     InquiryData->ResponseDataFormat = 0x2;
     InquiryData->DeviceTypeModifier = 0;
     InquiryData->DeviceTypeQualifier = DEVICE_CONNECTED;
@@ -1820,7 +2293,7 @@ InquiryCompletion (
                                          Srb->PathId,
                                          Srb->TargetId,
                                          Srb->Lun,
-                                         AHCI_Global_Port_CAP_NCS(AdapterExtension->CAP));
+                                         PortExtension->MaxPortQueueDepth);
 
     NT_ASSERT(status == TRUE);
     return;
@@ -2027,7 +2500,7 @@ DeviceRequestReadWrite (
     NT_ASSERT(SectorCount > 0);
 
     SrbExtension->AtaFunction = ATA_FUNCTION_ATA_READ;
-    SrbExtension->Flags |= ATA_FLAGS_USE_DMA;
+    SrbExtension->Flags = ATA_FLAGS_USE_DMA; // the extension may hold flags of an earlier request
     SrbExtension->CompletionRoutine = NULL;
 
     if (IsReading)
@@ -2074,6 +2547,17 @@ DeviceRequestReadWrite (
     SrbExtension->SectorCountLow = (SectorCount >> 0) & 0xFF;
     SrbExtension->SectorCountHigh = (SectorCount >> 8) & 0xFF;
 
+    if (PortExtension->DeviceParams.NcqEnabled)
+    {
+        // READ/WRITE FPDMA QUEUED carry the sector count in the Features register,
+        // AhciProcessSrb puts the tag in the Count register
+        SrbExtension->Flags |= ATA_FLAGS_NCQ;
+        SrbExtension->CommandReg = IsReading ? IDE_COMMAND_READ_FPDMA_QUEUED : IDE_COMMAND_WRITE_FPDMA_QUEUED;
+        SrbExtension->FeaturesLow = SrbExtension->SectorCountLow;
+        SrbExtension->FeaturesHigh = SrbExtension->SectorCountHigh;
+        SrbExtension->Device = IDE_LBA_MODE; // FUA off
+    }
+
     NT_ASSERT(SectorCount < 0x100);
 
     SrbExtension->pSgl = (PLOCAL_SCATTER_GATHER_LIST)StorPortGetScatterGatherList(AdapterExtension, Srb);
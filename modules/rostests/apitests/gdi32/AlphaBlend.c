@@ -0,0 +1,166 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Test for AlphaBlend
+ */
+
+#include "precomp.h"
+
+#define TEST_WIDTH  70
+#define TEST_HEIGHT 3
+
+static HDC ghdcSrc, ghdcDst;
+static HBITMAP ghbmpSrc, ghbmpDst;
+static PULONG gpulSrc, gpulDst;
+
+/* The per channel math of the blend, one channel at a time */
+static
+ULONG
+BlendPixel(ULONG ulDst, ULONG ulSrc, BLENDFUNCTION bf)
+{
+    ULONG i, Alpha, Src, Dst, Result = 0;
+
+    Alpha = (bf.AlphaFormat & AC_SRC_ALPHA) ?
+            ((ulSrc >> 24) * bf.SourceConstantAlpha) / 255 :
+            bf.SourceConstantAlpha;
+
+    for (i = 0; i < 32; i += 8)
+    {
+        Src = (((ulSrc >> i) & 0xFF) * bf.SourceConstantAlpha) / 255;
+        Dst = (((ulDst >> i) & 0xFF) * (255 - Alpha)) / 255 + Src;
+        Result |= min(Dst, 255) << i;
+    }
+
+    return Result;
+}
+
+static
+HBITMAP
+CreateDib32(HDC hdc, LONG cx, LONG cy, PULONG *ppulBits)
+{
+    BITMAPINFO bmi;
+
+    ZeroMemory(&bmi, sizeof(bmi));
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = cx;
+    bmi.bmiHeader.biHeight = -cy;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    return CreateDIBSection(hdc, &bmi, DIB_RGB_COLORS, (PVOID*)ppulBits, NULL, 0);
+}
+
+static
+VOID
+FillBits(ULONG ulSeed)
+{
+    ULONG i;
+
+    for (i = 0; i < TEST_WIDTH * TEST_HEIGHT; i++)
+    {
+        ulSeed = ulSeed * 1103515245 + 12345;
+        gpulDst[i] = ulSeed ^ (ulSeed >> 15);
+        ulSeed = ulSeed * 1103515245 + 12345;
+        gpulSrc[i] = ulSeed ^ (ulSeed >> 13);
+
+        /* Have plenty of opaque and fully transparent pixels */
+        switch (i % 5)
+        {
+            case 0: gpulSrc[i] |= 0xFF000000; break;
+            case 1: gpulSrc[i] = 0; break;
+            case 2: gpulSrc[i] &= 0x00FFFFFF; break;
+        }
+    }
+}
+
+static
+VOID
+Test_Blend(BYTE SourceConstantAlpha, BYTE AlphaFormat)
+{
+    ULONG aulExpected[TEST_WIDTH * TEST_HEIGHT];
+    BLENDFUNCTION bf = { AC_SRC_OVER, 0, SourceConstantAlpha, AlphaFormat };
+    ULONG i, cx, cErrors = 0;
+
+    for (cx = 1; cx <= TEST_WIDTH; cx += 3)
+    {
+        FillBits(cx * 31 + SourceConstantAlpha);
+        GdiFlush();
+
+        for (i = 0; i < TEST_WIDTH * TEST_HEIGHT; i++)
+        {
+            aulExpected[i] = ((i % TEST_WIDTH) < cx) ?
+                             BlendPixel(gpulDst[i], gpulSrc[i], bf) : gpulDst[i];
+        }
+
+        ok(GdiAlphaBlend(ghdcDst, 0, 0, cx, TEST_HEIGHT,
+                         ghdcSrc, 0, 0, cx, TEST_HEIGHT, bf),
+           "GdiAlphaBlend failed for %lu pixels\n", cx);
+        GdiFlush();
+
+        for (i = 0; i < TEST_WIDTH * TEST_HEIGHT; i++)
+        {
+            if (gpulDst[i] != aulExpected[i] && cErrors++ < 5)
+            {
+                ok(0, "Alpha %u, format %u, width %lu, pixel %lu: got 0x%08lx, expected 0x%08lx\n",
+                   SourceConstantAlpha, AlphaFormat, cx, i, gpulDst[i], aulExpected[i]);
+            }
+        }
+    }
+
+    ok(cErrors == 0, "Alpha %u, format %u: %lu pixels differ\n",
+       SourceConstantAlpha, AlphaFormat, cErrors);
+}
+
+static
+VOID
+Test_Stretch(void)
+{
+    BLENDFUNCTION bf = { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA };
+    ULONG x;
+
+    /* Every source pixel is used for two destination pixels */
+    FillBits(42);
+    for (x = 0; x < TEST_WIDTH; x++)
+        gpulSrc[x] |= 0xFF000000;
+    GdiFlush();
+
+    ok(GdiAlphaBlend(ghdcDst, 0, 0, TEST_WIDTH, 1,
+                     ghdcSrc, 0, 0, TEST_WIDTH / 2, 1, bf),
+       "GdiAlphaBlend failed\n");
+    GdiFlush();
+
+    for (x = 0; x < TEST_WIDTH; x++)
+    {
+        ok(gpulDst[x] == gpulSrc[x / 2],
+           "Pixel %lu: got 0x%08lx, expected 0x%08lx\n", x, gpulDst[x], gpulSrc[x / 2]);
+    }
+}
+
+START_TEST(AlphaBlend)
+{
+    ghdcSrc = CreateCompatibleDC(NULL);
+    ghdcDst = CreateCompatibleDC(NULL);
+    ghbmpSrc = CreateDib32(ghdcSrc, TEST_WIDTH, TEST_HEIGHT, &gpulSrc);
+    ghbmpDst = CreateDib32(ghdcDst, TEST_WIDTH, TEST_HEIGHT, &gpulDst);
+    if (!ghdcSrc || !ghdcDst || !ghbmpSrc || !ghbmpDst)
+    {
+        skip("Failed to create the bitmaps\n");
+        return;
+    }
+
+    SelectObject(ghdcSrc, ghbmpSrc);
+    SelectObject(ghdcDst, ghbmpDst);
+
+    Test_Blend(255, 0);
+    Test_Blend(128, 0);
+    Test_Blend(0, 0);
+    Test_Blend(255, AC_SRC_ALPHA);
+    Test_Blend(200, AC_SRC_ALPHA);
+    Test_Stretch();
+
+    DeleteDC(ghdcSrc);
+    DeleteDC(ghdcDst);
+    DeleteObject(ghbmpSrc);
+    DeleteObject(ghbmpDst);
+}
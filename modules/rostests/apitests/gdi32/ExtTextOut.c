@@ -0,0 +1,237 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Test for ExtTextOut
+ */
+
+#include "precomp.h"
+
+#define TARGET_WIDTH    320
+#define TARGET_HEIGHT   64
+#define WHITE_PIXEL     0x00FFFFFF
+
+static HDC ghdcTarget;
+static HBITMAP ghbmpTarget;
+static PULONG gpulBits;
+
+static
+BOOL
+InitTarget(void)
+{
+    BITMAPINFO bmi;
+    PVOID pvBits;
+
+    ZeroMemory(&bmi, sizeof(bmi));
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = TARGET_WIDTH;
+    bmi.bmiHeader.biHeight = -TARGET_HEIGHT;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    ghdcTarget = CreateCompatibleDC(NULL);
+    if (!ghdcTarget)
+        return FALSE;
+
+    ghbmpTarget = CreateDIBSection(ghdcTarget, &bmi, DIB_RGB_COLORS, &pvBits, NULL, 0);
+    if (!ghbmpTarget)
+    {
+        DeleteDC(ghdcTarget);
+        return FALSE;
+    }
+
+    SelectObject(ghdcTarget, ghbmpTarget);
+    SelectObject(ghdcTarget, GetStockObject(DEFAULT_GUI_FONT));
+    SetTextColor(ghdcTarget, RGB(0, 0, 0));
+    SetBkMode(ghdcTarget, TRANSPARENT);
+    gpulBits = pvBits;
+    return TRUE;
+}
+
+static
+VOID
+ClearTarget(void)
+{
+    PatBlt(ghdcTarget, 0, 0, TARGET_WIDTH, TARGET_HEIGHT, WHITENESS);
+    GdiFlush();
+}
+
+static
+ULONG
+CountInkPixels(LONG left, LONG top, LONG right, LONG bottom)
+{
+    LONG x, y;
+    ULONG cPixels = 0;
+
+    for (y = top; y < bottom; y++)
+    {
+        for (x = left; x < right; x++)
+        {
+            if ((gpulBits[y * TARGET_WIDTH + x] & 0x00FFFFFF) != WHITE_PIXEL)
+                cPixels++;
+        }
+    }
+
+    return cPixels;
+}
+
+static
+VOID
+Test_Run(void)
+{
+    ULONG cFull, cSingle, cSecond;
+
+    /* A run draws the pixels of all of its glyphs */
+    ClearTarget();
+    ok_int(ExtTextOutW(ghdcTarget, 10, 10, 0, NULL, L"AB", 2, NULL), TRUE);
+    GdiFlush();
+    cFull = CountInkPixels(0, 0, TARGET_WIDTH, TARGET_HEIGHT);
+    ok(cFull != 0, "No text was drawn\n");
+
+    ClearTarget();
+    ok_int(ExtTextOutW(ghdcTarget, 10, 10, 0, NULL, L"A ", 2, NULL), TRUE);
+    GdiFlush();
+    cSingle = CountInkPixels(0, 0, TARGET_WIDTH, TARGET_HEIGHT);
+    ok(cSingle != 0, "No text was drawn\n");
+    ok(cSingle < cFull, "Expected fewer pixels, got %lu and %lu\n", cSingle, cFull);
+
+    ClearTarget();
+    ok_int(ExtTextOutW(ghdcTarget, 10, 10, 0, NULL, L" B", 2, NULL), TRUE);
+    GdiFlush();
+    cSecond = CountInkPixels(0, 0, TARGET_WIDTH, TARGET_HEIGHT);
+    ok(cSecond != 0, "No text was drawn\n");
+    ok(cSingle + cSecond >= cFull, "Got %lu + %lu pixels for %lu\n", cSingle, cSecond, cFull);
+}
+
+static
+VOID
+Test_Clipped(void)
+{
+    RECT rc = { 20, 12, 60, 24 };
+
+    /* Nothing may be drawn outside of the clipping rectangle */
+    ClearTarget();
+    ok_int(ExtTextOutW(ghdcTarget, 10, 10, ETO_CLIPPED, &rc,
+                       L"WWWWWWWWWWWWWWWW", 16, NULL), TRUE);
+    GdiFlush();
+    ok(CountInkPixels(rc.left, rc.top, rc.right, rc.bottom) != 0, "No text was drawn\n");
+    ok_long(CountInkPixels(0, 0, TARGET_WIDTH, rc.top), 0);
+    ok_long(CountInkPixels(0, rc.bottom, TARGET_WIDTH, TARGET_HEIGHT), 0);
+    ok_long(CountInkPixels(0, rc.top, rc.left, rc.bottom), 0);
+    ok_long(CountInkPixels(rc.right, rc.top, TARGET_WIDTH, rc.bottom), 0);
+
+    /* Glyphs that are clipped away completely */
+    ClearTarget();
+    ok_int(ExtTextOutW(ghdcTarget, -1000, 10, 0, NULL, L"WWWW", 4, NULL), TRUE);
+    GdiFlush();
+    ok_long(CountInkPixels(0, 0, TARGET_WIDTH, TARGET_HEIGHT), 0);
+}
+
+static
+BOOL
+HasColor(HDC hdc, LONG left, LONG top, LONG right, LONG bottom, COLORREF crColor)
+{
+    LONG x, y;
+
+    for (y = top; y < bottom; y++)
+    {
+        for (x = left; x < right; x++)
+        {
+            if (GetPixel(hdc, x, y) == crColor)
+                return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static
+VOID
+Test_Batched(void)
+{
+    RECT rc1 = { 0, 0, 8, 8 }, rc2 = { 8, 0, 16, 8 };
+    HDC hdc;
+    HBITMAP hbmp;
+
+    /* Without a DIB section selected, the calls are queued in the GDI batch */
+    hdc = CreateCompatibleDC(NULL);
+    hbmp = CreateBitmap(64, 32, 1, 32, NULL);
+    if (!hdc || !hbmp)
+    {
+        skip("Failed to create the target\n");
+        return;
+    }
+    SelectObject(hdc, hbmp);
+    SelectObject(hdc, GetStockObject(DEFAULT_GUI_FONT));
+    PatBlt(hdc, 0, 0, 64, 32, WHITENESS);
+
+    /* An opaque rectangle without text uses the background color of the call */
+    SetBkColor(hdc, RGB(255, 0, 0));
+    ok_int(ExtTextOutW(hdc, 0, 0, ETO_OPAQUE, &rc1, NULL, 0, NULL), TRUE);
+    SetBkColor(hdc, RGB(0, 0, 255));
+    ok_int(ExtTextOutW(hdc, 0, 0, ETO_OPAQUE, &rc2, NULL, 0, NULL), TRUE);
+    ok_long(GetPixel(hdc, 4, 4), RGB(255, 0, 0));
+    ok_long(GetPixel(hdc, 12, 4), RGB(0, 0, 255));
+
+    /* Text uses the text color and background mode of the call */
+    PatBlt(hdc, 0, 0, 64, 32, WHITENESS);
+    SetBkMode(hdc, TRANSPARENT);
+    SetTextColor(hdc, RGB(255, 0, 0));
+    ok_int(ExtTextOutW(hdc, 0, 8, 0, NULL, L"W", 1, NULL), TRUE);
+    SetTextColor(hdc, RGB(0, 0, 255));
+    ok_int(ExtTextOutW(hdc, 32, 8, 0, NULL, L"W", 1, NULL), TRUE);
+    ok(HasColor(hdc, 0, 0, 32, 32, RGB(255, 0, 0)), "No red text was drawn\n");
+    ok(!HasColor(hdc, 0, 0, 32, 32, RGB(0, 0, 255)), "Blue text was drawn\n");
+    ok(HasColor(hdc, 32, 0, 64, 32, RGB(0, 0, 255)), "No blue text was drawn\n");
+    ok(!HasColor(hdc, 32, 0, 64, 32, RGB(255, 0, 0)), "Red text was drawn\n");
+
+    DeleteDC(hdc);
+    DeleteObject(hbmp);
+}
+
+static
+VOID
+Test_Benchmark(void)
+{
+    static const WCHAR Text[] =
+        L"The quick brown fox jumps over the lazy dog. 0123456789 ABCDEFGHIJKLMNOP";
+    DWORD dwStart, dwShort, dwLong;
+    ULONG i;
+
+    /* Not a pass/fail test, just report the time spent in text output */
+    dwStart = GetTickCount();
+    for (i = 0; i < 2000; i++)
+    {
+        ExtTextOutW(ghdcTarget, 0, 10, 0, NULL, Text, 4, NULL);
+    }
+    GdiFlush();
+    dwShort = GetTickCount() - dwStart;
+
+    dwStart = GetTickCount();
+    for (i = 0; i < 2000; i++)
+    {
+        ExtTextOutW(ghdcTarget, 0, 30, ETO_OPAQUE, NULL, Text, ARRAYSIZE(Text) - 1, NULL);
+    }
+    GdiFlush();
+    dwLong = GetTickCount() - dwStart;
+
+    trace("2000 runs of 4 glyphs: %lu ms, 2000 runs of %u glyphs: %lu ms\n",
+          dwShort, (UINT)(ARRAYSIZE(Text) - 1), dwLong);
+}
+
+START_TEST(ExtTextOut)
+{
+    if (!InitTarget())
+    {
+        skip("Failed to create the target DC\n");
+        return;
+    }
+
+    Test_Run();
+    Test_Clipped();
+    Test_Batched();
+    Test_Benchmark();
+
+    DeleteDC(ghdcTarget);
+    DeleteObject(ghbmpTarget);
+}
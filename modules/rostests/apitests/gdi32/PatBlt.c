@@ -123,6 +123,55 @@ void Test_BrushOrigin()
 
 }
 
+void Test_Batched()
+{
+    HDC hdc;
+    HBITMAP hbmp;
+    HBRUSH hbrRed, hbrBlue;
+
+    /* Without a DIB section selected, the calls are queued in the GDI batch */
+    hdc = CreateCompatibleDC(NULL);
+    ok(hdc != 0, "\n");
+    hbmp = CreateBitmap(16, 16, 1, 32, NULL);
+    ok(hbmp != 0, "\n");
+    if (!hdc || !hbmp)
+    {
+        skip("Could not create the target\n");
+        return;
+    }
+    SelectObject(hdc, hbmp);
+
+    hbrRed = CreateSolidBrush(RGB(255, 0, 0));
+    hbrBlue = CreateSolidBrush(RGB(0, 0, 255));
+
+    /* Every call must use the brush that was selected when it was made */
+    SelectObject(hdc, hbrRed);
+    ok_long(PatBlt(hdc, 0, 0, 8, 16, PATCOPY), 1);
+    SelectObject(hdc, hbrBlue);
+    ok_long(PatBlt(hdc, 8, 0, 8, 16, PATCOPY), 1);
+
+    /* The same for the color of the DC brush */
+    SelectObject(hdc, GetStockObject(DC_BRUSH));
+    SetDCBrushColor(hdc, RGB(0, 255, 0));
+    ok_long(PatBlt(hdc, 0, 0, 4, 4, PATCOPY), 1);
+    SetDCBrushColor(hdc, RGB(255, 255, 0));
+    ok_long(PatBlt(hdc, 4, 0, 4, 4, PATCOPY), 1);
+
+    /* A rop that reads the destination */
+    ok_long(PatBlt(hdc, 12, 12, 4, 4, DSTINVERT), 1);
+
+    ok_long(GetPixel(hdc, 2, 8), RGB(255, 0, 0));
+    ok_long(GetPixel(hdc, 10, 8), RGB(0, 0, 255));
+    ok_long(GetPixel(hdc, 1, 1), RGB(0, 255, 0));
+    ok_long(GetPixel(hdc, 5, 1), RGB(255, 255, 0));
+    ok_long(GetPixel(hdc, 13, 13), RGB(255, 255, 0));
+
+    DeleteDC(hdc);
+    DeleteObject(hbmp);
+    DeleteObject(hbrRed);
+    DeleteObject(hbrBlue);
+}
+
 START_TEST(PatBlt)
 {
     BITMAPINFO bmi;
@@ -168,6 +217,8 @@ START_TEST(PatBlt)
 
     Test_BrushOrigin();
 
+    Test_Batched();
+
 
 }
 
@@ -0,0 +1,142 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Test for PtInRegion and RectInRegion
+ */
+
+#include "precomp.h"
+
+#define CELLS       16
+#define CELL_SIZE   4
+
+/* A checkerboard, every other cell of a CELLS x CELLS grid is set */
+static
+BOOL
+IsCellSet(INT x, INT y)
+{
+    if ((x < 0) || (y < 0) || (x >= CELLS * CELL_SIZE) || (y >= CELLS * CELL_SIZE))
+        return FALSE;
+
+    return ((x / CELL_SIZE) + (y / CELL_SIZE)) % 2 == 0;
+}
+
+static
+HRGN
+CreateCheckerRgn(void)
+{
+    HRGN hrgn, hrgnCell;
+    INT x, y;
+
+    hrgn = CreateRectRgn(0, 0, 0, 0);
+    for (y = 0; y < CELLS; y++)
+    {
+        for (x = (y % 2); x < CELLS; x += 2)
+        {
+            hrgnCell = CreateRectRgn(x * CELL_SIZE, y * CELL_SIZE,
+                                     (x + 1) * CELL_SIZE, (y + 1) * CELL_SIZE);
+            CombineRgn(hrgn, hrgn, hrgnCell, RGN_OR);
+            DeleteObject(hrgnCell);
+        }
+    }
+
+    return hrgn;
+}
+
+static
+VOID
+Test_Points(HRGN hrgn)
+{
+    INT x, y;
+    ULONG cErrors = 0;
+
+    for (y = -2; y < CELLS * CELL_SIZE + 2; y++)
+    {
+        for (x = -2; x < CELLS * CELL_SIZE + 2; x++)
+        {
+            if (!PtInRegion(hrgn, x, y) != !IsCellSet(x, y))
+                cErrors++;
+        }
+    }
+
+    ok(cErrors == 0, "%lu points are wrong\n", cErrors);
+}
+
+static
+VOID
+Test_Rects(HRGN hrgn)
+{
+    RECT rc;
+
+    /* Inside of a set cell, and of a clear one */
+    SetRect(&rc, 1, 1, 3, 3);
+    ok_int(RectInRegion(hrgn, &rc), TRUE);
+    SetRect(&rc, CELL_SIZE + 1, 1, CELL_SIZE + 3, 3);
+    ok_int(RectInRegion(hrgn, &rc), FALSE);
+
+    /* Touching a set cell only at the edges does not count */
+    SetRect(&rc, CELL_SIZE, 0, 2 * CELL_SIZE, CELL_SIZE);
+    ok_int(RectInRegion(hrgn, &rc), FALSE);
+
+    /* Overlapping a set cell by a single pixel */
+    SetRect(&rc, CELL_SIZE, 0, 2 * CELL_SIZE, CELL_SIZE + 1);
+    ok_int(RectInRegion(hrgn, &rc), TRUE);
+    SetRect(&rc, CELL_SIZE, CELL_SIZE, 2 * CELL_SIZE + 1, 2 * CELL_SIZE);
+    ok_int(RectInRegion(hrgn, &rc), TRUE);
+
+    /* Unordered rects are normalized */
+    SetRect(&rc, 3, 3, 1, 1);
+    ok_int(RectInRegion(hrgn, &rc), TRUE);
+
+    /* Spanning several bands, and completely outside */
+    SetRect(&rc, CELL_SIZE * CELLS - 1, 0, CELL_SIZE * CELLS, CELL_SIZE * CELLS);
+    ok_int(RectInRegion(hrgn, &rc), TRUE);
+    SetRect(&rc, -10, -10, 0, 0);
+    ok_int(RectInRegion(hrgn, &rc), FALSE);
+}
+
+static
+VOID
+Test_Mirrored(HRGN hrgn)
+{
+    XFORM xform = { -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f };
+    PRGNDATA pData;
+    DWORD cjSize;
+    HRGN hrgnMirrored;
+
+    /* The checkerboard is point symmetric to its center. Mirroring it
+       reverses the order of the bands and of the rects inside of them. */
+    cjSize = GetRegionData(hrgn, 0, NULL);
+    pData = HeapAlloc(GetProcessHeap(), 0, cjSize);
+    if (!pData)
+    {
+        skip("Out of memory\n");
+        return;
+    }
+
+    ok_long(GetRegionData(hrgn, cjSize, pData), cjSize);
+    xform.eDx = (FLOAT)(CELLS * CELL_SIZE);
+    xform.eDy = (FLOAT)(CELLS * CELL_SIZE);
+    hrgnMirrored = ExtCreateRegion(&xform, cjSize, pData);
+    ok(hrgnMirrored != NULL, "ExtCreateRegion failed\n");
+    if (hrgnMirrored)
+    {
+        Test_Points(hrgnMirrored);
+        DeleteObject(hrgnMirrored);
+    }
+
+    HeapFree(GetProcessHeap(), 0, pData);
+}
+
+START_TEST(PtInRegion)
+{
+    HRGN hrgn;
+
+    hrgn = CreateCheckerRgn();
+    ok_int(CombineRgn(hrgn, hrgn, NULL, RGN_COPY), COMPLEXREGION);
+
+    Test_Points(hrgn);
+    Test_Rects(hrgn);
+    Test_Mirrored(hrgn);
+
+    DeleteObject(hrgn);
+}
@@ -0,0 +1,170 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Test for StretchBlt
+ */
+
+#include "precomp.h"
+
+static
+HBITMAP
+CreateDib(HDC hdc, LONG cx, LONG cy, WORD cBitsPixel, PVOID *ppvBits)
+{
+    struct
+    {
+        BITMAPINFOHEADER bmiHeader;
+        RGBQUAD bmiColors[256];
+    } bmi;
+    ULONG i;
+
+    ZeroMemory(&bmi, sizeof(bmi));
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = cx;
+    bmi.bmiHeader.biHeight = -cy;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = cBitsPixel;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    /* Gray scale palette for the palette formats */
+    for (i = 0; i < 256; i++)
+    {
+        bmi.bmiColors[i].rgbRed = (BYTE)i;
+        bmi.bmiColors[i].rgbGreen = (BYTE)i;
+        bmi.bmiColors[i].rgbBlue = (BYTE)i;
+    }
+
+    return CreateDIBSection(hdc, (BITMAPINFO*)&bmi, DIB_RGB_COLORS, ppvBits, NULL, 0);
+}
+
+static
+VOID
+Test_ColorOnColor(HDC hdcSrc, HDC hdcDst)
+{
+    HBITMAP hbmpSrc, hbmpDst;
+    PULONG pulSrc, pulDst;
+    PBYTE pjSrc;
+    ULONG i;
+
+    hbmpDst = CreateDib(hdcDst, 16, 4, 32, (PVOID*)&pulDst);
+    ok(hbmpDst != NULL, "Failed to create the target bitmap\n");
+    if (!hbmpDst)
+        return;
+    SelectObject(hdcDst, hbmpDst);
+    SetStretchBltMode(hdcDst, COLORONCOLOR);
+
+    /* Enlarge a 32 bpp source, every source pixel is repeated */
+    hbmpSrc = CreateDib(hdcSrc, 4, 2, 32, (PVOID*)&pulSrc);
+    ok(hbmpSrc != NULL, "Failed to create the source bitmap\n");
+    if (hbmpSrc)
+    {
+        SelectObject(hdcSrc, hbmpSrc);
+        for (i = 0; i < 8; i++)
+            pulSrc[i] = 0x00102030 * (i + 1);
+
+        ok_int(StretchBlt(hdcDst, 0, 0, 16, 4, hdcSrc, 0, 0, 4, 2, SRCCOPY), TRUE);
+        GdiFlush();
+        for (i = 0; i < 16 * 4; i++)
+        {
+            ok(pulDst[i] == pulSrc[(i / 16 / 2) * 4 + (i % 16) / 4],
+               "Pixel %lu: got 0x%08lx\n", i, pulDst[i]);
+        }
+
+        /* Shrink it again, only every other pixel is used */
+        ok_int(StretchBlt(hdcDst, 0, 0, 2, 1, hdcSrc, 0, 0, 4, 2, SRCCOPY), TRUE);
+        GdiFlush();
+        ok_long(pulDst[0], pulSrc[0]);
+        ok_long(pulDst[1], pulSrc[2]);
+
+        SelectObject(hdcSrc, GetStockObject(DEFAULT_BITMAP));
+        DeleteObject(hbmpSrc);
+    }
+
+    /* A palette source is translated to the target format */
+    hbmpSrc = CreateDib(hdcSrc, 4, 1, 8, (PVOID*)&pjSrc);
+    ok(hbmpSrc != NULL, "Failed to create the source bitmap\n");
+    if (hbmpSrc)
+    {
+        SelectObject(hdcSrc, hbmpSrc);
+        pjSrc[0] = 0x00;
+        pjSrc[1] = 0x40;
+        pjSrc[2] = 0x80;
+        pjSrc[3] = 0xFF;
+
+        ok_int(StretchBlt(hdcDst, 0, 0, 8, 1, hdcSrc, 0, 0, 4, 1, SRCCOPY), TRUE);
+        GdiFlush();
+        for (i = 0; i < 8; i++)
+        {
+            ok((pulDst[i] & 0x00FFFFFF) == pjSrc[i / 2] * 0x010101u,
+               "Pixel %lu: got 0x%08lx\n", i, pulDst[i]);
+        }
+
+        SelectObject(hdcSrc, GetStockObject(DEFAULT_BITMAP));
+        DeleteObject(hbmpSrc);
+    }
+
+    SelectObject(hdcDst, GetStockObject(DEFAULT_BITMAP));
+    DeleteObject(hbmpDst);
+}
+
+static
+VOID
+Test_Halftone(HDC hdcSrc, HDC hdcDst)
+{
+    HBITMAP hbmpSrc, hbmpDst;
+    PULONG pulSrc, pulDst;
+    ULONG i, Gray;
+
+    hbmpDst = CreateDib(hdcDst, 16, 1, 32, (PVOID*)&pulDst);
+    hbmpSrc = CreateDib(hdcSrc, 2, 1, 32, (PVOID*)&pulSrc);
+    ok(hbmpDst != NULL && hbmpSrc != NULL, "Failed to create the bitmaps\n");
+    if (!hbmpDst || !hbmpSrc)
+    {
+        if (hbmpDst) DeleteObject(hbmpDst);
+        if (hbmpSrc) DeleteObject(hbmpSrc);
+        return;
+    }
+    SelectObject(hdcDst, hbmpDst);
+    SelectObject(hdcSrc, hbmpSrc);
+    pulSrc[0] = 0x00000000;
+    pulSrc[1] = 0x00FFFFFF;
+
+    /* The pixels between black and white are blended */
+    SetStretchBltMode(hdcDst, HALFTONE);
+    ok_int(StretchBlt(hdcDst, 0, 0, 16, 1, hdcSrc, 0, 0, 2, 1, SRCCOPY), TRUE);
+    GdiFlush();
+    ok_long(pulDst[0] & 0x00FFFFFF, 0x00000000);
+    ok_long(pulDst[15] & 0x00FFFFFF, 0x00FFFFFF);
+    for (i = 1; i < 16; i++)
+    {
+        Gray = pulDst[i] & 0xFF;
+        ok(Gray >= (pulDst[i - 1] & 0xFF), "Pixel %lu: got 0x%08lx\n", i, pulDst[i]);
+        ok((pulDst[i] & 0x00FFFFFF) == Gray * 0x010101u, "Pixel %lu: got 0x%08lx\n", i, pulDst[i]);
+    }
+    Gray = pulDst[8] & 0xFF;
+    ok(Gray > 0x40 && Gray < 0xC0, "Got 0x%08lx in the middle\n", pulDst[8]);
+
+    SetStretchBltMode(hdcDst, COLORONCOLOR);
+    SelectObject(hdcSrc, GetStockObject(DEFAULT_BITMAP));
+    SelectObject(hdcDst, GetStockObject(DEFAULT_BITMAP));
+    DeleteObject(hbmpSrc);
+    DeleteObject(hbmpDst);
+}
+
+START_TEST(StretchBlt)
+{
+    HDC hdcSrc, hdcDst;
+
+    hdcSrc = CreateCompatibleDC(NULL);
+    hdcDst = CreateCompatibleDC(NULL);
+    if (!hdcSrc || !hdcDst)
+    {
+        skip("Failed to create the DCs\n");
+        return;
+    }
+
+    Test_ColorOnColor(hdcSrc, hdcDst);
+    Test_Halftone(hdcSrc, hdcDst);
+
+    DeleteDC(hdcSrc);
+    DeleteDC(hdcDst);
+}
@@ -0,0 +1,204 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Test for writing back a file backed ramdisk on flush
+ */
+
+#include "precomp.h"
+
+#include <winioctl.h>
+#include <ndk/iofuncs.h>
+#include <ndk/obfuncs.h>
+#include <ndk/setypes.h>
+#include <reactos/drivers/ntddrdsk.h>
+
+#define IMAGE_SIZE      0x200000
+#define WRITE_OFFSET    0x30000
+#define WRITE_SIZE      0x20000
+
+static
+BOOL
+CreateImage(PCWSTR FileName)
+{
+    HANDLE File;
+    PUCHAR Zero;
+    DWORD Written;
+    BOOL Success;
+
+    Zero = VirtualAlloc(NULL, IMAGE_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!Zero)
+        return FALSE;
+
+    File = CreateFileW(FileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL);
+    Success = (File != INVALID_HANDLE_VALUE) &&
+              WriteFile(File, Zero, IMAGE_SIZE, &Written, NULL) &&
+              (Written == IMAGE_SIZE);
+    if (File != INVALID_HANDLE_VALUE)
+        CloseHandle(File);
+
+    VirtualFree(Zero, 0, MEM_RELEASE);
+    return Success;
+}
+
+static
+NTSTATUS
+CreateRamdisk(PCWSTR FileName, GUID *DiskGuid)
+{
+    UNICODE_STRING BusName = RTL_CONSTANT_STRING(DD_RAMDISK_DEVICE_NAME_U);
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    IO_STATUS_BLOCK IoStatusBlock;
+    PRAMDISK_CREATE_INPUT Input;
+    WCHAR NtFileName[MAX_PATH];
+    HANDLE Bus;
+    DWORD Size, Returned;
+    NTSTATUS Status;
+
+    StringCchPrintfW(NtFileName, _countof(NtFileName), L"\\??\\%s", FileName);
+
+    Size = FIELD_OFFSET(RAMDISK_CREATE_INPUT, FileName) + (wcslen(NtFileName) + 1) * sizeof(WCHAR);
+    Size = max(Size, sizeof(RAMDISK_CREATE_INPUT));
+    Input = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, Size);
+    if (!Input)
+        return STATUS_NO_MEMORY;
+
+    Input->Version = sizeof(RAMDISK_CREATE_INPUT);
+    Input->DiskGuid = *DiskGuid;
+    Input->DiskType = RAMDISK_MEMORY_MAPPED_DISK;
+    Input->Options.NoDriveLetter = TRUE;
+    StringCchCopyW(Input->FileName,
+                   (Size - FIELD_OFFSET(RAMDISK_CREATE_INPUT, FileName)) / sizeof(WCHAR),
+                   NtFileName);
+
+    InitializeObjectAttributes(&ObjectAttributes, &BusName, OBJ_CASE_INSENSITIVE, NULL, NULL);
+    Status = NtOpenFile(&Bus,
+                        FILE_READ_DATA | FILE_WRITE_DATA | SYNCHRONIZE,
+                        &ObjectAttributes,
+                        &IoStatusBlock,
+                        FILE_SHARE_READ | FILE_SHARE_WRITE,
+                        FILE_SYNCHRONOUS_IO_NONALERT);
+    if (NT_SUCCESS(Status))
+    {
+        if (!DeviceIoControl(Bus, FSCTL_CREATE_RAM_DISK, Input, Size, NULL, 0, &Returned, NULL))
+            Status = STATUS_UNSUCCESSFUL;
+        NtClose(Bus);
+    }
+
+    HeapFree(GetProcessHeap(), 0, Input);
+    return Status;
+}
+
+static
+BOOL
+ReadImage(PCWSTR FileName, PUCHAR Buffer)
+{
+    HANDLE File;
+    DWORD Read;
+    BOOL Success;
+
+    /* The ramdisk keeps the file open for writing */
+    File = CreateFileW(FileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                       NULL, OPEN_EXISTING, 0, NULL);
+    if (File == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    Success = ReadFile(File, Buffer, IMAGE_SIZE, &Read, NULL) && (Read == IMAGE_SIZE);
+    CloseHandle(File);
+    return Success;
+}
+
+START_TEST(RamdiskFlush)
+{
+    WCHAR TempPath[MAX_PATH], FileName[MAX_PATH], DevicePath[MAX_PATH];
+    UNICODE_STRING GuidString;
+    LARGE_INTEGER Position;
+    BOOLEAN WasEnabled;
+    PUCHAR Buffer, Image;
+    HANDLE Device;
+    DWORD Written;
+    NTSTATUS Status;
+    GUID DiskGuid;
+    ULONG i;
+
+    Status = RtlAdjustPrivilege(SE_MANAGE_VOLUME_PRIVILEGE, TRUE, FALSE, &WasEnabled);
+    if (!NT_SUCCESS(Status))
+    {
+        skip("RtlAdjustPrivilege(SE_MANAGE_VOLUME_PRIVILEGE) failed (Status 0x%08lx)\n", Status);
+        return;
+    }
+
+    GetTempPathW(_countof(TempPath), TempPath);
+    GetTempFileNameW(TempPath, L"rdk", 0, FileName);
+    if (!CreateImage(FileName))
+    {
+        skip("Could not create the image file: %lu\n", GetLastError());
+        return;
+    }
+
+    /* Ramdisks can't be removed, so every run needs a disk of its own */
+    DiskGuid.Data1 = GetTickCount();
+    DiskGuid.Data2 = (USHORT)GetCurrentProcessId();
+    DiskGuid.Data3 = 0x4000;
+    for (i = 0; i < sizeof(DiskGuid.Data4); i++)
+        DiskGuid.Data4[i] = (UCHAR)rand();
+
+    Status = CreateRamdisk(FileName, &DiskGuid);
+    if (!NT_SUCCESS(Status))
+    {
+        skip("Could not create the ramdisk (Status 0x%08lx)\n", Status);
+        DeleteFileW(FileName);
+        return;
+    }
+
+    RtlStringFromGUID(&DiskGuid, &GuidString);
+    StringCchPrintfW(DevicePath, _countof(DevicePath), L"\\\\.\\Ramdisk%.*s",
+                     GuidString.Length / sizeof(WCHAR), GuidString.Buffer);
+    RtlFreeUnicodeString(&GuidString);
+
+    Device = CreateFileW(DevicePath,
+                         GENERIC_READ | GENERIC_WRITE,
+                         FILE_SHARE_READ | FILE_SHARE_WRITE,
+                         NULL,
+                         OPEN_EXISTING,
+                         FILE_FLAG_NO_BUFFERING,
+                         NULL);
+    ok(Device != INVALID_HANDLE_VALUE, "Could not open %S: %lu\n", DevicePath, GetLastError());
+    if (Device == INVALID_HANDLE_VALUE)
+        return;
+
+    Buffer = VirtualAlloc(NULL, WRITE_SIZE + IMAGE_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!Buffer)
+    {
+        skip("Out of memory\n");
+        CloseHandle(Device);
+        return;
+    }
+    Image = Buffer + WRITE_SIZE;
+
+    /* Write across the 64 KB chunks the ramdisk writes back */
+    for (i = 0; i < WRITE_SIZE; i++)
+        Buffer[i] = (UCHAR)(i * 7 + 1);
+
+    Position.QuadPart = WRITE_OFFSET;
+    ok(SetFilePointerEx(Device, Position, NULL, FILE_BEGIN), "SetFilePointerEx failed: %lu\n", GetLastError());
+    ok(WriteFile(Device, Buffer, WRITE_SIZE, &Written, NULL) && (Written == WRITE_SIZE),
+       "WriteFile failed: %lu\n", GetLastError());
+    ok(FlushFileBuffers(Device), "FlushFileBuffers failed: %lu\n", GetLastError());
+
+    /* The data must now be in the backing file, and nothing else changed */
+    ok(ReadImage(FileName, Image), "Could not read the image file: %lu\n", GetLastError());
+    ok(memcmp(Image + WRITE_OFFSET, Buffer, WRITE_SIZE) == 0, "Written data is not in the file\n");
+    for (i = 0; i < IMAGE_SIZE; i++)
+    {
+        if ((i >= WRITE_OFFSET) && (i < WRITE_OFFSET + WRITE_SIZE))
+            continue;
+        if (Image[i] != 0)
+            break;
+    }
+    ok(i == IMAGE_SIZE, "Unexpected data at offset 0x%lx\n", i);
+
+    VirtualFree(Buffer, 0, MEM_RELEASE);
+    CloseHandle(Device);
+
+    /* The ramdisk keeps the file open until the next boot */
+    MoveFileExW(FileName, NULL, MOVEFILE_DELAY_UNTIL_REBOOT);
+}
@@ -0,0 +1,162 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Test for reading from the boot ramdisk
+ */
+
+#include "precomp.h"
+
+#include <winioctl.h>
+
+#define BLOCK_SIZE      0x10000
+#define SECTOR_SIZE     0x200
+#define RANDOM_READS    2000
+
+static
+HANDLE
+OpenRamdisk(VOID)
+{
+    WCHAR Names[0x4000], DevicePath[MAX_PATH];
+    PWSTR Name;
+
+    /* The ramdisk creates a Ramdisk{GUID} link for each of its disks */
+    if (!QueryDosDeviceW(NULL, Names, _countof(Names)))
+        return INVALID_HANDLE_VALUE;
+
+    for (Name = Names; *Name; Name += wcslen(Name) + 1)
+    {
+        if (_wcsnicmp(Name, L"Ramdisk{", 8) != 0)
+            continue;
+
+        StringCchPrintfW(DevicePath, _countof(DevicePath), L"\\\\.\\%s", Name);
+        return CreateFileW(DevicePath,
+                           GENERIC_READ,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE,
+                           NULL,
+                           OPEN_EXISTING,
+                           FILE_FLAG_NO_BUFFERING,
+                           NULL);
+    }
+
+    return INVALID_HANDLE_VALUE;
+}
+
+static
+BOOL
+ReadAt(HANDLE Device, ULONGLONG Offset, PVOID Buffer, DWORD Length)
+{
+    LARGE_INTEGER Position;
+    DWORD Read;
+
+    Position.QuadPart = Offset;
+    if (!SetFilePointerEx(Device, Position, NULL, FILE_BEGIN))
+        return FALSE;
+
+    return ReadFile(Device, Buffer, Length, &Read, NULL) && Read == Length;
+}
+
+static
+VOID
+Test_Read(HANDLE Device, ULONGLONG DiskLength, PUCHAR Buffer, PUCHAR Buffer2)
+{
+    ULONGLONG Offset;
+    ULONG i;
+
+    /* A read across a view boundary (1 MB by default) returns the same data as two reads */
+    Offset = 0x100000 - BLOCK_SIZE / 2;
+    if (Offset + BLOCK_SIZE > DiskLength)
+        Offset = 0;
+
+    ok(ReadAt(Device, Offset, Buffer, BLOCK_SIZE), "Read failed: %lu\n", GetLastError());
+    ok(ReadAt(Device, Offset, Buffer2, BLOCK_SIZE / 2), "Read failed: %lu\n", GetLastError());
+    ok(ReadAt(Device, Offset + BLOCK_SIZE / 2, Buffer2 + BLOCK_SIZE / 2, BLOCK_SIZE / 2),
+       "Read failed: %lu\n", GetLastError());
+    ok(memcmp(Buffer, Buffer2, BLOCK_SIZE) == 0, "Data differs at offset 0x%I64x\n", Offset);
+
+    /* Reading the same sector through different views gives the same data */
+    for (i = 0; i < 64; i++)
+    {
+        Offset = ((ULONGLONG)rand() * SECTOR_SIZE) % (DiskLength - SECTOR_SIZE);
+        Offset -= Offset % SECTOR_SIZE;
+        ok(ReadAt(Device, Offset, Buffer, SECTOR_SIZE), "Read failed: %lu\n", GetLastError());
+        ok(ReadAt(Device, 0, Buffer2, SECTOR_SIZE), "Read failed: %lu\n", GetLastError());
+        ok(ReadAt(Device, Offset, Buffer2, SECTOR_SIZE), "Read failed: %lu\n", GetLastError());
+        ok(memcmp(Buffer, Buffer2, SECTOR_SIZE) == 0, "Data differs at offset 0x%I64x\n", Offset);
+    }
+
+    /* Reads past the end of the disk fail */
+    ok(!ReadAt(Device, DiskLength, Buffer, SECTOR_SIZE), "Read succeeded\n");
+}
+
+static
+VOID
+Test_Benchmark(HANDLE Device, ULONGLONG DiskLength, PUCHAR Buffer)
+{
+    ULONGLONG Offset, Bytes;
+    DWORD dwStart, dwSequential, dwRandom;
+    ULONG i;
+
+    /* Not a pass/fail test, just report the throughput */
+    Bytes = 0;
+    dwStart = GetTickCount();
+    for (Offset = 0; Offset + BLOCK_SIZE <= DiskLength; Offset += BLOCK_SIZE)
+    {
+        if (!ReadAt(Device, Offset, Buffer, BLOCK_SIZE))
+            break;
+        Bytes += BLOCK_SIZE;
+    }
+    dwSequential = GetTickCount() - dwStart;
+
+    trace("Sequential: %I64u KB in %lu ms\n", Bytes / 1024, dwSequential);
+
+    dwStart = GetTickCount();
+    for (i = 0; i < RANDOM_READS; i++)
+    {
+        Offset = ((ULONGLONG)rand() * rand() * SECTOR_SIZE) % (DiskLength - 8 * SECTOR_SIZE);
+        Offset -= Offset % SECTOR_SIZE;
+        if (!ReadAt(Device, Offset, Buffer, 8 * SECTOR_SIZE))
+            break;
+    }
+    dwRandom = GetTickCount() - dwStart;
+
+    trace("Random: %lu reads of %u bytes in %lu ms\n", i, 8 * SECTOR_SIZE, dwRandom);
+}
+
+START_TEST(RamdiskIo)
+{
+    GET_LENGTH_INFORMATION LengthInfo;
+    PUCHAR Buffer, Buffer2;
+    HANDLE Device;
+    DWORD Size;
+
+    Device = OpenRamdisk();
+    if (Device == INVALID_HANDLE_VALUE)
+    {
+        skip("No ramdisk found\n");
+        return;
+    }
+
+    if (!DeviceIoControl(Device, IOCTL_DISK_GET_LENGTH_INFO, NULL, 0,
+                         &LengthInfo, sizeof(LengthInfo), &Size, NULL) ||
+        LengthInfo.Length.QuadPart < 2 * BLOCK_SIZE)
+    {
+        skip("Could not get a usable ramdisk length\n");
+        CloseHandle(Device);
+        return;
+    }
+
+    Buffer = VirtualAlloc(NULL, 2 * BLOCK_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!Buffer)
+    {
+        skip("Out of memory\n");
+        CloseHandle(Device);
+        return;
+    }
+    Buffer2 = Buffer + BLOCK_SIZE;
+
+    Test_Read(Device, LengthInfo.Length.QuadPart, Buffer, Buffer2);
+    Test_Benchmark(Device, LengthInfo.Length.QuadPart, Buffer);
+
+    VirtualFree(Buffer, 0, MEM_RELEASE);
+    CloseHandle(Device);
+}
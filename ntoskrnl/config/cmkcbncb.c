@@ -492,6 +492,9 @@ CmpCleanUpKcbCacheWithLock(IN PCM_KEY_CONTROL_BLOCK Kcb,
     /* Check if we have an index hint block and free it */
     if (Kcb->ExtFlags & CM_KCB_SUBKEY_HINT) CmpFree(Kcb->IndexHint, 0);
 
+    /* Free the subkey name cache */
+    if (Kcb->SubKeyCache) CmpFree(Kcb->SubKeyCache, 0);
+
     /* Check if we were already deleted */
     Parent = Kcb->ParentKcb;
     if (!Kcb->Delete) CmpRemoveKeyControlBlock(Kcb);
@@ -517,6 +520,7 @@ NTAPI
 CmpCleanUpSubKeyInfo(IN PCM_KEY_CONTROL_BLOCK Kcb)
 {
     PCM_KEY_NODE KeyNode;
+    ULONG i;
 
     /* Make sure we have the exclusive lock */
     CMP_ASSERT_KCB_LOCK(Kcb);
@@ -535,6 +539,15 @@ CmpCleanUpSubKeyInfo(IN PCM_KEY_CONTROL_BLOCK Kcb)
         Kcb->ExtFlags &= ~(CM_KCB_NO_SUBKEY | CM_KCB_SUBKEY_ONE | CM_KCB_SUBKEY_HINT);
     }
 
+    /* A cached subkey might be gone, forget all of them */
+    if (Kcb->SubKeyCache)
+    {
+        for (i = 0; i < CMP_SUBKEY_CACHE_SIZE; i++)
+        {
+            Kcb->SubKeyCache->Entry[i].Cell = HCELL_NIL;
+        }
+    }
+
     /* Check if there's no linked cell */
     if (Kcb->KeyCell == HCELL_NIL)
     {
@@ -566,6 +579,71 @@ CmpCleanUpSubKeyInfo(IN PCM_KEY_CONTROL_BLOCK Kcb)
     }
 }
 
+HCELL_INDEX
+NTAPI
+CmpFindSubKeyByNameWithKcb(IN PCM_KEY_CONTROL_BLOCK Kcb,
+                           IN PCM_KEY_NODE Node,
+                           IN PCUNICODE_STRING SearchName)
+{
+    PCM_SUBKEY_NAME_CACHE Cache, NewCache;
+    PCM_SUBKEY_CACHE_ENTRY Entry;
+    HCELL_INDEX Cell;
+    ULONG HashKey, i;
+
+    /* Compute the hash key for the name, it is needed either way */
+    HashKey = CmpComputeHashKey(0, SearchName, FALSE);
+
+    /* Only keys with many subkeys get a cache, the others are cheap to search */
+    Cache = Kcb->SubKeyCache;
+    if (!Cache)
+    {
+        if ((Node->SubKeyCounts[Stable] + Node->SubKeyCounts[Volatile]) <
+            CMP_SUBKEY_CACHE_MIN_SUBKEYS)
+        {
+            return CmpFindSubKeyByNameAndHash(Kcb->KeyHive, Node, SearchName, HashKey);
+        }
+
+        /* Allocate the cache, we only hold the registry lock shared */
+        NewCache = CmpAllocate(sizeof(CM_SUBKEY_NAME_CACHE), TRUE, TAG_CM);
+        if (!NewCache)
+            return CmpFindSubKeyByNameAndHash(Kcb->KeyHive, Node, SearchName, HashKey);
+
+        for (i = 0; i < CMP_SUBKEY_CACHE_SIZE; i++)
+        {
+            NewCache->Entry[i].Cell = HCELL_NIL;
+        }
+
+        /* Someone else might have beaten us to it */
+        Cache = InterlockedCompareExchangePointer((PVOID*)&Kcb->SubKeyCache,
+                                                  NewCache,
+                                                  NULL);
+        if (Cache)
+            CmpFree(NewCache, 0);
+        else
+            Cache = NewCache;
+    }
+
+    /* Check if we found this name recently */
+    Entry = &Cache->Entry[HashKey % CMP_SUBKEY_CACHE_SIZE];
+    Cell = Entry->Cell;
+    if ((Cell != HCELL_NIL) &&
+        (Entry->HashKey == HashKey) &&
+        (CmpDoCompareKeyName(Kcb->KeyHive, SearchName, Cell) == 0))
+    {
+        return Cell;
+    }
+
+    /* Do the real lookup and remember what we found */
+    Cell = CmpFindSubKeyByNameAndHash(Kcb->KeyHive, Node, SearchName, HashKey);
+    if (Cell != HCELL_NIL)
+    {
+        Entry->HashKey = HashKey;
+        Entry->Cell = Cell;
+    }
+
+    return Cell;
+}
+
 VOID
 NTAPI
 CmpDereferenceKeyControlBlock(IN PCM_KEY_CONTROL_BLOCK Kcb)
@@ -724,6 +802,7 @@ CmpCreateKeyControlBlock(IN PHHIVE Hive,
     Kcb->ConvKey = ConvKey;
     Kcb->DelayedCloseIndex = CmpDelayedCloseSize;
     Kcb->InDelayClose = 0;
+    Kcb->SubKeyCache = NULL;
     ASSERT_KCB_VALID(Kcb);
 
     /* Check if we have two hash entires */
@@ -27,8 +27,40 @@ static ULONG CmpLazyFlushHiveCount = 7;
 ULONG CmpLazyFlushCount = 1;
 LONG CmpFlushStarveWriters;
 
+/*
+ * Once more than this many hive blocks are dirty, the lazy flusher is brought
+ * forward proportionally to the dirty volume, but never below the minimum
+ * interval, so bursts of writes are still batched into a single flush.
+ */
+ULONG CmpLazyFlushDirtyThreshold = 256;
+ULONG CmpLazyFlushMinIntervalInMs = 1000;
+volatile LONGLONG CmpLazyFlushDueTime;
+CM_LAZY_FLUSH_STATISTICS CmpLazyFlushStatistics;
+
 /* FUNCTIONS ******************************************************************/
 
+/* The due time is 64-bit, don't let x86 read it half-updated */
+static
+ULONGLONG
+CmpGetLazyFlushDueTime(VOID)
+{
+    return (ULONGLONG)InterlockedCompareExchange64(&CmpLazyFlushDueTime, 0, 0);
+}
+
+static
+VOID
+CmpSetLazyFlushDueTime(IN ULONGLONG DueTime)
+{
+    LONGLONG OldDueTime;
+
+    do
+    {
+        OldDueTime = CmpLazyFlushDueTime;
+    } while (InterlockedCompareExchange64(&CmpLazyFlushDueTime,
+                                          (LONGLONG)DueTime,
+                                          OldDueTime) != OldDueTime);
+}
+
 BOOLEAN
 NTAPI
 CmpDoFlushNextHive(_In_  BOOLEAN ForceFlush,
@@ -80,6 +112,9 @@ CmpDoFlushNextHive(_In_  BOOLEAN ForceFlush,
                 /* Do the sync */
                 DPRINT("Flushing: %wZ\n", &CmHive->FileFullPath);
                 DPRINT("Handle: %p\n", CmHive->FileHandles[HFILE_TYPE_PRIMARY]);
+                CmpLazyFlushStatistics.HivesFlushed++;
+                CmpLazyFlushStatistics.BytesFlushed += (ULONGLONG)CmHive->Hive.DirtyCount * HBLOCK_SIZE;
+                CmpLazyFlushStatistics.BlocksCoalesced += CmHive->Hive.CoalescedCount;
                 Status = HvSyncHive(&CmHive->Hive);
                 if(!NT_SUCCESS(Status))
                 {
@@ -144,6 +179,9 @@ CmpLazyFlushDpcRoutine(IN PKDPC Dpc,
                        IN PVOID SystemArgument1,
                        IN PVOID SystemArgument2)
 {
+    /* The timer fired, the next write has to arm it again */
+    CmpSetLazyFlushDueTime(0);
+
     /* Check if we should queue the lazy flush worker */
     DPRINT("Flush pending: %s, Holding lazy flush: %s.\n", CmpLazyFlushPending ? "yes" : "no", CmpHoldLazyFlush ? "yes" : "no");
     if ((!CmpLazyFlushPending) && (!CmpHoldLazyFlush))
@@ -158,16 +196,52 @@ NTAPI
 CmpLazyFlush(VOID)
 {
     LARGE_INTEGER DueTime;
+    ULONGLONG CurrentTime, CurrentDueTime;
+    ULONG DirtyCount;
+    ULONG Interval;
     PAGED_CODE();
 
     /* Check if we should set the lazy flush timer */
-    if ((!CmpNoWrite) && (!CmpHoldLazyFlush))
+    if ((CmpNoWrite) || (CmpHoldLazyFlush)) return;
+
+    /* A flush that is about to happen anyway will pick this write up too */
+    CurrentTime = KeQueryInterruptTime();
+    CurrentDueTime = CmpGetLazyFlushDueTime();
+    if ((CurrentDueTime) &&
+        (CurrentDueTime <= CurrentTime + CmpLazyFlushMinIntervalInMs * 10000ULL))
+    {
+        InterlockedIncrement((PLONG)&CmpLazyFlushStatistics.RequestsCoalesced);
+        return;
+    }
+
+    /* Don't bother if there is nothing to write */
+    DirtyCount = CmlibLazyFlushDirtyCount;
+    if ((!DirtyCount) && (!CmpForceForceFlush)) return;
+
+    /* Flush sooner the more dirty data piles up */
+    Interval = CmpLazyFlushIntervalInSeconds * 1000;
+    if (DirtyCount > CmpLazyFlushDirtyThreshold)
     {
-        /* Do it */
-        DueTime.QuadPart = Int32x32To64(CmpLazyFlushIntervalInSeconds,
-                                        -10 * 1000 * 1000);
-        KeSetTimer(&CmpLazyFlushTimer, DueTime, &CmpLazyFlushDpc);
+        Interval = (ULONG)(((ULONGLONG)Interval * CmpLazyFlushDirtyThreshold) / DirtyCount);
+        if (Interval < CmpLazyFlushMinIntervalInMs) Interval = CmpLazyFlushMinIntervalInMs;
     }
+
+    /* Keep an already scheduled flush unless we have to bring it forward */
+    if (CurrentDueTime)
+    {
+        if (CurrentDueTime <= CurrentTime + Interval * 10000ULL)
+        {
+            InterlockedIncrement((PLONG)&CmpLazyFlushStatistics.RequestsCoalesced);
+            return;
+        }
+
+        InterlockedIncrement((PLONG)&CmpLazyFlushStatistics.EarlyFlushes);
+    }
+
+    /* Do it */
+    CmpSetLazyFlushDueTime(CurrentTime + Interval * 10000ULL);
+    DueTime.QuadPart = Int32x32To64(Interval, -10 * 1000);
+    KeSetTimer(&CmpLazyFlushTimer, DueTime, &CmpLazyFlushDpc);
 }
 
 _Function_class_(WORKER_THREAD_ROUTINE)
@@ -204,6 +278,7 @@ CmpLazyFlushWorker(IN PVOID Parameter)
     }
 
     /* Flush the next hive */
+    CmpLazyFlushStatistics.FlushPasses++;
     MoreWork = CmpDoFlushNextHive(ForceFlush, &Result, &DirtyCount);
     if (!MoreWork)
     {
@@ -320,6 +395,7 @@ CmpShutdownWorkers(VOID)
     /* Stop lazy flushing */
     PAGED_CODE();
     KeCancelTimer(&CmpLazyFlushTimer);
+    CmpSetLazyFlushDueTime(0);
 }
 
 VOID
@@ -330,4 +406,34 @@ CmSetLazyFlushState(IN BOOLEAN Enable)
     CmpHoldLazyFlush = !Enable;
 }
 
+#if DBG && defined(KDBG)
+BOOLEAN
+CmpKdbgExtLazyFlush(ULONG Argc, PCHAR Argv[])
+{
+    ULONGLONG DueTime = CmpGetLazyFlushDueTime();
+
+    KdbpPrint("Flush passes:\t\t%lu\n", CmpLazyFlushStatistics.FlushPasses);
+    KdbpPrint("Hives flushed:\t\t%lu\n", CmpLazyFlushStatistics.HivesFlushed);
+    KdbpPrint("Bytes flushed:\t\t%I64u (%I64u Kb)\n", CmpLazyFlushStatistics.BytesFlushed,
+              CmpLazyFlushStatistics.BytesFlushed / 1024);
+    KdbpPrint("Blocks coalesced:\t%I64u\n", CmpLazyFlushStatistics.BlocksCoalesced);
+    KdbpPrint("Requests coalesced:\t%lu\n", CmpLazyFlushStatistics.RequestsCoalesced);
+    KdbpPrint("Early flushes:\t\t%lu\n", CmpLazyFlushStatistics.EarlyFlushes);
+    KdbpPrint("Dirty count:\t\t%lu (threshold %lu)\n", CmlibLazyFlushDirtyCount,
+              CmpLazyFlushDirtyThreshold);
+
+    if (DueTime)
+    {
+        KdbpPrint("Next flush in:\t\t%I64d ms\n",
+                  ((LONGLONG)DueTime - (LONGLONG)KeQueryInterruptTime()) / 10000);
+    }
+    else
+    {
+        KdbpPrint("No flush scheduled\n");
+    }
+
+    return TRUE;
+}
+#endif
+
 /* EOF */
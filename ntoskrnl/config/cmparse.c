@@ -1171,7 +1171,7 @@ CmpParseKey(IN PVOID ParseObject,
             if (!(Kcb->Flags & KEY_SYM_LINK))
             {
                 /* Find the subkey */
-                NextCell = CmpFindSubKeyByName(Hive, Node, &NextName);
+                NextCell = CmpFindSubKeyByNameWithKcb(ParentKcb, Node, &NextName);
                 if (NextCell != HCELL_NIL)
                 {
                     /* Get the new node */
@@ -84,6 +84,12 @@
 #define CMP_HASH_IRRATIONAL                             314159269
 #define CMP_HASH_PRIME                                  1000000007
 
+//
+// Subkey Name Cache Constants
+//
+#define CMP_SUBKEY_CACHE_SIZE                           32
+#define CMP_SUBKEY_CACHE_MIN_SUBKEYS                    128
+
 //
 // CmpCreateKeyControlBlock Flags
 //
@@ -220,6 +226,21 @@ typedef struct _CM_INDEX_HINT_BLOCK
     ULONG HashKey[ANYSIZE_ARRAY];
 } CM_INDEX_HINT_BLOCK, *PCM_INDEX_HINT_BLOCK;
 
+//
+// Subkey Name Cache
+// Remembers the subkeys last found under a key with many subkeys
+//
+typedef struct _CM_SUBKEY_CACHE_ENTRY
+{
+    ULONG HashKey;
+    HCELL_INDEX Cell;
+} CM_SUBKEY_CACHE_ENTRY, *PCM_SUBKEY_CACHE_ENTRY;
+
+typedef struct _CM_SUBKEY_NAME_CACHE
+{
+    CM_SUBKEY_CACHE_ENTRY Entry[CMP_SUBKEY_CACHE_SIZE];
+} CM_SUBKEY_NAME_CACHE, *PCM_SUBKEY_NAME_CACHE;
+
 //
 // Key Body
 //
@@ -307,6 +328,7 @@ typedef struct _CM_KEY_CONTROL_BLOCK
          ULONG Flags : 16;
     };
     ULONG InDelayClose;
+    PCM_SUBKEY_NAME_CACHE SubKeyCache;
 } CM_KEY_CONTROL_BLOCK, *PCM_KEY_CONTROL_BLOCK;
 
 //
@@ -385,6 +407,19 @@ typedef struct _CM_USE_COUNT_LOG
     CM_USE_COUNT_LOG_ENTRY Log[32];
 } CM_USE_COUNT_LOG, *PCM_USE_COUNT_LOG;
 
+//
+// Lazy Flusher Statistics
+//
+typedef struct _CM_LAZY_FLUSH_STATISTICS
+{
+    ULONG FlushPasses;
+    ULONG HivesFlushed;
+    ULONGLONG BytesFlushed;
+    ULONGLONG BlocksCoalesced;
+    ULONG RequestsCoalesced;
+    ULONG EarlyFlushes;
+} CM_LAZY_FLUSH_STATISTICS, *PCM_LAZY_FLUSH_STATISTICS;
+
 //
 // Configuration Manager Hive Structure
 //
@@ -1020,6 +1055,14 @@ CmpCleanUpSubKeyInfo(
     IN PCM_KEY_CONTROL_BLOCK Kcb
 );
 
+HCELL_INDEX
+NTAPI
+CmpFindSubKeyByNameWithKcb(
+    IN PCM_KEY_CONTROL_BLOCK Kcb,
+    IN PCM_KEY_NODE Node,
+    IN PCUNICODE_STRING SearchName
+);
+
 PUNICODE_STRING
 NTAPI
 CmpConstructName(
@@ -645,18 +645,16 @@ static HCELL_INDEX
 NTAPI
 CmpFindSubKeyByHash(IN PHHIVE Hive,
                     IN PCM_KEY_FAST_INDEX FastIndex,
-                    IN PCUNICODE_STRING SearchName)
+                    IN PCUNICODE_STRING SearchName,
+                    IN ULONG HashKey)
 {
-    ULONG HashKey, i;
+    ULONG i;
     PCM_INDEX FastEntry;
 
     /* Make sure it's really a hash */
     ASSERT(FastIndex->Signature == CM_KEY_HASH_LEAF);
 
-    /* Compute the hash key for the name */
-    HashKey = CmpComputeHashKey(0, SearchName, FALSE);
-
-    /* Loop all the entries */
+    /* Loop all the entries, only the ones with our hash need a name compare */
     for (i = 0; i < FastIndex->Count; i++)
     {
         /* Get the entry */
@@ -683,6 +681,20 @@ NTAPI
 CmpFindSubKeyByName(IN PHHIVE Hive,
                     IN PCM_KEY_NODE Parent,
                     IN PCUNICODE_STRING SearchName)
+{
+    /* Compute the hash key for the name and do the lookup */
+    return CmpFindSubKeyByNameAndHash(Hive,
+                                      Parent,
+                                      SearchName,
+                                      CmpComputeHashKey(0, SearchName, FALSE));
+}
+
+HCELL_INDEX
+NTAPI
+CmpFindSubKeyByNameAndHash(IN PHHIVE Hive,
+                           IN PCM_KEY_NODE Parent,
+                           IN PCUNICODE_STRING SearchName,
+                           IN ULONG HashKey)
 {
     ULONG i;
     PCM_KEY_INDEX IndexRoot;
@@ -750,7 +762,8 @@ CmpFindSubKeyByName(IN PHHIVE Hive,
                 /* Find the subkey in the hash */
                 SubKey = CmpFindSubKeyByHash(Hive,
                                              (PCM_KEY_FAST_INDEX)IndexRoot,
-                                             SearchName);
+                                             SearchName,
+                                             HashKey);
 
                 /* Release the previous cell */
                 ASSERT(CellToRelease != HCELL_NIL);
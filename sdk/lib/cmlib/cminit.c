@@ -11,6 +11,9 @@
 
 ULONG CmlibTraceLevel = 0;
 
+/* Sum of the dirty counts of all hives that are flushed lazily */
+ULONG CmlibLazyFlushDirtyCount = 0;
+
 // FIXME: This function must be replaced by CmpCreateRootNode from ntoskrnl/config/cmsysini.c
 // (and CmpCreateRootNode be moved there).
 BOOLEAN CMAPI
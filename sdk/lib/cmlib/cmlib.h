@@ -121,6 +121,29 @@
         IN PRTL_BITMAP BitMapHeader);
 
     #define RtlCheckBit(BMH,BP) (((((PLONG)(BMH)->Buffer)[(BP) / 32]) >> ((BP) % 32)) & 0x1)
+
+    // The host tools are single-threaded
+    static __inline LONG
+    InterlockedExchangeAdd(
+        IN OUT volatile LONG *Addend,
+        IN LONG Value)
+    {
+        LONG Old = *Addend;
+        *Addend += Value;
+        return Old;
+    }
+
+    static __inline LONG
+    InterlockedCompareExchange(
+        IN OUT volatile LONG *Destination,
+        IN LONG Exchange,
+        IN LONG Comparand)
+    {
+        LONG Old = *Destination;
+        if (Old == Comparand)
+            *Destination = Exchange;
+        return Old;
+    }
     #define UNREFERENCED_PARAMETER(P) {(P)=(P);}
 
     #define PKTHREAD PVOID
@@ -308,6 +331,7 @@ typedef struct _HV_TRACK_CELL_REF
 } HV_TRACK_CELL_REF, *PHV_TRACK_CELL_REF;
 
 extern ULONG CmlibTraceLevel;
+extern ULONG CmlibLazyFlushDirtyCount;
 
 //
 // Hack since bigkeys are not yet supported
@@ -480,6 +504,10 @@ ULONG CMAPI
 HvpHiveHeaderChecksum(
    PHBASE_BLOCK HiveHeader);
 
+VOID CMAPI
+HvpResetDirtyCount(
+   PHHIVE RegistryHive);
+
 
 /* Old-style Public "Cmlib" functions */
 
@@ -506,6 +534,23 @@ CmpFindSubKeyByName(
     IN PCUNICODE_STRING SearchName
 );
 
+LONG
+NTAPI
+CmpDoCompareKeyName(
+    IN PHHIVE Hive,
+    IN PCUNICODE_STRING SearchName,
+    IN HCELL_INDEX Cell
+);
+
+HCELL_INDEX
+NTAPI
+CmpFindSubKeyByNameAndHash(
+    IN PHHIVE Hive,
+    IN PCM_KEY_NODE Parent,
+    IN PCUNICODE_STRING SearchName,
+    IN ULONG HashKey
+);
+
 HCELL_INDEX
 NTAPI
 CmpFindSubKeyByNumber(
@@ -104,6 +104,7 @@ HvMarkCellDirty(
 {
     ULONG CellBlock;
     ULONG CellLastBlock;
+    ULONG Block, NewlyDirty = 0;
 
     ASSERT(RegistryHive->ReadOnly == FALSE);
 
@@ -116,9 +117,25 @@ HvMarkCellDirty(
     CellBlock     = HvGetCellBlock(CellIndex);
     CellLastBlock = HvGetCellBlock(CellIndex + HBLOCK_SIZE - 1);
 
+    /* Only count the blocks this write dirties for the first time */
+    for (Block = CellBlock; Block < CellLastBlock; Block++)
+    {
+        if (!RtlCheckBit(&RegistryHive->DirtyVector, Block))
+            NewlyDirty++;
+    }
+
     RtlSetBits(&RegistryHive->DirtyVector,
                CellBlock, CellLastBlock - CellBlock);
-    RegistryHive->DirtyCount++;
+
+    if (!NewlyDirty)
+    {
+        InterlockedExchangeAdd((PLONG)&RegistryHive->CoalescedCount, 1);
+        return TRUE;
+    }
+
+    InterlockedExchangeAdd((PLONG)&RegistryHive->DirtyCount, NewlyDirty);
+    if (!(RegistryHive->HiveFlags & (HIVE_VOLATILE | HIVE_NOLAZYFLUSH)))
+        InterlockedExchangeAdd((PLONG)&CmlibLazyFlushDirtyCount, NewlyDirty);
     return TRUE;
 }
 
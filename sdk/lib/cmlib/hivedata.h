@@ -293,7 +293,8 @@ typedef struct _HHIVE
 #endif
     PHBASE_BLOCK BaseBlock;
     RTL_BITMAP DirtyVector;
-    ULONG DirtyCount;
+    ULONG DirtyCount;       // Dirty blocks in DirtyVector
+    ULONG CoalescedCount;   // Writes to blocks that were dirty already
     ULONG DirtyAlloc;
     ULONG BaseBlockAlloc;
     ULONG Cluster;
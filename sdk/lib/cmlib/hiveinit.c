@@ -624,6 +624,9 @@ HvFree(
 {
     if (!RegistryHive->ReadOnly)
     {
+        /* Its dirty blocks will never be written now */
+        HvpResetDirtyCount(RegistryHive);
+
         /* Release hive bitmap */
         if (RegistryHive->DirtyVector.Buffer)
         {
@@ -9,6 +9,112 @@
 #define NDEBUG
 #include <debug.h>
 
+/* Size of the buffer used to coalesce adjacent hive blocks into one write */
+#define HV_WRITE_BUFFER_SIZE    (64 * HBLOCK_SIZE)
+
+typedef struct _HV_WRITE_BUFFER
+{
+    PHHIVE RegistryHive;
+    ULONG FileType;
+    PUCHAR Buffer;      /* NULL if blocks have to be written one by one */
+    ULONG FileOffset;   /* File offset of the first buffered block */
+    ULONG Length;       /* Number of bytes buffered */
+} HV_WRITE_BUFFER, *PHV_WRITE_BUFFER;
+
+static VOID
+HvpInitWriteBuffer(
+    PHV_WRITE_BUFFER WriteBuffer,
+    PHHIVE RegistryHive,
+    ULONG FileType)
+{
+    WriteBuffer->RegistryHive = RegistryHive;
+    WriteBuffer->FileType = FileType;
+    WriteBuffer->FileOffset = 0;
+    WriteBuffer->Length = 0;
+
+    /* Failing to get a buffer is not fatal, we just issue more writes */
+    WriteBuffer->Buffer = RegistryHive->Allocate(HV_WRITE_BUFFER_SIZE, TRUE, TAG_CM);
+    if (WriteBuffer->Buffer == NULL)
+    {
+        DPRINT1("Failed to allocate the hive write buffer\n");
+    }
+}
+
+static BOOLEAN
+HvpFlushWriteBuffer(
+    PHV_WRITE_BUFFER WriteBuffer)
+{
+    ULONG FileOffset;
+    BOOLEAN Success;
+
+    if (WriteBuffer->Length == 0)
+    {
+        return TRUE;
+    }
+
+    FileOffset = WriteBuffer->FileOffset;
+    Success = WriteBuffer->RegistryHive->FileWrite(WriteBuffer->RegistryHive,
+                                                   WriteBuffer->FileType,
+                                                   &FileOffset,
+                                                   WriteBuffer->Buffer,
+                                                   WriteBuffer->Length);
+    WriteBuffer->Length = 0;
+
+    return Success;
+}
+
+static VOID
+HvpFreeWriteBuffer(
+    PHV_WRITE_BUFFER WriteBuffer)
+{
+    if (WriteBuffer->Buffer != NULL)
+    {
+        WriteBuffer->RegistryHive->Free(WriteBuffer->Buffer, 0);
+        WriteBuffer->Buffer = NULL;
+    }
+}
+
+/*
+ * Queues a hive block for writing at the given file offset. Blocks landing
+ * right after the previously queued ones are gathered and written together.
+ */
+static BOOLEAN
+HvpWriteBlock(
+    PHV_WRITE_BUFFER WriteBuffer,
+    ULONG FileOffset,
+    PVOID BlockPtr)
+{
+    if (WriteBuffer->Buffer == NULL)
+    {
+        return WriteBuffer->RegistryHive->FileWrite(WriteBuffer->RegistryHive,
+                                                    WriteBuffer->FileType,
+                                                    &FileOffset,
+                                                    BlockPtr,
+                                                    HBLOCK_SIZE);
+    }
+
+    /* Write out what we have if the block does not extend the current run */
+    if (WriteBuffer->Length != 0 &&
+        (FileOffset != WriteBuffer->FileOffset + WriteBuffer->Length ||
+         WriteBuffer->Length + HBLOCK_SIZE > HV_WRITE_BUFFER_SIZE))
+    {
+        if (!HvpFlushWriteBuffer(WriteBuffer))
+        {
+            return FALSE;
+        }
+    }
+
+    if (WriteBuffer->Length == 0)
+    {
+        WriteBuffer->FileOffset = FileOffset;
+    }
+
+    RtlCopyMemory(WriteBuffer->Buffer + WriteBuffer->Length, BlockPtr, HBLOCK_SIZE);
+    WriteBuffer->Length += HBLOCK_SIZE;
+
+    return TRUE;
+}
+
 static BOOLEAN CMAPI
 HvpWriteLog(
     PHHIVE RegistryHive)
@@ -22,6 +128,7 @@ HvpWriteLog(
     ULONG LastIndex;
     PVOID BlockPtr;
     BOOLEAN Success;
+    HV_WRITE_BUFFER WriteBuffer;
     static ULONG PrintCount = 0;
 
     if (PrintCount++ == 0)
@@ -78,7 +185,8 @@ HvpWriteLog(
         return FALSE;
     }
 
-    /* Write dirty blocks */
+    /* Write dirty blocks, they are stored back to back in the log */
+    HvpInitWriteBuffer(&WriteBuffer, RegistryHive, HFILE_TYPE_LOG);
     FileOffset = BufferSize;
     BlockIndex = 0;
     while (BlockIndex < RegistryHive->Storage[Stable].Length)
@@ -93,10 +201,9 @@ HvpWriteLog(
         BlockPtr = (PVOID)RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress;
 
         /* Write hive block */
-        Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_LOG,
-                                         &FileOffset, BlockPtr, HBLOCK_SIZE);
-        if (!Success)
+        if (!HvpWriteBlock(&WriteBuffer, FileOffset, BlockPtr))
         {
+            HvpFreeWriteBuffer(&WriteBuffer);
             return FALSE;
         }
 
@@ -104,6 +211,13 @@ HvpWriteLog(
         FileOffset += HBLOCK_SIZE;
     }
 
+    Success = HvpFlushWriteBuffer(&WriteBuffer);
+    HvpFreeWriteBuffer(&WriteBuffer);
+    if (!Success)
+    {
+        return FALSE;
+    }
+
     Success = RegistryHive->FileSetSize(RegistryHive, HFILE_TYPE_LOG, FileOffset, FileOffset);
     if (!Success)
     {
@@ -153,6 +267,7 @@ HvpWriteHive(
     ULONG LastIndex;
     PVOID BlockPtr;
     BOOLEAN Success;
+    HV_WRITE_BUFFER WriteBuffer;
 
     ASSERT(RegistryHive->ReadOnly == FALSE);
     ASSERT(RegistryHive->BaseBlock->Length ==
@@ -182,6 +297,8 @@ HvpWriteHive(
         return FALSE;
     }
 
+    /* Write the (dirty) blocks, adjacent ones are written together */
+    HvpInitWriteBuffer(&WriteBuffer, RegistryHive, HFILE_TYPE_PRIMARY);
     BlockIndex = 0;
     while (BlockIndex < RegistryHive->Storage[Stable].Length)
     {
@@ -199,16 +316,22 @@ HvpWriteHive(
         FileOffset = (BlockIndex + 1) * HBLOCK_SIZE;
 
         /* Write hive block */
-        Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_PRIMARY,
-                                          &FileOffset, BlockPtr, HBLOCK_SIZE);
-        if (!Success)
+        if (!HvpWriteBlock(&WriteBuffer, FileOffset, BlockPtr))
         {
+            HvpFreeWriteBuffer(&WriteBuffer);
             return FALSE;
         }
 
         BlockIndex++;
     }
 
+    Success = HvpFlushWriteBuffer(&WriteBuffer);
+    HvpFreeWriteBuffer(&WriteBuffer);
+    if (!Success)
+    {
+        return FALSE;
+    }
+
     Success = RegistryHive->FileFlush(RegistryHive, HFILE_TYPE_PRIMARY, NULL, 0);
     if (!Success)
     {
@@ -239,6 +362,29 @@ HvpWriteHive(
     return TRUE;
 }
 
+VOID CMAPI
+HvpResetDirtyCount(
+    PHHIVE RegistryHive)
+{
+    LONG OldCount, NewCount;
+
+    /* Take the hive out of the total the lazy flusher looks at */
+    if (!(RegistryHive->HiveFlags & (HIVE_VOLATILE | HIVE_NOLAZYFLUSH)))
+    {
+        do
+        {
+            OldCount = *(volatile LONG *)&CmlibLazyFlushDirtyCount;
+            NewCount = ((ULONG)OldCount > RegistryHive->DirtyCount) ?
+                       OldCount - RegistryHive->DirtyCount : 0;
+        } while (InterlockedCompareExchange((PLONG)&CmlibLazyFlushDirtyCount,
+                                            NewCount,
+                                            OldCount) != OldCount);
+    }
+
+    RegistryHive->DirtyCount = 0;
+    RegistryHive->CoalescedCount = 0;
+}
+
 BOOLEAN CMAPI
 HvSyncHive(
     PHHIVE RegistryHive)
@@ -247,6 +393,7 @@ HvSyncHive(
 
     if (RtlFindSetBits(&RegistryHive->DirtyVector, 1, 0) == ~0U)
     {
+        HvpResetDirtyCount(RegistryHive);
         return TRUE;
     }
 
@@ -267,7 +414,7 @@ HvSyncHive(
 
     /* Clear dirty bitmap. */
     RtlClearAllBits(&RegistryHive->DirtyVector);
-    RegistryHive->DirtyCount = 0;
+    HvpResetDirtyCount(RegistryHive);
 
     return TRUE;
 }
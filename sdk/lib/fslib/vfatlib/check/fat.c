@@ -29,6 +29,14 @@
 #define NDEBUG
 #include <debug.h>
 
+/* Granularity of the FAT changes kept in fs->fat_dirty */
+#define FAT_DIRTY_BLOCK 512
+
+static int fat_eff_size(DOS_FS * fs)
+{
+    return ((fs->data_clusters + 2) * fs->fat_bits + 7) / 8ULL;
+}
+
 
 /**
  * Fetch the FAT entry for a specified cluster.
@@ -87,15 +95,20 @@ void read_fat(DOS_FS * fs)
     uint32_t total_num_clusters;
 
     /* Clean up from previous pass */
-    if (fs->fat)
+    if (fs->fat) {
+	flush_fat(fs);
 	free(fs->fat);
+    }
+    if (fs->fat_dirty)
+	free(fs->fat_dirty);
     if (fs->cluster_owner)
 	free(fs->cluster_owner);
     fs->fat = NULL;
+    fs->fat_dirty = NULL;
     fs->cluster_owner = NULL;
 
     total_num_clusters = fs->data_clusters + 2;
-    eff_size = (total_num_clusters * fs->fat_bits + 7) / 8ULL;
+    eff_size = fat_eff_size(fs);
 
     if (fs->fat_bits != 12)
 	    alloc_size = eff_size;
@@ -151,6 +164,10 @@ void read_fat(DOS_FS * fs)
     }
     fs->fat = (unsigned char *)first;
 
+    /* One bit per block of the FAT, see set_fat() */
+    fs->fat_dirty = alloc((eff_size / FAT_DIRTY_BLOCK + 8) / 8);
+    memset(fs->fat_dirty, 0, (eff_size / FAT_DIRTY_BLOCK + 8) / 8);
+
     fs->cluster_owner = alloc(total_num_clusters * sizeof(DOS_FILE *));
     memset(fs->cluster_owner, 0, (total_num_clusters * sizeof(DOS_FILE *)));
 
@@ -191,6 +208,7 @@ void set_fat(DOS_FS * fs, uint32_t cluster, int32_t new)
     unsigned char *data = NULL;
     int size;
     off_t offs;
+    uint32_t block;
 
     if (cluster > fs->data_clusters + 1) {
 	die("Internal error: cluster out of range in set_fat() (%lu > %lu).",
@@ -249,9 +267,40 @@ void set_fat(DOS_FS * fs, uint32_t cluster, int32_t new)
     default:
 	die("Bad FAT entry size: %d bits.", fs->fat_bits);
     }
-    fs_write(offs, size, data);
-    if (fs->nfats > 1) {
-	fs_write(offs + fs->fat_size, size, data);
+
+    /* Only remember the change here, writing every entry on its own
+     * would mean a read-modify-write of a sector for each of them */
+    offs -= fs->fat_start;
+    for (block = offs / FAT_DIRTY_BLOCK;
+	 block <= (offs + size - 1) / FAT_DIRTY_BLOCK; block++)
+	fs->fat_dirty[block / 8] |= 1 << (block % 8);
+}
+
+void flush_fat(DOS_FS * fs)
+{
+    uint32_t block, first, blocks;
+    off_t offs;
+    int eff_size, size, i;
+
+    if (!fs->fat || !fs->fat_dirty)
+	return;
+
+    eff_size = fat_eff_size(fs);
+    blocks = (eff_size + FAT_DIRTY_BLOCK - 1) / FAT_DIRTY_BLOCK;
+
+    for (block = 0; block < blocks; block++) {
+	if (!(fs->fat_dirty[block / 8] & (1 << (block % 8))))
+	    continue;
+
+	/* Write each run of changed blocks at once */
+	for (first = block; block < blocks &&
+	     (fs->fat_dirty[block / 8] & (1 << (block % 8))); block++)
+	    fs->fat_dirty[block / 8] &= ~(1 << (block % 8));
+
+	offs = (off_t)first * FAT_DIRTY_BLOCK;
+	size = min(eff_size - (int)offs, (int)((block - first) * FAT_DIRTY_BLOCK));
+	for (i = 0; i < fs->nfats; i++)
+	    fs_write(fs->fat_start + i * fs->fat_size + offs, size, fs->fat + offs);
     }
 }
 
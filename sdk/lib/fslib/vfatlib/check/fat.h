@@ -36,7 +36,12 @@ void set_fat(DOS_FS * fs, uint32_t cluster, int32_t new);
 
 /* Changes the value of the CLUSTERth cluster of the FAT of FS to NEW. Special
    values of NEW are -1 (EOF, 0xff8 or 0xfff8) and -2 (bad sector, 0xff7 or
-   0xfff7) */
+   0xfff7). The change is only written by flush_fat. */
+
+void flush_fat(DOS_FS * fs);
+
+/* Writes the parts of the FAT changed by set_fat to all FAT copies, in as
+   few writes as possible. */
 
 int bad_cluster(DOS_FS * fs, uint32_t cluster);
 
@@ -210,6 +210,7 @@ typedef struct {
     long free_clusters;
     off_t backupboot_start;	/* 0 if not present */
     unsigned char *fat;
+    unsigned char *fat_dirty;	/* bitmap of FAT blocks changed in memory */
     DOS_FILE **cluster_owner;
     char *label;
 } DOS_FS;
@@ -51,6 +51,24 @@ CalcVolumeSerialNumber(VOID)
     return Serial;
 }
 
+/* Size of the zeroed buffer used to write Sectors sectors, in sectors */
+static ULONG
+FatGetBatchSectors(
+    IN ULONG Sectors,
+    IN ULONG Granularity,
+    IN ULONG BytesPerSector)
+{
+    ULONG BatchSectors;
+
+    /* Write whole multiples of the granularity (a cluster when wiping) */
+    BatchSectors = FAT_WRITE_BUFFER_SIZE / BytesPerSector;
+    BatchSectors -= BatchSectors % Granularity;
+    if (BatchSectors < Granularity)
+        BatchSectors = Granularity;
+
+    return min(BatchSectors, Sectors);
+}
+
 /***** Wipe function for FAT12, FAT16 and FAT32 formats *****/
 NTSTATUS
 FatWipeSectors(
@@ -64,22 +82,23 @@ FatWipeSectors(
     PUCHAR Buffer;
     LARGE_INTEGER FileOffset;
     ULONGLONG Sector;
-    ULONG Length;
-    NTSTATUS Status;
+    ULONG BatchSectors;
+    ULONG Sectors;
+    NTSTATUS Status = STATUS_SUCCESS;
 
-    Length = SectorsPerCluster * BytesPerSector;
+    BatchSectors = FatGetBatchSectors(TotalSectors, SectorsPerCluster, BytesPerSector);
 
-    /* Allocate buffer for the cluster */
+    /* Allocate buffer for the clusters */
     Buffer = (PUCHAR)RtlAllocateHeap(RtlGetProcessHeap(),
                                      HEAP_ZERO_MEMORY,
-                                     Length);
+                                     BatchSectors * BytesPerSector);
     if (Buffer == NULL)
         return STATUS_INSUFFICIENT_RESOURCES;
 
-    /* Wipe all clusters */
-    Sector = 0;
-    while (Sector + SectorsPerCluster < TotalSectors)
+    /* Wipe all clusters, many at a time, and the trailing space behind the last one */
+    for (Sector = 0; Sector < TotalSectors; Sector += Sectors)
     {
+        Sectors = (ULONG)min(BatchSectors, TotalSectors - Sector);
         FileOffset.QuadPart = Sector * BytesPerSector;
 
         Status = NtWriteFile(FileHandle,
@@ -88,7 +107,7 @@ FatWipeSectors(
                              NULL,
                              &IoStatusBlock,
                              Buffer,
-                             Length,
+                             Sectors * BytesPerSector,
                              &FileOffset,
                              NULL);
         if (!NT_SUCCESS(Status))
@@ -97,18 +116,50 @@ FatWipeSectors(
             goto done;
         }
 
-        UpdateProgress(Context, SectorsPerCluster);
-
-        Sector += SectorsPerCluster;
+        UpdateProgress(Context, Sectors);
     }
 
-    /* Wipe the trailing space behind the last cluster */
-    if (Sector < TotalSectors)
-    {
-        DPRINT("Remaining sectors %lu\n", TotalSectors - Sector);
+done:
+    /* Free the buffer */
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Buffer);
+    return Status;
+}
 
-        FileOffset.QuadPart = Sector * BytesPerSector;
-        Length = (TotalSectors - Sector) * BytesPerSector;
+/***** FAT writing function for FAT12, FAT16 and FAT32 formats *****/
+NTSTATUS
+FatWriteFAT(
+    IN HANDLE FileHandle,
+    IN ULONG StartSector,
+    IN ULONG FatSectors,
+    IN ULONG BytesPerSector,
+    IN PUCHAR FatHeader,
+    IN ULONG FatHeaderLength,
+    IN OUT PFORMAT_CONTEXT Context)
+{
+    IO_STATUS_BLOCK IoStatusBlock;
+    PUCHAR Buffer;
+    LARGE_INTEGER FileOffset;
+    ULONG BatchSectors;
+    ULONG Sectors;
+    ULONG i;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    BatchSectors = FatGetBatchSectors(FatSectors, 1, BytesPerSector);
+
+    /* Allocate buffer */
+    Buffer = (PUCHAR)RtlAllocateHeap(RtlGetProcessHeap(),
+                                     HEAP_ZERO_MEMORY,
+                                     BatchSectors * BytesPerSector);
+    if (Buffer == NULL)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    /* The reserved entries go in front of the first batch, the rest of the FAT is zero */
+    RtlCopyMemory(Buffer, FatHeader, FatHeaderLength);
+
+    for (i = 0; i < FatSectors; i += Sectors)
+    {
+        Sectors = min(BatchSectors, FatSectors - i);
+        FileOffset.QuadPart = ((ULONGLONG)StartSector + i) * BytesPerSector;
 
         Status = NtWriteFile(FileHandle,
                              NULL,
@@ -116,7 +167,7 @@ FatWipeSectors(
                              NULL,
                              &IoStatusBlock,
                              Buffer,
-                             Length,
+                             Sectors * BytesPerSector,
                              &FileOffset,
                              NULL);
         if (!NT_SUCCESS(Status))
@@ -125,7 +176,10 @@ FatWipeSectors(
             goto done;
         }
 
-        UpdateProgress(Context, TotalSectors - Sector);
+        UpdateProgress(Context, Sectors);
+
+        /* Zero the begin of the buffer */
+        RtlZeroMemory(Buffer, FatHeaderLength);
     }
 
 done:
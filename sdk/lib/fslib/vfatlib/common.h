@@ -11,6 +11,9 @@
 #ifndef _VFATCOMMON_H_
 #define _VFATCOMMON_H_
 
+/* Largest write issued while formatting */
+#define FAT_WRITE_BUFFER_SIZE   (1024 * 1024)
+
 ULONG GetShiftCount(IN ULONG Value);
 ULONG CalcVolumeSerialNumber(VOID);
 
@@ -22,6 +25,16 @@ FatWipeSectors(
     IN ULONG BytesPerSector,
     IN OUT PFORMAT_CONTEXT Context);
 
+NTSTATUS
+FatWriteFAT(
+    IN HANDLE FileHandle,
+    IN ULONG StartSector,
+    IN ULONG FatSectors,
+    IN ULONG BytesPerSector,
+    IN PUCHAR FatHeader,
+    IN ULONG FatHeaderLength,
+    IN OUT PFORMAT_CONTEXT Context);
+
 #endif /* _VFATCOMMON_H_ */
 
 /* EOF */
@@ -77,85 +77,20 @@ Fat12WriteFAT(IN HANDLE FileHandle,
               IN PFAT16_BOOT_SECTOR BootSector,
               IN OUT PFORMAT_CONTEXT Context)
 {
-    IO_STATUS_BLOCK IoStatusBlock;
-    NTSTATUS Status;
-    PUCHAR Buffer;
-    LARGE_INTEGER FileOffset;
-    ULONG i;
-    ULONG Size;
-    ULONG Sectors;
-
-    /* Allocate buffer */
-    Buffer = (PUCHAR)RtlAllocateHeap(RtlGetProcessHeap(),
-                                     0,
-                                     32 * 1024);
-    if (Buffer == NULL)
-        return STATUS_INSUFFICIENT_RESOURCES;
-
-    /* Zero the buffer */
-    RtlZeroMemory(Buffer, 32 * 1024);
+    UCHAR Header[3];
 
     /* FAT cluster 0 & 1*/
-    Buffer[0] = 0xf8; /* Media type */
-    Buffer[1] = 0xff;
-    Buffer[2] = 0xff;
-
-    /* Write first sector of the FAT */
-    FileOffset.QuadPart = (SectorOffset + BootSector->ReservedSectors) * BootSector->BytesPerSector;
-    Status = NtWriteFile(FileHandle,
-                         NULL,
-                         NULL,
-                         NULL,
-                         &IoStatusBlock,
-                         Buffer,
-                         BootSector->BytesPerSector,
-                         &FileOffset,
-                         NULL);
-    if (!NT_SUCCESS(Status))
-    {
-        DPRINT("NtWriteFile() failed (Status %lx)\n", Status);
-        goto done;
-    }
-
-    UpdateProgress(Context, 1);
-
-    /* Zero the begin of the buffer */
-    RtlZeroMemory(Buffer, 3);
-
-    /* Zero the rest of the FAT */
-    Sectors = 32 * 1024 / BootSector->BytesPerSector;
-    for (i = 1; i < (ULONG)BootSector->FATSectors; i += Sectors)
-    {
-        /* Zero some sectors of the FAT */
-        FileOffset.QuadPart = (SectorOffset + BootSector->ReservedSectors + i) * BootSector->BytesPerSector;
-        if (((ULONG)BootSector->FATSectors - i) <= Sectors)
-        {
-            Sectors = (ULONG)BootSector->FATSectors - i;
-        }
-
-        Size = Sectors * BootSector->BytesPerSector;
-        Status = NtWriteFile(FileHandle,
-                             NULL,
-                             NULL,
-                             NULL,
-                             &IoStatusBlock,
-                             Buffer,
-                             Size,
-                             &FileOffset,
-                             NULL);
-        if (!NT_SUCCESS(Status))
-        {
-            DPRINT("NtWriteFile() failed (Status %lx)\n", Status);
-            goto done;
-        }
-
-        UpdateProgress(Context, Sectors);
-    }
-
-done:
-    /* Free the buffer */
-    RtlFreeHeap(RtlGetProcessHeap(), 0, Buffer);
-    return Status;
+    Header[0] = 0xf8; /* Media type */
+    Header[1] = 0xff;
+    Header[2] = 0xff;
+
+    return FatWriteFAT(FileHandle,
+                       SectorOffset + BootSector->ReservedSectors,
+                       (ULONG)BootSector->FATSectors,
+                       BootSector->BytesPerSector,
+                       Header,
+                       sizeof(Header),
+                       Context);
 }
 
 
@@ -225,97 +225,33 @@ Fat32WriteFAT(IN HANDLE FileHandle,
               IN PFAT32_BOOT_SECTOR BootSector,
               IN OUT PFORMAT_CONTEXT Context)
 {
-    IO_STATUS_BLOCK IoStatusBlock;
-    NTSTATUS Status;
-    PUCHAR Buffer;
-    LARGE_INTEGER FileOffset;
-    ULONG i;
-    ULONG Sectors;
-
-    /* Allocate buffer */
-    Buffer = (PUCHAR)RtlAllocateHeap(RtlGetProcessHeap(),
-                                     0,
-                                     64 * 1024);
-    if (Buffer == NULL)
-        return STATUS_INSUFFICIENT_RESOURCES;
-
-    /* Zero the buffer */
-    RtlZeroMemory(Buffer, 64 * 1024);
+    UCHAR Header[12];
 
     /* FAT cluster 0 */
-    Buffer[0] = 0xf8; /* Media type */
-    Buffer[1] = 0xff;
-    Buffer[2] = 0xff;
-    Buffer[3] = 0x0f;
+    Header[0] = 0xf8; /* Media type */
+    Header[1] = 0xff;
+    Header[2] = 0xff;
+    Header[3] = 0x0f;
 
     /* FAT cluster 1 */
-    Buffer[4] = 0xff; /* Clean shutdown, no disk read/write errors, end-of-cluster (EOC) mark */
-    Buffer[5] = 0xff;
-    Buffer[6] = 0xff;
-    Buffer[7] = 0x0f;
+    Header[4] = 0xff; /* Clean shutdown, no disk read/write errors, end-of-cluster (EOC) mark */
+    Header[5] = 0xff;
+    Header[6] = 0xff;
+    Header[7] = 0x0f;
 
     /* FAT cluster 2 */
-    Buffer[8] = 0xff; /* End of root directory */
-    Buffer[9] = 0xff;
-    Buffer[10] = 0xff;
-    Buffer[11] = 0x0f;
-
-    /* Write first sector of the FAT */
-    FileOffset.QuadPart = (SectorOffset + BootSector->ReservedSectors) * BootSector->BytesPerSector;
-    Status = NtWriteFile(FileHandle,
-                         NULL,
-                         NULL,
-                         NULL,
-                         &IoStatusBlock,
-                         Buffer,
-                         BootSector->BytesPerSector,
-                         &FileOffset,
-                         NULL);
-    if (!NT_SUCCESS(Status))
-    {
-        DPRINT("NtWriteFile() failed (Status %lx)\n", Status);
-        goto done;
-    }
-
-    UpdateProgress(Context, 1);
-
-    /* Zero the begin of the buffer */
-    RtlZeroMemory(Buffer, 12);
-
-    /* Zero the rest of the FAT */
-    Sectors = 64 * 1024 / BootSector->BytesPerSector;
-    for (i = 1; i < BootSector->FATSectors32; i += Sectors)
-    {
-        /* Zero some sectors of the FAT */
-        FileOffset.QuadPart = (SectorOffset + BootSector->ReservedSectors + i) * BootSector->BytesPerSector;
-
-        if ((BootSector->FATSectors32 - i) <= Sectors)
-        {
-            Sectors = BootSector->FATSectors32 - i;
-        }
-
-        Status = NtWriteFile(FileHandle,
-                             NULL,
-                             NULL,
-                             NULL,
-                             &IoStatusBlock,
-                             Buffer,
-                             Sectors * BootSector->BytesPerSector,
-                             &FileOffset,
-                             NULL);
-        if (!NT_SUCCESS(Status))
-        {
-            DPRINT("NtWriteFile() failed (Status %lx)\n", Status);
-            goto done;
-        }
-
-        UpdateProgress(Context, Sectors);
-    }
-
-done:
-    /* Free the buffer */
-    RtlFreeHeap(RtlGetProcessHeap(), 0, Buffer);
-    return Status;
+    Header[8] = 0xff; /* End of root directory */
+    Header[9] = 0xff;
+    Header[10] = 0xff;
+    Header[11] = 0x0f;
+
+    return FatWriteFAT(FileHandle,
+                       SectorOffset + BootSector->ReservedSectors,
+                       BootSector->FATSectors32,
+                       BootSector->BytesPerSector,
+                       Header,
+                       sizeof(Header),
+                       Context);
 }
 
 
@@ -466,6 +466,9 @@ VfatChkdsk(IN PUNICODE_STRING DriveRoot,
         qfree(&FsCheckMemQueue);
     }
 
+    /* Write the FAT entries changed by the passes */
+    flush_fat(&fs);
+
     if (fs_changed())
     {
         if (FsCheckFlags & FSCHECK_READ_WRITE)
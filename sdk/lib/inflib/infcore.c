@@ -133,12 +133,34 @@ InfpFreeSection (PINFCACHESECTION Section)
     }
   Section->LastLine = NULL;
 
+  if (Section->KeyHash != NULL)
+    {
+      FREE (Section->KeyHash);
+      Section->KeyHash = NULL;
+    }
+
   FREE (Section);
 
   return Next;
 }
 
 
+/* case-insensitive hash of a section or key name */
+static ULONG
+InfpHashName(PCWSTR Name)
+{
+  ULONG Hash = 0;
+
+  while (*Name != 0)
+    {
+      Hash = Hash * 31 + tolowerW(*Name);
+      Name++;
+    }
+
+  return Hash;
+}
+
+
 PINFCACHESECTION
 InfpFindSection(PINFCACHE Cache,
                 PCWSTR Name)
@@ -150,8 +172,8 @@ InfpFindSection(PINFCACHE Cache,
       return NULL;
     }
 
-  /* iterate through list of sections */
-  Section = Cache->FirstSection;
+  /* iterate through the hash bucket of the section name */
+  Section = Cache->SectionHash[InfpHashName(Name) % INF_SECTION_HASH_SIZE];
   while (Section != NULL)
     {
       if (strcmpiW(Section->Name, Name) == 0)
@@ -159,8 +181,8 @@ InfpFindSection(PINFCACHE Cache,
           return Section;
         }
 
-      /* get the next section*/
-      Section = Section->Next;
+      /* get the next section in the bucket */
+      Section = Section->HashNext;
     }
 
   return NULL;
@@ -173,6 +195,7 @@ InfpAddSection(PINFCACHE Cache,
 {
   PINFCACHESECTION Section = NULL;
   ULONG Size;
+  ULONG Bucket;
 
   if (Cache == NULL || Name == NULL)
     {
@@ -195,6 +218,11 @@ InfpAddSection(PINFCACHE Cache,
   /* Copy section name */
   strcpyW(Section->Name, Name);
 
+  /* Insert section into the hash bucket of its name */
+  Bucket = InfpHashName(Name) % INF_SECTION_HASH_SIZE;
+  Section->HashNext = Cache->SectionHash[Bucket];
+  Cache->SectionHash[Bucket] = Section;
+
   /* Append section */
   if (Cache->FirstSection == NULL)
     {
@@ -250,11 +278,76 @@ InfpAddLine(PINFCACHESECTION Section)
 }
 
 
+/* insert a line into the key hash of a section, unless an earlier line
+   with the same key is already there */
+static VOID
+InfpHashKeyLine(PINFCACHELINE *KeyHash,
+                ULONG KeyHashSize,
+                PINFCACHELINE Line)
+{
+  PINFCACHELINE *Bucket;
+  PINFCACHELINE Entry;
+
+  Bucket = &KeyHash[InfpHashName(Line->Key) & (KeyHashSize - 1)];
+  for (Entry = *Bucket; Entry != NULL; Entry = Entry->HashNext)
+    {
+      if (strcmpiW(Entry->Key, Line->Key) == 0)
+        {
+          return;
+        }
+    }
+
+  Line->HashNext = *Bucket;
+  *Bucket = Line;
+}
+
+
+/* (re)build the key hash of a section once it has grown large enough */
+static BOOLEAN
+InfpGrowKeyHash(PINFCACHESECTION Section)
+{
+  PINFCACHELINE *KeyHash;
+  PINFCACHELINE Line;
+  ULONG KeyHashSize;
+
+  KeyHashSize = (Section->KeyHashSize != 0) ? Section->KeyHashSize * 2 : INF_KEY_HASH_MIN * 2;
+  KeyHash = (PINFCACHELINE *)MALLOC(KeyHashSize * sizeof(PINFCACHELINE));
+  if (KeyHash == NULL)
+    {
+      /* Not fatal, lookups keep using the current hash or the line list */
+      DPRINT("MALLOC() failed\n");
+      return FALSE;
+    }
+  ZEROMEMORY(KeyHash,
+             KeyHashSize * sizeof(PINFCACHELINE));
+
+  /* Walk the lines in order, so the first line of each key is hashed */
+  for (Line = Section->FirstLine; Line != NULL; Line = Line->Next)
+    {
+      Line->HashNext = NULL;
+      if (Line->Key != NULL)
+        {
+          InfpHashKeyLine(KeyHash, KeyHashSize, Line);
+        }
+    }
+
+  if (Section->KeyHash != NULL)
+    {
+      FREE(Section->KeyHash);
+    }
+  Section->KeyHash = KeyHash;
+  Section->KeyHashSize = KeyHashSize;
+
+  return TRUE;
+}
+
+
 PVOID
-InfpAddKeyToLine(PINFCACHELINE Line,
+InfpAddKeyToLine(PINFCACHESECTION Section,
+                 PINFCACHELINE Line,
                  PCWSTR Key)
 {
-  if (Line == NULL)
+  if (Section == NULL || Line == NULL)
     {
       DPRINT1("Invalid Line\n");
       return NULL;
@@ -275,6 +368,19 @@ InfpAddKeyToLine(PINFCACHELINE Line,
 
   strcpyW(Line->Key, Key);
 
+  /* Keep the key hash in sync, growing it when the chains get long */
+  Section->KeyCount++;
+  if (Section->KeyCount >= INF_KEY_HASH_MIN &&
+      Section->KeyCount > Section->KeyHashSize &&
+      InfpGrowKeyHash(Section))
+    {
+      /* The new line has been hashed along with the others */
+    }
+  else if (Section->KeyHash != NULL)
+    {
+      InfpHashKeyLine(Section->KeyHash, Section->KeyHashSize, Line);
+    }
+
   return (PVOID)Line->Key;
 }
 
@@ -322,6 +428,22 @@ InfpFindKeyLine(PINFCACHESECTION Section,
 {
   PINFCACHELINE Line;
 
+  if (Section->KeyHash != NULL)
+    {
+      Line = Section->KeyHash[InfpHashName(Key) & (Section->KeyHashSize - 1)];
+      while (Line != NULL)
+        {
+          if (strcmpiW(Line->Key, Key) == 0)
+            {
+              return Line;
+            }
+
+          Line = Line->HashNext;
+        }
+
+      return NULL;
+    }
+
   Line = Section->FirstLine;
   while (Line != NULL)
     {
@@ -467,7 +589,7 @@ static struct field *add_field_from_token( struct parser *parser, int is_key )
 
   if (is_key)
     {
-      field = InfpAddKeyToLine(parser->line, parser->token);
+      field = InfpAddKeyToLine(parser->cur_section, parser->line, parser->token);
     }
   else
     {
@@ -18,6 +18,9 @@
 #define INF_STATUS_WRONG_INF_STYLE         ((INFSTATUS)0xC0700003)
 #define INF_STATUS_NOT_ENOUGH_MEMORY       ((INFSTATUS)0xC0700004)
 
+#define INF_SECTION_HASH_SIZE  1024  /* number of section hash buckets */
+#define INF_KEY_HASH_MIN       16    /* keyed lines before a section gets a key hash */
+
 typedef struct _INFCACHEFIELD
 {
   struct _INFCACHEFIELD *Next;
@@ -30,6 +33,7 @@ typedef struct _INFCACHELINE
 {
   struct _INFCACHELINE *Next;
   struct _INFCACHELINE *Prev;
+  struct _INFCACHELINE *HashNext;
 
   LONG FieldCount;
 
@@ -44,12 +48,17 @@ typedef struct _INFCACHESECTION
 {
   struct _INFCACHESECTION *Next;
   struct _INFCACHESECTION *Prev;
+  struct _INFCACHESECTION *HashNext;
 
   PINFCACHELINE FirstLine;
   PINFCACHELINE LastLine;
 
   LONG LineCount;
 
+  PINFCACHELINE *KeyHash;   /* first line of each key, NULL for small sections */
+  ULONG KeyHashSize;
+  ULONG KeyCount;
+
   WCHAR Name[1];
 } INFCACHESECTION, *PINFCACHESECTION;
 
@@ -60,6 +69,8 @@ typedef struct _INFCACHE
   PINFCACHESECTION LastSection;
 
   PINFCACHESECTION StringsSection;
+
+  PINFCACHESECTION SectionHash[INF_SECTION_HASH_SIZE];
 } INFCACHE, *PINFCACHE;
 
 typedef struct _INFCONTEXT
@@ -82,7 +93,8 @@ extern PINFCACHESECTION InfpFreeSection(PINFCACHESECTION Section);
 extern PINFCACHESECTION InfpAddSection(PINFCACHE Cache,
                                        PCWSTR Name);
 extern PINFCACHELINE InfpAddLine(PINFCACHESECTION Section);
-extern PVOID InfpAddKeyToLine(PINFCACHELINE Line,
+extern PVOID InfpAddKeyToLine(PINFCACHESECTION Section,
+                              PINFCACHELINE Line,
                               PCWSTR Key);
 extern PVOID InfpAddFieldToLine(PINFCACHELINE Line,
                                 PCWSTR Data);
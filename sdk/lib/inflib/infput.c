@@ -234,7 +234,7 @@ InfpAddLineWithKey(PINFCONTEXT Context, PCWSTR Key)
       return INF_STATUS_NO_MEMORY;
     }
 
-  if (NULL != Key && NULL == InfpAddKeyToLine(Context->Line, Key))
+  if (NULL != Key && NULL == InfpAddKeyToLine(Context->Section, Context->Line, Key))
     {
       DPRINT("Failed to add key\n");
       return INF_STATUS_NO_MEMORY;
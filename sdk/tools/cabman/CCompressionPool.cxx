@@ -0,0 +1,306 @@
+/*
+ * PROJECT:     ReactOS cabinet manager
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     CCompressionPool class implementation
+ * NOTES:       CFDATA blocks are compressed independently of each other,
+ *              so they can be handed to several workers as long as they are
+ *              written out in the order they were queued. Every worker owns
+ *              its codec instance, which keeps the output byte-identical to
+ *              compressing the blocks one after another.
+ */
+
+#include "CCompressionPool.h"
+#include "raw.h"
+#include "mszip.h"
+
+#if !defined(CAB_READ_ONLY)
+
+/**
+* @name CCompressionPool class
+* @implemented
+*
+* Default constructor
+*/
+CCompressionPool::CCompressionPool()
+{
+    MaxInFlight = 0;
+    Stopping = false;
+}
+
+/**
+* @name CCompressionPool class
+* @implemented
+*
+* Default destructor
+*/
+CCompressionPool::~CCompressionPool()
+{
+    Destroy();
+}
+
+/**
+* @name CCompressionPool class
+* @implemented
+*
+* Creates a codec instance for a worker
+*
+* @param CodecId
+* Codec identifier
+*
+* @return
+* Pointer to the codec, NULL if the codec is not supported
+*/
+CCABCodec* CCompressionPool::NewCodec(LONG CodecId)
+{
+    switch (CodecId)
+    {
+        case CAB_CODEC_RAW:
+            return new CRawCodec();
+
+        case CAB_CODEC_MSZIP:
+            return new CMSZipCodec();
+
+        default:
+            return NULL;
+    }
+}
+
+/**
+* @name CCompressionPool class
+* @implemented
+*
+* Starts the worker threads
+*
+* @param CodecId
+* Codec to compress the blocks with
+*
+* @param WorkerCount
+* Number of worker threads
+*
+* @return
+* Status of operation
+*/
+ULONG CCompressionPool::Create(LONG CodecId, ULONG WorkerCount)
+{
+    CCABCodec* Codec;
+    ULONG i;
+
+    ASSERT(Workers.empty());
+
+    Stopping = false;
+
+    /* Keep a few blocks per worker queued, but bound the memory we use */
+    MaxInFlight = WorkerCount * 4;
+
+    for (i = 0; i < WorkerCount; i++)
+    {
+        Codec = NewCodec(CodecId);
+        if (!Codec)
+        {
+            Destroy();
+            return CAB_STATUS_UNSUPPCOMP;
+        }
+        Codecs.push_back(Codec);
+
+        try
+        {
+            Workers.push_back(std::thread(&CCompressionPool::Worker, this, Codec));
+        }
+        catch (...)
+        {
+            DPRINT(MIN_TRACE, ("Cannot create compression worker.\n"));
+            Destroy();
+            return CAB_STATUS_NOMEMORY;
+        }
+    }
+
+    return CAB_STATUS_SUCCESS;
+}
+
+/**
+* @name CCompressionPool class
+* @implemented
+*
+* Stops the worker threads and frees all blocks that were not returned
+*/
+void CCompressionPool::Destroy()
+{
+    std::vector<CCABCodec*>::iterator Codec;
+    std::vector<std::thread>::iterator Thread;
+
+    {
+        std::lock_guard<std::mutex> Guard(Lock);
+        Stopping = true;
+    }
+    WorkAvailable.notify_all();
+
+    for (Thread = Workers.begin(); Thread != Workers.end(); Thread++)
+        Thread->join();
+    Workers.clear();
+
+    for (Codec = Codecs.begin(); Codec != Codecs.end(); Codec++)
+        delete *Codec;
+    Codecs.clear();
+
+    Pending.clear();
+    while (!InOrder.empty())
+    {
+        Release(InOrder.front());
+        InOrder.pop_front();
+    }
+}
+
+/**
+* @name CCompressionPool class
+* @implemented
+*
+* Queues a block for compression. Waits if too many blocks are in flight.
+*
+* @param InputBuffer
+* Buffer with the data to compress, CAB_BLOCKSIZE + 12 bytes large.
+* The pool takes ownership of it.
+*
+* @param InputLength
+* Number of bytes to compress
+*
+* @param Context
+* Caller data returned with the compressed block
+*
+* @return
+* Status of operation
+*/
+ULONG CCompressionPool::Submit(void* InputBuffer, ULONG InputLength, void* Context)
+{
+    PCOMPRESSION_JOB Job;
+
+    Job = (PCOMPRESSION_JOB)malloc(sizeof(COMPRESSION_JOB));
+    if (!Job)
+        return CAB_STATUS_NOMEMORY;
+
+    Job->InputBuffer  = InputBuffer;
+    Job->InputLength  = InputLength;
+    Job->OutputBuffer = malloc(CAB_BLOCKSIZE + 12); // This should be enough
+    Job->OutputLength = 0;
+    Job->Status       = CS_SUCCESS;
+    Job->Context      = Context;
+    Job->Done         = false;
+    if (!Job->OutputBuffer)
+    {
+        free(Job);
+        return CAB_STATUS_NOMEMORY;
+    }
+
+    std::unique_lock<std::mutex> Guard(Lock);
+
+    /* The caller has to collect the completed blocks to make room */
+    ASSERT(InOrder.size() < MaxInFlight);
+
+    Pending.push_back(Job);
+    InOrder.push_back(Job);
+    Guard.unlock();
+
+    WorkAvailable.notify_one();
+
+    return CAB_STATUS_SUCCESS;
+}
+
+/**
+* @name CCompressionPool class
+* @implemented
+*
+* Returns the oldest block once it is compressed
+*
+* @param Wait
+* true to wait for the oldest block if it is still being compressed.
+* Also true if the maximum number of blocks is in flight, so the caller
+* can always queue the next block after this returned.
+*
+* @return
+* Pointer to the block, NULL if no blocks are queued, or the oldest
+* one is not ready and Wait is false
+*/
+PCOMPRESSION_JOB CCompressionPool::GetCompleted(bool Wait)
+{
+    PCOMPRESSION_JOB Job;
+
+    std::unique_lock<std::mutex> Guard(Lock);
+
+    if (InOrder.empty())
+        return NULL;
+
+    if (Wait || InOrder.size() >= MaxInFlight)
+    {
+        while (!InOrder.front()->Done)
+            JobDone.wait(Guard);
+    }
+    else if (!InOrder.front()->Done)
+    {
+        return NULL;
+    }
+
+    Job = InOrder.front();
+    InOrder.pop_front();
+
+    return Job;
+}
+
+/**
+* @name CCompressionPool class
+* @implemented
+*
+* Frees a block returned by GetCompleted
+*
+* @param Job
+* Pointer to the block
+*/
+void CCompressionPool::Release(PCOMPRESSION_JOB Job)
+{
+    free(Job->InputBuffer);
+    free(Job->OutputBuffer);
+    free(Job);
+}
+
+/**
+* @name CCompressionPool class
+* @implemented
+*
+* Worker thread, compresses the queued blocks until the pool is destroyed
+*
+* @param Codec
+* Codec instance owned by this worker
+*/
+void CCompressionPool::Worker(CCABCodec* Codec)
+{
+    PCOMPRESSION_JOB Job;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> Guard(Lock);
+
+            while (Pending.empty() && !Stopping)
+                WorkAvailable.wait(Guard);
+
+            if (Stopping)
+                return;
+
+            Job = Pending.front();
+            Pending.pop_front();
+        }
+
+        Job->Status = Codec->Compress(Job->OutputBuffer,
+                                      Job->InputBuffer,
+                                      Job->InputLength,
+                                      &Job->OutputLength);
+
+        {
+            std::lock_guard<std::mutex> Guard(Lock);
+            Job->Done = true;
+        }
+        JobDone.notify_all();
+    }
+}
+
+#endif /* CAB_READ_ONLY */
+
+/* EOF */
@@ -0,0 +1,64 @@
+/*
+ * PROJECT:     ReactOS cabinet manager
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Worker pool compressing CFDATA blocks in parallel
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cabinet.h"
+
+#ifndef CAB_READ_ONLY
+
+typedef struct _COMPRESSION_JOB
+{
+    void* InputBuffer;          // Uncompressed data, CAB_BLOCKSIZE + 12 bytes
+    ULONG InputLength;
+    void* OutputBuffer;         // Compressed data, CAB_BLOCKSIZE + 12 bytes
+    ULONG OutputLength;
+    ULONG Status;               // Codec status
+    void* Context;              // Caller data, handed back with the block
+    bool Done;
+} COMPRESSION_JOB, *PCOMPRESSION_JOB;
+
+class CCompressionPool
+{
+public:
+    /* Default constructor */
+    CCompressionPool();
+    /* Default destructor */
+    virtual ~CCompressionPool();
+    /* Starts the worker threads, each with its own codec instance */
+    ULONG Create(LONG CodecId, ULONG WorkerCount);
+    /* Stops the worker threads and frees all blocks */
+    void Destroy();
+    /* Queues a block for compression, taking ownership of InputBuffer */
+    ULONG Submit(void* InputBuffer, ULONG InputLength, void* Context);
+    /* Returns the oldest queued block once it is compressed */
+    PCOMPRESSION_JOB GetCompleted(bool Wait);
+    /* Frees a block returned by GetCompleted */
+    void Release(PCOMPRESSION_JOB Job);
+private:
+    static CCABCodec* NewCodec(LONG CodecId);
+    void Worker(CCABCodec* Codec);
+
+    std::mutex Lock;
+    std::condition_variable WorkAvailable;  // Signalled when a block is queued
+    std::condition_variable JobDone;        // Signalled when a block is compressed
+    std::deque<PCOMPRESSION_JOB> Pending;   // Blocks waiting for a worker
+    std::deque<PCOMPRESSION_JOB> InOrder;   // All blocks not yet returned, in submission order
+    std::vector<std::thread> Workers;
+    std::vector<CCABCodec*> Codecs;
+    ULONG MaxInFlight;
+    bool Stopping;
+};
+
+#endif /* CAB_READ_ONLY */
+
+/* EOF */
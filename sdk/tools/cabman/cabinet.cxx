@@ -26,6 +26,7 @@
 #include "cabinet.h"
 #include "raw.h"
 #include "mszip.h"
+#include "CCompressionPool.h"
 
 #ifndef CAB_READ_ONLY
 
@@ -100,6 +101,8 @@ CCabinet::CCabinet()
     MaxDiskSize  = 0;
     BlockIsSplit = false;
     ScratchFile  = NULL;
+    CompressionThreads = 1;
+    CompressionPool    = NULL;
 
     FolderUncompSize = 0;
     BytesLeftInBlock = 0;
@@ -1165,6 +1168,18 @@ ULONG CCabinet::NewCabinet()
     CurrentIBuffer     = InputBuffer;
     CurrentIBufferSize = 0;
 
+    if (CompressionThreads > 1)
+    {
+        /* Not fatal, the blocks are compressed one by one then */
+        CompressionPool = new CCompressionPool();
+        if (CompressionPool->Create(CodecId, CompressionThreads) != CAB_STATUS_SUCCESS)
+        {
+            DPRINT(MIN_TRACE, ("Cannot create compression threads.\n"));
+            delete CompressionPool;
+            CompressionPool = NULL;
+        }
+    }
+
     CABHeader.Signature     = CAB_SIGNATURE;
     CABHeader.Reserved1     = 0;            // Not used
     CABHeader.CabinetSize   = 0;            // Not yet known
@@ -1246,8 +1261,15 @@ ULONG CCabinet::NewFolder()
  *     Status of operation
  */
 {
+    ULONG Status;
+
     DPRINT(MAX_TRACE, ("Creating new folder.\n"));
 
+    /* Blocks still being compressed belong to the previous folder */
+    Status = WriteCompressedBlocks(true);
+    if (Status != CAB_STATUS_SUCCESS)
+        return Status;
+
     CurrentFolderNode = NewFolderNode();
     if (!CurrentFolderNode)
     {
@@ -1425,6 +1447,9 @@ ULONG CCabinet::WriteDisk(ULONG MoreDisks)
             while (CreateNewDisk)
             {
                 DPRINT(MAX_TRACE, ("Creating new disk.\n"));
+                Status = WriteCompressedBlocks(true);
+                if (Status != CAB_STATUS_SUCCESS)
+                    return Status;
                 CommitDisk(true);
                 CloseDisk();
                 NewDisk();
@@ -1462,6 +1487,9 @@ ULONG CCabinet::WriteDisk(ULONG MoreDisks)
             if (CreateNewDisk)
             {
                 DPRINT(MID_TRACE, ("Creating new disk 2.\n"));
+                Status = WriteCompressedBlocks(true);
+                if (Status != CAB_STATUS_SUCCESS)
+                    return Status;
                 CommitDisk(true);
                 CloseDisk();
                 NewDisk();
@@ -1478,6 +1506,11 @@ ULONG CCabinet::WriteDisk(ULONG MoreDisks)
             }
         } while (CreateNewDisk);
     }
+
+    Status = WriteCompressedBlocks(true);
+    if (Status != CAB_STATUS_SUCCESS)
+        return Status;
+
     CommitDisk(MoreDisks);
 
     return CAB_STATUS_SUCCESS;
@@ -1580,6 +1613,12 @@ ULONG CCabinet::CloseCabinet()
 {
     ULONG Status;
 
+    if (CompressionPool)
+    {
+        delete CompressionPool;
+        CompressionPool = NULL;
+    }
+
     DestroyFileNodes();
 
     DestroyFolderNodes();
@@ -1837,6 +1876,19 @@ void CCabinet::SetMaxDiskSize(ULONG Size)
     MaxDiskSize = Size;
 }
 
+void CCabinet::SetCompressionThreads(ULONG Count)
+/*
+ * FUNCTION: Sets the number of threads compressing data blocks
+ * ARGUMENTS:
+ *     Count = Number of threads (1 compresses the blocks in the calling thread)
+ * NOTES:
+ *     Must be called before the cabinet is created. Cabinets spanning
+ *     several disks are always compressed in the calling thread.
+ */
+{
+    CompressionThreads = (Count > 0) ? Count : 1;
+}
+
 #endif /* CAB_READ_ONLY */
 
 
@@ -2984,6 +3036,34 @@ ULONG CCabinet::WriteDataBlock()
     ULONG BytesWritten;
     PCFDATA_NODE DataNode;
 
+    if (CompressionPool && MaxDiskSize == 0)
+    {
+        /* Hand the block to the compression threads and continue
+           filling a new input buffer meanwhile */
+        Status = CompressionPool->Submit(InputBuffer,
+            CurrentIBufferSize,
+            CurrentFolderNode);
+        if (Status != CAB_STATUS_SUCCESS)
+            return Status;
+
+        InputBuffer = malloc(CAB_BLOCKSIZE + 12); // This should be enough
+        if (!InputBuffer)
+        {
+            DPRINT(MIN_TRACE, ("Insufficient memory.\n"));
+            return CAB_STATUS_NOMEMORY;
+        }
+        CurrentIBufferSize = 0;
+        CurrentIBuffer     = InputBuffer;
+
+        /* Store the blocks which are done already */
+        return WriteCompressedBlocks(false);
+    }
+
+    /* Blocks must be stored in order */
+    Status = WriteCompressedBlocks(true);
+    if (Status != CAB_STATUS_SUCCESS)
+        return Status;
+
     if (!BlockIsSplit)
     {
         Status = Codec->Compress(OutputBuffer,
@@ -3060,6 +3140,96 @@ ULONG CCabinet::WriteDataBlock()
     return CAB_STATUS_SUCCESS;
 }
 
+
+ULONG CCabinet::StoreDataBlock(PCFFOLDER_NODE FolderNode,
+                               void* Buffer,
+                               ULONG CompSize,
+                               ULONG UncompSize)
+/*
+ * FUNCTION: Writes a compressed data block to the scratch file
+ * ARGUMENTS:
+ *     FolderNode = Pointer to folder node the block belongs to
+ *     Buffer     = Pointer to buffer with compressed data
+ *     CompSize   = Size of compressed data
+ *     UncompSize = Size of uncompressed data
+ * RETURNS:
+ *     Status of operation
+ * NOTES:
+ *     Only used when the disk size is not limited, so blocks are never split
+ */
+{
+    ULONG Status;
+    ULONG BytesWritten;
+    PCFDATA_NODE DataNode;
+
+    DataNode = NewDataNode(FolderNode);
+    if (!DataNode)
+    {
+        DPRINT(MIN_TRACE, ("Insufficient memory.\n"));
+        return CAB_STATUS_NOMEMORY;
+    }
+
+    DiskSize += sizeof(CFDATA);
+
+    DataNode->Data.CompSize   = (USHORT)CompSize;
+    DataNode->Data.UncompSize = (USHORT)UncompSize;
+    DataNode->Data.Checksum   = 0;
+    DataNode->ScratchFilePosition = ScratchFile->Position();
+
+    DPRINT(MAX_TRACE, ("Writing block. Checksum (0x%X)  CompSize (%u)  UncompSize (%u).\n",
+        (UINT)DataNode->Data.Checksum,
+        DataNode->Data.CompSize,
+        DataNode->Data.UncompSize));
+
+    Status = ScratchFile->WriteBlock(&DataNode->Data,
+        Buffer, &BytesWritten);
+    if (Status != CAB_STATUS_SUCCESS)
+        return Status;
+
+    DiskSize += BytesWritten;
+
+    FolderNode->TotalFolderSize += (BytesWritten + sizeof(CFDATA));
+    FolderNode->Folder.DataBlockCount++;
+
+    LastBlockStart += DataNode->Data.UncompSize;
+
+    return CAB_STATUS_SUCCESS;
+}
+
+
+ULONG CCabinet::WriteCompressedBlocks(bool Wait)
+/*
+ * FUNCTION: Writes blocks compressed by the compression threads to the
+ *           scratch file, in the order they were queued
+ * ARGUMENTS:
+ *     Wait = true to wait until all queued blocks are written
+ * RETURNS:
+ *     Status of operation
+ */
+{
+    PCOMPRESSION_JOB Job;
+    ULONG Status = CAB_STATUS_SUCCESS;
+
+    if (!CompressionPool)
+        return CAB_STATUS_SUCCESS;
+
+    while ((Job = CompressionPool->GetCompleted(Wait)) != NULL)
+    {
+        DPRINT(MAX_TRACE, ("Block compressed. InputLength (%u)  OutputLength(%u).\n",
+            (UINT)Job->InputLength, (UINT)Job->OutputLength));
+
+        Status = StoreDataBlock((PCFFOLDER_NODE)Job->Context,
+            Job->OutputBuffer,
+            Job->OutputLength,
+            Job->InputLength);
+        CompressionPool->Release(Job);
+        if (Status != CAB_STATUS_SUCCESS)
+            break;
+    }
+
+    return Status;
+}
+
 #if !defined(_WIN32)
 
 void CCabinet::ConvertDateAndTime(time_t* Time,
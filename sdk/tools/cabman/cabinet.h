@@ -297,6 +297,8 @@ public:
 
 #ifndef CAB_READ_ONLY
 
+class CCompressionPool;
+
 class CCFDATAStorage
 {
 public:
@@ -395,6 +397,8 @@ public:
     ULONG AddFile(char* FileName);
     /* Sets the maximum size of the current disk */
     void SetMaxDiskSize(ULONG Size);
+    /* Sets the number of threads compressing data blocks */
+    void SetCompressionThreads(ULONG Count);
 #endif /* CAB_READ_ONLY */
 
     /* Default event handlers */
@@ -438,6 +442,8 @@ private:
     ULONG WriteFileEntries();
     ULONG CommitDataBlocks(PCFFOLDER_NODE FolderNode);
     ULONG WriteDataBlock();
+    ULONG StoreDataBlock(PCFFOLDER_NODE FolderNode, void* Buffer, ULONG CompSize, ULONG UncompSize);
+    ULONG WriteCompressedBlocks(bool Wait);
     ULONG GetAttributesOnFile(PCFFILE_NODE File);
     ULONG SetAttributesOnFile(char* FileName, USHORT FileAttributes);
     ULONG GetFileTimes(FILE* FileHandle, PCFFILE_NODE File);
@@ -503,6 +509,8 @@ private:
     ULONG TotalBytesLeft;
     bool BlockIsSplit;                  // true if current data block is split
     ULONG NextFolderNumber;     // Zero based folder number
+    ULONG CompressionThreads;   // Number of threads compressing data blocks
+    CCompressionPool *CompressionPool;  // Compresses data blocks in parallel
 #endif /* CAB_READ_ONLY */
 };
 
@@ -14,6 +14,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <stdio.h>
+#include <thread>
 #include "cabman.h"
 
 
@@ -192,8 +193,8 @@ void CCABManager::Usage()
 {
     printf("ReactOS Cabinet Manager\n\n");
     printf("CABMAN [-D | -E] [-A] [-L dir] cabinet [filename ...]\n");
-    printf("CABMAN [-M mode] -C dirfile [-I] [-RC file] [-P dir]\n");
-    printf("CABMAN [-M mode] -S cabinet filename [...]\n");
+    printf("CABMAN [-M mode] [-J threads] -C dirfile [-I] [-RC file] [-P dir]\n");
+    printf("CABMAN [-M mode] [-J threads] -S cabinet filename [...]\n");
     printf("  cabinet   Cabinet file.\n");
     printf("  filename  Name of the file to add to or extract from the cabinet.\n");
     printf("            Wild cards and multiple filenames\n");
@@ -207,6 +208,8 @@ void CCABManager::Usage()
     printf("  -D        Display cabinet directory.\n");
     printf("  -E        Extract files from cabinet.\n");
     printf("  -I        Don't create the cabinet, only the .inf file.\n");
+    printf("  -J threads Number of threads compressing data blocks\n");
+    printf("            (default is the number of processors).\n");
     printf("  -L dir    Location to place extracted or generated files\n");
     printf("            (default is current directory).\n");
     printf("  -M mode   Specify the compression method to use:\n");
@@ -236,6 +239,9 @@ bool CCABManager::ParseCmdline(int argc, char* argv[])
 
     ShowUsage = (argc < 2);
 
+    // Compress on all processors unless told otherwise, the output is the same
+    SetCompressionThreads(std::thread::hardware_concurrency());
+
     for (i = 1; i < argc; i++)
     {
         if (argv[i][0] == '-')
@@ -267,6 +273,18 @@ bool CCABManager::ParseCmdline(int argc, char* argv[])
                     InfFileOnly = true;
                     break;
 
+                case 'j':
+                case 'J':
+                    if (argv[i][2] == 0)
+                    {
+                        i++;
+                        SetCompressionThreads(atoi(&argv[i][0]));
+                    }
+                    else
+                        SetCompressionThreads(atoi(&argv[i][2]));
+
+                    break;
+
                 case 'l':
                 case 'L':
                     if (argv[i][2] == 0)
@@ -9,6 +9,16 @@
 
 #include "diskio.h"		/* FatFs lower layer API */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+/* <windows.h> does not mix with the host typedefs */
+__declspec(dllimport) int __stdcall QueryPerformanceCounter(long long *lpPerformanceCount);
+__declspec(dllimport) int __stdcall QueryPerformanceFrequency(long long *lpFrequency);
+#else
+#include <sys/time.h>
+#endif
 
 /*-----------------------------------------------------------------------*/
 /* Correspondence between physical drive number and image file handles.  */
@@ -17,6 +27,204 @@ UINT sectorCount[1] = { 0 };
 FILE* driveHandle[1] = { NULL };
 const int driveHandleCount = sizeof(driveHandle) / sizeof(FILE*);
 
+/*-----------------------------------------------------------------------*/
+/* Write-back sector cache                                               */
+/*-----------------------------------------------------------------------*/
+/* FatFs issues many small requests and rewrites the FAT and directory   */
+/* sectors over and over. Keep the sectors in a direct-mapped cache of   */
+/* blocks and write the dirty sectors of a block with as few writes as   */
+/* possible when it is evicted or the drive is synchronized.             */
+/*                                                                       */
+/* A new image is created sparse: its size is only set when the image is */
+/* closed and zero-filled sectors past the end of the file are never     */
+/* written, so the free space of the volume stays a hole in the file.    */
+
+#define SECTOR_SIZE         512
+#define BLOCK_SECTORS       64      /* One bit per sector in the masks */
+#define BLOCK_SIZE          (BLOCK_SECTORS * SECTOR_SIZE)
+#define CACHE_BLOCKS        256     /* 8 MB of cache */
+
+typedef struct _CACHE_BLOCK
+{
+    DWORD Block;        /* Block number, valid only if ValidMask != 0 */
+    ULONGLONG ValidMask;
+    ULONGLONG DirtyMask;
+    BYTE Data[BLOCK_SIZE];
+} CACHE_BLOCK;
+
+static CACHE_BLOCK* cacheBlocks = NULL;
+static BYTE readBuffer[BLOCK_SIZE];
+static DWORD fileSectors;   /* Sectors actually present in the image file */
+
+DISK_STATISTICS diskStatistics;
+
+/* Wall-clock time in microseconds, clock() would only count the CPU time */
+static ULONGLONG time_now(void)
+{
+#ifdef _WIN32
+    long long counter, frequency;
+
+    if (!QueryPerformanceFrequency(&frequency) || !QueryPerformanceCounter(&counter))
+        return 0;
+    return (ULONGLONG)(counter / frequency) * 1000000 +
+           (ULONGLONG)(counter % frequency) * 1000000 / frequency;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (ULONGLONG)tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+static int is_zero_sector(const BYTE* data)
+{
+    UINT i;
+
+    for (i = 0; i < SECTOR_SIZE; i++)
+    {
+        if (data[i] != 0)
+            return 0;
+    }
+    return 1;
+}
+
+static DRESULT file_write(BYTE pdrv, const BYTE* data, DWORD sector, UINT count)
+{
+    ULONGLONG start = time_now();
+    size_t result;
+
+    if (fseek(driveHandle[pdrv], (long)sector * SECTOR_SIZE, SEEK_SET))
+        return RES_ERROR;
+
+    result = fwrite(data, SECTOR_SIZE, count, driveHandle[pdrv]);
+
+    diskStatistics.FileWrites++;
+    diskStatistics.BytesWritten += (ULONGLONG)count * SECTOR_SIZE;
+    diskStatistics.IoTime += time_now() - start;
+
+    if (result != count)
+        return RES_ERROR;
+
+    if (sector + count > fileSectors)
+        fileSectors = sector + count;
+
+    return RES_OK;
+}
+
+/* Reads a whole block, the part past the end of the file reads as zeros */
+static DRESULT file_read_block(BYTE pdrv, BYTE* data, DWORD block)
+{
+    DWORD sector = block * BLOCK_SECTORS;
+    ULONGLONG start;
+    UINT count;
+    size_t result;
+
+    if (sector >= fileSectors)
+    {
+        memset(data, 0, BLOCK_SIZE);
+        return RES_OK;
+    }
+
+    count = BLOCK_SECTORS;
+    if (count > fileSectors - sector)
+        count = fileSectors - sector;
+
+    start = time_now();
+
+    if (fseek(driveHandle[pdrv], (long)sector * SECTOR_SIZE, SEEK_SET))
+        return RES_ERROR;
+
+    result = fread(data, SECTOR_SIZE, count, driveHandle[pdrv]);
+
+    diskStatistics.FileReads++;
+    diskStatistics.BytesRead += (ULONGLONG)count * SECTOR_SIZE;
+    diskStatistics.IoTime += time_now() - start;
+
+    if (result != count)
+        return RES_ERROR;
+
+    memset(data + count * SECTOR_SIZE, 0, (BLOCK_SECTORS - count) * SECTOR_SIZE);
+    return RES_OK;
+}
+
+static DRESULT cache_flush_block(BYTE pdrv, CACHE_BLOCK* entry)
+{
+    DWORD base = entry->Block * BLOCK_SECTORS;
+    UINT first, last;
+
+    for (first = 0; first < BLOCK_SECTORS; first = last)
+    {
+        if (!(entry->DirtyMask & (1ULL << first)))
+        {
+            last = first + 1;
+            continue;
+        }
+
+        /* Zeros past the end of the file are already there, leave a hole */
+        if (base + first >= fileSectors &&
+            is_zero_sector(entry->Data + first * SECTOR_SIZE))
+        {
+            diskStatistics.SectorsSkipped++;
+            last = first + 1;
+            continue;
+        }
+
+        /* Write the whole run of dirty sectors at once */
+        for (last = first + 1; last < BLOCK_SECTORS; last++)
+        {
+            if (!(entry->DirtyMask & (1ULL << last)))
+                break;
+        }
+
+        if (file_write(pdrv, entry->Data + first * SECTOR_SIZE, base + first, last - first))
+            return RES_ERROR;
+    }
+
+    entry->DirtyMask = 0;
+    return RES_OK;
+}
+
+static DRESULT cache_flush(BYTE pdrv)
+{
+    UINT i;
+
+    if (!cacheBlocks)
+        return RES_OK;
+
+    for (i = 0; i < CACHE_BLOCKS; i++)
+    {
+        if (cacheBlocks[i].DirtyMask && cache_flush_block(pdrv, &cacheBlocks[i]))
+            return RES_ERROR;
+    }
+
+    if (fflush(driveHandle[pdrv]))
+        return RES_ERROR;
+
+    return RES_OK;
+}
+
+/* Returns the cache entry of a block, evicting whatever block was there */
+static CACHE_BLOCK* cache_get_block(BYTE pdrv, DWORD block)
+{
+    CACHE_BLOCK* entry = &cacheBlocks[block % CACHE_BLOCKS];
+
+    if (entry->ValidMask && entry->Block == block)
+    {
+        diskStatistics.CacheHits++;
+        return entry;
+    }
+
+    diskStatistics.CacheMisses++;
+
+    if (entry->DirtyMask && cache_flush_block(pdrv, entry))
+        return NULL;
+
+    entry->Block = block;
+    entry->ValidMask = 0;
+    entry->DirtyMask = 0;
+    return entry;
+}
+
 /*-----------------------------------------------------------------------*/
 /* Open an image file a Drive                                            */
 /*-----------------------------------------------------------------------*/
@@ -28,6 +236,16 @@ DSTATUS disk_openimage(BYTE pdrv, const char* imageFileName)
         if (driveHandle[0] != NULL)
             return 0;
 
+        if (!cacheBlocks)
+        {
+            cacheBlocks = calloc(CACHE_BLOCKS, sizeof(CACHE_BLOCK));
+            if (!cacheBlocks)
+                return STA_NOINIT;
+        }
+
+        memset(&diskStatistics, 0, sizeof(diskStatistics));
+        diskStatistics.StartTime = time_now();
+
         driveHandle[0] = fopen(imageFileName, "r+b");
         if (!driveHandle[0])
         {
@@ -35,7 +253,13 @@ DSTATUS disk_openimage(BYTE pdrv, const char* imageFileName)
         }
 
         if (driveHandle[0] != NULL)
+        {
+            if (fseek(driveHandle[0], 0, SEEK_END))
+                fileSectors = 0;
+            else
+                fileSectors = ftell(driveHandle[0]) / SECTOR_SIZE;
             return 0;
+        }
     }
     return STA_NOINIT;
 }
@@ -53,12 +277,62 @@ VOID disk_cleanup(
     {
         if (driveHandle[pdrv] != NULL)
         {
+            if (cache_flush(pdrv))
+                fprintf(stderr, "Error: Failed to write the image file.\n");
+
+            /* Give the image its final size, anything not written is a hole */
+            if (fileSectors < sectorCount[pdrv])
+            {
+                if (fseek(driveHandle[pdrv], (long)sectorCount[pdrv] * SECTOR_SIZE - 1, SEEK_SET) ||
+                    fputc(0, driveHandle[pdrv]) == EOF)
+                {
+                    fprintf(stderr, "Error: Failed to set the size of the image file.\n");
+                }
+                else
+                {
+                    fileSectors = sectorCount[pdrv];
+                }
+            }
+
             fclose(driveHandle[pdrv]);
             driveHandle[pdrv] = NULL;
+            diskStatistics.EndTime = time_now();
         }
+
+        free(cacheBlocks);
+        cacheBlocks = NULL;
     }
 }
 
+/*-----------------------------------------------------------------------*/
+/* Print I/O statistics of a Drive (after disk_cleanup)                  */
+/*-----------------------------------------------------------------------*/
+
+VOID disk_report(
+    BYTE pdrv		/* Physical drive nmuber (0..) */
+    )
+{
+    ULONGLONG total = diskStatistics.EndTime - diskStatistics.StartTime;
+
+    if (pdrv >= driveHandleCount)
+        return;
+
+    printf("Disk I/O statistics:\n");
+    printf("    Requests:      %lu reads (%lu sectors), %lu writes (%lu sectors)\n",
+           (unsigned long)diskStatistics.Reads, (unsigned long)diskStatistics.SectorsRead,
+           (unsigned long)diskStatistics.Writes, (unsigned long)diskStatistics.SectorsWritten);
+    printf("    Cache:         %lu hits, %lu misses\n",
+           (unsigned long)diskStatistics.CacheHits, (unsigned long)diskStatistics.CacheMisses);
+    printf("    Image file:    %lu reads (%lu KB), %lu writes (%lu KB)\n",
+           (unsigned long)diskStatistics.FileReads, (unsigned long)(diskStatistics.BytesRead / 1024),
+           (unsigned long)diskStatistics.FileWrites, (unsigned long)(diskStatistics.BytesWritten / 1024));
+    printf("    Sparse:        %lu zero sectors not written\n",
+           (unsigned long)diskStatistics.SectorsSkipped);
+    printf("    Time:          %lu ms total, %lu ms in image file I/O\n",
+           (unsigned long)(total / 1000),
+           (unsigned long)(diskStatistics.IoTime / 1000));
+}
+
 /*-----------------------------------------------------------------------*/
 /* Inidialize a Drive                                                    */
 /*-----------------------------------------------------------------------*/
@@ -103,19 +377,43 @@ DRESULT disk_read(
     UINT count		/* Number of sectors to read (1..128) */
     )
 {
-    DWORD result;
+    CACHE_BLOCK* entry;
+    UINT index, i;
 
     if (pdrv < driveHandleCount)
     {
         if (driveHandle[pdrv] != NULL)
         {
-            if (fseek(driveHandle[pdrv], sector * 512, SEEK_SET))
-                return RES_ERROR;
+            diskStatistics.Reads++;
+            diskStatistics.SectorsRead += count;
+
+            while (count > 0)
+            {
+                entry = cache_get_block(pdrv, sector / BLOCK_SECTORS);
+                if (!entry)
+                    return RES_ERROR;
+
+                index = sector % BLOCK_SECTORS;
+                if (!(entry->ValidMask & (1ULL << index)))
+                {
+                    /* Fill the sectors not yet cached, keeping the ones written */
+                    if (file_read_block(pdrv, readBuffer, entry->Block))
+                        return RES_ERROR;
+
+                    for (i = 0; i < BLOCK_SECTORS; i++)
+                    {
+                        if (!(entry->ValidMask & (1ULL << i)))
+                            memcpy(entry->Data + i * SECTOR_SIZE, readBuffer + i * SECTOR_SIZE, SECTOR_SIZE);
+                    }
+                    entry->ValidMask = ~0ULL;
+                }
 
-            result = fread(buff, 512, count, driveHandle[pdrv]);
+                memcpy(buff, entry->Data + index * SECTOR_SIZE, SECTOR_SIZE);
 
-            if (result != count)
-                return RES_ERROR;
+                buff += SECTOR_SIZE;
+                sector++;
+                count--;
+            }
 
             return RES_OK;
         }
@@ -138,19 +436,32 @@ DRESULT disk_write(
     UINT count			/* Number of sectors to write (1..128) */
     )
 {
-    DWORD result;
+    CACHE_BLOCK* entry;
+    UINT index;
 
     if (pdrv < driveHandleCount)
     {
         if (driveHandle[pdrv] != NULL)
         {
-            if (fseek(driveHandle[pdrv], sector * 512, SEEK_SET))
-                return RES_ERROR;
-
-            result = fwrite(buff, 512, count, driveHandle[pdrv]);
+            diskStatistics.Writes++;
+            diskStatistics.SectorsWritten += count;
 
-            if (result != count)
-                return RES_ERROR;
+            while (count > 0)
+            {
+                /* Sectors are only written to the cache, there is no need to read them first */
+                entry = cache_get_block(pdrv, sector / BLOCK_SECTORS);
+                if (!entry)
+                    return RES_ERROR;
+
+                index = sector % BLOCK_SECTORS;
+                memcpy(entry->Data + index * SECTOR_SIZE, buff, SECTOR_SIZE);
+                entry->ValidMask |= 1ULL << index;
+                entry->DirtyMask |= 1ULL << index;
+
+                buff += SECTOR_SIZE;
+                sector++;
+                count--;
+            }
 
             return RES_OK;
         }
@@ -179,8 +490,7 @@ DRESULT disk_ioctl(
             switch (cmd)
             {
             case CTRL_SYNC:
-                fflush(driveHandle[pdrv]);
-                return RES_OK;
+                return cache_flush(pdrv);
             case GET_SECTOR_SIZE:
                 *(DWORD*)buff = 512;
                 return RES_OK;
@@ -190,40 +500,18 @@ DRESULT disk_ioctl(
             case GET_SECTOR_COUNT:
             {
                 if (sectorCount[pdrv] <= 0)
-                {
-                    if (fseek(driveHandle[pdrv], 0, SEEK_END))
-                        printf("fseek failed!\n");
-                    else
-                        sectorCount[pdrv] = ftell(driveHandle[pdrv]) / 512;
-                }
+                    sectorCount[pdrv] = fileSectors;
 
                 *(DWORD*)buff = sectorCount[pdrv];
                 return RES_OK;
             }
             case SET_SECTOR_COUNT:
             {
-                int count = *(DWORD*)buff;
-                long size;
-
-                sectorCount[pdrv] = count;
-
-                fseek(driveHandle[pdrv], 0, SEEK_END);
-                size = ftell(driveHandle[pdrv]) / 512;
-
-                if (size < count)
-                {
-                    if (fseek(driveHandle[pdrv], count * 512 - 1, SEEK_SET))
-                        return RES_ERROR;
-
-                    fwrite(buff, 1, 1, driveHandle[pdrv]);
-
-                    return RES_OK;
-                }
-                else
-                {
-                    // SHRINKING NOT IMPLEMENTED
-                    return RES_OK;
-                }
+                /* The file is only extended when the image is closed,
+                 * so that the sectors never written become holes. */
+                // SHRINKING NOT IMPLEMENTED
+                sectorCount[pdrv] = *(DWORD*)buff;
+                return RES_OK;
             }
             }
         }
@@ -28,11 +28,33 @@ typedef enum {
 } DRESULT;
 
 
+/* I/O statistics of the image file */
+typedef struct {
+	ULONGLONG	Reads;			/* disk_read calls */
+	ULONGLONG	SectorsRead;
+	ULONGLONG	Writes;			/* disk_write calls */
+	ULONGLONG	SectorsWritten;
+	ULONGLONG	CacheHits;
+	ULONGLONG	CacheMisses;
+	ULONGLONG	FileReads;		/* Reads from the image file */
+	ULONGLONG	BytesRead;
+	ULONGLONG	FileWrites;		/* Writes to the image file */
+	ULONGLONG	BytesWritten;
+	ULONGLONG	SectorsSkipped;	/* Zero sectors left as holes */
+	ULONGLONG	IoTime;			/* Wall-clock times in microseconds */
+	ULONGLONG	StartTime;
+	ULONGLONG	EndTime;
+} DISK_STATISTICS;
+
+extern DISK_STATISTICS diskStatistics;
+
+
 /*---------------------------------------*/
 /* Prototypes for disk control functions */
 
 DSTATUS disk_openimage(BYTE pdrv, const char* imageFileName);
 VOID disk_cleanup(BYTE pdrv);
+VOID disk_report(BYTE pdrv);
 
 DSTATUS disk_initialize (BYTE pdrv);
 DSTATUS disk_status (BYTE pdrv);
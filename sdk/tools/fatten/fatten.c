@@ -14,6 +14,7 @@
 
 static FATFS g_Filesystem;
 static int isMounted = 0;
+static int printStats = 0;
 static unsigned char buff[32768];
 
 // tool needed by fatfs
@@ -83,6 +84,8 @@ void print_help(const char* name)
            "            Creates a directory.\n");
     printf("    -list [<pattern>]\n"
            "            Lists files a directory (defaults to root).\n");
+    printf("    -stats\n"
+           "            Prints the I/O statistics of the image file when done.\n");
 }
 
 #define PRINT_HELP_AND_QUIT() \
@@ -554,6 +557,12 @@ int main(int oargc, char* oargv[])
                     printf(" - %s\n", info.fname);
             }
         }
+        else if (strcmp(parg, "stats") == 0)
+        {
+            NEED_PARAMS(0, 0);
+
+            printStats = 1;
+        }
         else
         {
             fprintf(stderr, "Error: Unknown or invalid command: %s\n", argv[-1]);
@@ -569,5 +578,8 @@ exit:
 
     disk_cleanup(0);
 
+    if (printStats)
+        disk_report(0);
+
     return ret;
 }
@@ -0,0 +1,236 @@
+/*
+ * PROJECT:     ReactOS INF Benchmark
+ * LICENSE:     GPL - See COPYING in the top level directory
+ * FILE:        sdk/tools/infbench/infbench.c
+ * PURPOSE:     Times the host INF parser on real INF files: the parse, the
+ *              AddReg/DelReg walks mkhive does, and a keyed lookup of every
+ *              line of every section.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <typedefs.h>
+#include <infhost.h>
+
+#define MAX_SECTIONS        4096
+#define MAX_SECTION_LENGTH  256
+
+static const WCHAR AddReg[] = {'A','d','d','R','e','g',0};
+static const WCHAR DelReg[] = {'D','e','l','R','e','g',0};
+
+typedef struct _INF_FILE
+{
+    const char *FileName;
+    HINF hInf;
+    ULONG SectionCount;
+    WCHAR *Sections[MAX_SECTIONS];
+} INF_FILE;
+
+static
+void
+Usage(void)
+{
+    printf("Times the INF parser on the given INF files.\n"
+           "Syntax: infbench [-n <iterations>] <inf file> [<inf file> ...]\n"
+           "Each iteration repeats the lookups mkhive does on AddReg and DelReg,\n"
+           "then looks up every line of every section by its key.\n");
+}
+
+static
+double
+ElapsedMs(clock_t Start)
+{
+    return (double)(clock() - Start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+/*
+ * The host API can't enumerate sections, so collect their names from the
+ * file itself. Only ASCII names are picked up, which is all the boot INFs use.
+ */
+static
+int
+CollectSections(INF_FILE *Inf)
+{
+    char Line[1024];
+    FILE *File;
+    char *End;
+    size_t i, Length;
+
+    File = fopen(Inf->FileName, "r");
+    if (!File)
+        return 0;
+
+    while (fgets(Line, sizeof(Line), File) && Inf->SectionCount < MAX_SECTIONS)
+    {
+        if (Line[0] != '[')
+            continue;
+        End = strchr(Line, ']');
+        if (!End)
+            continue;
+
+        Length = (size_t)(End - Line - 1);
+        if (Length == 0 || Length >= MAX_SECTION_LENGTH)
+            continue;
+
+        Inf->Sections[Inf->SectionCount] = malloc((Length + 1) * sizeof(WCHAR));
+        if (!Inf->Sections[Inf->SectionCount])
+            break;
+        for (i = 0; i < Length; i++)
+            Inf->Sections[Inf->SectionCount][i] = (WCHAR)(unsigned char)Line[i + 1];
+        Inf->Sections[Inf->SectionCount][Length] = 0;
+        Inf->SectionCount++;
+    }
+
+    fclose(File);
+    return 1;
+}
+
+/* Same lookups as registry_callback() in mkhive's reginf.c */
+static
+ULONG
+WalkRegistrySection(HINF hInf, const WCHAR *Section)
+{
+    WCHAR Buffer[MAX_INF_STRING_LENGTH];
+    UCHAR Data[MAX_INF_STRING_LENGTH];
+    PINFCONTEXT Context = NULL;
+    ULONG Lines = 0, Size;
+    INT Flags;
+    int Ok;
+
+    if (InfHostFindFirstLine(hInf, Section, NULL, &Context) != 0)
+        return 0;
+
+    for (Ok = 1; Ok; Ok = (InfHostFindNextLine(Context, Context) == 0))
+    {
+        InfHostGetStringField(Context, 1, Buffer, MAX_INF_STRING_LENGTH, NULL);
+        InfHostGetStringField(Context, 2, Buffer, MAX_INF_STRING_LENGTH, NULL);
+        if (InfHostGetIntField(Context, 4, &Flags) != 0)
+            Flags = 0;
+        InfHostGetStringField(Context, 3, Buffer, MAX_INF_STRING_LENGTH, NULL);
+        InfHostGetFieldCount(Context);
+        InfHostGetMultiSzField(Context, 5, Buffer, MAX_INF_STRING_LENGTH, &Size);
+        InfHostGetBinaryField(Context, 5, Data, sizeof(Data), &Size);
+        Lines++;
+    }
+
+    InfHostFreeContext(Context);
+    return Lines;
+}
+
+static
+ULONG
+LookupAllKeys(INF_FILE *Inf)
+{
+    PINFCONTEXT Context = NULL, Match = NULL;
+    WCHAR *Key, *Data;
+    ULONG i, Lookups = 0;
+    int Ok;
+
+    for (i = 0; i < Inf->SectionCount; i++)
+    {
+        if (InfHostFindFirstLine(Inf->hInf, Inf->Sections[i], NULL, &Context) != 0)
+            continue;
+        Lookups++;
+
+        for (Ok = 1; Ok; Ok = (InfHostFindNextLine(Context, Context) == 0))
+        {
+            if (InfHostGetData(Context, &Key, &Data) != 0 || !Key)
+                continue;
+
+            if (InfHostFindFirstLine(Inf->hInf, Inf->Sections[i], Key, &Match) == 0)
+            {
+                InfHostFreeContext(Match);
+                Match = NULL;
+            }
+            Lookups++;
+        }
+
+        InfHostFreeContext(Context);
+        Context = NULL;
+    }
+
+    return Lookups;
+}
+
+int main(int argc, char *argv[])
+{
+    INF_FILE *Infs;
+    int InfCount, FirstInf = 1, Iterations = 100;
+    int i, j;
+    ULONG ErrorLine, Lines = 0, Lookups = 0;
+    ULONG k;
+    clock_t Start;
+
+    if (argc > 2 && strcmp(argv[1], "-n") == 0)
+    {
+        Iterations = atoi(argv[2]);
+        FirstInf = 3;
+    }
+
+    if ((argc <= FirstInf) || (Iterations <= 0) || (strcmp(argv[1], "--help") == 0))
+    {
+        Usage();
+        return -1;
+    }
+
+    InfCount = argc - FirstInf;
+    Infs = calloc(InfCount, sizeof(INF_FILE));
+    if (!Infs)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+
+    Start = clock();
+    for (i = 0; i < InfCount; i++)
+    {
+        Infs[i].FileName = argv[FirstInf + i];
+        if (InfHostOpenFile(&Infs[i].hInf, Infs[i].FileName, 0, &ErrorLine) != 0)
+        {
+            fprintf(stderr, "Could not parse '%s' (line %lu)\n", Infs[i].FileName, (unsigned long)ErrorLine);
+            return -1;
+        }
+    }
+    printf("Parse:         %10.2f ms\n", ElapsedMs(Start));
+
+    for (i = 0; i < InfCount; i++)
+    {
+        if (!CollectSections(&Infs[i]))
+        {
+            fprintf(stderr, "Could not read '%s'\n", Infs[i].FileName);
+            return -1;
+        }
+    }
+
+    Start = clock();
+    for (j = 0; j < Iterations; j++)
+    {
+        for (i = 0; i < InfCount; i++)
+        {
+            Lines += WalkRegistrySection(Infs[i].hInf, DelReg);
+            Lines += WalkRegistrySection(Infs[i].hInf, AddReg);
+        }
+    }
+    printf("AddReg/DelReg: %10.2f ms (%lu lines)\n", ElapsedMs(Start), (unsigned long)Lines);
+
+    Start = clock();
+    for (j = 0; j < Iterations; j++)
+    {
+        for (i = 0; i < InfCount; i++)
+            Lookups += LookupAllKeys(&Infs[i]);
+    }
+    printf("Keyed lookups: %10.2f ms (%lu lookups)\n", ElapsedMs(Start), (unsigned long)Lookups);
+
+    for (i = 0; i < InfCount; i++)
+    {
+        InfHostCloseFile(Infs[i].hInf);
+        for (k = 0; k < Infs[i].SectionCount; k++)
+            free(Infs[i].Sections[k]);
+    }
+    free(Infs);
+
+    return 0;
+}
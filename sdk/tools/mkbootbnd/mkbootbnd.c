@@ -0,0 +1,229 @@
+/*
+ * PROJECT:     ReactOS Boot Bundle Maker
+ * LICENSE:     GPL - See COPYING in the top level directory
+ * FILE:        sdk/tools/mkbootbnd/mkbootbnd.c
+ * PURPOSE:     Writes the boot driver bundle (system32\bootdrv.bnd) that
+ *              FreeLoader reads in place of the individual boot drivers.
+ *              The layout matches boot/freeldr/freeldr/include/winldr.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _MSC_VER
+#include <stdint.h>
+#else
+typedef unsigned __int8  uint8_t;
+typedef unsigned __int32 uint32_t;
+#endif
+
+#define BOOT_BUNDLE_SIGNATURE   0x4C444E42 /* 'LDNB' */
+#define BOOT_BUNDLE_VERSION     1
+#define BOOT_BUNDLE_HEADER_SIZE 16
+#define BOOT_BUNDLE_NAME_LENGTH 64
+#define BOOT_BUNDLE_ENTRY_SIZE  (BOOT_BUNDLE_NAME_LENGTH + 12)
+#define BOOT_BUNDLE_ALIGNMENT   16
+
+typedef struct _IMAGE
+{
+    char Name[BOOT_BUNDLE_NAME_LENGTH];
+    uint8_t *Data;
+    uint32_t Size;
+    uint32_t TimeDateStamp;
+    uint32_t DataOffset;
+} IMAGE;
+
+static
+void
+Usage(void)
+{
+    printf("Writes a boot driver bundle for FreeLoader.\n"
+           "Syntax: mkbootbnd <bundle file> <system root> <image> [<image> ...]\n"
+           "Each image is a path relative to the system root, for example\n"
+           "system32\\drivers\\disk.sys. An image given as <name>=<file> is read\n"
+           "from that file instead. The images are stored in the given order.\n");
+}
+
+static
+uint32_t
+GetLong(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static
+void
+PutLong(uint8_t *p, uint32_t Value)
+{
+    p[0] = (uint8_t)Value;
+    p[1] = (uint8_t)(Value >> 8);
+    p[2] = (uint8_t)(Value >> 16);
+    p[3] = (uint8_t)(Value >> 24);
+}
+
+static
+int
+LoadImage(IMAGE *Image, const char *SystemRoot, const char *Argument)
+{
+    char Path[1024];
+    FILE *File;
+    long Size;
+    uint32_t NtHeaderOffset;
+    const char *FileName;
+    size_t i, NameLength, PathLength;
+
+    /* Either <name>=<file>, or a name relative to the system root */
+    FileName = strchr(Argument, '=');
+    NameLength = FileName ? (size_t)(FileName - Argument) : strlen(Argument);
+    if (NameLength == 0 || NameLength >= sizeof(Image->Name))
+    {
+        fprintf(stderr, "Invalid image name '%s'\n", Argument);
+        return 0;
+    }
+
+    /* The loader looks the images up with backslashes */
+    memcpy(Image->Name, Argument, NameLength);
+    Image->Name[NameLength] = '\0';
+    for (i = 0; Image->Name[i]; i++)
+    {
+        if (Image->Name[i] == '/')
+            Image->Name[i] = '\\';
+    }
+
+    /* ... while the host wants its own separator */
+    if (FileName)
+        PathLength = (size_t)snprintf(Path, sizeof(Path), "%s", FileName + 1);
+    else
+        PathLength = (size_t)snprintf(Path, sizeof(Path), "%s/%s", SystemRoot, Argument);
+    if (PathLength >= sizeof(Path))
+    {
+        fprintf(stderr, "Path of '%s' is too long\n", Argument);
+        return 0;
+    }
+#ifndef _WIN32
+    for (i = 0; Path[i]; i++)
+    {
+        if (Path[i] == '\\')
+            Path[i] = '/';
+    }
+#endif
+
+    File = fopen(Path, "rb");
+    if (!File)
+    {
+        fprintf(stderr, "Could not open '%s'\n", Path);
+        return 0;
+    }
+
+    fseek(File, 0, SEEK_END);
+    Size = ftell(File);
+    fseek(File, 0, SEEK_SET);
+
+    Image->Data = (Size > 0) ? malloc(Size) : NULL;
+    if (!Image->Data || fread(Image->Data, 1, Size, File) != (size_t)Size)
+    {
+        fprintf(stderr, "Could not read '%s'\n", Path);
+        fclose(File);
+        return 0;
+    }
+    fclose(File);
+    Image->Size = (uint32_t)Size;
+
+    /* The loader checks the bundled image against this time stamp */
+    if (Image->Size < 0x40 || Image->Data[0] != 'M' || Image->Data[1] != 'Z')
+    {
+        fprintf(stderr, "'%s' is not a PE image\n", Path);
+        return 0;
+    }
+    NtHeaderOffset = GetLong(Image->Data + 0x3C);
+    if (NtHeaderOffset > Image->Size - 12 ||
+        memcmp(Image->Data + NtHeaderOffset, "PE\0\0", 4) != 0)
+    {
+        fprintf(stderr, "'%s' is not a PE image\n", Path);
+        return 0;
+    }
+    Image->TimeDateStamp = GetLong(Image->Data + NtHeaderOffset + 8);
+
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    uint8_t Header[BOOT_BUNDLE_HEADER_SIZE];
+    uint8_t Entry[BOOT_BUNDLE_ENTRY_SIZE];
+    static const uint8_t Padding[BOOT_BUNDLE_ALIGNMENT];
+    IMAGE *Images;
+    int ImageCount, i;
+    uint32_t Offset, End;
+    FILE *Bundle;
+
+    if ((argc < 4) || (strcmp(argv[1], "--help") == 0))
+    {
+        Usage();
+        return -1;
+    }
+
+    ImageCount = argc - 3;
+    Images = calloc(ImageCount, sizeof(IMAGE));
+    if (!Images)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+
+    /* Place the images behind the header and the entries */
+    Offset = BOOT_BUNDLE_HEADER_SIZE + ImageCount * BOOT_BUNDLE_ENTRY_SIZE;
+    for (i = 0; i < ImageCount; i++)
+    {
+        if (!LoadImage(&Images[i], argv[2], argv[i + 3]))
+            return -1;
+
+        Offset = (Offset + BOOT_BUNDLE_ALIGNMENT - 1) & ~(BOOT_BUNDLE_ALIGNMENT - 1);
+        Images[i].DataOffset = Offset;
+        Offset += Images[i].Size;
+    }
+    End = Offset;
+
+    Bundle = fopen(argv[1], "wb");
+    if (!Bundle)
+    {
+        fprintf(stderr, "Could not create '%s'\n", argv[1]);
+        return -1;
+    }
+
+    PutLong(Header, BOOT_BUNDLE_SIGNATURE);
+    PutLong(Header + 4, BOOT_BUNDLE_VERSION);
+    PutLong(Header + 8, (uint32_t)ImageCount);
+    PutLong(Header + 12, End);
+    fwrite(Header, 1, sizeof(Header), Bundle);
+
+    for (i = 0; i < ImageCount; i++)
+    {
+        memset(Entry, 0, sizeof(Entry));
+        memcpy(Entry, Images[i].Name, strlen(Images[i].Name));
+        PutLong(Entry + BOOT_BUNDLE_NAME_LENGTH, Images[i].Size);
+        PutLong(Entry + BOOT_BUNDLE_NAME_LENGTH + 4, Images[i].TimeDateStamp);
+        PutLong(Entry + BOOT_BUNDLE_NAME_LENGTH + 8, Images[i].DataOffset);
+        fwrite(Entry, 1, sizeof(Entry), Bundle);
+    }
+
+    Offset = BOOT_BUNDLE_HEADER_SIZE + ImageCount * BOOT_BUNDLE_ENTRY_SIZE;
+    for (i = 0; i < ImageCount; i++)
+    {
+        fwrite(Padding, 1, Images[i].DataOffset - Offset, Bundle);
+        fwrite(Images[i].Data, 1, Images[i].Size, Bundle);
+        Offset = Images[i].DataOffset + Images[i].Size;
+        free(Images[i].Data);
+    }
+
+    if (fclose(Bundle) != 0)
+    {
+        fprintf(stderr, "Could not write '%s'\n", argv[1]);
+        return -1;
+    }
+
+    free(Images);
+    return 0;
+}
@@ -28,9 +28,11 @@
 
 /* INCLUDES *****************************************************************/
 
+#include <errno.h>
 #include <limits.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 
 #include "mkhive.h"
 
@@ -54,12 +56,15 @@
 
 void usage(void)
 {
-    printf("Usage: mkhive [-?] -h:hive1[,hiveN...] [-u] -d:<dstdir> <inffiles>\n\n"
+    printf("Usage: mkhive [-?] -h:hive1[,hiveN...] [-u] -d:<dstdir> <inffiles>\n"
+           "       mkhive -b:count\n\n"
            "  -h:hiveN  - Comma-separated list of hives to create. Possible values are:\n"
            "              SETUPREG, SYSTEM, SOFTWARE, DEFAULT, SAM, SECURITY, BCD.\n"
            "  -u        - Generate file names in uppercase (default: lowercase) (TEMPORARY FLAG!).\n"
            "  -d:dstdir - The binary hive files are created in this directory.\n"
            "  inffiles  - List of INF files with full path.\n"
+           "  -b:count  - Times the lookup of keys in a generated SOFTWARE hive with\n"
+           "              count subkeys under one key, then exits.\n"
            "  -?        - Displays this help screen.\n");
 }
 
@@ -91,6 +96,98 @@ void convert_path(char *dst, char *src)
     dst[i] = 0;
 }
 
+static VOID
+MakeBenchmarkKeyName(
+    OUT PWCHAR Buffer,
+    IN PCSTR Prefix,
+    IN ULONG Number)
+{
+    CHAR Name[32];
+    INT i;
+
+    /* Scramble the number so that the keys are not created in sorted order */
+    sprintf(Name, "%s%08X", Prefix, (UINT)(Number * 2654435761U));
+    for (i = 0; Name[i]; i++)
+        Buffer[i] = (WCHAR)Name[i];
+    Buffer[i] = UNICODE_NULL;
+}
+
+static INT
+BenchmarkLookups(
+    IN ULONG SubKeyCount)
+{
+    HKEY ParentKey, Key;
+    WCHAR KeyName[32];
+    ULONG i, Found = 0;
+    clock_t Start, Create, Hit, Miss;
+
+    printf("Benchmarking the lookup of %u subkeys\n", (UINT)SubKeyCount);
+
+    RegInitializeRegistry("SOFTWARE");
+
+    if (RegCreateKeyW(NULL, L"Registry\\Machine\\SOFTWARE\\Classes", &ParentKey) != ERROR_SUCCESS)
+    {
+        fprintf(stderr, "Could not create the parent key.\n");
+        RegShutdownRegistry();
+        return -1;
+    }
+
+    Start = clock();
+    for (i = 0; i < SubKeyCount; i++)
+    {
+        MakeBenchmarkKeyName(KeyName, "Key", i);
+        if (RegCreateKeyW(ParentKey, KeyName, &Key) != ERROR_SUCCESS)
+        {
+            fprintf(stderr, "Could not create subkey %u.\n", (UINT)i);
+            RegCloseKey(ParentKey);
+            RegShutdownRegistry();
+            return -1;
+        }
+        RegCloseKey(Key);
+    }
+    Create = clock() - Start;
+
+    /* Open the keys in another order than they were created */
+    Start = clock();
+    for (i = 0; i < SubKeyCount; i++)
+    {
+        MakeBenchmarkKeyName(KeyName, "Key", SubKeyCount - 1 - i);
+        if (RegOpenKeyW(ParentKey, KeyName, &Key) == ERROR_SUCCESS)
+        {
+            Found++;
+            RegCloseKey(Key);
+        }
+    }
+    Hit = clock() - Start;
+
+    Start = clock();
+    for (i = 0; i < SubKeyCount; i++)
+    {
+        MakeBenchmarkKeyName(KeyName, "Nokey", i);
+        if (RegOpenKeyW(ParentKey, KeyName, &Key) == ERROR_SUCCESS)
+        {
+            Found++;
+            RegCloseKey(Key);
+        }
+    }
+    Miss = clock() - Start;
+
+    RegCloseKey(ParentKey);
+    RegShutdownRegistry();
+
+    printf("  Create:            %lu ms\n", (unsigned long)(Create * 1000 / CLOCKS_PER_SEC));
+    printf("  Existing lookups:  %lu ms\n", (unsigned long)(Hit * 1000 / CLOCKS_PER_SEC));
+    printf("  Missing lookups:   %lu ms\n", (unsigned long)(Miss * 1000 / CLOCKS_PER_SEC));
+
+    if (Found != SubKeyCount)
+    {
+        fprintf(stderr, "Found %u keys instead of %u.\n", (UINT)Found, (UINT)SubKeyCount);
+        return -1;
+    }
+
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
     INT ret;
@@ -100,8 +197,9 @@ int main(int argc, char *argv[])
     PCSTR HiveList = NULL;
     CHAR DestPath[PATH_MAX] = "";
     CHAR FileName[PATH_MAX];
+    ULONG BenchmarkSubKeys = 0;
 
-    if (argc < 4)
+    if (argc < 2)
     {
         usage();
         return -1;
@@ -131,6 +229,22 @@ int main(int argc, char *argv[])
         {
             convert_path(DestPath, argv[i] + 3);
         }
+        else if (argv[i][1] == 'b' && (argv[i][2] == ':' || argv[i][2] == '='))
+        {
+            char *Count = argv[i] + 3;
+            char *End;
+            unsigned long Value;
+
+            errno = 0;
+            Value = strtoul(Count, &End, 0);
+            if (*Count < '0' || *Count > '9' || *End != '\0' ||
+                errno == ERANGE || Value == 0 || (ULONG)Value != Value)
+            {
+                fprintf(stderr, "Invalid subkey count '%s', expected a positive number.\n", Count);
+                return -1;
+            }
+            BenchmarkSubKeys = (ULONG)Value;
+        }
         else
         {
             fprintf(stderr, "Unrecognized option: %s\n", argv[i]);
@@ -138,6 +252,10 @@ int main(int argc, char *argv[])
         }
     }
 
+    /* The benchmark does not need anything else */
+    if (BenchmarkSubKeys)
+        return BenchmarkLookups(BenchmarkSubKeys);
+
     /* Check whether we have all the parameters needed */
     if (!HiveList || !*HiveList)
     {
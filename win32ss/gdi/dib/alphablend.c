@@ -11,22 +11,174 @@
 #define NDEBUG
 #include <debug.h>
 
-typedef union
+/*
+ * The blend works on a whole row of pixels at a time. Source rows are read
+ * and translated with one XLATEOBJ_vXlateSpan call, then the four channels
+ * of a pixel are blended together in the 16 bit lanes of a ULONGLONG.
+ */
+
+#define LANES_LOW_BYTES 0x00FF00FF00FF00FFULL
+#define LANES_ONE       0x0001000100010001ULL
+
+/* Spreads the four bytes of a pixel into 16 bit lanes */
+static __inline ULONGLONG
+AlphaUnpack(ULONG ulPixel)
+{
+  ULONGLONG ullLanes = ulPixel;
+
+  ullLanes = (ullLanes | (ullLanes << 16)) & 0x0000FFFF0000FFFFULL;
+  return (ullLanes | (ullLanes << 8)) & LANES_LOW_BYTES;
+}
+
+static __inline ULONG
+AlphaPack(ULONGLONG ullLanes)
+{
+  ullLanes = (ullLanes | (ullLanes >> 8)) & 0x0000FFFF0000FFFFULL;
+  return (ULONG)(ullLanes | (ullLanes >> 16));
+}
+
+/* Divides every lane by 255, rounding down. Exact for lanes up to 255 * 255 */
+static __inline ULONGLONG
+AlphaDiv255(ULONGLONG ullLanes)
+{
+  return ((ullLanes + LANES_ONE + ((ullLanes >> 8) & LANES_LOW_BYTES)) >> 8) & LANES_LOW_BYTES;
+}
+
+/* Clamps lanes of up to 2 * 255 to 255 */
+static __inline ULONGLONG
+AlphaSaturate(ULONGLONG ullLanes)
+{
+  return (ullLanes | (((ullLanes >> 8) & LANES_ONE) * 0xFF)) & LANES_LOW_BYTES;
+}
+
+/* Scales the source by the constant alpha. Without source alpha, alpha is the constant */
+static __inline ULONGLONG
+AlphaScaleSource(ULONG ulSource, ULONG ConstAlpha, BOOLEAN bSourceAlpha)
+{
+  ULONGLONG ullSource = AlphaUnpack(ulSource);
+
+  if (ConstAlpha != 255)
+    ullSource = AlphaDiv255(ullSource * ConstAlpha);
+
+  if (!bSourceAlpha)
+    ullSource = (ullSource & 0x0000FFFFFFFFFFFFULL) | ((ULONGLONG)ConstAlpha << 48);
+
+  return ullSource;
+}
+
+/* Same alpha for every pixel */
+static VOID
+AlphaBlendLineConst(PULONG pulDest, const ULONG *pulSource, LONG cPixels,
+                    ULONG ConstAlpha, BOOLEAN bSourceAlpha)
 {
-  ULONG ul;
-  struct
+  ULONGLONG ullSource, ullDest;
+  LONG i;
+
+  for (i = 0; i < cPixels; i++)
   {
-    UCHAR red;
-    UCHAR green;
-    UCHAR blue;
-    UCHAR alpha;
-  } col;
-} NICEPIXEL32;
-
-static __inline UCHAR
-Clamp8(ULONG val)
+    ullSource = AlphaScaleSource(pulSource[i], ConstAlpha, bSourceAlpha);
+    if (ConstAlpha == 255)
+    {
+      pulDest[i] = AlphaPack(ullSource);
+      continue;
+    }
+
+    ullDest = AlphaDiv255(AlphaUnpack(pulDest[i]) * (255 - ConstAlpha));
+    pulDest[i] = AlphaPack(AlphaSaturate(ullDest + ullSource));
+  }
+}
+
+/* Alpha from every source pixel, scaled by the constant alpha */
+static VOID
+AlphaBlendLinePerPixel(PULONG pulDest, const ULONG *pulSource, LONG cPixels,
+                       ULONG ConstAlpha)
 {
-  return (val > 255) ? 255 : (UCHAR)val;
+  ULONGLONG ullSource, ullDest;
+  ULONG Alpha;
+  LONG i;
+
+  for (i = 0; i < cPixels; i++)
+  {
+    ullSource = AlphaScaleSource(pulSource[i], ConstAlpha, TRUE);
+    Alpha = (ULONG)(ullSource >> 48);
+
+    /* Opaque and fully transparent pixels are the common case for icons and themes */
+    if (Alpha == 255)
+    {
+      pulDest[i] = AlphaPack(ullSource);
+      continue;
+    }
+    if (ullSource == 0)
+      continue;
+
+    ullDest = AlphaUnpack(pulDest[i]);
+    if (Alpha != 0)
+      ullDest = AlphaDiv255(ullDest * (255 - Alpha));
+    pulDest[i] = AlphaPack(AlphaSaturate(ullDest + ullSource));
+  }
+}
+
+/*
+ * Blends a row of source pixels over 32 bpp pixels with 8 bit channels.
+ * bSourceAlpha tells if the source has an alpha channel. Without one,
+ * AC_SRC_ALPHA is ignored and the constant alpha is used.
+ */
+VOID
+DIB_AlphaBlendLine(PULONG pulDest, const ULONG *pulSource, LONG cPixels,
+                   BLENDFUNCTION BlendFunc, BOOLEAN bSourceAlpha)
+{
+  if ((BlendFunc.AlphaFormat & AC_SRC_ALPHA) && bSourceAlpha)
+    AlphaBlendLinePerPixel(pulDest, pulSource, cPixels, BlendFunc.SourceConstantAlpha);
+  else
+    AlphaBlendLineConst(pulDest, pulSource, cPixels, BlendFunc.SourceConstantAlpha, bSourceAlpha);
+}
+
+/*
+ * Reads the source pixels for cPixels destination pixels starting at DstX
+ * and translates them with ColorTranslation.
+ */
+VOID
+DIB_AlphaBlendFetch(SURFOBJ* Source, RECTL* SourceRect, RECTL* DestRect,
+                    LONG SrcY, LONG DstX, LONG cPixels,
+                    XLATEOBJ* ColorTranslation, PULONG pulLine)
+{
+  LONG SrcWidth = SourceRect->right - SourceRect->left;
+  LONG DstWidth = DestRect->right - DestRect->left;
+  LONG i, SrcX, Step, Remainder, Error;
+  PFN_DIB_GetPixel pfnGetPixel;
+
+  if (SrcWidth == DstWidth && Source->iBitmapFormat == BMF_32BPP)
+  {
+    RtlCopyMemory(pulLine,
+                  (PBYTE)Source->pvScan0 + SrcY * Source->lDelta +
+                  4 * (SourceRect->left + DstX - DestRect->left),
+                  4 * cPixels);
+  }
+  else
+  {
+    pfnGetPixel = DibFunctionsForBitmapFormat[Source->iBitmapFormat].DIB_GetPixel;
+
+    /* Same as SourceRect->left + x * SrcWidth / DstWidth, stepped without divisions */
+    i = DstX - DestRect->left;
+    SrcX = SourceRect->left + (LONG)(((LONGLONG)i * SrcWidth) / DstWidth);
+    Error = (LONG)(((LONGLONG)i * SrcWidth) % DstWidth);
+    Step = SrcWidth / DstWidth;
+    Remainder = SrcWidth % DstWidth;
+
+    for (i = 0; i < cPixels; i++)
+    {
+      pulLine[i] = pfnGetPixel(Source, SrcX, SrcY);
+      SrcX += Step;
+      Error += Remainder;
+      if (Error >= DstWidth)
+      {
+        Error -= DstWidth;
+        SrcX++;
+      }
+    }
+  }
+
+  XLATEOBJ_vXlateSpan(ColorTranslation, pulLine, pulLine, cPixels);
 }
 
 BOOLEAN
@@ -34,16 +186,17 @@ DIB_XXBPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
                      RECTL* SourceRect, CLIPOBJ* ClipRegion,
                      XLATEOBJ* ColorTranslation, BLENDOBJ* BlendObj)
 {
-  INT DstX, DstY, SrcX, SrcY;
+  INT DstX, DstY, SrcY, cPixels;
   BLENDFUNCTION BlendFunc;
-  register NICEPIXEL32 DstPixel32;
-  register NICEPIXEL32 SrcPixel32;
-  UCHAR Alpha, SrcBpp = BitsPerFormat(Source->iBitmapFormat);
+  ULONG aulSource[ALPHABLEND_CHUNK], aulDest[ALPHABLEND_CHUNK], aulAlpha[ALPHABLEND_CHUNK];
+  UCHAR SrcBpp = BitsPerFormat(Source->iBitmapFormat);
   EXLATEOBJ* pexlo;
   EXLATEOBJ exloSrcRGB, exloDstRGB, exloRGBSrc;
+  PFN_DIB_GetPixel pfnDibGetPixel = DibFunctionsForBitmapFormat[Dest->iBitmapFormat].DIB_GetPixel;
   PFN_DIB_PutPixel pfnDibPutPixel = DibFunctionsForBitmapFormat[Dest->iBitmapFormat].DIB_PutPixel;
+  INT i;
 
-  DPRINT("DIB_16BPP_AlphaBlend: srcRect: (%d,%d)-(%d,%d), dstRect: (%d,%d)-(%d,%d)\n",
+  DPRINT("DIB_XXBPP_AlphaBlend: srcRect: (%d,%d)-(%d,%d), dstRect: (%d,%d)-(%d,%d)\n",
     SourceRect->left, SourceRect->top, SourceRect->right, SourceRect->bottom,
     DestRect->left, DestRect->top, DestRect->right, DestRect->bottom);
 
@@ -81,37 +234,35 @@ DIB_XXBPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
   EXLATEOBJ_vInitialize(&exloDstRGB, pexlo->ppalDst, &gpalRGB, 0, 0, 0);
   EXLATEOBJ_vInitialize(&exloRGBSrc, &gpalRGB, pexlo->ppalSrc, 0, 0, 0);
 
-  SrcY = SourceRect->top;
-  DstY = DestRect->top;
-  while ( DstY < DestRect->bottom )
+  for (DstY = DestRect->top; DstY < DestRect->bottom; DstY++)
   {
-    SrcX = SourceRect->left;
-    DstX = DestRect->left;
-    while(DstX < DestRect->right)
+    SrcY = SourceRect->top + ((DstY - DestRect->top) * (SourceRect->bottom - SourceRect->top))
+                                            / (DestRect->bottom - DestRect->top);
+
+    for (DstX = DestRect->left; DstX < DestRect->right; DstX += cPixels)
     {
-      SrcPixel32.ul = DIB_GetSource(Source, SrcX, SrcY, &exloSrcRGB.xlo);
-      SrcPixel32.col.red = (SrcPixel32.col.red * BlendFunc.SourceConstantAlpha) / 255;
-      SrcPixel32.col.green = (SrcPixel32.col.green * BlendFunc.SourceConstantAlpha) / 255;
-      SrcPixel32.col.blue = (SrcPixel32.col.blue * BlendFunc.SourceConstantAlpha) / 255;
-
-      Alpha = ((BlendFunc.AlphaFormat & AC_SRC_ALPHA) != 0) ?
-           (SrcPixel32.col.alpha * BlendFunc.SourceConstantAlpha) / 255 :
-           BlendFunc.SourceConstantAlpha ;
-
-      DstPixel32.ul = DIB_GetSource(Dest, DstX, DstY, &exloDstRGB.xlo);
-      DstPixel32.col.red = Clamp8((DstPixel32.col.red * (255 - Alpha)) / 255 + SrcPixel32.col.red) ;
-      DstPixel32.col.green = Clamp8((DstPixel32.col.green * (255 - Alpha)) / 255 + SrcPixel32.col.green) ;
-      DstPixel32.col.blue = Clamp8((DstPixel32.col.blue * (255 - Alpha)) / 255 + SrcPixel32.col.blue) ;
-      DstPixel32.ul = XLATEOBJ_iXlate(&exloRGBSrc.xlo, DstPixel32.ul);
-      pfnDibPutPixel(Dest, DstX, DstY, XLATEOBJ_iXlate(ColorTranslation, DstPixel32.ul));
-
-      DstX++;
-      SrcX = SourceRect->left + ((DstX-DestRect->left)*(SourceRect->right - SourceRect->left))
-                                            /(DestRect->right-DestRect->left);
+      cPixels = min(DestRect->right - DstX, ALPHABLEND_CHUNK);
+
+      DIB_AlphaBlendFetch(Source, SourceRect, DestRect, SrcY, DstX, cPixels,
+                          &exloSrcRGB.xlo, aulSource);
+
+      for (i = 0; i < cPixels; i++)
+        aulDest[i] = pfnDibGetPixel(Dest, DstX + i, DstY);
+      XLATEOBJ_vXlateSpan(&exloDstRGB.xlo, aulDest, aulDest, cPixels);
+
+      /* Only the colors are blended, keep what the translation gave as alpha */
+      for (i = 0; i < cPixels; i++)
+        aulAlpha[i] = aulDest[i] & 0xFF000000;
+      DIB_AlphaBlendLine(aulDest, aulSource, cPixels, BlendFunc, SrcBpp == 32);
+      for (i = 0; i < cPixels; i++)
+        aulDest[i] = (aulDest[i] & 0x00FFFFFF) | aulAlpha[i];
+
+      XLATEOBJ_vXlateSpan(&exloRGBSrc.xlo, aulDest, aulDest, cPixels);
+      XLATEOBJ_vXlateSpan(ColorTranslation, aulDest, aulDest, cPixels);
+
+      for (i = 0; i < cPixels; i++)
+        pfnDibPutPixel(Dest, DstX + i, DstY, aulDest[i]);
     }
-    DstY++;
-    SrcY = SourceRect->top + ((DstY-DestRect->top)*(SourceRect->bottom - SourceRect->top))
-                                            /(DestRect->bottom-DestRect->top);
   }
 
   EXLATEOBJ_vCleanup(&exloDstRGB);
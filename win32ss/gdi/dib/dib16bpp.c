@@ -136,6 +136,46 @@ DIB_16BPP_VLine(SURFOBJ *SurfObj, LONG x, LONG y1, LONG y2, ULONG c)
 #endif
 }
 
+#define XLATE_CHUNK 64
+
+/* Translates a line of 16, 24 or 32 bpp pixels into 16 bpp, a chunk at a time */
+static VOID
+DIB_16BPP_XlateLine(XLATEOBJ *pxlo, PWORD pwDst, PBYTE pjSrc, ULONG iSrcFormat, LONG cx)
+{
+  ULONG aulLine[XLATE_CHUNK];
+  LONG i, cPixels;
+
+  while (cx > 0)
+  {
+    cPixels = min(cx, XLATE_CHUNK);
+
+    switch (iSrcFormat)
+    {
+    case BMF_16BPP:
+      for (i = 0; i < cPixels; i++)
+        aulLine[i] = ((PWORD)pjSrc)[i];
+      pjSrc += 2 * cPixels;
+      break;
+    case BMF_24BPP:
+      for (i = 0; i < cPixels; i++, pjSrc += 3)
+        aulLine[i] = (pjSrc[2] << 0x10) + (pjSrc[1] << 0x08) + pjSrc[0];
+      break;
+    default:
+      RtlCopyMemory(aulLine, pjSrc, 4 * cPixels);
+      pjSrc += 4 * cPixels;
+      break;
+    }
+
+    XLATEOBJ_vXlateSpan(pxlo, aulLine, aulLine, cPixels);
+
+    for (i = 0; i < cPixels; i++)
+      pwDst[i] = (WORD)aulLine[i];
+
+    pwDst += cPixels;
+    cx -= cPixels;
+  }
+}
+
 BOOLEAN
 DIB_16BPP_BitBltSrcCopy(PBLTINFO BltInfo)
 {
@@ -283,17 +323,9 @@ DIB_16BPP_BitBltSrcCopy(PBLTINFO BltInfo)
         DestLine = DestBits;
         for (j = BltInfo->DestRect.top; j < BltInfo->DestRect.bottom; j++)
         {
-          SourceBits = SourceLine;
-          DestBits = DestLine;
-          for (i = BltInfo->DestRect.left; i <
-            BltInfo->DestRect.right; i++)
-          {
-            *((WORD *)DestBits) = (WORD)XLATEOBJ_iXlate(
-              BltInfo->XlateSourceToDest,
-              *((WORD *)SourceBits));
-            SourceBits += 2;
-            DestBits += 2;
-          }
+          DIB_16BPP_XlateLine(BltInfo->XlateSourceToDest,
+            (PWORD)DestLine, SourceLine, BMF_16BPP,
+            BltInfo->DestRect.right - BltInfo->DestRect.left);
           SourceLine += BltInfo->SourceSurface->lDelta;
           DestLine += BltInfo->DestSurface->lDelta;
         }
@@ -315,17 +347,9 @@ DIB_16BPP_BitBltSrcCopy(PBLTINFO BltInfo)
         for (j = BltInfo->DestRect.bottom - 1;
           BltInfo->DestRect.top <= j; j--)
         {
-          SourceBits = SourceLine;
-          DestBits = DestLine;
-          for (i = BltInfo->DestRect.left; i <
-            BltInfo->DestRect.right; i++)
-          {
-            *((WORD *)DestBits) = (WORD)XLATEOBJ_iXlate(
-              BltInfo->XlateSourceToDest,
-              *((WORD *)SourceBits));
-            SourceBits += 2;
-            DestBits += 2;
-          }
+          DIB_16BPP_XlateLine(BltInfo->XlateSourceToDest,
+            (PWORD)DestLine, SourceLine, BMF_16BPP,
+            BltInfo->DestRect.right - BltInfo->DestRect.left);
           SourceLine -= BltInfo->SourceSurface->lDelta;
           DestLine -= BltInfo->DestSurface->lDelta;
         }
@@ -342,20 +366,9 @@ DIB_16BPP_BitBltSrcCopy(PBLTINFO BltInfo)
 
     for (j = BltInfo->DestRect.top; j < BltInfo->DestRect.bottom; j++)
     {
-      SourceBits = SourceLine;
-      DestBits = DestLine;
-
-      for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
-      {
-        xColor = (*(SourceBits + 2) << 0x10) +
-          (*(SourceBits + 1) << 0x08) + (*(SourceBits));
-
-        *((WORD *)DestBits) = (WORD)XLATEOBJ_iXlate(
-          BltInfo->XlateSourceToDest, xColor);
-
-        SourceBits += 3;
-        DestBits += 2;
-      }
+      DIB_16BPP_XlateLine(BltInfo->XlateSourceToDest,
+        (PWORD)DestLine, SourceLine, BMF_24BPP,
+        BltInfo->DestRect.right - BltInfo->DestRect.left);
       SourceLine += BltInfo->SourceSurface->lDelta;
       DestLine += BltInfo->DestSurface->lDelta;
     }
@@ -370,17 +383,9 @@ DIB_16BPP_BitBltSrcCopy(PBLTINFO BltInfo)
 
     for (j = BltInfo->DestRect.top; j < BltInfo->DestRect.bottom; j++)
     {
-      SourceBits = SourceLine;
-      DestBits = DestLine;
-
-      for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
-      {
-        *((WORD *)DestBits) = (WORD)XLATEOBJ_iXlate(
-          BltInfo->XlateSourceToDest,
-          *((PDWORD) SourceBits));
-        SourceBits += 4;
-        DestBits += 2;
-      }
+      DIB_16BPP_XlateLine(BltInfo->XlateSourceToDest,
+        (PWORD)DestLine, SourceLine, BMF_32BPP,
+        BltInfo->DestRect.right - BltInfo->DestRect.left);
 
       SourceLine += BltInfo->SourceSurface->lDelta;
       DestLine += BltInfo->DestSurface->lDelta;
@@ -577,9 +582,12 @@ DIB_16BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
                      RECTL* SourceRect, CLIPOBJ* ClipRegion,
                      XLATEOBJ* ColorTranslation, BLENDOBJ* BlendObj)
 {
-  INT DstX, DstY, SrcX, SrcY;
+  INT DstX, DstY, SrcY, cPixels, i;
   BLENDFUNCTION BlendFunc;
   NICEPIXEL32 SrcPixel32;
+  ULONG aulSource[ALPHABLEND_CHUNK];
+  PUSHORT pusDest;
+  BOOLEAN b555;
   UCHAR Alpha;
   EXLATEOBJ* pexlo;
   EXLATEOBJ exloSrcRGB;
@@ -619,31 +627,39 @@ DIB_16BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
 
   pexlo = CONTAINING_RECORD(ColorTranslation, EXLATEOBJ, xlo);
   EXLATEOBJ_vInitialize(&exloSrcRGB, pexlo->ppalSrc, &gpalRGB, 0, 0, 0);
+  b555 = (pexlo->ppalDst->flFlags & PAL_RGB16_555) != 0;
 
-  if (pexlo->ppalDst->flFlags & PAL_RGB16_555)
+  for (DstY = DestRect->top; DstY < DestRect->bottom; DstY++)
   {
-      NICEPIXEL16_555 DstPixel16;
+    SrcY = SourceRect->top + ((DstY - DestRect->top) * (SourceRect->bottom - SourceRect->top))
+                                            / (DestRect->bottom - DestRect->top);
+    pusDest = (PUSHORT)((ULONG_PTR)Dest->pvScan0 + DstY * Dest->lDelta);
+
+    for (DstX = DestRect->left; DstX < DestRect->right; DstX += cPixels)
+    {
+      cPixels = min(DestRect->right - DstX, ALPHABLEND_CHUNK);
 
-      SrcY = SourceRect->top;
-      DstY = DestRect->top;
-      while ( DstY < DestRect->bottom )
+      DIB_AlphaBlendFetch(Source, SourceRect, DestRect, SrcY, DstX, cPixels,
+                          &exloSrcRGB.xlo, aulSource);
+
+      for (i = 0; i < cPixels; i++)
       {
-        SrcX = SourceRect->left;
-        DstX = DestRect->left;
-        while(DstX < DestRect->right)
-        {
-          SrcPixel32.ul = DIB_GetSource(Source, SrcX, SrcY, &exloSrcRGB.xlo);
-          SrcPixel32.col.red = (SrcPixel32.col.red * BlendFunc.SourceConstantAlpha) / 255;
-          SrcPixel32.col.green = (SrcPixel32.col.green * BlendFunc.SourceConstantAlpha) / 255;
-          SrcPixel32.col.blue = (SrcPixel32.col.blue * BlendFunc.SourceConstantAlpha) / 255;
+        SrcPixel32.ul = aulSource[i];
+        SrcPixel32.col.red = (SrcPixel32.col.red * BlendFunc.SourceConstantAlpha) / 255;
+        SrcPixel32.col.green = (SrcPixel32.col.green * BlendFunc.SourceConstantAlpha) / 255;
+        SrcPixel32.col.blue = (SrcPixel32.col.blue * BlendFunc.SourceConstantAlpha) / 255;
 
-          Alpha = ((BlendFunc.AlphaFormat & AC_SRC_ALPHA) != 0) ?
-               (SrcPixel32.col.alpha * BlendFunc.SourceConstantAlpha) / 255 :
-               BlendFunc.SourceConstantAlpha;
+        Alpha = ((BlendFunc.AlphaFormat & AC_SRC_ALPHA) != 0) ?
+             (SrcPixel32.col.alpha * BlendFunc.SourceConstantAlpha) / 255 :
+             BlendFunc.SourceConstantAlpha;
+
+        if (b555)
+        {
+          NICEPIXEL16_555 DstPixel16;
 
           Alpha >>= 3;
 
-          DstPixel16.us = DIB_16BPP_GetPixel(Dest, DstX, DstY) & 0xFFFF;
+          DstPixel16.us = pusDest[DstX + i];
           /* Perform bit loss */
           SrcPixel32.col.red >>= 3;
           SrcPixel32.col.green >>= 3;
@@ -654,43 +670,17 @@ DIB_16BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
           DstPixel16.col.green = Clamp5((DstPixel16.col.green * (31 - Alpha)) / 31 + SrcPixel32.col.green);
           DstPixel16.col.blue = Clamp5((DstPixel16.col.blue * (31 - Alpha)) / 31 + SrcPixel32.col.blue);
 
-          DIB_16BPP_PutPixel(Dest, DstX, DstY, DstPixel16.us);
-
-          DstX++;
-          SrcX = SourceRect->left + ((DstX-DestRect->left)*(SourceRect->right - SourceRect->left))
-                                                /(DestRect->right-DestRect->left);
+          pusDest[DstX + i] = DstPixel16.us;
         }
-        DstY++;
-        SrcY = SourceRect->top + ((DstY-DestRect->top)*(SourceRect->bottom - SourceRect->top))
-                                                /(DestRect->bottom-DestRect->top);
-      }
-  }
-  else
-  {
-      NICEPIXEL16_565 DstPixel16;
-      UCHAR Alpha6, Alpha5;
-
-      SrcY = SourceRect->top;
-      DstY = DestRect->top;
-      while ( DstY < DestRect->bottom )
-      {
-        SrcX = SourceRect->left;
-        DstX = DestRect->left;
-        while(DstX < DestRect->right)
+        else
         {
-          SrcPixel32.ul = DIB_GetSource(Source, SrcX, SrcY, &exloSrcRGB.xlo);
-          SrcPixel32.col.red = (SrcPixel32.col.red * BlendFunc.SourceConstantAlpha) / 255;
-          SrcPixel32.col.green = (SrcPixel32.col.green * BlendFunc.SourceConstantAlpha) / 255;
-          SrcPixel32.col.blue = (SrcPixel32.col.blue * BlendFunc.SourceConstantAlpha) / 255;
-
-          Alpha = ((BlendFunc.AlphaFormat & AC_SRC_ALPHA) != 0) ?
-               (SrcPixel32.col.alpha * BlendFunc.SourceConstantAlpha) / 255 :
-               BlendFunc.SourceConstantAlpha;
+          NICEPIXEL16_565 DstPixel16;
+          UCHAR Alpha6, Alpha5;
 
           Alpha6 = Alpha >> 2;
           Alpha5 = Alpha >> 3;
 
-          DstPixel16.us = DIB_16BPP_GetPixel(Dest, DstX, DstY) & 0xFFFF;
+          DstPixel16.us = pusDest[DstX + i];
           /* Perform bit loss */
           SrcPixel32.col.red >>= 3;
           SrcPixel32.col.green >>= 2;
@@ -701,16 +691,10 @@ DIB_16BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
           DstPixel16.col.green = Clamp6((DstPixel16.col.green * (63 - Alpha6)) / 63 + SrcPixel32.col.green);
           DstPixel16.col.blue = Clamp5((DstPixel16.col.blue * (31 - Alpha5)) / 31 + SrcPixel32.col.blue);
 
-          DIB_16BPP_PutPixel(Dest, DstX, DstY, DstPixel16.us);
-
-          DstX++;
-          SrcX = SourceRect->left + ((DstX-DestRect->left)*(SourceRect->right - SourceRect->left))
-                                                /(DestRect->right-DestRect->left);
+          pusDest[DstX + i] = DstPixel16.us;
         }
-        DstY++;
-        SrcY = SourceRect->top + ((DstY-DestRect->top)*(SourceRect->bottom - SourceRect->top))
-                                                /(DestRect->bottom-DestRect->top);
       }
+    }
   }
 
   EXLATEOBJ_vCleanup(&exloSrcRGB);
@@ -53,6 +53,7 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
   PBYTE    SourceBits, DestBits, SourceLine, DestLine;
   PBYTE    SourceBits_4BPP, SourceLine_4BPP;
   PDWORD   Source32, Dest32;
+  LONG     cx = BltInfo->DestRect.right - BltInfo->DestRect.left;
 
   DestBits = (PBYTE)BltInfo->DestSurface->pvScan0
     + (BltInfo->DestRect.top * BltInfo->DestSurface->lDelta)
@@ -120,13 +121,11 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
       SourceBits = SourceLine;
       DestBits = DestLine;
 
-      for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
-      {
-        xColor = *SourceBits;
-        *((PDWORD) DestBits) = (DWORD)XLATEOBJ_iXlate(BltInfo->XlateSourceToDest, xColor);
-        SourceBits += 1;
-        DestBits += 4;
-      }
+      /* Widen the source line into the destination and translate it there */
+      Dest32 = (PDWORD)DestBits;
+      for (i = 0; i < cx; i++)
+        Dest32[i] = SourceBits[i];
+      XLATEOBJ_vXlateSpan(BltInfo->XlateSourceToDest, Dest32, Dest32, cx);
 
       SourceLine += BltInfo->SourceSurface->lDelta;
       DestLine += BltInfo->DestSurface->lDelta;
@@ -142,13 +141,10 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
       SourceBits = SourceLine;
       DestBits = DestLine;
 
-      for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
-      {
-        xColor = *((PWORD) SourceBits);
-        *((PDWORD) DestBits) = (DWORD)XLATEOBJ_iXlate(BltInfo->XlateSourceToDest, xColor);
-        SourceBits += 2;
-        DestBits += 4;
-      }
+      Dest32 = (PDWORD)DestBits;
+      for (i = 0; i < cx; i++)
+        Dest32[i] = ((PWORD)SourceBits)[i];
+      XLATEOBJ_vXlateSpan(BltInfo->XlateSourceToDest, Dest32, Dest32, cx);
 
       SourceLine += BltInfo->SourceSurface->lDelta;
       DestLine += BltInfo->DestSurface->lDelta;
@@ -166,15 +162,15 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
       SourceBits = SourceLine;
       DestBits = DestLine;
 
-      for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
+      Dest32 = (PDWORD)DestBits;
+      for (i = 0; i < cx; i++)
       {
-        xColor = (*(SourceBits + 2) << 0x10) +
+        Dest32[i] = (*(SourceBits + 2) << 0x10) +
           (*(SourceBits + 1) << 0x08) +
           (*(SourceBits));
-        *((PDWORD)DestBits) = (DWORD)XLATEOBJ_iXlate(BltInfo->XlateSourceToDest, xColor);
         SourceBits += 3;
-        DestBits += 4;
       }
+      XLATEOBJ_vXlateSpan(BltInfo->XlateSourceToDest, Dest32, Dest32, cx);
 
       SourceLine += BltInfo->SourceSurface->lDelta;
       DestLine += BltInfo->DestSurface->lDelta;
@@ -218,14 +214,12 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
         SourceBits = ((PBYTE)BltInfo->SourceSurface->pvScan0 + (BltInfo->SourcePoint.y * BltInfo->SourceSurface->lDelta) + 4 * BltInfo->SourcePoint.x);
         for (j = BltInfo->DestRect.top; j < BltInfo->DestRect.bottom; j++)
         {
-          if (BltInfo->DestRect.left < BltInfo->SourcePoint.x)
+          /* Going left to right is safe unless the line overlaps itself */
+          if (BltInfo->SourceSurface != BltInfo->DestSurface ||
+              BltInfo->DestRect.left < BltInfo->SourcePoint.x)
           {
-            Dest32 = (DWORD *) DestBits;
-            Source32 = (DWORD *) SourceBits;
-            for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
-            {
-              *Dest32++ = XLATEOBJ_iXlate(BltInfo->XlateSourceToDest, *Source32++);
-            }
+            XLATEOBJ_vXlateSpan(BltInfo->XlateSourceToDest,
+                                (PDWORD)DestBits, (PDWORD)SourceBits, cx);
           }
           else
           {
@@ -246,14 +240,12 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
         DestBits = (PBYTE)BltInfo->DestSurface->pvScan0 + ((BltInfo->DestRect.bottom - 1) * BltInfo->DestSurface->lDelta) + 4 * BltInfo->DestRect.left;
         for (j = BltInfo->DestRect.bottom - 1; BltInfo->DestRect.top <= j; j--)
         {
-          if (BltInfo->DestRect.left < BltInfo->SourcePoint.x)
+          /* Going left to right is safe unless the line overlaps itself */
+          if (BltInfo->SourceSurface != BltInfo->DestSurface ||
+              BltInfo->DestRect.left < BltInfo->SourcePoint.x)
           {
-            Dest32 = (DWORD *) DestBits;
-            Source32 = (DWORD *) SourceBits;
-            for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
-            {
-              *Dest32++ = XLATEOBJ_iXlate(BltInfo->XlateSourceToDest, *Source32++);
-            }
+            XLATEOBJ_vXlateSpan(BltInfo->XlateSourceToDest,
+                                (PDWORD)DestBits, (PDWORD)SourceBits, cx);
           }
           else
           {
@@ -325,32 +317,16 @@ DIB_32BPP_TransparentBlt(SURFOBJ *DestSurf, SURFOBJ *SourceSurf,
   return TRUE;
 }
 
-typedef union {
-  ULONG ul;
-  struct {
-    UCHAR red;
-    UCHAR green;
-    UCHAR blue;
-    UCHAR alpha;
-  } col;
-} NICEPIXEL32;
-
-static __inline UCHAR
-Clamp8(ULONG val)
-{
-  return (val > 255) ? 255 : (UCHAR)val;
-}
-
 BOOLEAN
 DIB_32BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
                      RECTL* SourceRect, CLIPOBJ* ClipRegion,
                      XLATEOBJ* ColorTranslation, BLENDOBJ* BlendObj)
 {
-  INT Rows, Cols, SrcX, SrcY;
-  register PULONG Dst;
+  INT DstX, DstY, SrcY, cPixels;
+  PULONG Dst;
   BLENDFUNCTION BlendFunc;
-  register NICEPIXEL32 DstPixel, SrcPixel;
-  UCHAR Alpha, SrcBpp;
+  ULONG aulSource[ALPHABLEND_CHUNK];
+  UCHAR SrcBpp;
 
   DPRINT("DIB_32BPP_AlphaBlend: srcRect: (%d,%d)-(%d,%d), dstRect: (%d,%d)-(%d,%d)\n",
     SourceRect->left, SourceRect->top, SourceRect->right, SourceRect->bottom,
@@ -379,40 +355,22 @@ DIB_32BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
     return FALSE;
   }
 
-  Dst = (PULONG)((ULONG_PTR)Dest->pvScan0 + (DestRect->top * Dest->lDelta) +
-    (DestRect->left << 2));
   SrcBpp = BitsPerFormat(Source->iBitmapFormat);
 
-  Rows = 0;
-   SrcY = SourceRect->top;
-   while (++Rows <= DestRect->bottom - DestRect->top)
+  for (DstY = DestRect->top; DstY < DestRect->bottom; DstY++)
   {
-    Cols = 0;
-    SrcX = SourceRect->left;
-    while (++Cols <= DestRect->right - DestRect->left)
+    SrcY = SourceRect->top + ((DstY - DestRect->top) * (SourceRect->bottom - SourceRect->top))
+                                            / (DestRect->bottom - DestRect->top);
+    Dst = (PULONG)((ULONG_PTR)Dest->pvScan0 + (DstY * Dest->lDelta));
+
+    for (DstX = DestRect->left; DstX < DestRect->right; DstX += cPixels)
     {
-      SrcPixel.ul = DIB_GetSource(Source, SrcX, SrcY, ColorTranslation);
-      SrcPixel.col.red = (SrcPixel.col.red * BlendFunc.SourceConstantAlpha) / 255;
-      SrcPixel.col.green = (SrcPixel.col.green * BlendFunc.SourceConstantAlpha)  / 255;
-      SrcPixel.col.blue = (SrcPixel.col.blue * BlendFunc.SourceConstantAlpha) / 255;
-      SrcPixel.col.alpha = (32 == SrcBpp) ?
-                        (SrcPixel.col.alpha * BlendFunc.SourceConstantAlpha) / 255 :
-                        BlendFunc.SourceConstantAlpha ;
-
-      Alpha = ((BlendFunc.AlphaFormat & AC_SRC_ALPHA) != 0) ?
-           SrcPixel.col.alpha : BlendFunc.SourceConstantAlpha ;
-
-      DstPixel.ul = *Dst;
-      DstPixel.col.red = Clamp8((DstPixel.col.red * (255 - Alpha)) / 255 + SrcPixel.col.red) ;
-      DstPixel.col.green = Clamp8((DstPixel.col.green * (255 - Alpha)) / 255 + SrcPixel.col.green) ;
-      DstPixel.col.blue = Clamp8((DstPixel.col.blue * (255 - Alpha)) / 255 + SrcPixel.col.blue) ;
-      DstPixel.col.alpha = Clamp8((DstPixel.col.alpha * (255 - Alpha)) / 255 + SrcPixel.col.alpha) ;
-      *Dst++ = DstPixel.ul;
-      SrcX = SourceRect->left + (Cols*(SourceRect->right - SourceRect->left))/(DestRect->right - DestRect->left);
+      cPixels = min(DestRect->right - DstX, ALPHABLEND_CHUNK);
+
+      DIB_AlphaBlendFetch(Source, SourceRect, DestRect, SrcY, DstX, cPixels,
+                          ColorTranslation, aulSource);
+      DIB_AlphaBlendLine(Dst + DstX, aulSource, cPixels, BlendFunc, SrcBpp == 32);
     }
-    Dst = (PULONG)((ULONG_PTR)Dest->pvScan0 + ((DestRect->top + Rows) * Dest->lDelta) +
-                (DestRect->left << 2));
-    SrcY = SourceRect->top + (Rows*(SourceRect->bottom - SourceRect->top))/(DestRect->bottom - DestRect->top);
   }
 
   return TRUE;
@@ -13,6 +13,471 @@
 #define NDEBUG
 #include <debug.h>
 
+/*
+ * Scaled source copies are done a scanline at a time: the source pixels of
+ * a line are picked through a precomputed column table, translated with one
+ * XLATEOBJ_vXlateSpan call and stored with format specific loops, instead of
+ * going through the GetPixel/PutPixel function pointers for every pixel.
+ */
+
+#define STACK_STRETCH_COLUMNS 128
+
+typedef VOID (*PFN_STRETCH_FETCH)(PBYTE, PLONG, PULONG, LONG);
+
+static VOID
+StretchFetch1BPP(PBYTE pjLine, PLONG plColumns, PULONG pulLine, LONG cx)
+{
+  LONG x, sx;
+
+  for (x = 0; x < cx; x++)
+  {
+    sx = plColumns[x];
+    pulLine[x] = (pjLine[sx >> 3] & MASK1BPP(sx)) ? 1 : 0;
+  }
+}
+
+static VOID
+StretchFetch4BPP(PBYTE pjLine, PLONG plColumns, PULONG pulLine, LONG cx)
+{
+  LONG x, sx;
+
+  for (x = 0; x < cx; x++)
+  {
+    sx = plColumns[x];
+    pulLine[x] = (pjLine[sx >> 1] >> ((1 - (sx & 1)) << 2)) & 0x0F;
+  }
+}
+
+static VOID
+StretchFetch8BPP(PBYTE pjLine, PLONG plColumns, PULONG pulLine, LONG cx)
+{
+  LONG x;
+
+  for (x = 0; x < cx; x++)
+    pulLine[x] = pjLine[plColumns[x]];
+}
+
+static VOID
+StretchFetch16BPP(PBYTE pjLine, PLONG plColumns, PULONG pulLine, LONG cx)
+{
+  LONG x;
+
+  for (x = 0; x < cx; x++)
+    pulLine[x] = ((PUSHORT)pjLine)[plColumns[x]];
+}
+
+static VOID
+StretchFetch24BPP(PBYTE pjLine, PLONG plColumns, PULONG pulLine, LONG cx)
+{
+  PBYTE pjPixel;
+  LONG x;
+
+  for (x = 0; x < cx; x++)
+  {
+    pjPixel = pjLine + plColumns[x] * 3;
+    pulLine[x] = pjPixel[0] | (pjPixel[1] << 8) | (pjPixel[2] << 16);
+  }
+}
+
+static VOID
+StretchFetch32BPP(PBYTE pjLine, PLONG plColumns, PULONG pulLine, LONG cx)
+{
+  LONG x;
+
+  for (x = 0; x < cx; x++)
+    pulLine[x] = ((PULONG)pjLine)[plColumns[x]];
+}
+
+static PFN_STRETCH_FETCH
+StretchGetFetch(ULONG iFormat)
+{
+  switch (iFormat)
+  {
+    case BMF_1BPP: return StretchFetch1BPP;
+    case BMF_4BPP: return StretchFetch4BPP;
+    case BMF_8BPP: return StretchFetch8BPP;
+    case BMF_16BPP: return StretchFetch16BPP;
+    case BMF_24BPP: return StretchFetch24BPP;
+    case BMF_32BPP: return StretchFetch32BPP;
+    default: return NULL;
+  }
+}
+
+static VOID
+StretchStoreLine(ULONG iFormat, PBYTE pjLine, PULONG pulLine, LONG cx)
+{
+  LONG x;
+
+  switch (iFormat)
+  {
+    case BMF_8BPP:
+      for (x = 0; x < cx; x++)
+        pjLine[x] = (BYTE)pulLine[x];
+      break;
+
+    case BMF_16BPP:
+      for (x = 0; x < cx; x++)
+        ((PUSHORT)pjLine)[x] = (USHORT)pulLine[x];
+      break;
+
+    case BMF_24BPP:
+      for (x = 0; x < cx; x++, pjLine += 3)
+      {
+        pjLine[0] = (BYTE)pulLine[x];
+        pjLine[1] = (BYTE)(pulLine[x] >> 8);
+        pjLine[2] = (BYTE)(pulLine[x] >> 16);
+      }
+      break;
+
+    case BMF_32BPP:
+      RtlCopyMemory(pjLine, pulLine, cx * sizeof(ULONG));
+      break;
+  }
+}
+
+/* Maps every destination column to its source column, without divisions */
+static VOID
+StretchBuildColumns(PLONG plColumns, LONG First, LONG SrcCount, LONG DstCount)
+{
+  LONG x, Step, Remainder, Error, sx;
+
+  /* Same as First + x * SrcCount / DstCount */
+  Step = SrcCount / DstCount;
+  Remainder = SrcCount % DstCount;
+  Error = 0;
+  sx = First;
+
+  for (x = 0; x < DstCount; x++)
+  {
+    plColumns[x] = sx;
+    sx += Step;
+    Error += Remainder;
+    if (Error >= DstCount)
+    {
+      Error -= DstCount;
+      sx++;
+    }
+  }
+}
+
+static ULONG
+StretchBytesPerPixel(ULONG iFormat)
+{
+  switch (iFormat)
+  {
+    case BMF_8BPP: return 1;
+    case BMF_16BPP: return 2;
+    case BMF_24BPP: return 3;
+    case BMF_32BPP: return 4;
+    default: return 0;
+  }
+}
+
+/*
+ * SRCCOPY without a mask. Returns FALSE if the formats or rectangles are
+ * not handled here, the caller then falls back to the per pixel code.
+ */
+static BOOLEAN
+DIB_StretchSrcCopy(SURFOBJ *DestSurf, SURFOBJ *SourceSurf,
+                   RECTL *DestRect, RECTL *SourceRect,
+                   XLATEOBJ *ColorTranslation)
+{
+  LONG StackColumns[STACK_STRETCH_COLUMNS];
+  ULONG StackLine[STACK_STRETCH_COLUMNS];
+  PFN_STRETCH_FETCH pfnFetch;
+  PLONG plColumns;
+  PULONG pulLine;
+  PBYTE pjDstLine, pjSrcLine, pjPrevLine = NULL;
+  LONG DstWidth, DstHeight, SrcWidth, SrcHeight;
+  LONG DesY, sy, PrevSy = -1, Step, Remainder, Error;
+  ULONG cjPixel, cjLine;
+  BOOLEAN Gather;
+
+  DstWidth = DestRect->right - DestRect->left;
+  DstHeight = DestRect->bottom - DestRect->top;
+  SrcWidth = SourceRect->right - SourceRect->left;
+  SrcHeight = SourceRect->bottom - SourceRect->top;
+
+  if (DstWidth <= 0 || DstHeight <= 0 || SrcWidth <= 0 || SrcHeight <= 0)
+    return FALSE;
+
+  /* The per pixel code handles the parts outside of the source bitmap */
+  if (SourceRect->left < 0 || SourceRect->top < 0 ||
+      SourceRect->right > SourceSurf->sizlBitmap.cx ||
+      SourceRect->bottom > abs(SourceSurf->sizlBitmap.cy))
+    return FALSE;
+
+  cjPixel = StretchBytesPerPixel(DestSurf->iBitmapFormat);
+  pfnFetch = StretchGetFetch(SourceSurf->iBitmapFormat);
+  if (cjPixel == 0 || pfnFetch == NULL)
+    return FALSE;
+
+  /* Same format without translation: copy the pixels directly */
+  Gather = (SourceSurf->iBitmapFormat == DestSurf->iBitmapFormat) &&
+           (DestSurf->iBitmapFormat != BMF_24BPP) &&
+           (ColorTranslation == NULL || (ColorTranslation->flXlate & XO_TRIVIAL));
+
+  if (DstWidth <= STACK_STRETCH_COLUMNS)
+  {
+    plColumns = StackColumns;
+    pulLine = StackLine;
+  }
+  else
+  {
+    plColumns = ExAllocatePoolWithTag(PagedPool,
+                                      DstWidth * (sizeof(LONG) + sizeof(ULONG)),
+                                      TAG_DIB);
+    if (plColumns == NULL)
+      return FALSE;
+    pulLine = (PULONG)(plColumns + DstWidth);
+  }
+
+  StretchBuildColumns(plColumns, SourceRect->left, SrcWidth, DstWidth);
+
+  cjLine = DstWidth * cjPixel;
+  Step = SrcHeight / DstHeight;
+  Remainder = SrcHeight % DstHeight;
+  Error = 0;
+  sy = SourceRect->top;
+
+  for (DesY = DestRect->top; DesY < DestRect->bottom; DesY++)
+  {
+    pjDstLine = (PBYTE)DestSurf->pvScan0 + DesY * DestSurf->lDelta +
+                DestRect->left * cjPixel;
+
+    if (sy == PrevSy)
+    {
+      /* Enlarged vertically, the line is the same as the one before */
+      RtlCopyMemory(pjDstLine, pjPrevLine, cjLine);
+    }
+    else
+    {
+      pjSrcLine = (PBYTE)SourceSurf->pvScan0 + sy * SourceSurf->lDelta;
+
+      if (Gather)
+      {
+        LONG x;
+
+        switch (cjPixel)
+        {
+          case 1:
+            for (x = 0; x < DstWidth; x++)
+              pjDstLine[x] = pjSrcLine[plColumns[x]];
+            break;
+          case 2:
+            for (x = 0; x < DstWidth; x++)
+              ((PUSHORT)pjDstLine)[x] = ((PUSHORT)pjSrcLine)[plColumns[x]];
+            break;
+          default:
+            for (x = 0; x < DstWidth; x++)
+              ((PULONG)pjDstLine)[x] = ((PULONG)pjSrcLine)[plColumns[x]];
+            break;
+        }
+      }
+      else
+      {
+        pfnFetch(pjSrcLine, plColumns, pulLine, DstWidth);
+        XLATEOBJ_vXlateSpan(ColorTranslation, pulLine, pulLine, DstWidth);
+        StretchStoreLine(DestSurf->iBitmapFormat, pjDstLine, pulLine, DstWidth);
+      }
+
+      PrevSy = sy;
+      pjPrevLine = pjDstLine;
+    }
+
+    sy += Step;
+    Error += Remainder;
+    if (Error >= DstHeight)
+    {
+      Error -= DstHeight;
+      sy++;
+    }
+  }
+
+  if (plColumns != StackColumns)
+    ExFreePoolWithTag(plColumns, TAG_DIB);
+
+  return TRUE;
+}
+
+/* Blends two pixels, two 8 bit channels at a time. Weight is 0 to 255 */
+static __inline ULONG
+StretchLerp(ULONG a, ULONG b, ULONG Weight)
+{
+  ULONG rb, ag;
+
+  rb = (((a & 0xFF00FF) * (256 - Weight) + (b & 0xFF00FF) * Weight) >> 8) & 0xFF00FF;
+  ag = (((a >> 8) & 0xFF00FF) * (256 - Weight) + ((b >> 8) & 0xFF00FF) * Weight) & 0xFF00FF00;
+
+  return rb | ag;
+}
+
+/*
+ * Center of destination pixel Index mapped into the source, in 16.16 fixed
+ * point and clamped to the source pixels.
+ */
+static LONG
+StretchSamplePosition(LONG Index, LONG SrcCount, LONG DstCount)
+{
+  LONGLONG Pos;
+
+  Pos = ((2 * (LONGLONG)Index + 1) * SrcCount * 0x10000) / (2 * DstCount) - 0x8000;
+  if (Pos < 0)
+    return 0;
+  if (Pos > ((LONGLONG)(SrcCount - 1) << 16))
+    return (SrcCount - 1) << 16;
+
+  return (LONG)Pos;
+}
+
+/*
+ * HALFTONE stretching to 24 and 32 bpp surfaces with bilinear filtering.
+ * DestRect and SourceRect are the whole stretched area, only the part
+ * inside ClipRect is drawn. Returns FALSE if the surfaces are not handled
+ * here, the caller then falls back to DIB_XXBPP_StretchBlt.
+ */
+BOOLEAN
+DIB_XXBPP_StretchBltHalftone(SURFOBJ *DestSurf, SURFOBJ *SourceSurf,
+                             RECTL *DestRect, RECTL *SourceRect,
+                             RECTL *ClipRect, XLATEOBJ *ColorTranslation)
+{
+  PFN_STRETCH_FETCH pfnFetch;
+  PLONG plColumns, plSourceX;
+  PULONG pulBuffer, pulFracX, pulRow0, pulRow1, pulLine, pulSwap;
+  PBYTE pjSrcLine, pjDstLine;
+  RECTL rcDraw;
+  LONG DstWidth, DstHeight, SrcWidth, SrcHeight;
+  LONG cx, cSource, FirstX, LastX, Pos, x, y0, y1, DesY;
+  LONG Row0 = -1, Row1 = -1;
+  ULONG cjPixel, FracY;
+
+  if (DestSurf->iBitmapFormat != BMF_24BPP && DestSurf->iBitmapFormat != BMF_32BPP)
+    return FALSE;
+
+  pfnFetch = StretchGetFetch(SourceSurf->iBitmapFormat);
+  if (pfnFetch == NULL)
+    return FALSE;
+
+  DstWidth = DestRect->right - DestRect->left;
+  DstHeight = DestRect->bottom - DestRect->top;
+  SrcWidth = SourceRect->right - SourceRect->left;
+  SrcHeight = SourceRect->bottom - SourceRect->top;
+
+  if (DstWidth <= 0 || DstHeight <= 0 || SrcWidth <= 0 || SrcHeight <= 0)
+    return FALSE;
+
+  if (SourceRect->left < 0 || SourceRect->top < 0 ||
+      SourceRect->right > SourceSurf->sizlBitmap.cx ||
+      SourceRect->bottom > abs(SourceSurf->sizlBitmap.cy))
+    return FALSE;
+
+  if (!RECTL_bIntersectRect(&rcDraw, DestRect, ClipRect))
+    return TRUE;
+
+  cx = rcDraw.right - rcDraw.left;
+  cjPixel = StretchBytesPerPixel(DestSurf->iBitmapFormat);
+
+  /* Range of source columns that the drawn part needs */
+  FirstX = StretchSamplePosition(rcDraw.left - DestRect->left, SrcWidth, DstWidth) >> 16;
+  LastX = StretchSamplePosition(rcDraw.right - 1 - DestRect->left, SrcWidth, DstWidth) >> 16;
+  LastX = min(LastX + 1, SrcWidth - 1);
+  cSource = LastX - FirstX + 1;
+
+  /*
+   * Source columns, two translated source rows with a spare pixel at the
+   * end, and per destination column the left source pixel, its weight and
+   * the output line.
+   */
+  pulBuffer = ExAllocatePoolWithTag(PagedPool,
+                                    (cSource * 3 + 2 + cx * 3) * sizeof(ULONG),
+                                    TAG_DIB);
+  if (pulBuffer == NULL)
+    return FALSE;
+
+  plColumns = (PLONG)pulBuffer;
+  pulRow0 = (PULONG)(plColumns + cSource);
+  pulRow1 = pulRow0 + cSource + 1;
+  plSourceX = (PLONG)(pulRow1 + cSource + 1);
+  pulFracX = (PULONG)(plSourceX + cx);
+  pulLine = pulFracX + cx;
+
+  for (x = 0; x < cSource; x++)
+    plColumns[x] = SourceRect->left + FirstX + x;
+
+  for (x = 0; x < cx; x++)
+  {
+    Pos = StretchSamplePosition(rcDraw.left - DestRect->left + x, SrcWidth, DstWidth);
+    plSourceX[x] = (Pos >> 16) - FirstX;
+    pulFracX[x] = (Pos >> 8) & 0xFF;
+  }
+
+  for (DesY = rcDraw.top; DesY < rcDraw.bottom; DesY++)
+  {
+    Pos = StretchSamplePosition(DesY - DestRect->top, SrcHeight, DstHeight);
+    y0 = Pos >> 16;
+    y1 = min(y0 + 1, SrcHeight - 1);
+    FracY = (Pos >> 8) & 0xFF;
+
+    /* Going down, the lower row of the last line is the upper row of this one */
+    if (y0 != Row0 && y0 == Row1)
+    {
+      pulSwap = pulRow0;
+      pulRow0 = pulRow1;
+      pulRow1 = pulSwap;
+      Row0 = Row1;
+      Row1 = -1;
+    }
+
+    if (y0 != Row0)
+    {
+      pjSrcLine = (PBYTE)SourceSurf->pvScan0 + (SourceRect->top + y0) * SourceSurf->lDelta;
+      pfnFetch(pjSrcLine, plColumns, pulRow0, cSource);
+      XLATEOBJ_vXlateSpan(ColorTranslation, pulRow0, pulRow0, cSource);
+      pulRow0[cSource] = pulRow0[cSource - 1];
+      Row0 = y0;
+    }
+
+    if (FracY != 0 && y1 != Row1)
+    {
+      pjSrcLine = (PBYTE)SourceSurf->pvScan0 + (SourceRect->top + y1) * SourceSurf->lDelta;
+      pfnFetch(pjSrcLine, plColumns, pulRow1, cSource);
+      XLATEOBJ_vXlateSpan(ColorTranslation, pulRow1, pulRow1, cSource);
+      pulRow1[cSource] = pulRow1[cSource - 1];
+      Row1 = y1;
+    }
+
+    if (FracY == 0)
+    {
+      for (x = 0; x < cx; x++)
+      {
+        pulLine[x] = StretchLerp(pulRow0[plSourceX[x]],
+                                 pulRow0[plSourceX[x] + 1],
+                                 pulFracX[x]);
+      }
+    }
+    else
+    {
+      for (x = 0; x < cx; x++)
+      {
+        pulLine[x] = StretchLerp(StretchLerp(pulRow0[plSourceX[x]],
+                                             pulRow0[plSourceX[x] + 1],
+                                             pulFracX[x]),
+                                 StretchLerp(pulRow1[plSourceX[x]],
+                                             pulRow1[plSourceX[x] + 1],
+                                             pulFracX[x]),
+                                 FracY);
+      }
+    }
+
+    pjDstLine = (PBYTE)DestSurf->pvScan0 + DesY * DestSurf->lDelta + rcDraw.left * cjPixel;
+    StretchStoreLine(DestSurf->iBitmapFormat, pjDstLine, pulLine, cx);
+  }
+
+  ExFreePoolWithTag(pulBuffer, TAG_DIB);
+
+  return TRUE;
+}
+
 BOOLEAN DIB_XXBPP_StretchBlt(SURFOBJ *DestSurf, SURFOBJ *SourceSurf, SURFOBJ *MaskSurf,
                             SURFOBJ *PatternSurface,
                             RECTL *DestRect, RECTL *SourceRect,
@@ -50,6 +515,12 @@ BOOLEAN DIB_XXBPP_StretchBlt(SURFOBJ *DestSurf, SURFOBJ *SourceSurf, SURFOBJ *Ma
 
   ASSERT(IS_VALID_ROP4(ROP));
 
+  if (ROP == ROP4_FROM_INDEX(R3_OPINDEX_SRCCOPY) && MaskSurf == NULL &&
+      DIB_StretchSrcCopy(DestSurf, SourceSurf, DestRect, SourceRect, ColorTranslation))
+  {
+    return TRUE;
+  }
+
   fnDest_GetPixel = DibFunctionsForBitmapFormat[DestSurf->iBitmapFormat].DIB_GetPixel;
   fnDest_PutPixel = DibFunctionsForBitmapFormat[DestSurf->iBitmapFormat].DIB_PutPixel;
 
@@ -153,6 +153,55 @@ CompareLeftUp(
     return Cmp;
 }
 
+static
+VOID
+ReverseRects(
+    RECTL *Rects,
+    ULONG Count)
+{
+    RECTL *RectEnd = Rects + Count - 1;
+    RECTL Temp;
+
+    while (Rects < RectEnd)
+    {
+        Temp = *Rects;
+        *Rects++ = *RectEnd;
+        *RectEnd-- = Temp;
+    }
+}
+
+/*
+ * Banded rects can be brought into another direction by reversing the order
+ * of the bands and/or the order of the rects inside of each band, so there
+ * is no need to sort them.
+ */
+static
+VOID
+ReorderBandedRects(
+    XCLIPOBJ *Clip,
+    ULONG iDirection)
+{
+    ULONG Flip = Clip->iDirection ^ iDirection;
+    RECTL *Band, *RectEnd = Clip->Rects + Clip->RectCount;
+    ULONG Count;
+
+    /* Reversing everything reverses the bands, and the rects inside of them */
+    if (Flip & CD_UPWARDS)
+    {
+        ReverseRects(Clip->Rects, Clip->RectCount);
+        Flip ^= CD_LEFTWARDS;
+    }
+
+    if (Flip & CD_LEFTWARDS)
+    {
+        for (Band = Clip->Rects; Band < RectEnd; Band += Count)
+        {
+            for (Count = 1; Band + Count < RectEnd && Band[Count].top == Band->top; Count++);
+            ReverseRects(Band, Count);
+        }
+    }
+}
+
 VOID
 FASTCALL
 IntEngInitClipObj(XCLIPOBJ *Clip)
@@ -183,7 +232,8 @@ IntEngUpdateClipRegion(
         if(NewRects != NULL)
         {
             Clip->RectCount = count;
-            Clip->iDirection = CD_ANY;
+            /* The rects come from a region, those are sorted in y-x bands */
+            Clip->iDirection = CD_RIGHTDOWN;
             RtlCopyMemory(NewRects, pRect, count * sizeof(RECTL));
 
             Clip->iDComplexity = DC_COMPLEX;
@@ -267,7 +317,13 @@ CLIPOBJ_cEnumStart(
     Clip->EnumPos = 0;
     Clip->EnumMax = (cMaxRects > 0) ? cMaxRects : Clip->RectCount;
 
-    if (CD_ANY != iDirection && Clip->iDirection != iDirection)
+    if (CD_ANY != iDirection && Clip->iDirection != iDirection &&
+        Clip->iDirection != CD_ANY && iDirection <= CD_LEFTUP)
+    {
+        ReorderBandedRects(Clip, iDirection);
+        Clip->iDirection = iDirection;
+    }
+    else if (CD_ANY != iDirection && Clip->iDirection != iDirection)
     {
         switch (iDirection)
         {
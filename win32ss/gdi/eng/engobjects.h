@@ -125,12 +125,22 @@ typedef struct _SHARED_FACE_CACHE {
     UNICODE_STRING FullName;
 } SHARED_FACE_CACHE, *PSHARED_FACE_CACHE;
 
+#define SHARED_FACE_INDEX_CACHE_SIZE 256   /* Must be a power of two */
+
+typedef struct _SHARED_FACE_INDEX {
+  ULONG         Char;                /* MAXULONG while the entry is unused */
+  ULONG         GlyphIndex;
+} SHARED_FACE_INDEX, *PSHARED_FACE_INDEX;
+
 typedef struct _SHARED_FACE {
   FT_Face       Face;
   LONG          RefCount;
   PSHARED_MEM   Memory;
   SHARED_FACE_CACHE EnglishUS;
   SHARED_FACE_CACHE UserLanguage;
+  LIST_ENTRY    GlyphCacheListHead;  /* Cached glyphs of this face */
+  ULONG         SizeSerial;          /* Bumped whenever a size is requested */
+  SHARED_FACE_INDEX GlyphIndexCache[SHARED_FACE_INDEX_CACHE_SIZE]; /* Character to glyph index */
 } SHARED_FACE, *PSHARED_FACE;
 
 typedef struct _FONTGDI {
@@ -161,6 +171,11 @@ typedef struct _FONTGDI {
   LONG          tmInternalLeading;
   LONG          EmHeight;
   LONG          Magic;
+
+  /* Size the metrics above were computed for */
+  ULONG         SizeSerial;
+  LONG          SizeWidth;
+  LONG          SizeHeight;
 } FONTGDI, *PFONTGDI;
 
 /* The initialized 'Magic' value in FONTGDI */
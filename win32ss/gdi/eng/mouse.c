@@ -182,61 +182,21 @@ IntHideMousePointer(
                  ROP4_FROM_INDEX(R3_OPINDEX_SRCCOPY));
 }
 
+/*
+ * Draws the part rclPointer of the pointer into prclDest of psoDest, which
+ * has the format of the screen.
+ */
+static
 VOID
-NTAPI
-IntShowMousePointer(
-    _Inout_ PDEVOBJ *ppdev,
-    _Inout_ SURFOBJ *psoDest)
+IntDrawMousePointer(
+    _In_ PDEVOBJ *ppdev,
+    _Inout_ SURFOBJ *psoDest,
+    _In_ RECTL *prclDest,
+    _In_ const RECTL *prclPointer)
 {
-    GDIPOINTER *pgp;
-    POINTL pt;
-    RECTL rclSurf, rclPointer;
-
-    ASSERT(ppdev);
-    ASSERT(psoDest);
-
-    pgp = &ppdev->Pointer;
-
-    if (pgp->Enabled)
-    {
-        return;
-    }
-
-    pgp->Enabled = TRUE;
-
-    /* Check if we have any mouse pointer */
-    if (!pgp->psurfSave) return;
-
-    /* Calculate pointer coordinates */
-    pt.x = ppdev->ptlPointer.x - pgp->HotSpot.x;
-    pt.y = ppdev->ptlPointer.y - pgp->HotSpot.y;
-
-    /* Calculate the rect on the surface */
-    rclSurf.left = max(pt.x, 0);
-    rclSurf.top = max(pt.y, 0);
-    rclSurf.right = min(pt.x + pgp->Size.cx, psoDest->sizlBitmap.cx);
-    rclSurf.bottom = min(pt.y + pgp->Size.cy, psoDest->sizlBitmap.cy);
-
-    /* Calculate the rect in the pointer bitmap */
-    rclPointer.left = rclSurf.left - pt.x;
-    rclPointer.top = rclSurf.top - pt.y;
-    rclPointer.right = min(pgp->Size.cx, psoDest->sizlBitmap.cx - pt.x);
-    rclPointer.bottom = min(pgp->Size.cy, psoDest->sizlBitmap.cy - pt.y);
-
-    /* Copy the pixels under the cursor to temporary surface. */
-    IntEngBitBlt(&pgp->psurfSave->SurfObj,
-                 psoDest,
-                 NULL,
-                 NULL,
-                 NULL,
-                 &rclPointer,
-                 (POINTL*)&rclSurf,
-                 NULL,
-                 NULL,
-                 NULL,
-                 ROP4_FROM_INDEX(R3_OPINDEX_SRCCOPY));
+    GDIPOINTER *pgp = &ppdev->Pointer;
+    RECTL rclPointer = *prclPointer;
 
-    /* Blt the pointer on the screen. */
     if (pgp->psurfColor)
     {
         if(!(pgp->flags & SPS_ALPHA))
@@ -246,7 +206,7 @@ IntShowMousePointer(
                          NULL,
                          NULL,
                          NULL,
-                         &rclSurf,
+                         prclDest,
                          (POINTL*)&rclPointer,
                          NULL,
                          NULL,
@@ -258,7 +218,7 @@ IntShowMousePointer(
                          NULL,
                          NULL,
                          NULL,
-                         &rclSurf,
+                         prclDest,
                          (POINTL*)&rclPointer,
                          NULL,
                          NULL,
@@ -277,7 +237,7 @@ IntShowMousePointer(
                              &pgp->psurfColor->SurfObj,
                              NULL,
                              &exlo.xlo,
-                             &rclSurf,
+                             prclDest,
                              &rclPointer,
                              &blendobj);
             EXLATEOBJ_vCleanup(&exlo);
@@ -290,7 +250,7 @@ IntShowMousePointer(
                      NULL,
                      NULL,
                      NULL,
-                     &rclSurf,
+                     prclDest,
                      (POINTL*)&rclPointer,
                      NULL,
                      NULL,
@@ -304,7 +264,7 @@ IntShowMousePointer(
                      NULL,
                      NULL,
                      NULL,
-                     &rclSurf,
+                     prclDest,
                      (POINTL*)&rclPointer,
                      NULL,
                      NULL,
@@ -313,6 +273,256 @@ IntShowMousePointer(
     }
 }
 
+VOID
+NTAPI
+IntShowMousePointer(
+    _Inout_ PDEVOBJ *ppdev,
+    _Inout_ SURFOBJ *psoDest)
+{
+    GDIPOINTER *pgp;
+    POINTL pt;
+    RECTL rclSurf, rclPointer;
+
+    ASSERT(ppdev);
+    ASSERT(psoDest);
+
+    pgp = &ppdev->Pointer;
+
+    if (pgp->Enabled)
+    {
+        return;
+    }
+
+    pgp->Enabled = TRUE;
+
+    /* Check if we have any mouse pointer */
+    if (!pgp->psurfSave) return;
+
+    /* Calculate pointer coordinates */
+    pt.x = ppdev->ptlPointer.x - pgp->HotSpot.x;
+    pt.y = ppdev->ptlPointer.y - pgp->HotSpot.y;
+
+    /* Calculate the rect on the surface */
+    rclSurf.left = max(pt.x, 0);
+    rclSurf.top = max(pt.y, 0);
+    rclSurf.right = min(pt.x + pgp->Size.cx, psoDest->sizlBitmap.cx);
+    rclSurf.bottom = min(pt.y + pgp->Size.cy, psoDest->sizlBitmap.cy);
+
+    /* Calculate the rect in the pointer bitmap */
+    rclPointer.left = rclSurf.left - pt.x;
+    rclPointer.top = rclSurf.top - pt.y;
+    rclPointer.right = min(pgp->Size.cx, psoDest->sizlBitmap.cx - pt.x);
+    rclPointer.bottom = min(pgp->Size.cy, psoDest->sizlBitmap.cy - pt.y);
+
+    /* Copy the pixels under the cursor to temporary surface. */
+    IntEngBitBlt(&pgp->psurfSave->SurfObj,
+                 psoDest,
+                 NULL,
+                 NULL,
+                 NULL,
+                 &rclPointer,
+                 (POINTL*)&rclSurf,
+                 NULL,
+                 NULL,
+                 NULL,
+                 ROP4_FROM_INDEX(R3_OPINDEX_SRCCOPY));
+
+    /* Blt the pointer on the screen. */
+    IntDrawMousePointer(ppdev, psoDest, &rclSurf, &rclPointer);
+}
+
+/*
+ * Returns the part of the pointer at pt that is on the surface, both in
+ * surface coordinates and in pointer coordinates. FALSE if nothing is visible.
+ */
+static
+BOOL
+IntGetPointerRects(
+    _In_ GDIPOINTER *pgp,
+    _In_ SURFOBJ *psoDest,
+    _In_ LONG x,
+    _In_ LONG y,
+    _Out_ RECTL *prclSurf,
+    _Out_ RECTL *prclPointer)
+{
+    prclSurf->left = max(x, 0);
+    prclSurf->top = max(y, 0);
+    prclSurf->right = min(x + pgp->Size.cx, psoDest->sizlBitmap.cx);
+    prclSurf->bottom = min(y + pgp->Size.cy, psoDest->sizlBitmap.cy);
+
+    prclPointer->left = prclSurf->left - x;
+    prclPointer->top = prclSurf->top - y;
+    prclPointer->right = prclSurf->right - x;
+    prclPointer->bottom = prclSurf->bottom - y;
+
+    return (prclSurf->left < prclSurf->right) && (prclSurf->top < prclSurf->bottom);
+}
+
+static
+VOID
+IntCopyPointerRect(
+    _Inout_ SURFOBJ *psoDest,
+    _In_ SURFOBJ *psoSource,
+    _In_ RECTL *prclDest,
+    _In_ LONG xSrc,
+    _In_ LONG ySrc)
+{
+    POINTL ptlSrc = {xSrc, ySrc};
+
+    if ((prclDest->left >= prclDest->right) || (prclDest->top >= prclDest->bottom))
+        return;
+
+    IntEngBitBlt(psoDest,
+                 psoSource,
+                 NULL,
+                 NULL,
+                 NULL,
+                 prclDest,
+                 &ptlSrc,
+                 NULL,
+                 NULL,
+                 NULL,
+                 ROP4_FROM_INDEX(R3_OPINDEX_SRCCOPY));
+}
+
+/*
+ * Copies the part of the screen rect prcl that is outside of prclExclude,
+ * as up to four strips. The strips are offset by dxDest/dyDest in psoDest
+ * and by dxSrc/dySrc in psoSource.
+ */
+static
+VOID
+IntCopyPointerRectExcluding(
+    _Inout_ SURFOBJ *psoDest,
+    _In_ SURFOBJ *psoSource,
+    _In_ const RECTL *prcl,
+    _In_ const RECTL *prclExclude,
+    _In_ LONG dxDest,
+    _In_ LONG dyDest,
+    _In_ LONG dxSrc,
+    _In_ LONG dySrc)
+{
+    RECTL arcl[4];
+    ULONG i;
+
+    /* Above and below the excluded rect */
+    arcl[0] = *prcl;
+    arcl[0].bottom = prclExclude->top;
+    arcl[1] = *prcl;
+    arcl[1].top = prclExclude->bottom;
+
+    /* Left and right of it */
+    arcl[2].top = prclExclude->top;
+    arcl[2].bottom = prclExclude->bottom;
+    arcl[2].left = prcl->left;
+    arcl[2].right = prclExclude->left;
+    arcl[3].top = prclExclude->top;
+    arcl[3].bottom = prclExclude->bottom;
+    arcl[3].left = prclExclude->right;
+    arcl[3].right = prcl->right;
+
+    for (i = 0; i < 4; i++)
+    {
+        LONG xSrc = arcl[i].left + dxSrc;
+        LONG ySrc = arcl[i].top + dySrc;
+
+        RECTL_vOffsetRect(&arcl[i], dxDest, dyDest);
+        IntCopyPointerRect(psoDest, psoSource, &arcl[i], xSrc, ySrc);
+    }
+}
+
+/*
+ * Moves a visible software pointer. Instead of restoring the whole old
+ * rectangle and saving and drawing over the new one on the screen, the
+ * new pointer is composed off-screen from the pixels that are saved
+ * already, only the part of the old rectangle that gets uncovered is
+ * restored, and the new rectangle is written to the screen with a single
+ * copy. This avoids reading back most of the screen and any flicker while
+ * the pointer moves by a few pixels.
+ */
+static
+VOID
+IntMoveMousePointer(
+    _Inout_ PDEVOBJ *ppdev,
+    _Inout_ SURFOBJ *psoDest,
+    _In_ LONG x,
+    _In_ LONG y)
+{
+    GDIPOINTER *pgp = &ppdev->Pointer;
+    SURFOBJ *psoSave, *psoBack, *psoWork;
+    SURFACE *psurfTemp;
+    POINTL ptOld, ptNew;
+    RECTL rclOld, rclOldPointer, rclNew, rclNewPointer, rclOverlap, rcl;
+    BOOL bOld, bNew, bOverlap;
+
+    psoSave = &pgp->psurfSave->SurfObj;
+    psoBack = &pgp->psurfSaveBack->SurfObj;
+    psoWork = &pgp->psurfWork->SurfObj;
+
+    ptOld.x = ppdev->ptlPointer.x - pgp->HotSpot.x;
+    ptOld.y = ppdev->ptlPointer.y - pgp->HotSpot.y;
+    ptNew.x = x - pgp->HotSpot.x;
+    ptNew.y = y - pgp->HotSpot.y;
+
+    bOld = IntGetPointerRects(pgp, psoDest, ptOld.x, ptOld.y, &rclOld, &rclOldPointer);
+    bNew = IntGetPointerRects(pgp, psoDest, ptNew.x, ptNew.y, &rclNew, &rclNewPointer);
+
+    bOverlap = bOld && bNew && RECTL_bIntersectRect(&rclOverlap, &rclOld, &rclNew);
+
+    if (bNew)
+    {
+        /* Save the background of the new rect. Where the old pointer is
+           still visible, it is in the old save surface, and only the rest
+           is read from the screen. */
+        if (bOverlap)
+        {
+            IntCopyPointerRectExcluding(psoBack, psoDest, &rclNew, &rclOverlap,
+                                        -ptNew.x, -ptNew.y, 0, 0);
+
+            rcl = rclOverlap;
+            RECTL_vOffsetRect(&rcl, -ptNew.x, -ptNew.y);
+            IntCopyPointerRect(psoBack, psoSave, &rcl,
+                               rclOverlap.left - ptOld.x, rclOverlap.top - ptOld.y);
+        }
+        else
+        {
+            IntCopyPointerRect(psoBack, psoDest, &rclNewPointer, rclNew.left, rclNew.top);
+        }
+
+        /* Compose the new pointer on top of it */
+        IntCopyPointerRect(psoWork, psoBack, &rclNewPointer,
+                           rclNewPointer.left, rclNewPointer.top);
+        IntDrawMousePointer(ppdev, psoWork, &rclNewPointer, &rclNewPointer);
+    }
+
+    /* Restore the part of the old rect that the new one does not cover */
+    if (bOverlap)
+    {
+        IntCopyPointerRectExcluding(psoDest, psoSave, &rclOld, &rclOverlap,
+                                    0, 0, -ptOld.x, -ptOld.y);
+    }
+    else if (bOld)
+    {
+        IntCopyPointerRect(psoDest, psoSave, &rclOld,
+                           rclOldPointer.left, rclOldPointer.top);
+    }
+
+    /* Show the new pointer */
+    if (bNew)
+    {
+        IntCopyPointerRect(psoDest, psoWork, &rclNew,
+                           rclNewPointer.left, rclNewPointer.top);
+    }
+
+    /* The new background becomes the saved one */
+    psurfTemp = pgp->psurfSave;
+    pgp->psurfSave = pgp->psurfSaveBack;
+    pgp->psurfSaveBack = psurfTemp;
+
+    ppdev->ptlPointer.x = x;
+    ppdev->ptlPointer.y = y;
+}
+
 /*
  * @implemented
  */
@@ -333,8 +543,8 @@ EngSetPointerShape(
     PDEVOBJ *ppdev;
     GDIPOINTER *pgp;
     LONG lDelta = 0;
-    HBITMAP hbmSave = NULL, hbmColor = NULL, hbmMask = NULL;
-    PSURFACE psurfSave = NULL, psurfColor = NULL, psurfMask = NULL;
+    HBITMAP hbmSave = NULL, hbmSaveBack = NULL, hbmWork = NULL, hbmColor = NULL, hbmMask = NULL;
+    PSURFACE psurfSave = NULL, psurfSaveBack = NULL, psurfWork = NULL, psurfColor = NULL, psurfMask = NULL;
     RECTL rectl;
     SIZEL sizel = {0, 0};
 
@@ -379,6 +589,23 @@ EngSetPointerShape(
                                   NULL);
         psurfSave = SURFACE_ShareLockSurface(hbmSave);
         if (!psurfSave) goto failure;
+
+        /* And two more to move the pointer without flicker */
+        hbmSaveBack = EngCreateBitmap(sizel,
+                                      lDelta,
+                                      pso->iBitmapFormat,
+                                      BMF_TOPDOWN | BMF_NOZEROINIT,
+                                      NULL);
+        psurfSaveBack = SURFACE_ShareLockSurface(hbmSaveBack);
+        if (!psurfSaveBack) goto failure;
+
+        hbmWork = EngCreateBitmap(sizel,
+                                  lDelta,
+                                  pso->iBitmapFormat,
+                                  BMF_TOPDOWN | BMF_NOZEROINIT,
+                                  NULL);
+        psurfWork = SURFACE_ShareLockSurface(hbmWork);
+        if (!psurfWork) goto failure;
     }
 
     if (psoColor)
@@ -508,6 +735,20 @@ EngSetPointerShape(
         pgp->psurfSave = NULL;
     }
 
+    if (pgp->psurfSaveBack)
+    {
+        EngDeleteSurface(pgp->psurfSaveBack->BaseObject.hHmgr);
+        SURFACE_ShareUnlockSurface(pgp->psurfSaveBack);
+        pgp->psurfSaveBack = NULL;
+    }
+
+    if (pgp->psurfWork)
+    {
+        EngDeleteSurface(pgp->psurfWork->BaseObject.hHmgr);
+        SURFACE_ShareUnlockSurface(pgp->psurfWork);
+        pgp->psurfWork = NULL;
+    }
+
     /* See if we are being asked to hide the pointer. */
     if (psoMask == NULL && psoColor == NULL)
     {
@@ -519,6 +760,8 @@ EngSetPointerShape(
     pgp->psurfColor = psurfColor;
     pgp->psurfMask = psurfMask;
     pgp->psurfSave = psurfSave;
+    pgp->psurfSaveBack = psurfSaveBack;
+    pgp->psurfWork = psurfWork;
     pgp->HotSpot.x = xHot;
     pgp->HotSpot.y = yHot;
     pgp->Size = sizel;
@@ -554,6 +797,10 @@ failure:
     if (psurfColor) SURFACE_ShareUnlockSurface(psurfColor);
     if (hbmSave) EngDeleteSurface((HSURF)hbmSave);
     if (psurfSave) SURFACE_ShareUnlockSurface(psurfSave);
+    if (hbmSaveBack) EngDeleteSurface((HSURF)hbmSaveBack);
+    if (psurfSaveBack) SURFACE_ShareUnlockSurface(psurfSaveBack);
+    if (hbmWork) EngDeleteSurface((HSURF)hbmWork);
+    if (psurfWork) SURFACE_ShareUnlockSurface(psurfWork);
 
     return SPS_ERROR;
 }
@@ -579,14 +826,25 @@ EngMovePointer(
 
     pgp = &ppdev->Pointer;
 
-    IntHideMousePointer(ppdev, pso);
+    if (x != -1 && pgp->Enabled && pgp->psurfSave)
+    {
+        /* Nothing to do if the pointer did not move since the last call */
+        if (x != ppdev->ptlPointer.x || y != ppdev->ptlPointer.y)
+            IntMoveMousePointer(ppdev, pso, x, y);
+    }
+    else
+    {
+        IntHideMousePointer(ppdev, pso);
 
-    ppdev->ptlPointer.x = x;
-    ppdev->ptlPointer.y = y;
+        ppdev->ptlPointer.x = x;
+        ppdev->ptlPointer.y = y;
+
+        if (x != -1)
+            IntShowMousePointer(ppdev, pso);
+    }
 
     if (x != -1)
     {
-        IntShowMousePointer(ppdev, pso);
         if (prcl != NULL)
         {
             prcl->left = x - pgp->HotSpot.x;
@@ -33,6 +33,8 @@ typedef struct _GDIPOINTER /* should stay private to ENG? No, part of PDEVOBJ ak
   SURFACE  *psurfColor;
   SURFACE  *psurfMask;
   SURFACE  *psurfSave;
+  SURFACE  *psurfSaveBack; /* Second save surface, used while moving */
+  SURFACE  *psurfWork;     /* The new pointer is composed here before it is shown */
   FLONG    flags;
 
   /* Public pointer information */
@@ -100,6 +100,7 @@ EngStretchBltROP(
     BOOLEAN            Ret = TRUE;
     POINTL             AdjustedBrushOrigin;
     BOOL               UsesSource = ROP4_USES_SOURCE(Rop4);
+    BOOL               bHalftone;
 
     BYTE               clippingType;
     RECTL              ClipRect;
@@ -233,6 +234,12 @@ EngStretchBltROP(
 
     BltRectFunc = CallDibStretchBlt;
 
+    /* HALFTONE source copies to true colour surfaces are filtered */
+    bHalftone = (Mode == HALFTONE && UsesSource && Mask == NULL &&
+                 Rop4 == ROP4_FROM_INDEX(R3_OPINDEX_SRCCOPY) &&
+                 (psoOutput->iBitmapFormat == BMF_24BPP ||
+                  psoOutput->iBitmapFormat == BMF_32BPP));
+
     DstHeight = OutputRect.bottom - OutputRect.top;
     DstWidth = OutputRect.right - OutputRect.left;
     SrcHeight = InputRect.bottom - InputRect.top;
@@ -240,6 +247,12 @@ EngStretchBltROP(
     switch (clippingType)
     {
         case DC_TRIVIAL:
+            if (bHalftone &&
+                DIB_XXBPP_StretchBltHalftone(psoOutput, psoInput, &OutputRect,
+                                             &InputRect, &OutputRect, ColorTranslation))
+            {
+                break;
+            }
             Ret = (*BltRectFunc)(psoOutput, psoInput, Mask,
                          ColorTranslation, &OutputRect, &InputRect, MaskOrigin,
                          pbo, &AdjustedBrushOrigin, Rop4);
@@ -252,6 +265,12 @@ EngStretchBltROP(
             ClipRect.bottom = ClipRegion->rclBounds.bottom + Translate.y;
             if (RECTL_bIntersectRect(&CombinedRect, &OutputRect, &ClipRect))
             {
+                if (bHalftone &&
+                    DIB_XXBPP_StretchBltHalftone(psoOutput, psoInput, &OutputRect,
+                                                 &InputRect, &CombinedRect, ColorTranslation))
+                {
+                    break;
+                }
                 InputToCombinedRect.top = InputRect.top + (CombinedRect.top - OutputRect.top) * SrcHeight / DstHeight;
                 InputToCombinedRect.bottom = InputRect.top + (CombinedRect.bottom - OutputRect.top) * SrcHeight / DstHeight;
                 InputToCombinedRect.left = InputRect.left + (CombinedRect.left - OutputRect.left) * SrcWidth / DstWidth;
@@ -297,6 +316,12 @@ EngStretchBltROP(
                     ClipRect.bottom = RectEnum.arcl[i].bottom + Translate.y;
                     if (RECTL_bIntersectRect(&CombinedRect, &OutputRect, &ClipRect))
                     {
+                        if (bHalftone &&
+                            DIB_XXBPP_StretchBltHalftone(psoOutput, psoInput, &OutputRect,
+                                                         &InputRect, &CombinedRect, ColorTranslation))
+                        {
+                            continue;
+                        }
                         InputToCombinedRect.top = InputRect.top + (CombinedRect.top - OutputRect.top) * SrcHeight / DstHeight;
                         InputToCombinedRect.bottom = InputRect.top + (CombinedRect.bottom - OutputRect.top) * SrcHeight / DstHeight;
                         InputToCombinedRect.left = InputRect.left + (CombinedRect.left - OutputRect.left) * SrcWidth / DstWidth;
@@ -371,7 +396,8 @@ IntEngStretchBlt(SURFOBJ *psoDest,
                  POINTL *pMaskOrigin,
                  BRUSHOBJ *pbo,
                  POINTL *BrushOrigin,
-                 DWORD Rop4)
+                 DWORD Rop4,
+                 ULONG Mode)
 {
     BOOLEAN ret;
     POINTL MaskOrigin = {0, 0};
@@ -491,7 +517,7 @@ IntEngStretchBlt(SURFOBJ *psoDest,
                                                  &OutputRect,
                                                  &InputRect,
                                                  &MaskOrigin,
-                                                 COLORONCOLOR,
+                                                 Mode,
                                                  pbo,
                                                  Rop4);
     }
@@ -508,7 +534,7 @@ IntEngStretchBlt(SURFOBJ *psoDest,
                                &OutputRect,
                                &InputRect,
                                &MaskOrigin,
-                               COLORONCOLOR,
+                               Mode,
                                pbo,
                                Rop4);
     }
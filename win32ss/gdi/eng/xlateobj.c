@@ -19,9 +19,19 @@ EXLATEOBJ_iXlateTrivial(
     _In_ PEXLATEOBJ pexlo,
     _In_ ULONG iColor);
 
+_Function_class_(FN_XLATE_SPAN)
+static
+VOID
+FASTCALL
+EXLATEOBJ_vXlateSpanTrivial(
+    _In_ PEXLATEOBJ pexlo,
+    _Out_writes_(cPixels) PULONG pulDst,
+    _In_reads_(cPixels) const ULONG *pulSrc,
+    _In_ ULONG cPixels);
+
 /** Globals *******************************************************************/
 
-EXLATEOBJ gexloTrivial = {{0, XO_TRIVIAL, 0, 0, 0, 0}, EXLATEOBJ_iXlateTrivial};
+EXLATEOBJ gexloTrivial = {{0, XO_TRIVIAL, 0, 0, 0, 0}, EXLATEOBJ_iXlateTrivial, EXLATEOBJ_vXlateSpanTrivial};
 
 static ULONG giUniqueXlate = 0;
 
@@ -351,6 +361,145 @@ EXLATEOBJ_iXlateBitfieldsToPal(PEXLATEOBJ pexlo, ULONG iColor)
 }
 
 
+/** Span functions ************************************************************/
+
+/*
+ * The span functions translate a whole scanline with one call. They call the
+ * iXlate function of their kind directly, so the compiler can inline it into
+ * the loop and vectorize the pure shift and mask conversions. pulDst may be
+ * the same buffer as pulSrc.
+ */
+
+#define DEFINE_XLATE_SPAN(name) \
+_Function_class_(FN_XLATE_SPAN) \
+static \
+VOID \
+FASTCALL \
+EXLATEOBJ_vXlateSpan##name(PEXLATEOBJ pexlo, PULONG pulDst, const ULONG *pulSrc, ULONG cPixels) \
+{ \
+    ULONG i; \
+\
+    for (i = 0; i < cPixels; i++) \
+        pulDst[i] = EXLATEOBJ_iXlate##name(pexlo, pulSrc[i]); \
+}
+
+/* The nearest palette index search is slow, don't repeat it for runs of equal colors */
+#define DEFINE_XLATE_SPAN_CACHED(name) \
+_Function_class_(FN_XLATE_SPAN) \
+static \
+VOID \
+FASTCALL \
+EXLATEOBJ_vXlateSpan##name(PEXLATEOBJ pexlo, PULONG pulDst, const ULONG *pulSrc, ULONG cPixels) \
+{ \
+    ULONG i, iLastSrc, iLastDst; \
+\
+    if (cPixels == 0) return; \
+    iLastSrc = pulSrc[0]; \
+    iLastDst = EXLATEOBJ_iXlate##name(pexlo, iLastSrc); \
+    for (i = 0; i < cPixels; i++) \
+    { \
+        if (pulSrc[i] != iLastSrc) \
+        { \
+            iLastSrc = pulSrc[i]; \
+            iLastDst = EXLATEOBJ_iXlate##name(pexlo, iLastSrc); \
+        } \
+        pulDst[i] = iLastDst; \
+    } \
+}
+
+DEFINE_XLATE_SPAN(ToMono)
+DEFINE_XLATE_SPAN(Table)
+DEFINE_XLATE_SPAN(RGBtoBGR)
+DEFINE_XLATE_SPAN(RGBto555)
+DEFINE_XLATE_SPAN(BGRto555)
+DEFINE_XLATE_SPAN(RGBto565)
+DEFINE_XLATE_SPAN(BGRto565)
+DEFINE_XLATE_SPAN_CACHED(RGBtoPal)
+DEFINE_XLATE_SPAN(555toRGB)
+DEFINE_XLATE_SPAN(555toBGR)
+DEFINE_XLATE_SPAN(555to565)
+DEFINE_XLATE_SPAN_CACHED(555toPal)
+DEFINE_XLATE_SPAN(565to555)
+DEFINE_XLATE_SPAN(565toRGB)
+DEFINE_XLATE_SPAN(565toBGR)
+DEFINE_XLATE_SPAN_CACHED(565toPal)
+DEFINE_XLATE_SPAN(ShiftAndMask)
+DEFINE_XLATE_SPAN_CACHED(BitfieldsToPal)
+
+_Function_class_(FN_XLATE_SPAN)
+static
+VOID
+FASTCALL
+EXLATEOBJ_vXlateSpanTrivial(
+    _In_ PEXLATEOBJ pexlo,
+    _Out_writes_(cPixels) PULONG pulDst,
+    _In_reads_(cPixels) const ULONG *pulSrc,
+    _In_ ULONG cPixels)
+{
+    if (pulDst != pulSrc)
+        RtlMoveMemory(pulDst, pulSrc, cPixels * sizeof(ULONG));
+}
+
+static const struct
+{
+    PFN_XLATE pfnXlate;
+    PFN_XLATE_SPAN pfnXlateSpan;
+} gaXlateSpans[] =
+{
+    {EXLATEOBJ_iXlateTrivial, EXLATEOBJ_vXlateSpanTrivial},
+    {EXLATEOBJ_iXlateToMono, EXLATEOBJ_vXlateSpanToMono},
+    {EXLATEOBJ_iXlateTable, EXLATEOBJ_vXlateSpanTable},
+    {EXLATEOBJ_iXlateRGBtoBGR, EXLATEOBJ_vXlateSpanRGBtoBGR},
+    {EXLATEOBJ_iXlateRGBto555, EXLATEOBJ_vXlateSpanRGBto555},
+    {EXLATEOBJ_iXlateBGRto555, EXLATEOBJ_vXlateSpanBGRto555},
+    {EXLATEOBJ_iXlateRGBto565, EXLATEOBJ_vXlateSpanRGBto565},
+    {EXLATEOBJ_iXlateBGRto565, EXLATEOBJ_vXlateSpanBGRto565},
+    {EXLATEOBJ_iXlateRGBtoPal, EXLATEOBJ_vXlateSpanRGBtoPal},
+    {EXLATEOBJ_iXlate555toRGB, EXLATEOBJ_vXlateSpan555toRGB},
+    {EXLATEOBJ_iXlate555toBGR, EXLATEOBJ_vXlateSpan555toBGR},
+    {EXLATEOBJ_iXlate555to565, EXLATEOBJ_vXlateSpan555to565},
+    {EXLATEOBJ_iXlate555toPal, EXLATEOBJ_vXlateSpan555toPal},
+    {EXLATEOBJ_iXlate565to555, EXLATEOBJ_vXlateSpan565to555},
+    {EXLATEOBJ_iXlate565toRGB, EXLATEOBJ_vXlateSpan565toRGB},
+    {EXLATEOBJ_iXlate565toBGR, EXLATEOBJ_vXlateSpan565toBGR},
+    {EXLATEOBJ_iXlate565toPal, EXLATEOBJ_vXlateSpan565toPal},
+    {EXLATEOBJ_iXlateShiftAndMask, EXLATEOBJ_vXlateSpanShiftAndMask},
+    {EXLATEOBJ_iXlateBitfieldsToPal, EXLATEOBJ_vXlateSpanBitfieldsToPal},
+};
+
+_Function_class_(FN_XLATE_SPAN)
+static
+VOID
+FASTCALL
+EXLATEOBJ_vXlateSpanGeneric(
+    _In_ PEXLATEOBJ pexlo,
+    _Out_writes_(cPixels) PULONG pulDst,
+    _In_reads_(cPixels) const ULONG *pulSrc,
+    _In_ ULONG cPixels)
+{
+    ULONG i;
+
+    for (i = 0; i < cPixels; i++)
+        pulDst[i] = pexlo->pfnXlate(pexlo, pulSrc[i]);
+}
+
+static
+PFN_XLATE_SPAN
+EXLATEOBJ_pfnGetXlateSpan(
+    _In_ PFN_XLATE pfnXlate)
+{
+    ULONG i;
+
+    for (i = 0; i < _countof(gaXlateSpans); i++)
+    {
+        if (gaXlateSpans[i].pfnXlate == pfnXlate)
+            return gaXlateSpans[i].pfnXlateSpan;
+    }
+
+    return EXLATEOBJ_vXlateSpanGeneric;
+}
+
+
 /** Private Functions *********************************************************/
 
 VOID
@@ -374,6 +523,7 @@ EXLATEOBJ_vInitialize(
     pexlo->xlo.flXlate = 0;
     pexlo->xlo.pulXlate = pexlo->aulXlate;
     pexlo->pfnXlate = EXLATEOBJ_iXlateTrivial;
+    pexlo->pfnXlateSpan = EXLATEOBJ_vXlateSpanTrivial;
     pexlo->hColorTransform = NULL;
     pexlo->ppalSrc = ppalSrc;
     pexlo->ppalDst = ppalDst;
@@ -604,6 +754,8 @@ EXLATEOBJ_vInitialize(
         pexlo->xlo.flXlate = XO_TRIVIAL;
     else
         pexlo->xlo.flXlate &= ~XO_TRIVIAL;
+
+    pexlo->pfnXlateSpan = EXLATEOBJ_pfnGetXlateSpan(pexlo->pfnXlate);
 }
 
 VOID
@@ -656,6 +808,27 @@ EXLATEOBJ_vCleanup(
     pexlo->xlo.pulXlate = pexlo->aulXlate;
 }
 
+VOID
+FASTCALL
+XLATEOBJ_vXlateSpan(
+    _In_opt_ XLATEOBJ *pxlo,
+    _Out_writes_(cPixels) PULONG pulDst,
+    _In_reads_(cPixels) const ULONG *pulSrc,
+    _In_ ULONG cPixels)
+{
+    PEXLATEOBJ pexlo = (PEXLATEOBJ)pxlo;
+
+    if (!pxlo)
+    {
+        if (pulDst != pulSrc)
+            RtlMoveMemory(pulDst, pulSrc, cPixels * sizeof(ULONG));
+        return;
+    }
+
+    /* Call the span function */
+    pexlo->pfnXlateSpan(pexlo, pulDst, pulSrc, cPixels);
+}
+
 /** Public DDI Functions ******************************************************/
 
 #undef XLATEOBJ_iXlate
@@ -16,11 +16,21 @@ ULONG
     _In_ struct _EXLATEOBJ *pexlo,
     _In_ ULONG iColor);
 
+_Function_class_(FN_XLATE_SPAN)
+typedef
+VOID
+(FASTCALL *PFN_XLATE_SPAN)(
+    _In_ struct _EXLATEOBJ *pexlo,
+    _Out_writes_(cPixels) PULONG pulDst,
+    _In_reads_(cPixels) const ULONG *pulSrc,
+    _In_ ULONG cPixels);
+
 typedef struct _EXLATEOBJ
 {
     XLATEOBJ xlo;
 
     PFN_XLATE pfnXlate;
+    PFN_XLATE_SPAN pfnXlateSpan;
 
     PPALETTE ppalSrc;
     PPALETTE ppalDst;
@@ -54,6 +64,14 @@ XLATEOBJ_pfnXlate(
     return ((PEXLATEOBJ)pxlo)->pfnXlate;
 }
 
+VOID
+FASTCALL
+XLATEOBJ_vXlateSpan(
+    _In_opt_ XLATEOBJ *pxlo,
+    _Out_writes_(cPixels) PULONG pulDst,
+    _In_reads_(cPixels) const ULONG *pulSrc,
+    _In_ ULONG cPixels);
+
 VOID
 NTAPI
 EXLATEOBJ_vInitialize(
@@ -352,12 +352,13 @@ BOOL FASTCALL LoadTheSpoolerDrv(VOID);
 
 FORCEINLINE
 PVOID
-GdiAllocBatchCommand(
+GdiAllocBatchCommandEx(
     HDC hdc,
-    USHORT Cmd)
+    USHORT Cmd,
+    ULONG cjExtra)
 {
     PTEB pTeb;
-    USHORT cjSize;
+    ULONG cjSize;
     PGDIBATCHHDR pHdr;
 
     /* Get a pointer to the TEB */
@@ -366,21 +367,14 @@ GdiAllocBatchCommand(
     /* Check if we have a valid environment */
     if (!pTeb || !pTeb->Win32ThreadInfo) return NULL;
 
-    /* Do we use a DC? */
-    if (hdc)
-    {
-        /* If the batch DC is NULL, we set this one as the new one */
-        if (!pTeb->GdiTebBatch.HDC) pTeb->GdiTebBatch.HDC = hdc;
-
-        /* If not, check if the batch DC equal to our DC */
-        else if (pTeb->GdiTebBatch.HDC != hdc) return NULL;
-    }
+    /* Do we use a DC? If so, it must be the batch DC, if there is one */
+    if (hdc && pTeb->GdiTebBatch.HDC && (pTeb->GdiTebBatch.HDC != hdc)) return NULL;
 
     /* Get the size of the entry */
-    if      (Cmd == GdiBCPatBlt) cjSize = 0;
-    else if (Cmd == GdiBCPolyPatBlt) cjSize = 0;
-    else if (Cmd == GdiBCTextOut) cjSize = 0;
-    else if (Cmd == GdiBCExtTextOut) cjSize = 0;
+    if      (Cmd == GdiBCPatBlt) cjSize = sizeof(GDIBSPATBLT);
+    else if (Cmd == GdiBCPolyPatBlt) cjSize = FIELD_OFFSET(GDIBSPPATBLT, pRect);
+    else if (Cmd == GdiBCTextOut) cjSize = FIELD_OFFSET(GDIBSTEXTOUT, Buffer);
+    else if (Cmd == GdiBCExtTextOut) cjSize = sizeof(GDIBSEXTTEXTOUT);
     else if (Cmd == GdiBCSetBrushOrg) cjSize = sizeof(GDIBSSETBRHORG);
     else if (Cmd == GdiBCExtSelClipRgn) cjSize = 0;
     else if (Cmd == GdiBCSelObj) cjSize = sizeof(GDIBSOBJECT);
@@ -391,15 +385,24 @@ GdiAllocBatchCommand(
     /* Unsupported operation */
     if (cjSize == 0) return NULL;
 
+    /* Add the variable sized data, keeping the entries ULONG aligned */
+    cjSize = (cjSize + cjExtra + sizeof(ULONG) - 1) & ~(sizeof(ULONG) - 1);
+
+    /* Check if the entry can fit in the buffer at all */
+    if (cjSize > GDIBATCHBUFSIZE) return NULL;
+
     /* Check if the buffer is full */
     if ((pTeb->GdiBatchCount >= GDI_BatchLimit) ||
         ((pTeb->GdiTebBatch.Offset + cjSize) > GDIBATCHBUFSIZE))
     {
         /* Call win32k, the kernel will call NtGdiFlushUserBatch to flush
-           the current batch */
+           the current batch. This also resets the batch DC. */
         NtGdiFlush();
     }
 
+    /* If the batch DC is NULL, we set this one as the new one */
+    if (hdc && !pTeb->GdiTebBatch.HDC) pTeb->GdiTebBatch.HDC = hdc;
+
     /* Get the head of the entry */
     pHdr = (PVOID)((PUCHAR)pTeb->GdiTebBatch.Buffer + pTeb->GdiTebBatch.Offset);
 
@@ -409,11 +412,20 @@ GdiAllocBatchCommand(
 
     /* Fill in the core fields */
     pHdr->Cmd = Cmd;
-    pHdr->Size = cjSize;
+    pHdr->Size = (SHORT)cjSize;
 
     return pHdr;
 }
 
+FORCEINLINE
+PVOID
+GdiAllocBatchCommand(
+    HDC hdc,
+    USHORT Cmd)
+{
+    return GdiAllocBatchCommandEx(hdc, Cmd, 0);
+}
+
 FORCEINLINE
 PDC_ATTR
 GdiGetDcAttr(HDC hdc)
@@ -496,7 +496,7 @@ SetViewportExtEx(
     {
         if (NtCurrentTeb()->GdiTebBatch.HDC == hdc)
         {
-            if (pdcattr->ulDirty_ & DC_FONTTEXT_DIRTY)
+            if (pdcattr->ulDirty_ & (DC_MODE_DIRTY|DC_FONTTEXT_DIRTY))
             {
                 NtGdiFlush(); // Sync up pdcattr from Kernel space.
                 pdcattr->ulDirty_ &= ~(DC_MODE_DIRTY|DC_FONTTEXT_DIRTY);
@@ -622,7 +622,7 @@ SetWindowExtEx(
 
         if (NtCurrentTeb()->GdiTebBatch.HDC == hdc)
         {
-            if (pdcattr->ulDirty_ & DC_FONTTEXT_DIRTY)
+            if (pdcattr->ulDirty_ & (DC_MODE_DIRTY|DC_FONTTEXT_DIRTY))
             {
                 NtGdiFlush(); // Sync up Dc_Attr from Kernel space.
                 pdcattr->ulDirty_ &= ~(DC_MODE_DIRTY|DC_FONTTEXT_DIRTY);
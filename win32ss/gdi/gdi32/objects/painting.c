@@ -456,9 +456,44 @@ PatBlt(
     _In_ INT nHeight,
     _In_ DWORD dwRop)
 {
+    PDC_ATTR pdcattr;
+    PGDIBSPATBLT pgO;
+
     HANDLE_METADC(BOOL, PatBlt, FALSE, hdc, nXLeft, nYLeft, nWidth, nHeight, dwRop);
 
-    /* FIXME some part need be done in user mode */
+    /* Rops with a source fail in win32k, which a batch command cannot report */
+    if (!ROP_USES_SOURCE(dwRop))
+    {
+        pdcattr = GdiGetDcAttr(hdc);
+
+        /* If the DC does not have a DIB section selected, try a batch command */
+        if (pdcattr && !(pdcattr->ulDirty_ & DC_DIBSECTION))
+        {
+            pgO = GdiAllocBatchCommand(hdc, GdiBCPatBlt);
+            if (pgO)
+            {
+                pgO->nXLeft = nXLeft;
+                pgO->nYLeft = nYLeft;
+                pgO->nWidth = nWidth;
+                pgO->nHeight = nHeight;
+                pgO->dwRop = dwRop;
+
+                /* Snapshot the attributes the brush is realized with */
+                pgO->hbrush = pdcattr->hbrush;
+                pgO->crForegroundClr = pdcattr->crForegroundClr;
+                pgO->crBackgroundClr = pdcattr->crBackgroundClr;
+                pgO->crBrushClr = pdcattr->crBrushClr;
+                pgO->ulForegroundClr = pdcattr->ulForegroundClr;
+                pgO->ulBackgroundClr = pdcattr->ulBackgroundClr;
+                pgO->ulBrushClr = pdcattr->ulBrushClr;
+
+                /* Mode changes done in user mode need to flush the batch first */
+                pdcattr->ulDirty_ |= DC_MODE_DIRTY;
+                return TRUE;
+            }
+        }
+    }
+
     return NtGdiPatBlt( hdc,  nXLeft,  nYLeft,  nWidth,  nHeight,  dwRop);
 }
 
@@ -474,6 +509,8 @@ PolyPatBlt(
     UINT i;
     BOOL bResult;
     HBRUSH hbrOld;
+    PDC_ATTR pdcattr;
+    PGDIBSPPATBLT pgO;
 
     /* Handle meta DCs */
     if ((GDI_HANDLE_GET_TYPE(hdc) == GDILoObjType_LO_METADC16_TYPE) ||
@@ -511,7 +548,39 @@ PolyPatBlt(
         return bResult;
     }
 
-    /* FIXME some part need be done in user mode */
+    /* Small requests go into the batch, unless a DIB section is selected */
+    if (!ROP_USES_SOURCE(dwRop) &&
+        (nCount > 0) &&
+        (nCount <= (GDIBATCHBUFSIZE / sizeof(PATRECT))))
+    {
+        pdcattr = GdiGetDcAttr(hdc);
+        if (pdcattr && !(pdcattr->ulDirty_ & DC_DIBSECTION))
+        {
+            pgO = GdiAllocBatchCommandEx(hdc, GdiBCPolyPatBlt, nCount * sizeof(PATRECT));
+            if (pgO)
+            {
+                pgO->rop4 = dwRop;
+                pgO->Mode = dwMode;
+                pgO->Count = nCount;
+
+                /* POLYPATBLT and PATRECT share their layout */
+                RtlCopyMemory(pgO->pRect, pPoly, nCount * sizeof(PATRECT));
+
+                /* Snapshot the attributes the brushes are realized with */
+                pgO->crForegroundClr = pdcattr->crForegroundClr;
+                pgO->crBackgroundClr = pdcattr->crBackgroundClr;
+                pgO->crBrushClr = pdcattr->crBrushClr;
+                pgO->ulForegroundClr = pdcattr->ulForegroundClr;
+                pgO->ulBackgroundClr = pdcattr->ulBackgroundClr;
+                pgO->ulBrushClr = pdcattr->ulBrushClr;
+
+                /* Mode changes done in user mode need to flush the batch first */
+                pdcattr->ulDirty_ |= DC_MODE_DIRTY;
+                return TRUE;
+            }
+        }
+    }
+
     return NtGdiPolyPatBlt(hdc, dwRop, pPoly, nCount, dwMode);
 }
 
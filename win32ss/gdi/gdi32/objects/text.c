@@ -473,6 +473,104 @@ ExtTextOutA(
 }
 
 
+/*
+ * Queues ExtTextOutW into the GDI batch. Returns FALSE if the call
+ * has to go to win32k directly.
+ */
+static
+BOOL
+GdiBatchExtTextOut(
+    _In_ HDC hdc,
+    _In_ INT x,
+    _In_ INT y,
+    _In_ UINT fuOptions,
+    _In_opt_ const RECT *lprc,
+    _In_reads_opt_(cwc) LPCWSTR lpString,
+    _In_ UINT cwc,
+    _In_reads_opt_(cwc) const INT *lpDx)
+{
+    PDC_ATTR pdcattr;
+    PGDIBSEXTTEXTOUT pgEO;
+    PGDIBSTEXTOUT pgO;
+    ULONG cjDx, cjString;
+
+    /* Get the DC attribute */
+    pdcattr = GdiGetDcAttr(hdc);
+    if (pdcattr == NULL)
+        return FALSE;
+
+    /* Not with a DIB section selected, and TA_UPDATECP needs the current
+       position from win32k */
+    if ((pdcattr->ulDirty_ & DC_DIBSECTION) ||
+        (pdcattr->lTextAlign & TA_UPDATECP))
+    {
+        return FALSE;
+    }
+
+    if (cwc == 0)
+    {
+        /* Only the opaque rectangle fill is worth a batch command */
+        if (!lprc || !(fuOptions & ETO_OPAQUE))
+            return FALSE;
+
+        pgEO = GdiAllocBatchCommand(hdc, GdiBCExtTextOut);
+        if (!pgEO)
+            return FALSE;
+
+        pgEO->Count = 0;
+        pgEO->Options = fuOptions;
+        pgEO->Rect = *lprc;
+
+        /* Snapshot attributes */
+        pgEO->ulBackgroundClr = pdcattr->ulBackgroundClr;
+
+        /* Mode changes done in user mode need to flush the batch first */
+        pdcattr->ulDirty_ |= DC_MODE_DIRTY;
+        return TRUE;
+    }
+
+    /* Let win32k fail invalid parameters, and long strings do not fit */
+    if (!lpString || (cwc > GDIBATCHBUFSIZE / sizeof(WCHAR)))
+        return FALSE;
+
+    /* If ETO_PDY is specified, we have pairs of INTs */
+    cjDx = lpDx ? (cwc * sizeof(INT)) * (fuOptions & ETO_PDY ? 2 : 1) : 0;
+    cjString = cwc * sizeof(WCHAR);
+
+    pgO = GdiAllocBatchCommandEx(hdc, GdiBCTextOut, cjDx + cjString);
+    if (!pgO)
+        return FALSE;
+
+    pgO->x = x;
+    pgO->y = y;
+    pgO->Options = fuOptions;
+    if (lprc)
+        pgO->Rect = *lprc;
+    else
+        pgO->Options |= GDIBS_NORECT;
+    pgO->iCS_CP = 0;
+    pgO->cbCount = cwc;
+    pgO->Size = cjDx;
+
+    /* Put the Dx before the String to assure alignment of 4 */
+    if (lpDx)
+        RtlCopyMemory(pgO->Buffer, lpDx, cjDx);
+    RtlCopyMemory((PUCHAR)pgO->Buffer + cjDx, lpString, cjString);
+
+    /* Snapshot attributes */
+    pgO->crForegroundClr = pdcattr->crForegroundClr;
+    pgO->crBackgroundClr = pdcattr->crBackgroundClr;
+    pgO->ulForegroundClr = pdcattr->ulForegroundClr;
+    pgO->ulBackgroundClr = pdcattr->ulBackgroundClr;
+    pgO->lmBkMode = pdcattr->lBkMode;
+    pgO->hlfntNew = pdcattr->hlfntNew;
+    pgO->flTextAlign = pdcattr->lTextAlign; // Raw
+
+    /* Mode and text changes done in user mode need to flush the batch first */
+    pdcattr->ulDirty_ |= (DC_MODE_DIRTY|DC_FONTTEXT_DIRTY);
+    return TRUE;
+}
+
 /*
  * @implemented
  */
@@ -506,6 +604,10 @@ ExtTextOutW(
             return LpkExtTextOut(hdc, x, y, fuOptions, lprc, lpString, cwc , lpDx, 0);
     }
 
+    /* Try a batch command first */
+    if (GdiBatchExtTextOut(hdc, x, y, fuOptions, lprc, lpString, cwc, lpDx))
+        return TRUE;
+
     return NtGdiExtTextOutW(hdc,
                             x,
                             y,
@@ -715,7 +715,9 @@ GreStretchBltMask(
                               BitmapMask ? &MaskPoint : NULL,
                               &DCDest->eboFill.BrushObject,
                               &BrushOrigin,
-                              rop4);
+                              rop4,
+                              (DCDest->pdcattr->jStretchBltMode == HALFTONE) ?
+                                  HALFTONE : COLORONCOLOR);
     if (UsesSource)
     {
         EXLATEOBJ_vCleanup(&exlo);
@@ -1338,7 +1338,9 @@ NtGdiStretchDIBitsInternal(
                                NULL,
                                &pdc->eboFill.BrushObject,
                                NULL,
-                               WIN32_ROP3_TO_ENG_ROP4(dwRop));
+                               WIN32_ROP3_TO_ENG_ROP4(dwRop),
+                               (pdc->pdcattr->jStretchBltMode == HALFTONE) ?
+                                   HALFTONE : COLORONCOLOR);
 
     /* Cleanup */
     DC_vFinishBlit(pdc, NULL);
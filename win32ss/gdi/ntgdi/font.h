@@ -25,9 +25,13 @@ typedef struct _FONT_ENTRY_COLL_MEM
 
 typedef struct _FONT_CACHE_ENTRY
 {
-    LIST_ENTRY ListEntry;
+    LIST_ENTRY ListEntry;       /* Global LRU list, most recently used first */
+    LIST_ENTRY HashEntry;       /* Hash bucket chain */
+    LIST_ENTRY FaceEntry;       /* SHARED_FACE::GlyphCacheListHead */
+    ULONG Hash;
+    ULONG Size;                 /* Bytes charged against the cache limit */
     int GlyphIndex;
-    FT_Face Face;
+    struct _SHARED_FACE *SharedFace;
     FT_BitmapGlyph BitmapGlyph;
     int Height;
     FT_Render_Mode RenderMode;
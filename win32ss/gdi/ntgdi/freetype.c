@@ -58,8 +58,10 @@ static UNICODE_STRING g_FontRegPath =
 
 
 /* The FreeType library is not thread safe, so we have
-   to serialize access to it */
-static PFAST_MUTEX      g_FreeTypeLock;
+   to serialize access to it. Reading face tables, mapping
+   characters and looking up cached glyphs is done with the
+   lock held shared, everything else needs it exclusively. */
+static PERESOURCE       g_FreeTypeLock;
 
 static LIST_ENTRY       g_FontListHead;
 static PFAST_MUTEX      g_FontListLock;
@@ -75,21 +77,48 @@ static BOOL             g_RenderingEnabled = TRUE;
     ASSERT(g_FontListLock->Owner == KeGetCurrentThread())
 
 #define IntLockFreeType() \
-    ExEnterCriticalRegionAndAcquireFastMutexUnsafe(g_FreeTypeLock)
+    ExEnterCriticalRegionAndAcquireResourceExclusive(g_FreeTypeLock)
+
+#define IntLockFreeTypeShared() \
+    ExEnterCriticalRegionAndAcquireResourceShared(g_FreeTypeLock)
 
 #define IntUnLockFreeType() \
-    ExReleaseFastMutexUnsafeAndLeaveCriticalRegion(g_FreeTypeLock)
+    ExReleaseResourceAndLeaveCriticalRegion(g_FreeTypeLock)
+
+#define IntDowngradeFreeTypeLock() \
+    ExConvertExclusiveToSharedLite(g_FreeTypeLock)
 
 #define ASSERT_FREETYPE_LOCK_HELD() \
-    ASSERT(g_FreeTypeLock->Owner == KeGetCurrentThread())
+    ASSERT(ExIsResourceAcquiredExclusiveLite(g_FreeTypeLock))
+
+#define ASSERT_FREETYPE_LOCK_HELD_SHARED() \
+    ASSERT(ExIsResourceAcquiredSharedLite(g_FreeTypeLock))
 
 #define ASSERT_FREETYPE_LOCK_NOT_HELD() \
-    ASSERT(g_FreeTypeLock->Owner != KeGetCurrentThread())
+    ASSERT(!ExIsResourceAcquiredSharedLite(g_FreeTypeLock))
+
+/* Protects the LRU order and counters of the glyph cache against
+   concurrent lookups under the shared FreeType lock */
+static PFAST_MUTEX      g_FontCacheLock;
+
+#define IntLockFontCache() \
+    ExEnterCriticalRegionAndAcquireFastMutexUnsafe(g_FontCacheLock)
+
+#define IntUnLockFontCache() \
+    ExReleaseFastMutexUnsafeAndLeaveCriticalRegion(g_FontCacheLock)
 
-#define MAX_FONT_CACHE 256
+/* The glyph cache is bounded by the memory the glyphs use, not their count */
+#define MAX_FONT_CACHE_SIZE     (1024 * 1024)
+#define FONT_CACHE_HASH_SIZE    1024    /* Must be a power of two */
 
 static LIST_ENTRY g_FontCacheListHead;
+static LIST_ENTRY g_FontCacheHashTable[FONT_CACHE_HASH_SIZE];
 static UINT g_FontCacheNumEntries;
+static ULONG g_FontCacheSize;
+static ULONG g_FontCacheHits;
+static ULONG g_FontCacheMisses;
+static ULONG g_FontCacheEvictions;
+static LONG g_FontCacheHoldCount;
 
 static PWCHAR g_ElfScripts[32] =   /* These are in the order of the fsCsb[0] bits */
 {
@@ -212,6 +241,7 @@ static PSHARED_FACE
 SharedFace_Create(FT_Face Face, PSHARED_MEM Memory)
 {
     PSHARED_FACE Ptr;
+    ULONG i;
     Ptr = ExAllocatePoolWithTag(PagedPool, sizeof(SHARED_FACE), TAG_FONT);
     if (Ptr)
     {
@@ -220,6 +250,10 @@ SharedFace_Create(FT_Face Face, PSHARED_MEM Memory)
         Ptr->Memory = Memory;
         SharedFaceCache_Init(&Ptr->EnglishUS);
         SharedFaceCache_Init(&Ptr->UserLanguage);
+        InitializeListHead(&Ptr->GlyphCacheListHead);
+        Ptr->SizeSerial = 0;
+        for (i = 0; i < SHARED_FACE_INDEX_CACHE_SIZE; i++)
+            Ptr->GlyphIndexCache[i].Char = MAXULONG;
 
         SharedMem_AddRef(Memory);
         DPRINT("Creating SharedFace for %s\n", Face->family_name ? Face->family_name : "<NULL>");
@@ -258,30 +292,68 @@ RemoveCachedEntry(PFONT_CACHE_ENTRY Entry)
 
     FT_Done_Glyph((FT_Glyph)Entry->BitmapGlyph);
     RemoveEntryList(&Entry->ListEntry);
-    ExFreePoolWithTag(Entry, TAG_FONT);
+    RemoveEntryList(&Entry->HashEntry);
+    RemoveEntryList(&Entry->FaceEntry);
+    ASSERT(g_FontCacheSize >= Entry->Size);
+    g_FontCacheSize -= Entry->Size;
     g_FontCacheNumEntries--;
-    ASSERT(g_FontCacheNumEntries <= MAX_FONT_CACHE);
+    ExFreePoolWithTag(Entry, TAG_FONT);
 }
 
+/* Evict the least recently used glyphs until the cache fits again */
 static void
-RemoveCacheEntries(FT_Face Face)
+FontCacheTrim(PFONT_CACHE_ENTRY KeepEntry)
 {
-    PLIST_ENTRY CurrentEntry, NextEntry;
-    PFONT_CACHE_ENTRY FontEntry;
+    ASSERT_FREETYPE_LOCK_HELD();
 
+    while ((g_FontCacheSize > MAX_FONT_CACHE_SIZE) &&
+           (!IsListEmpty(&g_FontCacheListHead)) &&
+           (!KeepEntry || g_FontCacheListHead.Blink != &KeepEntry->ListEntry))
+    {
+        RemoveCachedEntry(CONTAINING_RECORD(g_FontCacheListHead.Blink, FONT_CACHE_ENTRY, ListEntry));
+        g_FontCacheEvictions++;
+    }
+}
+
+/*
+ * Glyphs returned by the cache stay valid until the cache is released
+ * again, so a whole run can be rendered before it is drawn.
+ */
+static void
+FontCacheHold(void)
+{
     ASSERT_FREETYPE_LOCK_HELD();
 
-    for (CurrentEntry = g_FontCacheListHead.Flink;
-         CurrentEntry != &g_FontCacheListHead;
-         CurrentEntry = NextEntry)
+    InterlockedIncrement(&g_FontCacheHoldCount);
+}
+
+static void
+FontCacheRelease(void)
+{
+    ASSERT_FREETYPE_LOCK_HELD_SHARED();
+    ASSERT(g_FontCacheHoldCount > 0);
+
+    /* Shared owners may still use cached glyphs, the next insertion trims */
+    if ((InterlockedDecrement(&g_FontCacheHoldCount) == 0) &&
+        ExIsResourceAcquiredExclusiveLite(g_FreeTypeLock))
     {
-        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, ListEntry);
-        NextEntry = CurrentEntry->Flink;
+        FontCacheTrim(NULL);
+    }
+}
 
-        if (FontEntry->Face == Face)
-        {
-            RemoveCachedEntry(FontEntry);
-        }
+static void
+RemoveCacheEntries(PSHARED_FACE SharedFace)
+{
+    PFONT_CACHE_ENTRY FontEntry;
+
+    ASSERT_FREETYPE_LOCK_HELD();
+
+    /* Only the glyphs of this face have to be visited */
+    while (!IsListEmpty(&SharedFace->GlyphCacheListHead))
+    {
+        FontEntry = CONTAINING_RECORD(SharedFace->GlyphCacheListHead.Flink,
+                                      FONT_CACHE_ENTRY, FaceEntry);
+        RemoveCachedEntry(FontEntry);
     }
 }
 
@@ -325,7 +397,7 @@ SharedFace_Release(PSHARED_FACE Ptr)
     if (Ptr->RefCount == 0)
     {
         DPRINT("Releasing SharedFace for %s\n", Ptr->Face->family_name ? Ptr->Face->family_name : "<NULL>");
-        RemoveCacheEntries(Ptr->Face);
+        RemoveCacheEntries(Ptr);
         FT_Done_Face(Ptr->Face);
         SharedMem_Release(Ptr->Memory);
         SharedFaceCache_Release(&Ptr->EnglishUS);
@@ -614,10 +686,16 @@ BOOL FASTCALL
 InitFontSupport(VOID)
 {
     ULONG ulError;
+    ULONG i;
 
     InitializeListHead(&g_FontListHead);
     InitializeListHead(&g_FontCacheListHead);
+    for (i = 0; i < FONT_CACHE_HASH_SIZE; i++)
+    {
+        InitializeListHead(&g_FontCacheHashTable[i]);
+    }
     g_FontCacheNumEntries = 0;
+    g_FontCacheSize = 0;
     /* Fast Mutexes must be allocated from non paged pool */
     g_FontListLock = ExAllocatePoolWithTag(NonPagedPool, sizeof(FAST_MUTEX), TAG_INTERNAL_SYNC);
     if (g_FontListLock == NULL)
@@ -626,12 +704,20 @@ InitFontSupport(VOID)
     }
 
     ExInitializeFastMutex(g_FontListLock);
-    g_FreeTypeLock = ExAllocatePoolWithTag(NonPagedPool, sizeof(FAST_MUTEX), TAG_INTERNAL_SYNC);
+    g_FontCacheLock = ExAllocatePoolWithTag(NonPagedPool, sizeof(FAST_MUTEX), TAG_INTERNAL_SYNC);
+    if (g_FontCacheLock == NULL)
+    {
+        return FALSE;
+    }
+    ExInitializeFastMutex(g_FontCacheLock);
+
+    /* Resources must be allocated from non paged pool as well */
+    g_FreeTypeLock = ExAllocatePoolWithTag(NonPagedPool, sizeof(ERESOURCE), TAG_INTERNAL_SYNC);
     if (g_FreeTypeLock == NULL)
     {
         return FALSE;
     }
-    ExInitializeFastMutex(g_FreeTypeLock);
+    ExInitializeResourceLite(g_FreeTypeLock);
 
     ulError = FT_Init_FreeType(&g_FreeTypeLibrary);
     if (ulError)
@@ -1116,7 +1202,7 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
     }
 
     os2_version = 0;
-    IntLockFreeType();
+    IntLockFreeTypeShared();
     pOS2 = (TT_OS2 *)FT_Get_Sfnt_Table(Face, FT_SFNT_OS2);
     if (pOS2)
     {
@@ -1156,7 +1242,7 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
     else
     {
         /* get charset from WinFNT header */
-        IntLockFreeType();
+        IntLockFreeTypeShared();
         Error = FT_Get_WinFNT_Header(Face, &WinFNT);
         if (!Error)
         {
@@ -2818,25 +2904,53 @@ SameScaleMatrix(
             FLOATOBJ_Equal(&pmx1->efM22, &pmx2->efM22));
 }
 
+static
+ULONG
+FontCacheHash(
+    PSHARED_FACE SharedFace,
+    INT GlyphIndex,
+    INT Height,
+    FT_Render_Mode RenderMode)
+{
+    ULONG_PTR Hash;
+
+    /* The low bits of the pointer are always the same */
+    Hash = (ULONG_PTR)SharedFace;
+    Hash ^= Hash >> 7;
+    Hash = Hash * 31 + (ULONG)Height;
+    Hash = Hash * 31 + (ULONG)RenderMode;
+    Hash = Hash * 31 + (ULONG)GlyphIndex;
+    return (ULONG)Hash;
+}
+
 FT_BitmapGlyph APIENTRY
 ftGdiGlyphCacheGet(
-    FT_Face Face,
+    PSHARED_FACE SharedFace,
     INT GlyphIndex,
     INT Height,
     FT_Render_Mode RenderMode,
     PMATRIX pmx)
 {
-    PLIST_ENTRY CurrentEntry;
+    PLIST_ENTRY CurrentEntry, BucketHead;
     PFONT_CACHE_ENTRY FontEntry;
+    FT_BitmapGlyph BitmapGlyph;
+    ULONG Hash;
 
-    ASSERT_FREETYPE_LOCK_HELD();
+    /* Entries are only inserted and removed with the lock held exclusively */
+    ASSERT_FREETYPE_LOCK_HELD_SHARED();
+
+    Hash = FontCacheHash(SharedFace, GlyphIndex, Height, RenderMode);
+    BucketHead = &g_FontCacheHashTable[Hash & (FONT_CACHE_HASH_SIZE - 1)];
 
-    for (CurrentEntry = g_FontCacheListHead.Flink;
-         CurrentEntry != &g_FontCacheListHead;
+    IntLockFontCache();
+
+    for (CurrentEntry = BucketHead->Flink;
+         CurrentEntry != BucketHead;
          CurrentEntry = CurrentEntry->Flink)
     {
-        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, ListEntry);
-        if ((FontEntry->Face == Face) &&
+        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, HashEntry);
+        if ((FontEntry->Hash == Hash) &&
+            (FontEntry->SharedFace == SharedFace) &&
             (FontEntry->GlyphIndex == GlyphIndex) &&
             (FontEntry->Height == Height) &&
             (FontEntry->RenderMode == RenderMode) &&
@@ -2844,14 +2958,22 @@ ftGdiGlyphCacheGet(
             break;
     }
 
-    if (CurrentEntry == &g_FontCacheListHead)
+    if (CurrentEntry == BucketHead)
     {
+        g_FontCacheMisses++;
+        IntUnLockFontCache();
         return NULL;
     }
 
-    RemoveEntryList(CurrentEntry);
-    InsertHeadList(&g_FontCacheListHead, CurrentEntry);
-    return FontEntry->BitmapGlyph;
+    g_FontCacheHits++;
+
+    /* Move it to the front of the LRU list */
+    RemoveEntryList(&FontEntry->ListEntry);
+    InsertHeadList(&g_FontCacheListHead, &FontEntry->ListEntry);
+    BitmapGlyph = FontEntry->BitmapGlyph;
+
+    IntUnLockFontCache();
+    return BitmapGlyph;
 }
 
 /* no cache */
@@ -2898,7 +3020,7 @@ ftGdiGlyphSet(
 
 FT_BitmapGlyph APIENTRY
 ftGdiGlyphCacheSet(
-    FT_Face Face,
+    PSHARED_FACE SharedFace,
     INT GlyphIndex,
     INT Height,
     PMATRIX pmx,
@@ -2951,22 +3073,41 @@ ftGdiGlyphCacheSet(
     BitmapGlyph->bitmap = AlignedBitmap;
 
     NewEntry->GlyphIndex = GlyphIndex;
-    NewEntry->Face = Face;
+    NewEntry->SharedFace = SharedFace;
     NewEntry->BitmapGlyph = BitmapGlyph;
     NewEntry->Height = Height;
     NewEntry->RenderMode = RenderMode;
     NewEntry->mxWorldToDevice = *pmx;
+    NewEntry->Hash = FontCacheHash(SharedFace, GlyphIndex, Height, RenderMode);
+    NewEntry->Size = sizeof(FONT_CACHE_ENTRY) + sizeof(FT_BitmapGlyphRec) +
+                     abs(BitmapGlyph->bitmap.pitch) * BitmapGlyph->bitmap.rows;
 
     InsertHeadList(&g_FontCacheListHead, &NewEntry->ListEntry);
-    if (++g_FontCacheNumEntries > MAX_FONT_CACHE)
-    {
-        NewEntry = CONTAINING_RECORD(g_FontCacheListHead.Blink, FONT_CACHE_ENTRY, ListEntry);
-        RemoveCachedEntry(NewEntry);
-    }
+    InsertHeadList(&g_FontCacheHashTable[NewEntry->Hash & (FONT_CACHE_HASH_SIZE - 1)],
+                   &NewEntry->HashEntry);
+    InsertHeadList(&SharedFace->GlyphCacheListHead, &NewEntry->FaceEntry);
+    g_FontCacheNumEntries++;
+    g_FontCacheSize += NewEntry->Size;
+
+    /* Evict the least recently used glyphs, but never the new one */
+    if (g_FontCacheHoldCount == 0)
+        FontCacheTrim(NewEntry);
 
     return BitmapGlyph;
 }
 
+/* Used by the debugger, so this must not take any locks */
+VOID FASTCALL
+ftGdiGetGlyphCacheStatistics(PFONT_CACHE_STATISTICS Statistics)
+{
+    Statistics->Entries = g_FontCacheNumEntries;
+    Statistics->Size = g_FontCacheSize;
+    Statistics->MaxSize = MAX_FONT_CACHE_SIZE;
+    Statistics->Hits = g_FontCacheHits;
+    Statistics->Misses = g_FontCacheMisses;
+    Statistics->Evictions = g_FontCacheEvictions;
+}
+
 
 static void FTVectorToPOINTFX(FT_Vector *vec, POINTFX *pt)
 {
@@ -3197,7 +3338,7 @@ static unsigned int get_bezier_glyph_outline(FT_Outline *outline, unsigned int b
 }
 
 static FT_Error
-IntRequestFontSize(PDC dc, PFONTGDI FontGDI, LONG lfWidth, LONG lfHeight)
+IntRequestFontSizeWorker(PDC dc, PFONTGDI FontGDI, LONG lfWidth, LONG lfHeight)
 {
     FT_Error error;
     FT_Size_RequestRec  req;
@@ -3299,6 +3440,42 @@ IntRequestFontSize(PDC dc, PFONTGDI FontGDI, LONG lfWidth, LONG lfHeight)
     return FT_Request_Size(face, &req);
 }
 
+static FT_Error
+IntRequestFontSize(PDC dc, PFONTGDI FontGDI, LONG lfWidth, LONG lfHeight)
+{
+    PSHARED_FACE SharedFace = FontGDI->SharedFace;
+    FT_Error error;
+
+    ASSERT_FREETYPE_LOCK_HELD();
+
+    error = IntRequestFontSizeWorker(dc, FontGDI, lfWidth, lfHeight);
+
+    /* Remember which font and size the face and the metrics are set up for */
+    if (++SharedFace->SizeSerial == 0)
+        SharedFace->SizeSerial = 1;
+    FontGDI->SizeSerial = error ? 0 : SharedFace->SizeSerial;
+    FontGDI->SizeWidth = lfWidth;
+    FontGDI->SizeHeight = lfHeight;
+
+    return error;
+}
+
+/*
+ * Checks if the face of a font and its metrics are still set up for the
+ * given size, so they can be used with the FreeType lock held shared.
+ */
+static BOOL
+IntIsFontSizeCurrent(PFONTGDI FontGDI, LOGFONTW *plf)
+{
+    ASSERT_FREETYPE_LOCK_HELD_SHARED();
+
+    return (FontGDI->SizeSerial != 0) &&
+           (FontGDI->SizeSerial == FontGDI->SharedFace->SizeSerial) &&
+           (FontGDI->SizeWidth == plf->lfWidth) &&
+           (FontGDI->SizeHeight == plf->lfHeight) &&
+           (FontGDI->SharedFace->Face->charmap != NULL);
+}
+
 BOOL
 FASTCALL
 TextIntUpdateSize(PDC dc,
@@ -3417,6 +3594,54 @@ get_glyph_index_flagged(FT_Face face, FT_ULong code, DWORD indexed_flag, DWORD f
     return glyph_index;
 }
 
+/*
+ * The glyph indices of the characters measured last are kept with the face,
+ * so that measuring under the shared FreeType lock never has to call into
+ * the face. The entries are only written with the lock held exclusively.
+ */
+static inline BOOL FASTCALL
+IntLookupGlyphIndex(PSHARED_FACE SharedFace, FT_ULong code, DWORD flags, FT_UInt *pGlyphIndex)
+{
+    PSHARED_FACE_INDEX Entry;
+
+    if (flags & GTEF_INDICES)
+    {
+        *pGlyphIndex = code;
+        return TRUE;
+    }
+
+    Entry = &SharedFace->GlyphIndexCache[code & (SHARED_FACE_INDEX_CACHE_SIZE - 1)];
+    if (Entry->Char != code)
+        return FALSE;
+
+    *pGlyphIndex = Entry->GlyphIndex;
+    return TRUE;
+}
+
+static inline FT_UInt FASTCALL
+IntGetGlyphIndexCached(PSHARED_FACE SharedFace, FT_ULong code, DWORD flags)
+{
+    PSHARED_FACE_INDEX Entry;
+    FT_UInt glyph_index;
+
+    ASSERT_FREETYPE_LOCK_HELD();
+
+    if (IntLookupGlyphIndex(SharedFace, code, flags, &glyph_index))
+        return glyph_index;
+
+    glyph_index = get_glyph_index(SharedFace->Face, code);
+
+    /* The mapping changes once TextIntUpdateSize selects a charmap */
+    if (SharedFace->Face->charmap != NULL)
+    {
+        Entry = &SharedFace->GlyphIndexCache[code & (SHARED_FACE_INDEX_CACHE_SIZE - 1)];
+        Entry->Char = code;
+        Entry->GlyphIndex = glyph_index;
+    }
+
+    return glyph_index;
+}
+
 /*
  * Based on WineEngGetGlyphOutline
  *
@@ -3890,6 +4115,71 @@ ftGdiGetGlyphOutline(
     return needed;
 }
 
+/*
+ * Measures a string with the glyph cache alone, with the FreeType lock held
+ * shared. FT_Face objects are not safe for concurrent use, so nothing here
+ * calls into the face: the glyph indices come from the face's index cache
+ * and kerned fonts are left to the exclusive path. Fails as soon as a glyph
+ * is not cached; the string then has to be measured again with the lock
+ * held exclusively, which fills the caches.
+ */
+static
+BOOL
+IntGetTextExtentFromCache(
+    PFONTGDI FontGDI,
+    LOGFONTW *plf,
+    FT_Render_Mode RenderMode,
+    PMATRIX pmxWorldToDevice,
+    LPCWSTR String,
+    INT Count,
+    ULONG MaxExtent,
+    LPINT Fit,
+    LPINT Dx,
+    FLONG fl,
+    PULONGLONG pTotalWidth)
+{
+    FT_BitmapGlyph realglyph;
+    FT_UInt glyph_index;
+    INT i;
+    ULONGLONG TotalWidth = 0;
+
+    ASSERT_FREETYPE_LOCK_HELD_SHARED();
+
+    /* Kerning would need FT_Get_Kerning */
+    if (FT_HAS_KERNING(FontGDI->SharedFace->Face))
+        return FALSE;
+
+    if (NULL != Fit)
+    {
+        *Fit = 0;
+    }
+
+    for (i = 0; i < Count; i++)
+    {
+        if (!IntLookupGlyphIndex(FontGDI->SharedFace, String[i], fl, &glyph_index))
+            return FALSE;
+
+        realglyph = ftGdiGlyphCacheGet(FontGDI->SharedFace, glyph_index, plf->lfHeight,
+                                       RenderMode, pmxWorldToDevice);
+        if (!realglyph)
+            return FALSE;
+
+        TotalWidth += realglyph->root.advance.x >> 10;
+
+        if (((TotalWidth + 32) >> 6) <= MaxExtent && NULL != Fit)
+        {
+            *Fit = i + 1;
+        }
+        if (NULL != Dx)
+        {
+            Dx[i] = (TotalWidth + 32) >> 6;
+        }
+    }
+
+    *pTotalWidth = TotalWidth;
+    return TRUE;
+}
+
 BOOL
 FASTCALL
 TextIntGetTextExtentPoint(PDC dc,
@@ -3919,14 +4209,6 @@ TextIntGetTextExtentPoint(PDC dc,
     FontGDI = ObjToGDI(TextObj->Font, FONT);
 
     face = FontGDI->SharedFace->Face;
-    if (NULL != Fit)
-    {
-        *Fit = 0;
-    }
-
-    IntLockFreeType();
-
-    TextIntUpdateSize(dc, TextObj, FontGDI, FALSE);
 
     plf = &TextObj->logfont.elfEnumLogfontEx.elfLogFont;
     EmuBold = (plf->lfWeight >= FW_BOLD && FontGDI->OriginalWeight <= FW_NORMAL);
@@ -3940,6 +4222,37 @@ TextIntGetTextExtentPoint(PDC dc,
 
     /* Get the DC's world-to-device transformation matrix */
     pmxWorldToDevice = DC_pmxWorldToDevice(dc);
+
+    /* Text that was measured or drawn before only needs the shared lock */
+    if (!EmuBold && !EmuItalic)
+    {
+        IntLockFreeTypeShared();
+        if (IntIsFontSizeCurrent(FontGDI, plf) &&
+            IntGetTextExtentFromCache(FontGDI, plf, RenderMode, pmxWorldToDevice,
+                                      String, Count, MaxExtent, Fit, Dx, fl,
+                                      &TotalWidth))
+        {
+            ASSERT(FontGDI->Magic == FONTGDI_MAGIC);
+            ascender = FontGDI->tmAscent; /* Units above baseline */
+            descender = FontGDI->tmDescent; /* Units below baseline */
+            IntUnLockFreeType();
+
+            Size->cx = (TotalWidth + 32) >> 6;
+            Size->cy = ascender + descender;
+            return TRUE;
+        }
+        IntUnLockFreeType();
+        TotalWidth = 0;
+    }
+
+    if (NULL != Fit)
+    {
+        *Fit = 0;
+    }
+
+    IntLockFreeType();
+
+    TextIntUpdateSize(dc, TextObj, FontGDI, FALSE);
     FtSetCoordinateTransform(face, pmxWorldToDevice);
 
     use_kerning = FT_HAS_KERNING(face);
@@ -3947,12 +4260,12 @@ TextIntGetTextExtentPoint(PDC dc,
 
     for (i = 0; i < Count; i++)
     {
-        glyph_index = get_glyph_index_flagged(face, *String, GTEF_INDICES, fl);
+        glyph_index = IntGetGlyphIndexCached(FontGDI->SharedFace, *String, fl);
 
         if (EmuBold || EmuItalic)
             realglyph = NULL;
         else
-            realglyph = ftGdiGlyphCacheGet(face, glyph_index, plf->lfHeight,
+            realglyph = ftGdiGlyphCacheGet(FontGDI->SharedFace, glyph_index, plf->lfHeight,
                                            RenderMode, pmxWorldToDevice);
 
         if (EmuBold || EmuItalic || !realglyph)
@@ -3975,7 +4288,7 @@ TextIntGetTextExtentPoint(PDC dc,
             }
             else
             {
-                realglyph = ftGdiGlyphCacheSet(face,
+                realglyph = ftGdiGlyphCacheSet(FontGDI->SharedFace,
                                                glyph_index,
                                                plf->lfHeight,
                                                pmxWorldToDevice,
@@ -4263,7 +4576,7 @@ ftGdiGetTextMetricsW(
             FT_Face Face = FontGDI->SharedFace->Face;
             Status = STATUS_SUCCESS;
 
-            IntLockFreeType();
+            IntLockFreeTypeShared();
             pOS2 = FT_Get_Sfnt_Table(Face, ft_sfnt_os2);
             if (NULL == pOS2)
             {
@@ -5487,10 +5800,132 @@ ScaleLong(LONG lValue, PFLOATOBJ pef)
     return lValue;
 }
 
+/* A rendered glyph of a text run, with its position on the surface */
+typedef struct _GLYPH_RUN_ENTRY
+{
+    FT_BitmapGlyph BitmapGlyph;
+    RECTL DestRect;
+} GLYPH_RUN_ENTRY, *PGLYPH_RUN_ENTRY;
+
+#define STACK_GLYPH_RUN_SIZE 64
+
+/*
+ * Composes the glyphs of a run into a single 8bpp mask and draws it with
+ * the text brush, so the mask surface is set up and blitted only once.
+ * Only the part of the run inside the clip bounds is composed.
+ */
+static
 BOOL
-APIENTRY
-GreExtTextOutW(
-    IN HDC hDC,
+IntDrawGlyphRun(
+    PDC dc,
+    SURFOBJ *SurfObj,
+    XLATEOBJ *pxloRGB2Dst,
+    XLATEOBJ *pxloDst2RGB,
+    PGLYPH_RUN_ENTRY RunGlyphs,
+    ULONG cRunGlyphs)
+{
+    RECTL RunRect, PartRect;
+    POINTL MaskOrigin, BrushOrigin;
+    PSURFACE psurfMask;
+    SURFOBJ *MaskObj;
+    FT_Bitmap *Bitmap;
+    PBYTE pjSrc, pjDst;
+    LONG x, y, cx, cy;
+    ULONG i;
+
+    ASSERT(cRunGlyphs > 0);
+
+    RunRect = RunGlyphs[0].DestRect;
+    for (i = 1; i < cRunGlyphs; i++)
+    {
+        RECTL_bUnionRect(&RunRect, &RunRect, &RunGlyphs[i].DestRect);
+    }
+
+    /* Nothing to do if the run is not visible at all */
+    if (!RECTL_bIntersectRect(&RunRect, &RunRect, &dc->co.rclBounds))
+        return TRUE;
+
+    psurfMask = SURFACE_AllocSurface(STYPE_BITMAP,
+                                     RunRect.right - RunRect.left,
+                                     RunRect.bottom - RunRect.top,
+                                     BMF_8BPP,
+                                     BMF_TOPDOWN,
+                                     0,
+                                     0,
+                                     NULL);
+    if (!psurfMask)
+    {
+        DPRINT1("WARNING: Failed to allocate the glyph run mask!\n");
+        return FALSE;
+    }
+    MaskObj = &psurfMask->SurfObj;
+
+    /* The mask is zero initialized, merge the glyphs into it */
+    for (i = 0; i < cRunGlyphs; i++)
+    {
+        if (!RECTL_bIntersectRect(&PartRect, &RunGlyphs[i].DestRect, &RunRect))
+            continue;
+
+        Bitmap = &RunGlyphs[i].BitmapGlyph->bitmap;
+        pjSrc = Bitmap->buffer +
+                (PartRect.top - RunGlyphs[i].DestRect.top) * Bitmap->pitch +
+                (PartRect.left - RunGlyphs[i].DestRect.left);
+        pjDst = (PBYTE)MaskObj->pvScan0 +
+                (PartRect.top - RunRect.top) * MaskObj->lDelta +
+                (PartRect.left - RunRect.left);
+        cx = PartRect.right - PartRect.left;
+        cy = PartRect.bottom - PartRect.top;
+
+        for (y = 0; y < cy; y++)
+        {
+            /* Glyphs can overlap, keep the strongest coverage */
+            for (x = 0; x < cx; x++)
+            {
+                if (pjSrc[x] > pjDst[x])
+                    pjDst[x] = pjSrc[x];
+            }
+            pjSrc += Bitmap->pitch;
+            pjDst += MaskObj->lDelta;
+        }
+    }
+
+    MaskOrigin.x = 0;
+    MaskOrigin.y = 0;
+    BrushOrigin.x = 0;
+    BrushOrigin.y = 0;
+
+    if (dc->dctype == DCTYPE_DIRECT)
+        MouseSafetyOnDrawStart(dc->ppdev, RunRect.left, RunRect.top, RunRect.right, RunRect.bottom);
+
+    /*
+     * Use the composed mask to paint onto the DCs surface using a brush.
+     */
+    if (!IntEngMaskBlt(SurfObj,
+                       MaskObj,
+                       (CLIPOBJ *)&dc->co,
+                       pxloRGB2Dst,
+                       pxloDst2RGB,
+                       &RunRect,
+                       &MaskOrigin,
+                       &dc->eboText.BrushObject,
+                       &BrushOrigin))
+    {
+        DPRINT1("Failed to MaskBlt a glyph run!\n");
+    }
+
+    if (dc->dctype == DCTYPE_DIRECT)
+        MouseSafetyOnDrawEnd(dc->ppdev);
+
+    GDIOBJ_vDeleteObject(&psurfMask->BaseObject);
+
+    return TRUE;
+}
+
+/* The DC must be locked by the caller */
+BOOL
+FASTCALL
+IntExtTextOutW(
+    IN PDC dc,
     IN INT XStart,
     IN INT YStart,
     IN UINT fuOptions,
@@ -5506,7 +5941,6 @@ GreExtTextOutW(
      * appropriate)
      */
 
-    DC *dc;
     PDC_ATTR pdcattr;
     SURFOBJ *SurfObj;
     SURFACE *psurf = NULL;
@@ -5517,11 +5951,8 @@ GreExtTextOutW(
     LONGLONG TextLeft, RealXStart;
     ULONG TextTop, previous, BackgroundLeft;
     FT_Bool use_kerning;
-    RECTL DestRect, MaskRect;
+    RECTL DestRect;
     POINTL SourcePoint, BrushOrigin;
-    HBITMAP HSourceGlyph;
-    SURFOBJ *SourceGlyphSurf;
-    SIZEL bitSize;
     INT yoff;
     FONTOBJ *FontObj;
     PFONTGDI FontGDI;
@@ -5539,39 +5970,23 @@ GreExtTextOutW(
     BOOL EmuBold, EmuItalic;
     int thickness;
     BOOL bResult;
+    GLYPH_RUN_ENTRY StackRunGlyphs[STACK_GLYPH_RUN_SIZE];
+    PGLYPH_RUN_ENTRY RunGlyphs;
+    ULONG cRunGlyphs;
+    BOOL Queued;
 
-    /* Check if String is valid */
-    if ((Count > 0xFFFF) || (Count > 0 && String == NULL))
-    {
-        EngSetLastError(ERROR_INVALID_PARAMETER);
-        return FALSE;
-    }
-
-    /* NOTE: This function locks the screen DC, so it must never be called
-       with a DC already locked */
     Render = IntIsFontRenderingEnabled();
 
-    // TODO: Write test-cases to exactly match real Windows in different
-    // bad parameters (e.g. does Windows check the DC or the RECT first?).
-    dc = DC_LockDc(hDC);
-    if (!dc)
-    {
-        EngSetLastError(ERROR_INVALID_HANDLE);
-        return FALSE;
-    }
-
     if (PATH_IsPathOpen(dc->dclevel))
     {
-        bResult = PATH_ExtTextOut(dc,
-                              XStart,
-                              YStart,
-                              fuOptions,
-                              (const RECTL *)lprc,
-                              String,
-                              Count,
-                              (const INT *)Dx);
-        DC_UnlockDc(dc);
-        return bResult;
+        return PATH_ExtTextOut(dc,
+                               XStart,
+                               YStart,
+                               fuOptions,
+                               (const RECTL *)lprc,
+                               String,
+                               Count,
+                               (const INT *)Dx);
     }
 
     DC_vPrepareDCsForBlit(dc, NULL, NULL, NULL);
@@ -5605,8 +6020,6 @@ GreExtTextOutW(
 
     SourcePoint.x = 0;
     SourcePoint.y = 0;
-    MaskRect.left = 0;
-    MaskRect.top = 0;
     BrushOrigin.x = 0;
     BrushOrigin.y = 0;
 
@@ -5755,7 +6168,7 @@ GreExtTextOutW(
             if (EmuBold || EmuItalic)
                 realglyph = NULL;
             else
-                realglyph = ftGdiGlyphCacheGet(face, glyph_index, plf->lfHeight,
+                realglyph = ftGdiGlyphCacheGet(FontGDI->SharedFace, glyph_index, plf->lfHeight,
                                                RenderMode, pmxWorldToDevice);
             if (!realglyph)
             {
@@ -5776,7 +6189,7 @@ GreExtTextOutW(
                 }
                 else
                 {
-                    realglyph = ftGdiGlyphCacheSet(face,
+                    realglyph = ftGdiGlyphCacheSet(FontGDI->SharedFace,
                                                    glyph_index,
                                                    plf->lfHeight,
                                                    pmxWorldToDevice,
@@ -5915,11 +6328,6 @@ GreExtTextOutW(
             DestRect.top = TextTop + yoff - realglyph->top;
             DestRect.bottom = DestRect.top + realglyph->bitmap.rows;
 
-            bitSize.cx = realglyph->bitmap.width;
-            bitSize.cy = realglyph->bitmap.rows;
-            MaskRect.right = realglyph->bitmap.width;
-            MaskRect.bottom = realglyph->bitmap.rows;
-
             if (NULL == Dx)
             {
                 TextLeft += realglyph->root.advance.x >> 10;
@@ -5953,12 +6361,31 @@ GreExtTextOutW(
         }
     }
 
+    /* The glyphs are collected first and drawn as one run */
+    RunGlyphs = StackRunGlyphs;
+    cRunGlyphs = 0;
+    if (Count > STACK_GLYPH_RUN_SIZE)
+    {
+        RunGlyphs = ExAllocatePoolWithTag(PagedPool,
+                                          Count * sizeof(GLYPH_RUN_ENTRY),
+                                          GDITAG_TEXT);
+        if (!RunGlyphs)
+        {
+            IntUnLockFreeType();
+            bResult = FALSE;
+            goto Cleanup;
+        }
+    }
+
     EXLATEOBJ_vInitialize(&exloRGB2Dst, &gpalRGB, psurf->ppal, 0, 0, 0);
     EXLATEOBJ_vInitialize(&exloDst2RGB, psurf->ppal, &gpalRGB, 0, 0, 0);
 
     /* Assume success */
     bResult = TRUE;
 
+    /* Keep the cached glyphs of the run alive until it is drawn */
+    FontCacheHold();
+
     /*
      * The main rendering loop.
      */
@@ -5972,7 +6399,7 @@ GreExtTextOutW(
         if (EmuBold || EmuItalic)
             realglyph = NULL;
         else
-            realglyph = ftGdiGlyphCacheGet(face, glyph_index, plf->lfHeight,
+            realglyph = ftGdiGlyphCacheGet(FontGDI->SharedFace, glyph_index, plf->lfHeight,
                                            RenderMode, pmxWorldToDevice);
         if (!realglyph)
         {
@@ -5995,7 +6422,7 @@ GreExtTextOutW(
             }
             else
             {
-                realglyph = ftGdiGlyphCacheSet(face,
+                realglyph = ftGdiGlyphCacheSet(FontGDI->SharedFace,
                                                glyph_index,
                                                plf->lfHeight,
                                                pmxWorldToDevice,
@@ -6059,42 +6486,10 @@ GreExtTextOutW(
         DestRect.top = TextTop + yoff - realglyph->top;
         DestRect.bottom = DestRect.top + realglyph->bitmap.rows;
 
-        bitSize.cx = realglyph->bitmap.width;
-        bitSize.cy = realglyph->bitmap.rows;
-        MaskRect.right = realglyph->bitmap.width;
-        MaskRect.bottom = realglyph->bitmap.rows;
-
         /* Check if the bitmap has any pixels */
-        if ((bitSize.cx != 0) && (bitSize.cy != 0))
-        {
-            /*
-             * We should create the bitmap out of the loop at the biggest possible
-             * glyph size. Then use memset with 0 to clear it and sourcerect to
-             * limit the work of the transbitblt.
-             */
-            HSourceGlyph = EngCreateBitmap(bitSize, realglyph->bitmap.pitch,
-                                           BMF_8BPP, BMF_TOPDOWN,
-                                           realglyph->bitmap.buffer);
-            if ( !HSourceGlyph )
-            {
-                DPRINT1("WARNING: EngCreateBitmap() failed!\n");
-                // FT_Done_Glyph(realglyph);
-                bResult = FALSE;
-                break;
-            }
-            SourceGlyphSurf = EngLockSurface((HSURF)HSourceGlyph);
-            if ( !SourceGlyphSurf )
-            {
-                EngDeleteSurface((HSURF)HSourceGlyph);
-                DPRINT1("WARNING: EngLockSurface() failed!\n");
-                bResult = FALSE;
-                break;
-            }
-
-            /*
-             * Use the font data as a mask to paint onto the DCs surface using a
-             * brush.
-             */
+        Queued = FALSE;
+        if ((realglyph->bitmap.width != 0) && (realglyph->bitmap.rows != 0))
+        {
             if (lprc && (fuOptions & ETO_CLIPPED) &&
                     DestRect.right >= lprc->right + dc->ptlDCOrig.x)
             {
@@ -6110,32 +6505,20 @@ GreExtTextOutW(
                 DestRect.bottom = lprc->bottom + dc->ptlDCOrig.y;
             }
 
-            if (dc->dctype == DCTYPE_DIRECT)
-                MouseSafetyOnDrawStart(dc->ppdev, DestRect.left, DestRect.top, DestRect.right, DestRect.bottom);
-
-            if (!IntEngMaskBlt(
-                SurfObj,
-                SourceGlyphSurf,
-                (CLIPOBJ *)&dc->co,
-                &exloRGB2Dst.xlo,
-                &exloDst2RGB.xlo,
-                &DestRect,
-                (PPOINTL)&MaskRect,
-                &dc->eboText.BrushObject,
-                &BrushOrigin))
+            /* The glyph is drawn with the rest of the run below */
+            if (!RECTL_bIsEmptyRect(&DestRect))
             {
-                DPRINT1("Failed to MaskBlt a glyph!\n");
+                RunGlyphs[cRunGlyphs].BitmapGlyph = realglyph;
+                RunGlyphs[cRunGlyphs].DestRect = DestRect;
+                cRunGlyphs++;
+                Queued = TRUE;
             }
-
-            if (dc->dctype == DCTYPE_DIRECT)
-                MouseSafetyOnDrawEnd(dc->ppdev) ;
-
-            EngUnlockSurface(SourceGlyphSurf);
-            EngDeleteSurface((HSURF)HSourceGlyph);
         }
 
         if (DoBreak)
         {
+            if ((EmuBold || EmuItalic) && !Queued)
+                FT_Done_Glyph((FT_Glyph)realglyph);
             break;
         }
 
@@ -6206,13 +6589,37 @@ GreExtTextOutW(
 
         previous = glyph_index;
 
-        if (EmuBold || EmuItalic)
+        if ((EmuBold || EmuItalic) && !Queued)
         {
             FT_Done_Glyph((FT_Glyph)realglyph);
             realglyph = NULL;
         }
     }
 
+    /* The run is rendered, other threads may use the cache while it is drawn */
+    IntDowngradeFreeTypeLock();
+
+    if (cRunGlyphs != 0)
+    {
+        if (!IntDrawGlyphRun(dc, SurfObj, &exloRGB2Dst.xlo, &exloDst2RGB.xlo,
+                             RunGlyphs, cRunGlyphs))
+        {
+            bResult = FALSE;
+        }
+    }
+
+    /* The emulated glyphs are not cached, they belong to the run */
+    if (EmuBold || EmuItalic)
+    {
+        for (i = 0; i < (INT)cRunGlyphs; i++)
+            FT_Done_Glyph((FT_Glyph)RunGlyphs[i].BitmapGlyph);
+    }
+
+    FontCacheRelease();
+
+    if (RunGlyphs != StackRunGlyphs)
+        ExFreePoolWithTag(RunGlyphs, GDITAG_TEXT);
+
     if (pdcattr->lTextAlign & TA_UPDATECP) {
         pdcattr->ptlCurrent.x = DestRect.right - dc->ptlDCOrig.x;
     }
@@ -6229,6 +6636,51 @@ Cleanup:
     if (TextObj != NULL)
         TEXTOBJ_UnlockText(TextObj);
 
+    return bResult;
+}
+
+BOOL
+APIENTRY
+GreExtTextOutW(
+    IN HDC hDC,
+    IN INT XStart,
+    IN INT YStart,
+    IN UINT fuOptions,
+    IN OPTIONAL PRECTL lprc,
+    IN LPCWSTR String,
+    IN INT Count,
+    IN OPTIONAL LPINT Dx,
+    IN DWORD dwCodePage)
+{
+    PDC dc;
+    BOOL bResult;
+
+    /* Check if String is valid */
+    if ((Count > 0xFFFF) || (Count > 0 && String == NULL))
+    {
+        EngSetLastError(ERROR_INVALID_PARAMETER);
+        return FALSE;
+    }
+
+    // TODO: Write test-cases to exactly match real Windows in different
+    // bad parameters (e.g. does Windows check the DC or the RECT first?).
+    dc = DC_LockDc(hDC);
+    if (!dc)
+    {
+        EngSetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+
+    bResult = IntExtTextOutW(dc,
+                             XStart,
+                             YStart,
+                             fuOptions,
+                             lprc,
+                             String,
+                             Count,
+                             Dx,
+                             dwCodePage);
+
     DC_UnlockDc(dc);
 
     return bResult;
@@ -59,6 +59,349 @@ SynchonizeDriver(FLONG Flags)
   return;
 }
 
+//
+// DC attributes gdi32 snapshots along with the batched drawing commands.
+// The DC_ATTR may have been changed in user mode since the command was
+// queued, so the command is replayed with its own copy of them.
+//
+typedef struct _GDIBATCHATTR
+{
+  HANDLE hbrush;
+  HANDLE hlfntNew;
+  COLORREF crForegroundClr;
+  COLORREF crBackgroundClr;
+  COLORREF crBrushClr;
+  ULONG ulForegroundClr;
+  ULONG ulBackgroundClr;
+  ULONG ulBrushClr;
+  LONG lBkMode;
+  LONG lTextAlign;
+} GDIBATCHATTR, *PGDIBATCHATTR;
+
+#define STACK_BATCH_TEXT_BUFFER_SIZE 256
+
+//
+// Exchanges the DC attributes with the ones in pAttr, marking the brushes
+// depending on them dirty. Calling it a second time restores the DC.
+//
+static
+VOID
+FASTCALL
+GdiBatchSwapAttr(PDC_ATTR pdcattr, PGDIBATCHATTR pAttr)
+{
+  GDIBATCHATTR Current;
+
+  Current.hbrush          = pdcattr->hbrush;
+  Current.hlfntNew        = pdcattr->hlfntNew;
+  Current.crForegroundClr = pdcattr->crForegroundClr;
+  Current.crBackgroundClr = pdcattr->crBackgroundClr;
+  Current.crBrushClr      = pdcattr->crBrushClr;
+  Current.ulForegroundClr = pdcattr->ulForegroundClr;
+  Current.ulBackgroundClr = pdcattr->ulBackgroundClr;
+  Current.ulBrushClr      = pdcattr->ulBrushClr;
+  Current.lBkMode         = pdcattr->lBkMode;
+  Current.lTextAlign      = pdcattr->lTextAlign;
+
+  if (Current.hbrush != pAttr->hbrush)
+     pdcattr->ulDirty_ |= DC_BRUSH_DIRTY;
+  if (Current.crBrushClr != pAttr->crBrushClr)
+     pdcattr->ulDirty_ |= DIRTY_FILL;
+  if (Current.crForegroundClr != pAttr->crForegroundClr)
+     pdcattr->ulDirty_ |= (DIRTY_TEXT|DIRTY_LINE|DIRTY_FILL);
+  if (Current.crBackgroundClr != pAttr->crBackgroundClr)
+     pdcattr->ulDirty_ |= (DIRTY_BACKGROUND|DIRTY_LINE|DIRTY_FILL);
+
+  pdcattr->hbrush          = pAttr->hbrush;
+  pdcattr->hlfntNew        = pAttr->hlfntNew;
+  pdcattr->crForegroundClr = pAttr->crForegroundClr;
+  pdcattr->crBackgroundClr = pAttr->crBackgroundClr;
+  pdcattr->crBrushClr      = pAttr->crBrushClr;
+  pdcattr->ulForegroundClr = pAttr->ulForegroundClr;
+  pdcattr->ulBackgroundClr = pAttr->ulBackgroundClr;
+  pdcattr->ulBrushClr      = pAttr->ulBrushClr;
+  pdcattr->lBkMode         = pAttr->lBkMode;
+  pdcattr->jBkMode         = pAttr->lBkMode;
+  pdcattr->lTextAlign      = pAttr->lTextAlign;
+
+  *pAttr = Current;
+}
+
+//
+// Initializes a snapshot from the current DC attributes.
+//
+static
+VOID
+FASTCALL
+GdiBatchGetAttr(PDC_ATTR pdcattr, PGDIBATCHATTR pAttr)
+{
+  pAttr->hbrush          = pdcattr->hbrush;
+  pAttr->hlfntNew        = pdcattr->hlfntNew;
+  pAttr->crForegroundClr = pdcattr->crForegroundClr;
+  pAttr->crBackgroundClr = pdcattr->crBackgroundClr;
+  pAttr->crBrushClr      = pdcattr->crBrushClr;
+  pAttr->ulForegroundClr = pdcattr->ulForegroundClr;
+  pAttr->ulBackgroundClr = pdcattr->ulBackgroundClr;
+  pAttr->ulBrushClr      = pdcattr->ulBrushClr;
+  pAttr->lBkMode         = pdcattr->lBkMode;
+  pAttr->lTextAlign      = pdcattr->lTextAlign;
+}
+
+static
+VOID
+FASTCALL
+GdiBatchPatBlt(PDC dc, PGDIBSPATBLT pgDPB)
+{
+  GDIBSPATBLT PatBlt;
+  GDIBATCHATTR Attr;
+  DWORD dwRop;
+
+  _SEH2_TRY
+  {
+     PatBlt = *pgDPB;
+  }
+  _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+  {
+     _SEH2_YIELD(return;)
+  }
+  _SEH2_END;
+
+  /* Convert the ROP3 to a ROP4, gdi32 does not queue rops with a source */
+  dwRop = MAKEROP4(PatBlt.dwRop & 0xFF0000, PatBlt.dwRop);
+  if (WIN32_ROP4_USES_SOURCE(dwRop)) return;
+
+  /* Check if the DC has no surface (empty mem or info DC) */
+  if (dc->dclevel.pSurface == NULL) return;
+
+  GdiBatchGetAttr(dc->pdcattr, &Attr);
+  Attr.hbrush          = PatBlt.hbrush;
+  Attr.crForegroundClr = PatBlt.crForegroundClr;
+  Attr.crBackgroundClr = PatBlt.crBackgroundClr;
+  Attr.crBrushClr      = PatBlt.crBrushClr;
+  Attr.ulForegroundClr = PatBlt.ulForegroundClr;
+  Attr.ulBackgroundClr = PatBlt.ulBackgroundClr;
+  Attr.ulBrushClr      = PatBlt.ulBrushClr;
+  GdiBatchSwapAttr(dc->pdcattr, &Attr);
+
+  if (dc->pdcattr->ulDirty_ & (DIRTY_FILL | DC_BRUSH_DIRTY))
+     DC_vUpdateFillBrush(dc);
+
+  IntPatBlt(dc, PatBlt.nXLeft, PatBlt.nYLeft, PatBlt.nWidth, PatBlt.nHeight, dwRop, &dc->eboFill);
+
+  GdiBatchSwapAttr(dc->pdcattr, &Attr);
+}
+
+static
+VOID
+FASTCALL
+GdiBatchPolyPatBlt(PDC dc, PGDIBSPPATBLT pgDPB, ULONG Size)
+{
+  GDIBATCHATTR Attr;
+  PATRECT Rect;
+  PBRUSH pbrush;
+  EBRUSHOBJ eboFill;
+  DWORD dwRop = 0, Count = 0, i;
+
+  if (Size < FIELD_OFFSET(GDIBSPPATBLT, pRect)) return;
+
+  GdiBatchGetAttr(dc->pdcattr, &Attr);
+
+  _SEH2_TRY
+  {
+     dwRop = pgDPB->rop4;
+     Count = pgDPB->Count;
+     Attr.crForegroundClr = pgDPB->crForegroundClr;
+     Attr.crBackgroundClr = pgDPB->crBackgroundClr;
+     Attr.crBrushClr      = pgDPB->crBrushClr;
+     Attr.ulForegroundClr = pgDPB->ulForegroundClr;
+     Attr.ulBackgroundClr = pgDPB->ulBackgroundClr;
+     Attr.ulBrushClr      = pgDPB->ulBrushClr;
+  }
+  _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+  {
+     _SEH2_YIELD(return;)
+  }
+  _SEH2_END;
+
+  /* The rectangles must be within the entry */
+  if (Count > (Size - FIELD_OFFSET(GDIBSPPATBLT, pRect)) / sizeof(PATRECT)) return;
+
+  dwRop = MAKEROP4(dwRop & 0xFF0000, dwRop);
+  if (WIN32_ROP4_USES_SOURCE(dwRop)) return;
+
+  /* Check if the DC has no surface (empty mem or info DC) */
+  if (dc->dclevel.pSurface == NULL) return;
+
+  GdiBatchSwapAttr(dc->pdcattr, &Attr);
+
+  for (i = 0; i < Count; i++)
+  {
+     _SEH2_TRY
+     {
+        Rect = pgDPB->pRect[i];
+     }
+     _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+     {
+        _SEH2_YIELD(break;)
+     }
+     _SEH2_END;
+
+     pbrush = BRUSH_ShareLockBrush(Rect.hBrush);
+
+     /* Check if we could lock the brush */
+     if (pbrush != NULL)
+     {
+        /* Initialize a brush object */
+        EBRUSHOBJ_vInitFromDC(&eboFill, pbrush, dc);
+
+        IntPatBlt(dc, Rect.r.left, Rect.r.top, Rect.r.right, Rect.r.bottom, dwRop, &eboFill);
+
+        /* Cleanup the brush object and unlock the brush */
+        EBRUSHOBJ_vCleanup(&eboFill);
+        BRUSH_ShareUnlockBrush(pbrush);
+     }
+  }
+
+  GdiBatchSwapAttr(dc->pdcattr, &Attr);
+}
+
+static
+VOID
+FASTCALL
+GdiBatchTextOut(PDC dc, PGDIBSTEXTOUT pgO, ULONG Size)
+{
+  GDIBSTEXTOUT TextOut;
+  GDIBATCHATTR Attr;
+  BYTE LocalBuffer[STACK_BATCH_TEXT_BUFFER_SIZE];
+  PVOID Buffer = LocalBuffer;
+  ULONG cjData;
+  RECTL Rect, *lprc;
+
+  if (Size < FIELD_OFFSET(GDIBSTEXTOUT, Buffer)) return;
+  Size -= FIELD_OFFSET(GDIBSTEXTOUT, Buffer);
+
+  _SEH2_TRY
+  {
+     RtlCopyMemory(&TextOut, pgO, FIELD_OFFSET(GDIBSTEXTOUT, Buffer));
+  }
+  _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+  {
+     _SEH2_YIELD(return;)
+  }
+  _SEH2_END;
+
+  /* The Dx values and the string must be within the entry */
+  if ((TextOut.cbCount > 0xFFFF) ||
+      (TextOut.Size > Size) ||
+      (TextOut.cbCount * sizeof(WCHAR) > Size - TextOut.Size))
+  {
+     return;
+  }
+
+  /* Either no Dx values at all, or one (two with ETO_PDY) for each character */
+  if (TextOut.Size &&
+      (TextOut.Size != (TextOut.cbCount * sizeof(INT)) * (TextOut.Options & ETO_PDY ? 2 : 1)))
+  {
+     return;
+  }
+
+  cjData = TextOut.Size + TextOut.cbCount * sizeof(WCHAR);
+  if (cjData > sizeof(LocalBuffer))
+  {
+     Buffer = ExAllocatePoolWithTag(PagedPool, cjData, GDITAG_TEXT);
+     if (!Buffer) return;
+  }
+
+  _SEH2_TRY
+  {
+     RtlCopyMemory(Buffer, pgO->Buffer, cjData);
+  }
+  _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+  {
+     cjData = 0;
+  }
+  _SEH2_END;
+
+  if (cjData)
+  {
+     if (TextOut.Options & GDIBS_NORECT)
+     {
+        lprc = NULL;
+     }
+     else
+     {
+        Rect.left   = TextOut.Rect.left;
+        Rect.top    = TextOut.Rect.top;
+        Rect.right  = TextOut.Rect.right;
+        Rect.bottom = TextOut.Rect.bottom;
+        lprc = &Rect;
+     }
+
+     GdiBatchGetAttr(dc->pdcattr, &Attr);
+     Attr.hlfntNew        = TextOut.hlfntNew;
+     Attr.crForegroundClr = TextOut.crForegroundClr;
+     Attr.crBackgroundClr = TextOut.crBackgroundClr;
+     Attr.ulForegroundClr = TextOut.ulForegroundClr;
+     Attr.ulBackgroundClr = TextOut.ulBackgroundClr;
+     Attr.lBkMode         = TextOut.lmBkMode;
+     Attr.lTextAlign      = TextOut.flTextAlign;
+     GdiBatchSwapAttr(dc->pdcattr, &Attr);
+
+     IntExtTextOutW(dc,
+                    TextOut.x,
+                    TextOut.y,
+                    TextOut.Options & ~GDIBS_NORECT,
+                    lprc,
+                    (LPCWSTR)((PUCHAR)Buffer + TextOut.Size),
+                    TextOut.cbCount,
+                    TextOut.Size ? (LPINT)Buffer : NULL,
+                    TextOut.iCS_CP);
+
+     GdiBatchSwapAttr(dc->pdcattr, &Attr);
+  }
+
+  if (Buffer != LocalBuffer)
+  {
+     ExFreePoolWithTag(Buffer, GDITAG_TEXT);
+  }
+}
+
+static
+VOID
+FASTCALL
+GdiBatchExtTextOut(PDC dc, PGDIBSEXTTEXTOUT pgO)
+{
+  GDIBSEXTTEXTOUT ExtTextOut;
+  GDIBATCHATTR Attr;
+  RECTL Rect;
+
+  _SEH2_TRY
+  {
+     ExtTextOut = *pgO;
+  }
+  _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+  {
+     _SEH2_YIELD(return;)
+  }
+  _SEH2_END;
+
+  /* gdi32 only queues the opaque rectangle fill without text */
+  if (ExtTextOut.Count != 0) return;
+
+  Rect.left   = ExtTextOut.Rect.left;
+  Rect.top    = ExtTextOut.Rect.top;
+  Rect.right  = ExtTextOut.Rect.right;
+  Rect.bottom = ExtTextOut.Rect.bottom;
+
+  GdiBatchGetAttr(dc->pdcattr, &Attr);
+  Attr.crBackgroundClr = ExtTextOut.ulBackgroundClr;
+  Attr.ulBackgroundClr = ExtTextOut.ulBackgroundClr;
+  GdiBatchSwapAttr(dc->pdcattr, &Attr);
+
+  IntExtTextOutW(dc, 0, 0, ExtTextOut.Options, &Rect, NULL, 0, NULL, 0);
+
+  GdiBatchSwapAttr(dc->pdcattr, &Attr);
+}
+
 //
 // Process the batch.
 //
@@ -86,18 +429,33 @@ GdiFlushUserBatch(PDC dc, PGDIBATCHHDR pHdr)
   }
   _SEH2_END;
 
+  /* Entries are ULONG aligned and never larger than the batch buffer */
+  if ((Size < sizeof(GDIBATCHHDR)) || (Size > GDIBATCHBUFSIZE) || (Size & (sizeof(ULONG) - 1)))
+  {
+     DPRINT1("WARNING! Invalid GdiBatch entry size %d!\n", Size);
+     return 0;
+  }
+
   switch(Cmd)
   {
      case GdiBCPatBlt:
+        if (!dc || Size < sizeof(GDIBSPATBLT)) break;
+        GdiBatchPatBlt(dc, (PGDIBSPATBLT) pHdr);
         break;
 
      case GdiBCPolyPatBlt:
+        if (!dc) break;
+        GdiBatchPolyPatBlt(dc, (PGDIBSPPATBLT) pHdr, Size);
         break;
 
      case GdiBCTextOut:
+        if (!dc) break;
+        GdiBatchTextOut(dc, (PGDIBSTEXTOUT) pHdr, Size);
         break;
 
      case GdiBCExtTextOut:
+        if (!dc || Size < sizeof(GDIBSEXTTEXTOUT)) break;
+        GdiBatchExtTextOut(dc, (PGDIBSEXTTEXTOUT) pHdr);
         break;
 
      case GdiBCSetBrushOrg:
@@ -191,6 +549,8 @@ NtGdiFlushUserBatch(VOID)
        for (; GdiBatchCount > 0; GdiBatchCount--)
        {
            ULONG Size;
+           // Stay within the batch buffer.
+           if (pHdr + sizeof(GDIBATCHHDR) > (PCHAR)&pTeb->GdiTebBatch.Buffer[0] + GDIBATCHBUFSIZE) break;
            // Process Gdi Batch!
            Size = GdiFlushUserBatch(pDC, (PGDIBATCHHDR) pHdr);
            if (!Size) break;
@@ -199,6 +559,8 @@ NtGdiFlushUserBatch(VOID)
 
        if (pDC)
        {
+           // Nothing is pending anymore, gdi32 does not need to flush before mode changes.
+           pDC->pdcattr->ulDirty_ &= ~(DC_MODE_DIRTY|DC_FONTTEXT_DIRTY);
            DC_UnlockDc(pDC);
        }
 
@@ -69,6 +69,7 @@ KdbCommand_Gdi_help(VOID)
              "- handle <handle> - Displays information about a handle\n"
              "- entry <entry> - Displays an ENTRY, <entry> can be a pointer or index\n"
              "- baseobject <object> - Displays a BASEOBJECT\n"
+             "- fontcache - Displays the glyph cache counters\n"
 #if DBG_ENABLE_EVENT_LOGGING
              "- eventlist <object> - Displays the eventlist for an object\n"
 #endif
@@ -278,6 +279,25 @@ KdbCommand_Gdi_baseobject(char *argv)
 {
 }
 
+static
+VOID
+KdbCommand_Gdi_fontcache(VOID)
+{
+    FONT_CACHE_STATISTICS Statistics;
+    ULONG ulLookups;
+
+    ftGdiGetGlyphCacheStatistics(&Statistics);
+    ulLookups = Statistics.Hits + Statistics.Misses;
+
+    DbgPrint("Glyph cache:\n");
+    DbgPrint(" Entries   = %lu\n", Statistics.Entries);
+    DbgPrint(" Size      = %lu of %lu bytes\n", Statistics.Size, Statistics.MaxSize);
+    DbgPrint(" Hits      = %lu (%lu%%)\n", Statistics.Hits,
+             ulLookups ? (ULONG)((ULONGLONG)Statistics.Hits * 100 / ulLookups) : 0);
+    DbgPrint(" Misses    = %lu\n", Statistics.Misses);
+    DbgPrint(" Evictions = %lu\n", Statistics.Evictions);
+}
+
 #if DBG_ENABLE_EVENT_LOGGING
 static
 VOID
@@ -347,6 +367,10 @@ DbgGdiKdbgCliCallback(
     {
         KdbCommand_Gdi_baseobject(argv[1]);
     }
+    else if (stricmp(argv[0], "!gdi.fontcache") == 0)
+    {
+        KdbCommand_Gdi_fontcache();
+    }
 #if DBG_ENABLE_EVENT_LOGGING
     else if (stricmp(argv[0], "!gdi.eventlist") == 0)
     {
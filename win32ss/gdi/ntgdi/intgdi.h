@@ -59,6 +59,17 @@ GreMoveTo( HDC hdc,
            INT y,
            LPPOINT pptOut);
 
+/* Bitblt functions */
+
+BOOL FASTCALL
+IntPatBlt(PDC pdc,
+          INT XLeft,
+          INT YLeft,
+          INT Width,
+          INT Height,
+          DWORD dwRop3,
+          PEBRUSHOBJ pebo);
+
 /* Shape functions */
 
 BOOL
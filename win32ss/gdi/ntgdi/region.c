@@ -2038,6 +2038,53 @@ GreCreateFrameRgn(
     return hrgnFrame;
 }
 
+static
+VOID
+REGION_vReverseRects(
+    _Inout_updates_(cRects) PRECTL prcl,
+    _In_ ULONG cRects)
+{
+    PRECTL prclEnd = prcl + cRects - 1;
+    RECTL rclTemp;
+
+    while (prcl < prclEnd)
+    {
+        rclTemp = *prcl;
+        *prcl++ = *prclEnd;
+        *prclEnd-- = rclTemp;
+    }
+}
+
+/*
+ * Mirroring the rectangles of a region keeps the bands intact, but reverses
+ * their order and/or the order of the rectangles inside of them.
+ */
+static
+VOID
+REGION_vRestoreBanding(
+    _Inout_ PREGION prgn)
+{
+    PRECTL prclBand, prclEnd;
+    ULONG cRects;
+
+    if (prgn->rdh.nCount < 2)
+        return;
+
+    prclEnd = prgn->Buffer + prgn->rdh.nCount;
+    if (prgn->Buffer[0].top > prclEnd[-1].top)
+        REGION_vReverseRects(prgn->Buffer, prgn->rdh.nCount);
+
+    for (prclBand = prgn->Buffer; prclBand < prclEnd; prclBand += cRects)
+    {
+        for (cRects = 1;
+             (prclBand + cRects < prclEnd) && (prclBand[cRects].top == prclBand->top);
+             cRects++);
+
+        if (prclBand->left > prclBand[cRects - 1].left)
+            REGION_vReverseRects(prclBand, cRects);
+    }
+}
+
 BOOL
 FASTCALL
 REGION_bXformRgn(
@@ -2103,6 +2150,10 @@ REGION_bXformRgn(
                                  &prgn->Buffer[i]);
             }
 
+            /* A negative scale reverses the band order, or the order inside
+             * the bands. Restore the y-x banding the lookups depend on. */
+            REGION_vRestoreBanding(prgn);
+
             /* Loop all rects in the region */
             for (i = 0; i < prgn->rdh.nCount - 1; i++)
             {
@@ -2556,6 +2607,59 @@ IntGdiGetRgnBox(
 }
 
 
+/*
+ * The rectangles of a region are sorted in y-x bands, so the bottom
+ * coordinates never decrease through the buffer. Returns the index of the
+ * first rectangle at or after iStart whose bottom is below y, or nCount.
+ */
+static
+ULONG
+REGION_ulFindBand(
+    _In_ PREGION prgn,
+    _In_ ULONG iStart,
+    _In_ LONG y)
+{
+    ULONG iLow = iStart, iHigh = prgn->rdh.nCount, iMid;
+
+    while (iLow < iHigh)
+    {
+        iMid = iLow + (iHigh - iLow) / 2;
+        if (prgn->Buffer[iMid].bottom > y)
+            iHigh = iMid;
+        else
+            iLow = iMid + 1;
+    }
+
+    return iLow;
+}
+
+/*
+ * Within a band the rectangles do not overlap and are sorted left to right.
+ * Returns the index of the first rectangle in [iStart, iEnd) whose right
+ * edge is right of x, or iEnd.
+ */
+static
+ULONG
+REGION_ulFindInBand(
+    _In_ PREGION prgn,
+    _In_ ULONG iStart,
+    _In_ ULONG iEnd,
+    _In_ LONG x)
+{
+    ULONG iMid;
+
+    while (iStart < iEnd)
+    {
+        iMid = iStart + (iEnd - iStart) / 2;
+        if (prgn->Buffer[iMid].right > x)
+            iEnd = iMid;
+        else
+            iStart = iMid + 1;
+    }
+
+    return iStart;
+}
+
 BOOL
 FASTCALL
 REGION_PtInRegion(
@@ -2563,17 +2667,20 @@ REGION_PtInRegion(
     INT X,
     INT Y)
 {
-    ULONG i;
-    PRECT r;
+    ULONG i, iEnd;
 
     if (prgn->rdh.nCount > 0 && INRECT(prgn->rdh.rcBound, X, Y))
     {
-        r =  prgn->Buffer;
-        for (i = 0; i < prgn->rdh.nCount; i++)
-        {
-            if (INRECT(r[i], X, Y))
-                return TRUE;
-        }
+        /* Find the band containing Y, there might be a gap instead */
+        i = REGION_ulFindBand(prgn, 0, Y);
+        if ((i >= prgn->rdh.nCount) || (prgn->Buffer[i].top > Y))
+            return FALSE;
+
+        /* The band ends where the next one (with a greater bottom) starts */
+        iEnd = REGION_ulFindBand(prgn, i, prgn->Buffer[i].bottom);
+
+        i = REGION_ulFindInBand(prgn, i, iEnd, X);
+        return (i < iEnd) && (prgn->Buffer[i].left <= X);
     }
 
     return FALSE;
@@ -2585,7 +2692,7 @@ REGION_RectInRegion(
     PREGION Rgn,
     const RECTL *rect)
 {
-    PRECTL pCurRect, pRectEnd;
+    ULONG i, j, iEnd;
     RECT rc;
 
     /* Swap the coordinates to make right >= left and bottom >= top */
@@ -2615,24 +2722,17 @@ REGION_RectInRegion(
     /* This is (just) a useful optimization */
     if ((Rgn->rdh.nCount > 0) && EXTENTCHECK(&Rgn->rdh.rcBound, &rc))
     {
-        for (pCurRect = Rgn->Buffer, pRectEnd = pCurRect +
-                                                Rgn->rdh.nCount; pCurRect < pRectEnd; pCurRect++)
+        /* Skip the bands above the rectangle and stop at the first one below */
+        for (i = REGION_ulFindBand(Rgn, 0, rc.top);
+             (i < Rgn->rdh.nCount) && (Rgn->Buffer[i].top < rc.bottom);
+             i = iEnd)
         {
-            if (pCurRect->bottom <= rc.top)
-                continue;             /* Not far enough down yet */
-
-            if (pCurRect->top >= rc.bottom)
-                break;                /* Too far down */
+            iEnd = REGION_ulFindBand(Rgn, i, Rgn->Buffer[i].bottom);
 
-            if (pCurRect->right <= rc.left)
-                continue;              /* Not far enough over yet */
-
-            if (pCurRect->left >= rc.right)
-            {
-                continue;
-            }
-
-            return TRUE;
+            /* The first rectangle of the band that ends right of rc.left */
+            j = REGION_ulFindInBand(Rgn, i, iEnd, rc.left);
+            if ((j < iEnd) && (Rgn->Buffer[j].left < rc.right))
+                return TRUE;
         }
     }
 
@@ -100,6 +100,16 @@ TEXTOBJ_UnlockText(PLFONT plfnt)
     LFONT_ShareUnlockFont(plfnt);
 }
 
+/* Glyph cache counters, for tuning */
+typedef struct _FONT_CACHE_STATISTICS
+{
+  ULONG Entries;
+  ULONG Size;
+  ULONG MaxSize;
+  ULONG Hits;
+  ULONG Misses;
+  ULONG Evictions;
+} FONT_CACHE_STATISTICS, *PFONT_CACHE_STATISTICS;
 
 PTEXTOBJ FASTCALL RealizeFontInit(HFONT);
 NTSTATUS FASTCALL TextIntRealizeFont(HFONT,PTEXTOBJ);
@@ -130,6 +140,9 @@ BOOL FASTCALL ftGdiRealizationInfo(PFONTGDI,PREALIZATION_INFO);
 DWORD FASTCALL ftGdiGetKerningPairs(PFONTGDI,DWORD,LPKERNINGPAIR);
 BOOL NTAPI GreExtTextOutW(IN HDC,IN INT,IN INT,IN UINT,IN OPTIONAL RECTL*,
     IN LPCWSTR, IN INT, IN OPTIONAL LPINT, IN DWORD);
+BOOL FASTCALL IntExtTextOutW(IN PDC,IN INT,IN INT,IN UINT,IN OPTIONAL RECTL*,
+    IN LPCWSTR, IN INT, IN OPTIONAL LPINT, IN DWORD);
+VOID FASTCALL ftGdiGetGlyphCacheStatistics(PFONT_CACHE_STATISTICS);
 DWORD FASTCALL IntGetCharDimensions(HDC, PTEXTMETRICW, PDWORD);
 BOOL FASTCALL GreGetTextExtentW(HDC,LPCWSTR,INT,LPSIZE,UINT);
 BOOL FASTCALL GreGetTextExtentExW(HDC,LPCWSTR,ULONG,ULONG,PULONG,PULONG,LPSIZE,FLONG);
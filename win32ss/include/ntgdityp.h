@@ -513,9 +513,15 @@ typedef struct _GDIBSTEXTOUT
   HANDLE hlfntNew;
   FLONG flTextAlign;
   POINTL ptlViewportOrg;
-  WCHAR String[2];
+  union {
+    WCHAR String[2]; // Size bytes of Dx values, then cbCount characters
+    ULONG Buffer[1];
+  };
 } GDIBSTEXTOUT, *PGDIBSTEXTOUT;
 
+/* Set in GDIBSTEXTOUT::Options when no rectangle was passed */
+#define GDIBS_NORECT 0x80000000
+
 typedef struct _GDIBSEXTTEXTOUT
 {
   GDIBATCHHDR gbHdr;
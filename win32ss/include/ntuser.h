@@ -726,6 +726,8 @@ typedef struct _WND
     PSBINFOEX pSBInfoex; // convert to PSBINFO
     /* Entry in the list of thread windows. */
     LIST_ENTRY ThreadListEntry;
+    /* Entry in the list of thread windows that may need painting. */
+    LIST_ENTRY PaintListEntry;
 } WND, *PWND;
 
 #define PWND_BOTTOM ((PWND)1)
@@ -620,6 +620,32 @@ UserSyncAndPaintWindows(PWND pWnd, ULONG Flags)
    co_IntPaintWindows(pWnd, Flags, FALSE);
 }
 
+/*
+ * Every thread keeps a list of its windows that have an update region or an
+ * internal paint pending, so the next window to paint can be found without
+ * walking the whole window tree. Windows are queued when they get invalidated
+ * and removed once they are validated, destroyed, or found clean.
+ */
+static
+VOID FASTCALL
+IntQueuePaintWindow(PWND Wnd)
+{
+   if (IsListEmpty(&Wnd->PaintListEntry))
+   {
+      InsertTailList(&Wnd->head.pti->PaintListHead, &Wnd->PaintListEntry);
+   }
+}
+
+VOID FASTCALL
+IntDequeuePaintWindow(PWND Wnd)
+{
+   if (!IsListEmpty(&Wnd->PaintListEntry))
+   {
+      RemoveEntryList(&Wnd->PaintListEntry);
+      InitializeListHead(&Wnd->PaintListEntry);
+   }
+}
+
 /*
  * IntInvalidateWindows
  *
@@ -758,6 +784,12 @@ IntInvalidateWindows(PWND Wnd, PREGION Rgn, ULONG Flags)
          MsqIncPaintCountQueue(Wnd->head.pti);
       }
 
+      /* Hidden windows are queued too, they become dirty when shown. */
+      if (Wnd->hrgnUpdate != NULL || Wnd->state & WNDS_INTERNALPAINT)
+      {
+         IntQueuePaintWindow(Wnd);
+      }
+
    }    // The following flags are used to validate the window.
    else if (Flags & (RDW_VALIDATE|RDW_NOINTERNALPAINT|RDW_NOERASE|RDW_NOFRAME))
    {
@@ -805,6 +837,11 @@ IntInvalidateWindows(PWND Wnd, PREGION Rgn, ULONG Flags)
       {
          MsqDecPaintCountQueue(Wnd->head.pti);
       }
+
+      if (Wnd->hrgnUpdate == NULL && !(Wnd->state & WNDS_INTERNALPAINT))
+      {
+         IntDequeuePaintWindow(Wnd);
+      }
    }
 
    /*
@@ -1119,42 +1156,57 @@ IntIsWindowDirty(PWND Wnd)
 
  */
 PWND FASTCALL
-IntFindWindowToRepaint(PWND Window, PTHREADINFO Thread)
+IntFindWindowToRepaint(PTHREADINFO Thread)
 {
-   PWND hChild;
-   PWND TempWindow;
+   PLIST_ENTRY Entry;
+   PWND Window, TempWindow;
 
-   for (; Window != NULL; Window = Window->spwndNext)
+   /* Find the oldest queued window that is visible, drop the clean ones. */
+   for (Entry = Thread->PaintListHead.Flink, Window = NULL;
+        Entry != &Thread->PaintListHead;)
    {
-      if (IntWndBelongsToThread(Window, Thread))
+      TempWindow = CONTAINING_RECORD(Entry, WND, PaintListEntry);
+      Entry = Entry->Flink;
+
+      if (IntIsWindowDirty(TempWindow))
       {
-         if (IntIsWindowDirty(Window))
-         {
-            /* Make sure all non-transparent siblings are already drawn. */
-            if (Window->ExStyle & WS_EX_TRANSPARENT)
-            {
-               for (TempWindow = Window->spwndNext; TempWindow != NULL;
-                    TempWindow = TempWindow->spwndNext)
-               {
-                  if (!(TempWindow->ExStyle & WS_EX_TRANSPARENT) &&
-                       IntWndBelongsToThread(TempWindow, Thread) &&
-                       IntIsWindowDirty(TempWindow))
-                  {
-                     return TempWindow;
-                  }
-               }
-            }
-            return Window;
-         }
+         Window = TempWindow;
+         break;
       }
-      /* find a child of the specified window that needs repainting */
-      if (Window->spwndChild)
+
+      if (TempWindow->hrgnUpdate == NULL && !(TempWindow->state & WNDS_INTERNALPAINT))
       {
-         hChild = IntFindWindowToRepaint(Window->spwndChild, Thread);
-         if (hChild != NULL)
-            return hChild;
+         IntDequeuePaintWindow(TempWindow);
       }
    }
+
+   if (Window == NULL)
+      return NULL;
+
+   /* Parents are painted before their children. */
+   for (TempWindow = Window->spwndParent;
+        TempWindow != NULL;
+        TempWindow = TempWindow->spwndParent)
+   {
+      if (IntWndBelongsToThread(TempWindow, Thread) && IntIsWindowDirty(TempWindow))
+         Window = TempWindow;
+   }
+
+   /* Make sure all non-transparent siblings are already drawn. */
+   if (Window->ExStyle & WS_EX_TRANSPARENT)
+   {
+      for (TempWindow = Window->spwndNext; TempWindow != NULL;
+           TempWindow = TempWindow->spwndNext)
+      {
+         if (!(TempWindow->ExStyle & WS_EX_TRANSPARENT) &&
+              IntWndBelongsToThread(TempWindow, Thread) &&
+              IntIsWindowDirty(TempWindow))
+         {
+            return TempWindow;
+         }
+      }
+   }
+
    return Window;
 }
 
@@ -1177,7 +1229,7 @@ IntGetPaintMessage(
    MSG *Message,
    BOOL Remove)
 {
-   PWND PaintWnd, StartWnd;
+   PWND PaintWnd;
 
    if ((MsgFilterMin != 0 || MsgFilterMax != 0) &&
          (MsgFilterMin > WM_PAINT || MsgFilterMax < WM_PAINT))
@@ -1188,8 +1240,7 @@ IntGetPaintMessage(
       ERR("WM_PAINT is in a System Thread!\n");
    }
 
-   StartWnd = UserGetDesktopWindow();
-   PaintWnd = IntFindWindowToRepaint(StartWnd, Thread);
+   PaintWnd = IntFindWindowToRepaint(Thread);
 
    Message->hwnd = PaintWnd ? UserHMGetHandle(PaintWnd) : NULL;
 
@@ -147,6 +147,7 @@ typedef struct _THREADINFO
     DWORD nCntsQBits[QSIDCOUNTS]; // QS_KEY QS_MOUSEMOVE QS_MOUSEBUTTON QS_POSTMESSAGE QS_SENDMESSAGE QS_HOTKEY
 
     LIST_ENTRY WindowListHead;
+    LIST_ENTRY PaintListHead; /* Windows with an update region or internal paint pending. */
     LIST_ENTRY W32CallbackListHead;
     SINGLE_LIST_ENTRY  ReferencesList;
     ULONG cExclusiveLocks;
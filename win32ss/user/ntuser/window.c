@@ -570,6 +570,7 @@ LRESULT co_UserFreeWindow(PWND Window,
       don't get into trouble when destroying the thread windows while we're still
       in co_UserFreeWindow() */
    RemoveEntryList(&Window->ThreadListEntry);
+   IntDequeuePaintWindow(Window);
 
    BelongsToThreadData = IntWndBelongsToThread(Window, ThreadData);
 
@@ -1927,6 +1928,7 @@ PWND FASTCALL IntCreateWindow(CREATESTRUCTW* Cs,
 
    /* Insert the window into the thread's window list. */
    InsertTailList (&pti->WindowListHead, &pWnd->ThreadListEntry);
+   InitializeListHead(&pWnd->PaintListEntry);
 
    /* Handle "CS_CLASSDC", it is tested first. */
    if ( (pWnd->pcls->style & CS_CLASSDC) && !(pWnd->pcls->pdce) )